@@ -52,6 +52,23 @@ typedef struct
 #define GINKeyIsMinusInf(key) ((key)->type & GINKeyMinusInf)
 #define GINKeyIsEmptyArray(key) ((key)->type & GINKeyEmptyArray)
 
+/*
+ * Formats of the key value.  Full format keeps numerics as is, aligned.
+ * Compact format stores the value right after the type byte and packs
+ * numerics into 8 bytes ordered as float8, so numeric keys become lossy.
+ * Hash format stores a 4-byte hash of numerics too and can only search for
+ * exact values.  Scans always recheck, so lossy keys only cost false
+ * positives.
+ */
+typedef enum
+{
+	GINKeyFormatFull,
+	GINKeyFormatCompact,
+	GINKeyFormatHash
+} GINKeyFormat;
+
+#define GINKeyLenCompact(len) (offsetof(GINKey, data) + (len))
+
 #define BLOOM_BITS 2
 #define JsonbNestedContainsStrategyNumber	13
 #define JsQueryMatchStrategyNumber			14
@@ -63,6 +80,7 @@ typedef struct
 	bool	*partial_match;
 	int		*map;
 	int count, total;
+	GINKeyFormat format;
 } Entries;
 
 typedef struct
@@ -76,12 +94,14 @@ typedef struct
 
 static uint32 get_bloom_value(uint32 hash);
 static uint32 get_path_bloom(PathHashStack *stack);
-static GINKey *make_gin_key(JsonbValue *v, uint32 hash);
-static GINKey *make_gin_key_string(uint32 hash);
-static GINKey *make_gin_query_value_key(JsQueryItem *value, uint32 hash);
-static GINKey *make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtra *keyExtra);
+static GINKey *make_gin_key(JsonbValue *v, uint32 hash, GINKeyFormat format);
+static GINKey *make_gin_key_string(uint32 hash, GINKeyFormat format);
+static GINKey *make_gin_key_string_hash(uint32 value, uint32 hash, GINKeyFormat format);
+static GINKey *make_gin_key_numeric(Numeric numeric, uint32 hash, GINKeyFormat format);
+static GINKey *make_gin_query_value_key(JsQueryItem *value, uint32 hash, GINKeyFormat format);
+static GINKey *make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtra *keyExtra, GINKeyFormat format);
 static GINKey *make_gin_query_key_minus_inf(uint32 hash);
-static int32 compare_gin_key_value(GINKey *arg1, GINKey *arg2);
+static int32 compare_gin_key_value(GINKey *arg1, GINKey *arg2, GINKeyFormat format);
 static int add_entry(Entries *e, Datum key, Pointer extra, bool pmatch);
 
 PG_FUNCTION_INFO_V1(gin_compare_jsonb_value_path);
@@ -100,6 +120,24 @@ Datum gin_consistent_jsonb_value_path(PG_FUNCTION_ARGS);
 Datum gin_triconsistent_jsonb_value_path(PG_FUNCTION_ARGS);
 Datum gin_debug_query_value_path(PG_FUNCTION_ARGS);
 
+PG_FUNCTION_INFO_V1(gin_compare_jsonb_value_path_compact);
+PG_FUNCTION_INFO_V1(gin_compare_partial_jsonb_value_path_compact);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_value_path_compact);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_query_value_path_compact);
+PG_FUNCTION_INFO_V1(gin_compare_jsonb_value_path_hash);
+PG_FUNCTION_INFO_V1(gin_compare_partial_jsonb_value_path_hash);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_value_path_hash);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_query_value_path_hash);
+
+Datum gin_compare_jsonb_value_path_compact(PG_FUNCTION_ARGS);
+Datum gin_compare_partial_jsonb_value_path_compact(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_value_path_compact(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_query_value_path_compact(PG_FUNCTION_ARGS);
+Datum gin_compare_jsonb_value_path_hash(PG_FUNCTION_ARGS);
+Datum gin_compare_partial_jsonb_value_path_hash(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_value_path_hash(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_query_value_path_hash(PG_FUNCTION_ARGS);
+
 PG_FUNCTION_INFO_V1(gin_compare_jsonb_path_value);
 PG_FUNCTION_INFO_V1(gin_compare_partial_jsonb_path_value);
 PG_FUNCTION_INFO_V1(gin_extract_jsonb_path_value);
@@ -116,6 +154,24 @@ Datum gin_consistent_jsonb_path_value(PG_FUNCTION_ARGS);
 Datum gin_triconsistent_jsonb_path_value(PG_FUNCTION_ARGS);
 Datum gin_debug_query_path_value(PG_FUNCTION_ARGS);
 
+PG_FUNCTION_INFO_V1(gin_compare_jsonb_path_value_compact);
+PG_FUNCTION_INFO_V1(gin_compare_partial_jsonb_path_value_compact);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_path_value_compact);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_query_path_value_compact);
+PG_FUNCTION_INFO_V1(gin_compare_jsonb_path_value_hash);
+PG_FUNCTION_INFO_V1(gin_compare_partial_jsonb_path_value_hash);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_path_value_hash);
+PG_FUNCTION_INFO_V1(gin_extract_jsonb_query_path_value_hash);
+
+Datum gin_compare_jsonb_path_value_compact(PG_FUNCTION_ARGS);
+Datum gin_compare_partial_jsonb_path_value_compact(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_path_value_compact(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_query_path_value_compact(PG_FUNCTION_ARGS);
+Datum gin_compare_jsonb_path_value_hash(PG_FUNCTION_ARGS);
+Datum gin_compare_partial_jsonb_path_value_hash(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_path_value_hash(PG_FUNCTION_ARGS);
+Datum gin_extract_jsonb_query_path_value_hash(PG_FUNCTION_ARGS);
+
 static int
 add_entry(Entries *e, Datum key, Pointer extra, bool pmatch)
 {
@@ -253,8 +309,101 @@ log_gin_key(GINKey *key)
 }
 #endif
 
+/*
+ * Map numeric to uint64 keeping the order of float8 values.
+ */
+static uint64
+pack_numeric(Numeric numeric)
+{
+	float8		f;
+	uint64		u;
+
+	f = DatumGetFloat8(DirectFunctionCall1(numeric_float8_no_overflow,
+										   NumericGetDatum(numeric)));
+	if (f == 0.0)
+		f = 0.0;				/* no negative zero */
+	memcpy(&u, &f, sizeof(u));
+	if (u & UINT64CONST(0x8000000000000000))
+		u = ~u;
+	else
+		u |= UINT64CONST(0x8000000000000000);
+	return u;
+}
+
 static GINKey *
-make_gin_key(JsonbValue *v, uint32 hash)
+make_gin_key_numeric(Numeric numeric, uint32 hash, GINKeyFormat format)
+{
+	GINKey *key;
+	uint64	packed;
+	uint32	value;
+
+	switch (format)
+	{
+		case GINKeyFormatFull:
+			key = (GINKey *)palloc(GINKeyLenNumeric(VARSIZE_ANY(numeric)));
+			memcpy(GINKeyDataNumeric(key), numeric, VARSIZE_ANY(numeric));
+			SET_VARSIZE(key, GINKeyLenNumeric(VARSIZE_ANY(numeric)));
+			break;
+		case GINKeyFormatCompact:
+			packed = pack_numeric(numeric);
+			key = (GINKey *)palloc(GINKeyLenCompact(sizeof(uint64)));
+			memcpy(key->data, &packed, sizeof(uint64));
+			SET_VARSIZE(key, GINKeyLenCompact(sizeof(uint64)));
+			break;
+		case GINKeyFormatHash:
+			value = DatumGetUInt32(DirectFunctionCall1(hash_numeric,
+												NumericGetDatum(numeric)));
+			key = (GINKey *)palloc(GINKeyLenCompact(sizeof(uint32)));
+			memcpy(key->data, &value, sizeof(uint32));
+			SET_VARSIZE(key, GINKeyLenCompact(sizeof(uint32)));
+			break;
+		default:
+			elog(ERROR, "Wrong key format");
+			return NULL;
+	}
+	key->type = jbvNumeric;
+	key->hash = hash;
+	return key;
+}
+
+static GINKey *
+make_gin_key_string_hash(uint32 value, uint32 hash, GINKeyFormat format)
+{
+	GINKey *key;
+
+	if (format == GINKeyFormatFull)
+	{
+		key = (GINKey *)palloc(GINKeyLenString);
+		GINKeyDataString(key) = value;
+		SET_VARSIZE(key, GINKeyLenString);
+	}
+	else
+	{
+		key = (GINKey *)palloc(GINKeyLenCompact(sizeof(uint32)));
+		memcpy(key->data, &value, sizeof(uint32));
+		SET_VARSIZE(key, GINKeyLenCompact(sizeof(uint32)));
+	}
+	key->type = jbvString;
+	key->hash = hash;
+	return key;
+}
+
+/*
+ * Get 4-byte value of string key or of numeric key in hash format.
+ */
+static uint32
+get_gin_key_uint32(GINKey *key, GINKeyFormat format)
+{
+	uint32	value;
+
+	if (format == GINKeyFormatFull)
+		return GINKeyDataString(key);
+	memcpy(&value, key->data, sizeof(uint32));
+	return value;
+}
+
+static GINKey *
+make_gin_key(JsonbValue *v, uint32 hash, GINKeyFormat format)
 {
 	GINKey *key;
 
@@ -286,18 +435,14 @@ make_gin_key(JsonbValue *v, uint32 hash)
 	}
 	else if (v->type == jbvNumeric)
 	{
-		key = (GINKey *)palloc(GINKeyLenNumeric(VARSIZE_ANY(v->val.numeric)));
-		key->type = v->type;
-		memcpy(GINKeyDataNumeric(key), v->val.numeric, VARSIZE_ANY(v->val.numeric));
-		SET_VARSIZE(key, GINKeyLenNumeric(VARSIZE_ANY(v->val.numeric)));
+		key = make_gin_key_numeric(v->val.numeric, hash, format);
 	}
 	else if (v->type == jbvString)
 	{
-		key = (GINKey *)palloc(GINKeyLenString);
-		key->type = v->type;
-		GINKeyDataString(key) = hash_any((unsigned char *)v->val.string.val,
-														  v->val.string.len);
-		SET_VARSIZE(key, GINKeyLenString);
+		key = make_gin_key_string_hash(
+					hash_any((unsigned char *)v->val.string.val,
+							 v->val.string.len),
+					hash, format);
 	}
 	else
 	{
@@ -308,20 +453,13 @@ make_gin_key(JsonbValue *v, uint32 hash)
 }
 
 static GINKey *
-make_gin_key_string(uint32 hash)
+make_gin_key_string(uint32 hash, GINKeyFormat format)
 {
-	GINKey *key;
-
-	key = (GINKey *)palloc(GINKeyLenString);
-	key->type = jbvString;
-	GINKeyDataString(key) = 0;
-	SET_VARSIZE(key, GINKeyLenString);
-	key->hash = hash;
-	return key;
+	return make_gin_key_string_hash(0, hash, format);
 }
 
 static GINKey *
-make_gin_query_value_key(JsQueryItem *value, uint32 hash)
+make_gin_query_value_key(JsQueryItem *value, uint32 hash, GINKeyFormat format)
 {
 	GINKey *key;
 	int32	len;
@@ -336,11 +474,9 @@ make_gin_query_value_key(JsQueryItem *value, uint32 hash)
 			SET_VARSIZE(key, GINKEYLEN);
 			break;
 		case jqiString:
-			key = (GINKey *)palloc(GINKeyLenString);
-			key->type = jbvString;
 			s = jsqGetString(value, &len);
-			GINKeyDataString(key) = hash_any((unsigned char *)s, len);
-			SET_VARSIZE(key, GINKeyLenString);
+			key = make_gin_key_string_hash(hash_any((unsigned char *)s, len),
+										   hash, format);
 			break;
 		case jqiBool:
 			key = (GINKey *)palloc(GINKEYLEN);
@@ -349,10 +485,7 @@ make_gin_query_value_key(JsQueryItem *value, uint32 hash)
 			break;
 		case jqiNumeric:
 			numeric = jsqGetNumeric(value);
-			key = (GINKey *)palloc(GINKeyLenNumeric(VARSIZE_ANY(numeric)));
-			key->type = jbvNumeric;
-			memcpy(GINKeyDataNumeric(key), numeric, VARSIZE_ANY(numeric));
-			SET_VARSIZE(key, GINKeyLenNumeric(VARSIZE_ANY(numeric)));
+			key = make_gin_key_numeric(numeric, hash, format);
 			break;
 		default:
 			elog(ERROR,"Wrong state");
@@ -363,7 +496,7 @@ make_gin_query_value_key(JsQueryItem *value, uint32 hash)
 }
 
 static GINKey *
-make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtra *keyExtra)
+make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtra *keyExtra, GINKeyFormat format)
 {
 	JsonbValue	v;
 	GINKey	   *key;
@@ -371,21 +504,21 @@ make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtr
 	switch (node->type)
 	{
 		case eExactValue:
-			key = make_gin_query_value_key(node->exactValue, hash);
+			key = make_gin_query_value_key(node->exactValue, hash, format);
 			break;
 		case eEmptyArray:
 			v.type = jbvArray;
 			v.val.array.nElems = 0;
-			key = make_gin_key(&v, hash);
+			key = make_gin_key(&v, hash, format);
 			break;
 		case eInequality:
 			*partialMatch = true;
 			if (node->bounds.leftBound)
-				key = make_gin_query_value_key(node->bounds.leftBound, hash);
+				key = make_gin_query_value_key(node->bounds.leftBound, hash, format);
 			else
 				key = make_gin_query_key_minus_inf(hash);
 			if (node->bounds.rightBound)
-				keyExtra->rightBound = make_gin_query_value_key(node->bounds.rightBound, hash);
+				keyExtra->rightBound = make_gin_query_value_key(node->bounds.rightBound, hash, format);
 			else
 				keyExtra->rightBound = NULL;
 			break;
@@ -396,16 +529,16 @@ make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtr
 					*partialMatch = true;
 					v.type = jbvArray;
 					v.val.array.nElems = 1;
-					key = make_gin_key(&v, hash);
+					key = make_gin_key(&v, hash, format);
 					break;
 				case jbvObject:
 					*partialMatch = true;
 					v.type = jbvObject;
-					key = make_gin_key(&v, hash);
+					key = make_gin_key(&v, hash, format);
 					break;
 				case jbvString:
 					*partialMatch = true;
-					key = make_gin_key_string(hash);
+					key = make_gin_key_string(hash, format);
 					break;
 				case jbvNumeric:
 					*partialMatch = true;
@@ -415,11 +548,11 @@ make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtr
 					*partialMatch = true;
 					v.type = jbvBool;
 					v.val.boolean = false;
-					key = make_gin_key(&v, hash);
+					key = make_gin_key(&v, hash, format);
 					break;
 				case jbvNull:
 					v.type = jbvNull;
-					key = make_gin_key(&v, hash);
+					key = make_gin_key(&v, hash, format);
 					break;
 				default:
 					elog(ERROR,"Wrong type");
@@ -428,7 +561,7 @@ make_gin_query_key(ExtractedNode *node, bool *partialMatch, uint32 hash, KeyExtr
 			break;
 		case eAny:
 			v.type = jbvNull;
-			key = make_gin_key(&v, hash);
+			key = make_gin_key(&v, hash, format);
 			*partialMatch = true;
 			break;
 		default:
@@ -454,6 +587,11 @@ make_gin_query_key_minus_inf(uint32 hash)
 static bool
 check_value_path_entry_handler(ExtractedNode *node, Pointer extra)
 {
+	Entries	   *e = (Entries *)extra;
+
+	/* hashed numerics can't be searched for by range */
+	if (e->format == GINKeyFormatHash && node->type == eInequality)
+		return false;
 	return true;
 }
 
@@ -469,13 +607,16 @@ make_value_path_entry_handler(ExtractedNode *node, Pointer extra)
 
 	Assert(!isLogicalNodeType(node->type));
 
+	if (!check_value_path_entry_handler(node, extra))
+		return -1;
+
 	hash = get_query_path_bloom(node->path, &lossy);
 	keyExtra = (KeyExtra *)palloc(sizeof(KeyExtra));
 	keyExtra->hash = hash;
 	keyExtra->node = node;
 	keyExtra->lossyHash = lossy;
 
-	key = make_gin_query_key(node, &partialMatch, hash, keyExtra);
+	key = make_gin_query_key(node, &partialMatch, hash, keyExtra, e->format);
 
 	result = add_entry(e, PointerGetDatum(key), (Pointer)keyExtra,
 											lossy | partialMatch);
@@ -483,8 +624,11 @@ make_value_path_entry_handler(ExtractedNode *node, Pointer extra)
 }
 
 static int32
-compare_gin_key_value(GINKey *arg1, GINKey *arg2)
+compare_gin_key_value(GINKey *arg1, GINKey *arg2, GINKeyFormat format)
 {
+	uint64		packed1,
+				packed2;
+
 	if (GINKeyType(arg1) != GINKeyType(arg2))
 	{
 		return (GINKeyType(arg1) > GINKeyType(arg2)) ? 1 : -1;
@@ -523,16 +667,38 @@ compare_gin_key_value(GINKey *arg1, GINKey *arg2)
 					if (GINKeyIsMinusInf(arg2))
 						return 1;
 				}
+				if (format == GINKeyFormatCompact)
+				{
+					memcpy(&packed1, arg1->data, sizeof(uint64));
+					memcpy(&packed2, arg2->data, sizeof(uint64));
+					if (packed1 == packed2)
+						return 0;
+					return (packed1 > packed2) ? 1 : -1;
+				}
+				else if (format == GINKeyFormatHash)
+				{
+					uint32	h1 = get_gin_key_uint32(arg1, format),
+							h2 = get_gin_key_uint32(arg2, format);
+
+					if (h1 == h2)
+						return 0;
+					return (h1 > h2) ? 1 : -1;
+				}
 				return DatumGetInt32(DirectFunctionCall2(numeric_cmp,
 							 PointerGetDatum(GINKeyDataNumeric(arg1)),
 							 PointerGetDatum(GINKeyDataNumeric(arg2))));
 			case jbvString:
-				if (GINKeyDataString(arg1) < GINKeyDataString(arg2))
-					return -1;
-				else if (GINKeyDataString(arg1) == GINKeyDataString(arg2))
-					return 0;
-				else
-					return 1;
+				{
+					uint32	h1 = get_gin_key_uint32(arg1, format),
+							h2 = get_gin_key_uint32(arg2, format);
+
+					if (h1 < h2)
+						return -1;
+					else if (h1 == h2)
+						return 0;
+					else
+						return 1;
+				}
 			default:
 				elog(ERROR, "GINKey must be scalar");
 				return 0;
@@ -540,14 +706,14 @@ compare_gin_key_value(GINKey *arg1, GINKey *arg2)
 	}
 }
 
-Datum
-gin_compare_jsonb_value_path(PG_FUNCTION_ARGS)
+static Datum
+compare_jsonb_value_path(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	GINKey	   *arg1 = (GINKey *)PG_GETARG_VARLENA_P(0);
 	GINKey	   *arg2 = (GINKey *)PG_GETARG_VARLENA_P(1);
 	int32		result = 0;
 
-	result = compare_gin_key_value(arg1, arg2);
+	result = compare_gin_key_value(arg1, arg2, format);
 	if (result == 0 && arg1->hash != arg2->hash)
 	{
 		result = (arg1->hash > arg2->hash) ? 1 : -1;
@@ -557,13 +723,14 @@ gin_compare_jsonb_value_path(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32(result);
 }
 
-Datum
-gin_compare_partial_jsonb_value_path(PG_FUNCTION_ARGS)
+static Datum
+compare_partial_jsonb_value_path(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	GINKey	   *partial_key = (GINKey *)PG_GETARG_VARLENA_P(0);
 	GINKey	   *key = (GINKey *)PG_GETARG_VARLENA_P(1);
 	StrategyNumber strategy = PG_GETARG_UINT16(2);
 	int32		result;
+	bool		lossyBounds;
 
 	if (strategy == JsQueryMatchStrategyNumber)
 	{
@@ -574,20 +741,22 @@ gin_compare_partial_jsonb_value_path(PG_FUNCTION_ARGS)
 		{
 			case eExactValue:
 			case eEmptyArray:
-				result = compare_gin_key_value(key, partial_key);
+				result = compare_gin_key_value(key, partial_key, format);
 				break;
 			case eInequality:
+				/* lossy keys equal to a bound may hold values beyond it */
+				lossyBounds = (format != GINKeyFormatFull);
 				result = 0;
-				if (!node->bounds.leftInclusive &&
-						compare_gin_key_value(key, partial_key) <= 0)
+				if (!node->bounds.leftInclusive && !lossyBounds &&
+						compare_gin_key_value(key, partial_key, format) <= 0)
 				{
 					result = -1;
 				}
 				if (result == 0 && extra->rightBound)
 				{
-					result = compare_gin_key_value(key,	extra->rightBound);
-					if ((node->bounds.rightInclusive && result <= 0)
-																|| result < 0)
+					result = compare_gin_key_value(key, extra->rightBound, format);
+					if (((node->bounds.rightInclusive || lossyBounds) &&
+						 result <= 0) || result < 0)
 						result = 0;
 					else
 						result = 1;
@@ -626,7 +795,7 @@ gin_compare_partial_jsonb_value_path(PG_FUNCTION_ARGS)
 		uint32 *extra_data = (uint32 *)PG_GETARG_POINTER(3);
 		uint32	bloom = *extra_data;
 
-		result = compare_gin_key_value(key, partial_key);
+		result = compare_gin_key_value(key, partial_key, format);
 
 		if (result == 0)
 		{
@@ -641,7 +810,8 @@ gin_compare_partial_jsonb_value_path(PG_FUNCTION_ARGS)
 }
 
 static Datum *
-gin_extract_jsonb_value_path_internal(Jsonb *jb, int32 *nentries, uint32 **bloom)
+gin_extract_jsonb_value_path_internal(Jsonb *jb, int32 *nentries, uint32 **bloom,
+									  GINKeyFormat format)
 {
 	int			total = 2 * JB_ROOT_COUNT(jb);
 	JsonbIterator *it;
@@ -681,10 +851,10 @@ gin_extract_jsonb_value_path_internal(Jsonb *jb, int32 *nentries, uint32 **bloom
 		switch (r)
 		{
 			case WJB_BEGIN_ARRAY:
-				entries[i++] = PointerGetDatum(make_gin_key(&v, get_path_bloom(stack)));
+				entries[i++] = PointerGetDatum(make_gin_key(&v, get_path_bloom(stack), format));
 				break;
 			case WJB_BEGIN_OBJECT:
-				entries[i++] = PointerGetDatum(make_gin_key(&v, get_path_bloom(stack)));
+				entries[i++] = PointerGetDatum(make_gin_key(&v, get_path_bloom(stack), format));
 				tmp = stack;
 				stack = (PathHashStack *) palloc(sizeof(PathHashStack));
 				stack->parent = tmp;
@@ -704,7 +874,7 @@ gin_extract_jsonb_value_path_internal(Jsonb *jb, int32 *nentries, uint32 **bloom
 				{
 					hash = get_path_bloom(stack);
 				}
-				entries[i++] =  PointerGetDatum(make_gin_key(&v, hash));
+				entries[i++] =  PointerGetDatum(make_gin_key(&v, hash, format));
 				break;
 			case WJB_END_OBJECT:
 				/* Pop the stack */
@@ -724,13 +894,14 @@ gin_extract_jsonb_value_path_internal(Jsonb *jb, int32 *nentries, uint32 **bloom
 	return entries;
 }
 
-Datum
-gin_extract_jsonb_value_path(PG_FUNCTION_ARGS)
+static Datum
+extract_jsonb_value_path(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	Jsonb	   *jb = PG_GETARG_JSONB(0);
 	int32	   *nentries = (int32 *) PG_GETARG_POINTER(1);
 
-	PG_RETURN_POINTER(gin_extract_jsonb_value_path_internal(jb, nentries, NULL));
+	PG_RETURN_POINTER(gin_extract_jsonb_value_path_internal(jb, nentries, NULL,
+															 format));
 }
 
 Datum
@@ -746,8 +917,8 @@ gin_debug_query_value_path(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(cstring_to_text(s));
 }
 
-Datum
-gin_extract_jsonb_query_value_path(PG_FUNCTION_ARGS)
+static Datum
+extract_jsonb_query_value_path(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	Jsonb	   *jb;
 	int32	   *nentries = (int32 *) PG_GETARG_POINTER(1);
@@ -762,16 +933,20 @@ gin_extract_jsonb_query_value_path(PG_FUNCTION_ARGS)
 	JsQuery	   *jq;
 	ExtractedNode *root;
 
+	e.format = format;
+
 	switch(strategy)
 	{
 		case JsonbContainsStrategyNumber:
 			jb = PG_GETARG_JSONB(0);
-			entries = gin_extract_jsonb_value_path_internal(jb, nentries, NULL);
+			entries = gin_extract_jsonb_value_path_internal(jb, nentries, NULL,
+															format);
 			break;
 
 		case JsonbNestedContainsStrategyNumber:
 			jb = PG_GETARG_JSONB(0);
-			entries = gin_extract_jsonb_value_path_internal(jb, nentries, &bloom);
+			entries = gin_extract_jsonb_value_path_internal(jb, nentries, &bloom,
+															format);
 
 			n = *nentries;
 			*pmatch = (bool *) palloc(sizeof(bool) * n);
@@ -922,6 +1097,78 @@ gin_triconsistent_jsonb_value_path(PG_FUNCTION_ARGS)
 	PG_RETURN_GIN_TERNARY_VALUE(res);
 }
 
+Datum
+gin_compare_jsonb_value_path(PG_FUNCTION_ARGS)
+{
+	return compare_jsonb_value_path(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_compare_partial_jsonb_value_path(PG_FUNCTION_ARGS)
+{
+	return compare_partial_jsonb_value_path(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_extract_jsonb_value_path(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_value_path(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_extract_jsonb_query_value_path(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_query_value_path(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_compare_jsonb_value_path_compact(PG_FUNCTION_ARGS)
+{
+	return compare_jsonb_value_path(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_compare_partial_jsonb_value_path_compact(PG_FUNCTION_ARGS)
+{
+	return compare_partial_jsonb_value_path(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_extract_jsonb_value_path_compact(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_value_path(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_extract_jsonb_query_value_path_compact(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_query_value_path(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_compare_jsonb_value_path_hash(PG_FUNCTION_ARGS)
+{
+	return compare_jsonb_value_path(fcinfo, GINKeyFormatHash);
+}
+
+Datum
+gin_compare_partial_jsonb_value_path_hash(PG_FUNCTION_ARGS)
+{
+	return compare_partial_jsonb_value_path(fcinfo, GINKeyFormatHash);
+}
+
+Datum
+gin_extract_jsonb_value_path_hash(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_value_path(fcinfo, GINKeyFormatHash);
+}
+
+Datum
+gin_extract_jsonb_query_value_path_hash(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_query_value_path(fcinfo, GINKeyFormatHash);
+}
+
 static bool
 get_query_path_hash(PathItem *pathItem, uint32 *hash)
 {
@@ -960,7 +1207,12 @@ get_query_path_hash(PathItem *pathItem, uint32 *hash)
 static bool
 check_path_value_entry_handler(ExtractedNode *node, Pointer extra)
 {
+	Entries	   *e = (Entries *)extra;
 	uint32		hash;
+
+	/* hashed numerics can't be searched for by range */
+	if (e->format == GINKeyFormatHash && node->type == eInequality)
+		return false;
 	hash = 0;
 	if (!get_query_path_hash(node->path, &hash))
 		return false;
@@ -979,6 +1231,9 @@ make_path_value_entry_handler(ExtractedNode *node, Pointer extra)
 
 	Assert(!isLogicalNodeType(node->type));
 
+	if (e->format == GINKeyFormatHash && node->type == eInequality)
+		return -1;
+
 	hash = 0;
 	if (!get_query_path_hash(node->path, &hash))
 		return -1;
@@ -986,14 +1241,14 @@ make_path_value_entry_handler(ExtractedNode *node, Pointer extra)
 	keyExtra = (KeyExtra *)palloc(sizeof(KeyExtra));
 	keyExtra->hash = hash;
 	keyExtra->node = node;
-	key = make_gin_query_key(node, &partialMatch, hash, keyExtra);
+	key = make_gin_query_key(node, &partialMatch, hash, keyExtra, e->format);
 
 	result = add_entry(e, PointerGetDatum(key), (Pointer)keyExtra, partialMatch);
 	return result;
 }
 
-Datum
-gin_compare_jsonb_path_value(PG_FUNCTION_ARGS)
+static Datum
+compare_jsonb_path_value(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	GINKey	   *arg1 = (GINKey *)PG_GETARG_VARLENA_P(0);
 	GINKey	   *arg2 = (GINKey *)PG_GETARG_VARLENA_P(1);
@@ -1005,20 +1260,21 @@ gin_compare_jsonb_path_value(PG_FUNCTION_ARGS)
 	}
 	else
 	{
-		result = compare_gin_key_value(arg1, arg2);
+		result = compare_gin_key_value(arg1, arg2, format);
 	}
 	PG_FREE_IF_COPY(arg1, 0);
 	PG_FREE_IF_COPY(arg2, 1);
 	PG_RETURN_INT32(result);
 }
 
-Datum
-gin_compare_partial_jsonb_path_value(PG_FUNCTION_ARGS)
+static Datum
+compare_partial_jsonb_path_value(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	GINKey	   *partial_key = (GINKey *)PG_GETARG_VARLENA_P(0);
 	GINKey	   *key = (GINKey *)PG_GETARG_VARLENA_P(1);
 	StrategyNumber strategy = PG_GETARG_UINT16(2);
 	int32		result;
+	bool		lossyBounds;
 
 	if (key->hash != partial_key->hash)
 	{
@@ -1032,17 +1288,19 @@ gin_compare_partial_jsonb_path_value(PG_FUNCTION_ARGS)
 		switch (node->type)
 		{
 			case eInequality:
+				/* lossy keys equal to a bound may hold values beyond it */
+				lossyBounds = (format != GINKeyFormatFull);
 				result = 0;
-				if (!node->bounds.leftInclusive &&
-						compare_gin_key_value(key, partial_key) <= 0)
+				if (!node->bounds.leftInclusive && !lossyBounds &&
+						compare_gin_key_value(key, partial_key, format) <= 0)
 				{
 					result = -1;
 				}
 				if (result == 0 && extra->rightBound)
 				{
-					result = compare_gin_key_value(key, extra->rightBound);
-					if ((node->bounds.rightInclusive && result <= 0)
-																|| result < 0)
+					result = compare_gin_key_value(key, extra->rightBound, format);
+					if (((node->bounds.rightInclusive || lossyBounds) &&
+						 result <= 0) || result < 0)
 						result = 0;
 					else
 						result = 1;
@@ -1064,7 +1322,7 @@ gin_compare_partial_jsonb_path_value(PG_FUNCTION_ARGS)
 	}
 	else
 	{
-		result = compare_gin_key_value(key, partial_key);
+		result = compare_gin_key_value(key, partial_key, format);
 	}
 
 	PG_FREE_IF_COPY(partial_key, 0);
@@ -1073,7 +1331,8 @@ gin_compare_partial_jsonb_path_value(PG_FUNCTION_ARGS)
 }
 
 static Datum *
-gin_extract_jsonb_path_value_internal(Jsonb *jb, int32 *nentries)
+gin_extract_jsonb_path_value_internal(Jsonb *jb, int32 *nentries,
+									  GINKeyFormat format)
 {
 	int			total = 2 * JB_ROOT_COUNT(jb);
 	JsonbIterator *it;
@@ -1111,7 +1370,7 @@ gin_extract_jsonb_path_value_internal(Jsonb *jb, int32 *nentries)
 		switch (r)
 		{
 			case WJB_BEGIN_ARRAY:
-				entries[i++] = PointerGetDatum(make_gin_key(&v, stack->hash));
+				entries[i++] = PointerGetDatum(make_gin_key(&v, stack->hash, format));
 				tmp = stack;
 				stack = (PathHashStack *) palloc(sizeof(PathHashStack));
 				stack->parent = tmp;
@@ -1120,7 +1379,7 @@ gin_extract_jsonb_path_value_internal(Jsonb *jb, int32 *nentries)
 				stack->hash ^= JB_FARRAY;
 				break;
 			case WJB_BEGIN_OBJECT:
-				entries[i++] = PointerGetDatum(make_gin_key(&v, stack->hash));
+				entries[i++] = PointerGetDatum(make_gin_key(&v, stack->hash, format));
 				tmp = stack;
 				stack = (PathHashStack *) palloc(sizeof(PathHashStack));
 				stack->parent = tmp;
@@ -1134,7 +1393,7 @@ gin_extract_jsonb_path_value_internal(Jsonb *jb, int32 *nentries)
 			case WJB_ELEM:
 			case WJB_VALUE:
 				/* Element/value case */
-				entries[i++] = PointerGetDatum(make_gin_key(&v, stack->hash));
+				entries[i++] = PointerGetDatum(make_gin_key(&v, stack->hash, format));
 				break;
 			case WJB_END_ARRAY:
 			case WJB_END_OBJECT:
@@ -1153,13 +1412,13 @@ gin_extract_jsonb_path_value_internal(Jsonb *jb, int32 *nentries)
 	return entries;
 }
 
-Datum
-gin_extract_jsonb_path_value(PG_FUNCTION_ARGS)
+static Datum
+extract_jsonb_path_value(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	Jsonb	   *jb = PG_GETARG_JSONB(0);
 	int32	   *nentries = (int32 *) PG_GETARG_POINTER(1);
 
-	PG_RETURN_POINTER(gin_extract_jsonb_path_value_internal(jb, nentries));
+	PG_RETURN_POINTER(gin_extract_jsonb_path_value_internal(jb, nentries, format));
 }
 
 Datum
@@ -1175,8 +1434,8 @@ gin_debug_query_path_value(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(cstring_to_text(s));
 }
 
-Datum
-gin_extract_jsonb_query_path_value(PG_FUNCTION_ARGS)
+static Datum
+extract_jsonb_query_path_value(FunctionCallInfo fcinfo, GINKeyFormat format)
 {
 	Jsonb	   *jb;
 	int32	   *nentries = (int32 *) PG_GETARG_POINTER(1);
@@ -1190,11 +1449,13 @@ gin_extract_jsonb_query_path_value(PG_FUNCTION_ARGS)
 	JsQuery	   *jq;
 	ExtractedNode *root;
 
+	e.format = format;
+
 	switch(strategy)
 	{
 		case JsonbContainsStrategyNumber:
 			jb = PG_GETARG_JSONB(0);
-			entries = gin_extract_jsonb_path_value_internal(jb, nentries);
+			entries = gin_extract_jsonb_path_value_internal(jb, nentries, format);
 			break;
 
 		case JsQueryMatchStrategyNumber:
@@ -1335,3 +1596,74 @@ gin_triconsistent_jsonb_path_value(PG_FUNCTION_ARGS)
 	PG_RETURN_GIN_TERNARY_VALUE(res);
 }
 
+Datum
+gin_compare_jsonb_path_value(PG_FUNCTION_ARGS)
+{
+	return compare_jsonb_path_value(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_compare_partial_jsonb_path_value(PG_FUNCTION_ARGS)
+{
+	return compare_partial_jsonb_path_value(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_extract_jsonb_path_value(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_path_value(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_extract_jsonb_query_path_value(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_query_path_value(fcinfo, GINKeyFormatFull);
+}
+
+Datum
+gin_compare_jsonb_path_value_compact(PG_FUNCTION_ARGS)
+{
+	return compare_jsonb_path_value(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_compare_partial_jsonb_path_value_compact(PG_FUNCTION_ARGS)
+{
+	return compare_partial_jsonb_path_value(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_extract_jsonb_path_value_compact(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_path_value(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_extract_jsonb_query_path_value_compact(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_query_path_value(fcinfo, GINKeyFormatCompact);
+}
+
+Datum
+gin_compare_jsonb_path_value_hash(PG_FUNCTION_ARGS)
+{
+	return compare_jsonb_path_value(fcinfo, GINKeyFormatHash);
+}
+
+Datum
+gin_compare_partial_jsonb_path_value_hash(PG_FUNCTION_ARGS)
+{
+	return compare_partial_jsonb_path_value(fcinfo, GINKeyFormatHash);
+}
+
+Datum
+gin_extract_jsonb_path_value_hash(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_path_value(fcinfo, GINKeyFormatHash);
+}
+
+Datum
+gin_extract_jsonb_query_path_value_hash(PG_FUNCTION_ARGS)
+{
+	return extract_jsonb_query_path_value(fcinfo, GINKeyFormatHash);
+}
@@ -0,0 +1,14 @@
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION jsquery UPDATE TO '1.1'" to load this file. \quit
+
+CREATE FUNCTION jsquery_sel(internal, oid, internal, integer)
+	RETURNS float8
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT STABLE;
+
+-- There is no ALTER OPERATOR ... SET (RESTRICT = ...), so update the
+-- catalog directly.
+UPDATE pg_catalog.pg_operator
+SET oprrest = 'jsquery_sel(internal,oid,internal,integer)'::pg_catalog.regprocedure
+WHERE oprcode IN ('jsquery_json_exec(jsquery,jsonb)'::pg_catalog.regprocedure,
+				  'json_jsquery_exec(jsonb,jsquery)'::pg_catalog.regprocedure);
@@ -0,0 +1,130 @@
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION jsquery UPDATE TO '1.2'" to load this file. \quit
+
+CREATE OR REPLACE FUNCTION gin_compare_jsonb_value_path_compact(bytea, bytea)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_compare_partial_jsonb_value_path_compact(bytea, bytea, smallint, internal)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_value_path_compact(internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_query_value_path_compact(anyarray, internal, smallint, internal, internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OPERATOR CLASS jsonb_value_path_compact_ops
+	FOR TYPE jsonb USING gin AS
+	OPERATOR 7  @>,
+	OPERATOR 14  @@ (jsonb, jsquery),
+	FUNCTION 1  gin_compare_jsonb_value_path_compact(bytea, bytea),
+	FUNCTION 2  gin_extract_jsonb_value_path_compact(internal, internal, internal),
+	FUNCTION 3  gin_extract_jsonb_query_value_path_compact(anyarray, internal, smallint, internal, internal, internal, internal),
+	FUNCTION 4  gin_consistent_jsonb_value_path(internal, smallint, anyarray, integer, internal, internal, internal, internal),
+	FUNCTION 5  gin_compare_partial_jsonb_value_path_compact(bytea, bytea, smallint, internal),
+	FUNCTION 6  gin_triconsistent_jsonb_value_path(internal, smallint, anyarray, integer, internal, internal, internal),
+	STORAGE bytea;
+
+CREATE OR REPLACE FUNCTION gin_compare_jsonb_value_path_hash(bytea, bytea)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_compare_partial_jsonb_value_path_hash(bytea, bytea, smallint, internal)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_value_path_hash(internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_query_value_path_hash(anyarray, internal, smallint, internal, internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OPERATOR CLASS jsonb_value_path_hash_ops
+	FOR TYPE jsonb USING gin AS
+	OPERATOR 7  @>,
+	OPERATOR 14  @@ (jsonb, jsquery),
+	FUNCTION 1  gin_compare_jsonb_value_path_hash(bytea, bytea),
+	FUNCTION 2  gin_extract_jsonb_value_path_hash(internal, internal, internal),
+	FUNCTION 3  gin_extract_jsonb_query_value_path_hash(anyarray, internal, smallint, internal, internal, internal, internal),
+	FUNCTION 4  gin_consistent_jsonb_value_path(internal, smallint, anyarray, integer, internal, internal, internal, internal),
+	FUNCTION 5  gin_compare_partial_jsonb_value_path_hash(bytea, bytea, smallint, internal),
+	FUNCTION 6  gin_triconsistent_jsonb_value_path(internal, smallint, anyarray, integer, internal, internal, internal),
+	STORAGE bytea;
+
+CREATE OR REPLACE FUNCTION gin_compare_jsonb_path_value_compact(bytea, bytea)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_compare_partial_jsonb_path_value_compact(bytea, bytea, smallint, internal)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_path_value_compact(internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_query_path_value_compact(anyarray, internal, smallint, internal, internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OPERATOR CLASS jsonb_path_value_compact_ops
+	FOR TYPE jsonb USING gin AS
+	OPERATOR 7  @>,
+	OPERATOR 14  @@ (jsonb, jsquery),
+	FUNCTION 1  gin_compare_jsonb_path_value_compact(bytea, bytea),
+	FUNCTION 2  gin_extract_jsonb_path_value_compact(internal, internal, internal),
+	FUNCTION 3  gin_extract_jsonb_query_path_value_compact(anyarray, internal, smallint, internal, internal, internal, internal),
+	FUNCTION 4  gin_consistent_jsonb_path_value(internal, smallint, anyarray, integer, internal, internal, internal, internal),
+	FUNCTION 5  gin_compare_partial_jsonb_path_value_compact(bytea, bytea, smallint, internal),
+	FUNCTION 6  gin_triconsistent_jsonb_path_value(internal, smallint, anyarray, integer, internal, internal, internal),
+	STORAGE bytea;
+
+CREATE OR REPLACE FUNCTION gin_compare_jsonb_path_value_hash(bytea, bytea)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_compare_partial_jsonb_path_value_hash(bytea, bytea, smallint, internal)
+	RETURNS integer
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_path_value_hash(internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION gin_extract_jsonb_query_path_value_hash(anyarray, internal, smallint, internal, internal, internal, internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OPERATOR CLASS jsonb_path_value_hash_ops
+	FOR TYPE jsonb USING gin AS
+	OPERATOR 7  @>,
+	OPERATOR 14  @@ (jsonb, jsquery),
+	FUNCTION 1  gin_compare_jsonb_path_value_hash(bytea, bytea),
+	FUNCTION 2  gin_extract_jsonb_path_value_hash(internal, internal, internal),
+	FUNCTION 3  gin_extract_jsonb_query_path_value_hash(anyarray, internal, smallint, internal, internal, internal, internal),
+	FUNCTION 4  gin_consistent_jsonb_path_value(internal, smallint, anyarray, integer, internal, internal, internal, internal),
+	FUNCTION 5  gin_compare_partial_jsonb_path_value_hash(bytea, bytea, smallint, internal),
+	FUNCTION 6  gin_triconsistent_jsonb_path_value(internal, smallint, anyarray, integer, internal, internal, internal),
+	STORAGE bytea;
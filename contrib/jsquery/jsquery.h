@@ -233,10 +233,14 @@ bool isLogicalNodeType(ExtractedNodeType type);
 
 ExtractedNode *extractJsQuery(JsQuery *jq, MakeEntryHandler makeHandler,
 								CheckEntryHandler checkHandler, Pointer extra);
+ExtractedNode *extractJsQueryTree(JsQuery *jq);
 char *debugJsQuery(JsQuery *jq, MakeEntryHandler makeHandler,
 								CheckEntryHandler checkHandler, Pointer extra);
 bool queryNeedRecheck(ExtractedNode *node);
 bool execRecursive(ExtractedNode *node, bool *check);
 bool execRecursiveTristate(ExtractedNode *node, GinTernaryValue *check);
 
+/* jsquery_op.c */
+bool checkScalarEquality(JsQueryItem *jsq,  JsonbValue *jb);
+
 #endif
@@ -779,6 +779,27 @@ extractJsQuery(JsQuery *jq, MakeEntryHandler makeHandler,
 	return root;
 }
 
+/*
+ * Turn jsquery into simplified tree of conditions without making entries.
+ * Used for selectivity estimation, where every condition counts regardless
+ * of its selectivity class.
+ */
+ExtractedNode *
+extractJsQueryTree(JsQuery *jq)
+{
+	ExtractedNode 	*root;
+	JsQueryItem		jsq;
+
+	jsqInit(&jsq, jq);
+	root = recursiveExtract(&jsq, false, false, NULL);
+	if (root)
+	{
+		flatternTree(root);
+		simplifyRecursive(root);
+	}
+	return root;
+}
+
 /*
  * Evaluate previously extracted tree.
  */
@@ -134,7 +134,7 @@ recursiveAll(JsQueryItem *jsq, JsonbValue *jb)
 	return res;
 }
 
-static bool
+bool
 checkScalarEquality(JsQueryItem *jsq,  JsonbValue *jb)
 {
 	int		len;
@@ -0,0 +1,1069 @@
+/*-------------------------------------------------------------------------
+ *
+ * jsquery_stats.c
+ *     Per-path statistics of jsonb columns and selectivity estimation
+ *     of jsquery operators
+ *
+ * ANALYZE of a jsonb column collects, in addition to the standard scalar
+ * statistics, one statistics slot describing the most common paths of the
+ * documents: for each path the fraction of documents having it, the most
+ * common values found there, a histogram of numeric values and the
+ * fractions of value types.  The @@ operators use it to estimate the
+ * selectivity of the conditions a jsquery is made of.
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * IDENTIFICATION
+ *    contrib/jsquery/jsquery_stats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_statistic.h"
+#include "catalog/pg_type.h"
+#include "commands/vacuum.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/json.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/selfuncs.h"
+
+#include "jsquery.h"
+
+/*
+ * Private statistics kind, see pg_statistic.h.  stavalues holds one jsonb
+ * object per path:
+ *
+ *	{"path": ["key", null, ...], "ndistinct": N,
+ *	 "mcv": [...], "mcv_freq": [...], "nonmcv_freq": F,
+ *	 "hist": [...], "hist_freq": F, "types": {"string": F, ...}}
+ *
+ * where null stands for an array element.  As in the standard statistics,
+ * the histogram describes the numeric values left out of the MCV list, and
+ * hist_freq is the fraction of documents having one of them.  stanumbers holds the fraction of
+ * non-null documents having each path, followed by the frequency to assume
+ * for paths missing from the slot and the lowest frequency the sample could
+ * show.
+ */
+#define STATISTIC_KIND_JSQUERY_PATHS	15743
+
+/* Selectivity used when no statistics are available, same as contsel() */
+#define DEFAULT_JSQUERY_SEL		0.001
+
+/* Value types, in the order values of a path are sorted in */
+typedef enum
+{
+	jsvNull,
+	jsvString,
+	jsvNumeric,
+	jsvBool,
+	jsvArray,
+	jsvObject,
+	JSV_NTYPES
+} JsqStatsValueType;
+
+static const char *const valueTypeNames[JSV_NTYPES] = {
+	"null", "string", "numeric", "bool", "array", "object"
+};
+
+/* A value found at some path of a sample document */
+typedef struct
+{
+	char	   *path;		/* path as JSON array text */
+	int			pathlen;
+	int			row;		/* sample row number */
+	int			type;		/* JsqStatsValueType */
+	char	   *value;		/* JSON text of scalar or empty array, or NULL */
+	int			valuelen;
+	double		num;		/* value of numeric */
+} PathEntry;
+
+/* A path and the range of its entries */
+typedef struct
+{
+	PathEntry  *entries;
+	int			nentries;
+	int			nrows;		/* number of documents having the path */
+	int			typerows[JSV_NTYPES];
+} PathGroup;
+
+/* A distinct value of a path */
+typedef struct
+{
+	PathEntry  *entry;			/* first of its entries */
+	int			nentries;
+	int			nrows;
+} ValueCount;
+
+typedef struct
+{
+	PathEntry  *entries;
+	int			nentries;
+	int			maxentries;
+} PathCollector;
+
+/* Extra data for compute_jsquery_stats function */
+typedef struct
+{
+	/* Saved state from std_typanalyze() */
+	AnalyzeAttrComputeStatsFunc std_compute_stats;
+	void	   *std_extra_data;
+} JsqAnalyzeExtraData;
+
+/* Path statistics of a column, as read back by the estimator */
+typedef struct
+{
+	Jsonb	   *stats;
+	JsonbContainer *path;
+	int			npath;
+	float4		freq;
+} PathStats;
+
+typedef struct
+{
+	PathStats  *paths;
+	int			npaths;
+	float4		missingfreq;
+	float4		minfreq;
+} ColumnStats;
+
+void _PG_init(void);
+
+static examine_attribute_hook_type prev_examine_attribute_hook = NULL;
+
+static void jsquery_examine_attribute(VacAttrStats *stats);
+static void compute_jsquery_stats(VacAttrStats *stats,
+					  AnalyzeAttrFetchFunc fetchfunc, int samplerows,
+					  double totalrows);
+
+/*
+ * Module load callback
+ */
+void
+_PG_init(void)
+{
+	prev_examine_attribute_hook = examine_attribute_hook;
+	examine_attribute_hook = jsquery_examine_attribute;
+}
+
+/*
+ * Arrange for compute_jsquery_stats() to run for jsonb columns, in the way
+ * array_typanalyze() wraps the standard compute_stats function.
+ */
+static void
+jsquery_examine_attribute(VacAttrStats *stats)
+{
+	JsqAnalyzeExtraData *extra_data;
+
+	if (prev_examine_attribute_hook)
+		prev_examine_attribute_hook(stats);
+
+	if (stats->attrtypid != JSONBOID || stats->compute_stats == NULL)
+		return;
+
+	extra_data = (JsqAnalyzeExtraData *) palloc(sizeof(JsqAnalyzeExtraData));
+	extra_data->std_compute_stats = stats->compute_stats;
+	extra_data->std_extra_data = stats->extra_data;
+
+	stats->compute_stats = compute_jsquery_stats;
+	stats->extra_data = extra_data;
+}
+
+static void
+addEntry(PathCollector *c, StringInfo path, int row, int type,
+		 char *value, double num)
+{
+	PathEntry  *e;
+
+	if (c->nentries >= c->maxentries)
+	{
+		if (c->maxentries >= MaxAllocSize / sizeof(PathEntry) / 2)
+			return;
+		c->maxentries *= 2;
+		c->entries = (PathEntry *) repalloc(c->entries,
+										sizeof(PathEntry) * c->maxentries);
+	}
+
+	e = &c->entries[c->nentries++];
+	e->pathlen = (path->len > 0) ? path->len + 1 : 2;
+	e->path = (char *) palloc(e->pathlen + 1);
+	e->path[0] = '[';
+	if (path->len > 0)
+		memcpy(e->path + 1, path->data + 1, path->len - 1);
+	e->path[e->pathlen - 1] = ']';
+	e->path[e->pathlen] = '\0';
+	e->row = row;
+	e->type = type;
+	e->value = value;
+	e->valuelen = value ? strlen(value) : 0;
+	e->num = num;
+}
+
+static void
+addScalarEntry(PathCollector *c, StringInfo path, int row, JsonbValue *v)
+{
+	StringInfoData buf;
+	char	   *s;
+
+	switch (v->type)
+	{
+		case jbvNull:
+			addEntry(c, path, row, jsvNull, pstrdup("null"), 0);
+			break;
+		case jbvString:
+			s = pnstrdup(v->val.string.val, v->val.string.len);
+			initStringInfo(&buf);
+			escape_json(&buf, s);
+			pfree(s);
+			addEntry(c, path, row, jsvString, buf.data, 0);
+			break;
+		case jbvNumeric:
+			s = DatumGetCString(DirectFunctionCall1(numeric_out,
+										NumericGetDatum(v->val.numeric)));
+			addEntry(c, path, row, jsvNumeric, s,
+					 DatumGetFloat8(DirectFunctionCall1(numeric_float8,
+										NumericGetDatum(v->val.numeric))));
+			break;
+		case jbvBool:
+			addEntry(c, path, row, jsvBool,
+					 pstrdup(v->val.boolean ? "true" : "false"), 0);
+			break;
+		default:
+			elog(ERROR, "unexpected jsonb value type: %d", v->type);
+	}
+}
+
+/*
+ * Add an entry for each container and scalar of the document.  The path is
+ * kept as a list of JSON items each preceded by a comma, an array element
+ * step being null.
+ */
+static void
+collectPaths(PathCollector *c, Jsonb *jb, int row)
+{
+	JsonbIterator *it;
+	JsonbValue	v;
+	int			r;
+	StringInfoData path;
+	int		   *starts;
+	int			depth = 0;
+	int			maxdepth = 16;
+
+	initStringInfo(&path);
+	starts = (int *) palloc(sizeof(int) * maxdepth);
+
+	it = JsonbIteratorInit(&jb->root);
+	while ((r = JsonbIteratorNext(&it, &v, false)) != WJB_DONE)
+	{
+		char	   *s;
+
+		switch (r)
+		{
+			case WJB_BEGIN_ARRAY:
+			case WJB_BEGIN_OBJECT:
+				if (depth >= maxdepth)
+				{
+					maxdepth *= 2;
+					starts = (int *) repalloc(starts, sizeof(int) * maxdepth);
+				}
+				starts[depth++] = path.len;
+				if (r == WJB_BEGIN_OBJECT)
+					addEntry(c, &path, row, jsvObject, NULL, 0);
+				else if (!v.val.array.rawScalar)
+				{
+					addEntry(c, &path, row, jsvArray,
+							 v.val.array.nElems == 0 ? pstrdup("[]") : NULL, 0);
+					appendStringInfoString(&path, ",null");
+				}
+				break;
+			case WJB_KEY:
+				path.len = starts[depth - 1];
+				path.data[path.len] = '\0';
+				appendStringInfoChar(&path, ',');
+				s = pnstrdup(v.val.string.val, v.val.string.len);
+				escape_json(&path, s);
+				pfree(s);
+				break;
+			case WJB_VALUE:
+			case WJB_ELEM:
+				addScalarEntry(c, &path, row, &v);
+				break;
+			case WJB_END_ARRAY:
+			case WJB_END_OBJECT:
+				path.len = starts[--depth];
+				path.data[path.len] = '\0';
+				break;
+			default:
+				elog(ERROR, "unexpected jsonb token: %d", r);
+		}
+	}
+
+	pfree(starts);
+	pfree(path.data);
+}
+
+static int
+comparePaths(const PathEntry *a, const PathEntry *b)
+{
+	int			res;
+
+	res = memcmp(a->path, b->path, Min(a->pathlen, b->pathlen));
+	if (res != 0)
+		return res;
+	return (a->pathlen > b->pathlen) ? 1 : (a->pathlen < b->pathlen) ? -1 : 0;
+}
+
+/* Order entries by path, row and type */
+static int
+compareEntriesByRow(const void *a1, const void *a2)
+{
+	const PathEntry *a = (const PathEntry *) a1;
+	const PathEntry *b = (const PathEntry *) a2;
+	int			res;
+
+	res = comparePaths(a, b);
+	if (res != 0)
+		return res;
+	if (a->row != b->row)
+		return (a->row > b->row) ? 1 : -1;
+	if (a->type != b->type)
+		return (a->type > b->type) ? 1 : -1;
+	return 0;
+}
+
+static int
+compareValues(const PathEntry *a, const PathEntry *b)
+{
+	int			res;
+
+	if (a->type != b->type)
+		return (a->type > b->type) ? 1 : -1;
+	if (a->type == jsvNumeric)
+	{
+		if (a->num != b->num)
+			return (a->num > b->num) ? 1 : -1;
+		return 0;
+	}
+	res = memcmp(a->value, b->value, Min(a->valuelen, b->valuelen));
+	if (res != 0)
+		return res;
+	return (a->valuelen > b->valuelen) ? 1 : (a->valuelen < b->valuelen) ? -1 : 0;
+}
+
+/* Order entries of a path by value and row, containers go last */
+static int
+compareEntriesByValue(const void *a1, const void *a2)
+{
+	const PathEntry *a = (const PathEntry *) a1;
+	const PathEntry *b = (const PathEntry *) a2;
+	int			res;
+
+	if (!a->value || !b->value)
+		return (a->value ? 0 : 1) - (b->value ? 0 : 1);
+	res = compareValues(a, b);
+	if (res != 0)
+		return res;
+	if (a->row != b->row)
+		return (a->row > b->row) ? 1 : -1;
+	return 0;
+}
+
+static int
+compareGroupsByRows(const void *a1, const void *a2)
+{
+	const PathGroup *a = (const PathGroup *) a1;
+	const PathGroup *b = (const PathGroup *) a2;
+
+	if (a->nrows != b->nrows)
+		return (a->nrows < b->nrows) ? 1 : -1;
+	return comparePaths(a->entries, b->entries);
+}
+
+static int
+compareEntryPtrsByValue(const void *a1, const void *a2)
+{
+	return compareValues(*(PathEntry *const *) a1, *(PathEntry *const *) a2);
+}
+
+static int
+compareValueCountsByRows(const void *a1, const void *a2)
+{
+	const ValueCount *a = (const ValueCount *) a1;
+	const ValueCount *b = (const ValueCount *) a2;
+
+	if (a->nrows != b->nrows)
+		return (a->nrows < b->nrows) ? 1 : -1;
+	return compareValues(a->entry, b->entry);
+}
+
+/*
+ * Make the jsonb object describing values of the path.
+ */
+static Datum
+makePathStats(PathGroup *group, int nonnull_cnt, int num_mcv, int num_hist)
+{
+	StringInfoData buf;
+	ValueCount *values;
+	int			nvalues = 0;
+	int			nnumerics = 0;
+	int			nmcv;
+	int			nonmcv_rows = 0;
+	int			hist_rows = 0;
+	PathEntry **numerics;
+	int			i,
+				j;
+
+	pg_qsort(group->entries, group->nentries, sizeof(PathEntry),
+			 compareEntriesByValue);
+
+	/* count documents for each distinct value */
+	values = (ValueCount *) palloc(sizeof(ValueCount) * group->nentries);
+	for (i = 0; i < group->nentries; i++)
+	{
+		PathEntry  *e = &group->entries[i];
+
+		if (!e->value)
+			break;
+		if (nvalues == 0 || compareValues(values[nvalues - 1].entry, e) != 0)
+		{
+			values[nvalues].entry = e;
+			values[nvalues].nentries = 1;
+			values[nvalues].nrows = 1;
+			nvalues++;
+		}
+		else
+		{
+			values[nvalues - 1].nentries++;
+			if (e->row != group->entries[i - 1].row)
+				values[nvalues - 1].nrows++;
+		}
+	}
+
+	/*
+	 * Keep all the values if they fit, otherwise only the ones seen in more
+	 * than one document.
+	 */
+	pg_qsort(values, nvalues, sizeof(ValueCount), compareValueCountsByRows);
+	nmcv = Min(nvalues, num_mcv);
+	if (nvalues > num_mcv)
+	{
+		while (nmcv > 0 && values[nmcv - 1].nrows < 2)
+			nmcv--;
+	}
+	for (i = nmcv; i < nvalues; i++)
+		nonmcv_rows += values[i].nrows;
+
+	/* the histogram is made of the numeric values not in the MCV list */
+	numerics = (PathEntry **) palloc(sizeof(PathEntry *) * group->nentries);
+	for (i = nmcv; i < nvalues; i++)
+	{
+		if (values[i].entry->type != jsvNumeric)
+			continue;
+		for (j = 0; j < values[i].nentries; j++)
+			numerics[nnumerics++] = values[i].entry + j;
+		hist_rows += values[i].nrows;
+	}
+	pg_qsort(numerics, nnumerics, sizeof(PathEntry *),
+			 compareEntryPtrsByValue);
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "{\"path\": %s, \"ndistinct\": %d, \"mcv\": [",
+					 group->entries[0].path, nvalues);
+	for (i = 0; i < nmcv; i++)
+		appendStringInfo(&buf, "%s%s", i > 0 ? ", " : "",
+						 values[i].entry->value);
+	appendStringInfoString(&buf, "], \"mcv_freq\": [");
+	for (i = 0; i < nmcv; i++)
+		appendStringInfo(&buf, "%s%g", i > 0 ? ", " : "",
+						 (double) values[i].nrows / nonnull_cnt);
+	appendStringInfo(&buf, "], \"nonmcv_freq\": %g, \"hist\": [",
+					 (double) nonmcv_rows / nonnull_cnt);
+
+	/* equi-depth histogram of the remaining numeric values */
+	if (nnumerics >= 2)
+	{
+		int			nhist = Min(num_hist, nnumerics);
+
+		for (i = 0; i < nhist; i++)
+		{
+			int			pos = (int) (((int64) i * (nnumerics - 1)) / (nhist - 1));
+
+			appendStringInfo(&buf, "%s%s", i > 0 ? ", " : "",
+							 numerics[pos]->value);
+		}
+	}
+	appendStringInfo(&buf, "], \"hist_freq\": %g, \"types\": {",
+					 (double) hist_rows / nonnull_cnt);
+	for (i = 0; i < JSV_NTYPES; i++)
+	{
+		if (group->typerows[i] > 0)
+			appendStringInfo(&buf, "%s\"%s\": %g",
+							 buf.data[buf.len - 1] == '{' ? "" : ", ",
+							 valueTypeNames[i],
+							 (double) group->typerows[i] / nonnull_cnt);
+	}
+	appendStringInfoString(&buf, "}}");
+
+	pfree(numerics);
+	pfree(values);
+
+	return DirectFunctionCall1(jsonb_in, CStringGetDatum(buf.data));
+}
+
+/*
+ * compute_jsquery_stats() -- compute path statistics for a jsonb column
+ *
+ * The standard statistics are computed first.  Then all the paths of the
+ * sample documents are gathered with the values found there and sorted, so
+ * each path and each of its values can be counted once per document.  The
+ * most common paths get described in a free statistics slot.
+ */
+static void
+compute_jsquery_stats(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfunc,
+					  int samplerows, double totalrows)
+{
+	JsqAnalyzeExtraData *extra_data;
+	MemoryContext collect_context;
+	MemoryContext row_context;
+	MemoryContext old_context;
+	PathCollector c;
+	PathGroup  *groups;
+	int			ngroups = 0;
+	int			nonnull_cnt = 0;
+	int			num_paths;
+	int			num_mcv;
+	int			num_hist;
+	int			slot;
+	int			i;
+
+	extra_data = (JsqAnalyzeExtraData *) stats->extra_data;
+
+	/* Let the standard code compute scalar statistics first */
+	stats->extra_data = extra_data->std_extra_data;
+	extra_data->std_compute_stats(stats, fetchfunc, samplerows, totalrows);
+	stats->extra_data = extra_data;
+
+	if (!stats->stats_valid)
+		return;
+
+	for (slot = 0; slot < STATISTIC_NUM_SLOTS; slot++)
+	{
+		if (stats->stakind[slot] == 0)
+			break;
+	}
+	if (slot >= STATISTIC_NUM_SLOTS)
+		return;
+
+	num_paths = stats->attr->attstattarget;
+	num_mcv = Max(stats->attr->attstattarget / 10, 10);
+	num_hist = num_mcv + 1;
+
+	collect_context = AllocSetContextCreate(CurrentMemoryContext,
+											"jsquery path statistics",
+											ALLOCSET_DEFAULT_MINSIZE,
+											ALLOCSET_DEFAULT_INITSIZE,
+											ALLOCSET_DEFAULT_MAXSIZE);
+	row_context = AllocSetContextCreate(collect_context,
+										"jsquery path statistics row",
+										ALLOCSET_SMALL_MINSIZE,
+										ALLOCSET_SMALL_INITSIZE,
+										ALLOCSET_SMALL_MAXSIZE);
+	old_context = MemoryContextSwitchTo(collect_context);
+
+	c.nentries = 0;
+	c.maxentries = 1024;
+	c.entries = (PathEntry *) palloc(sizeof(PathEntry) * c.maxentries);
+
+	for (i = 0; i < samplerows; i++)
+	{
+		Datum		value;
+		bool		isnull;
+
+		vacuum_delay_point();
+
+		value = fetchfunc(stats, i, &isnull);
+		if (isnull)
+			continue;
+		nonnull_cnt++;
+
+		MemoryContextSwitchTo(row_context);
+		value = PointerGetDatum(DatumGetJsonb(value));
+		MemoryContextSwitchTo(collect_context);
+
+		collectPaths(&c, (Jsonb *) DatumGetPointer(value), nonnull_cnt);
+
+		MemoryContextReset(row_context);
+	}
+
+	if (nonnull_cnt == 0 || c.nentries == 0)
+	{
+		MemoryContextSwitchTo(old_context);
+		MemoryContextDelete(collect_context);
+		return;
+	}
+
+	/* Split entries into paths and count documents having each of them */
+	pg_qsort(c.entries, c.nentries, sizeof(PathEntry), compareEntriesByRow);
+	groups = (PathGroup *) palloc(sizeof(PathGroup) * c.nentries);
+	for (i = 0; i < c.nentries; i++)
+	{
+		PathEntry  *e = &c.entries[i];
+		PathGroup  *g;
+
+		if (ngroups == 0 || comparePaths(groups[ngroups - 1].entries, e) != 0)
+		{
+			g = &groups[ngroups++];
+			memset(g, 0, sizeof(PathGroup));
+			g->entries = e;
+		}
+		else
+			g = &groups[ngroups - 1];
+
+		if (g->nentries == 0 || e[-1].row != e->row)
+		{
+			g->nrows++;
+			g->typerows[e->type]++;
+		}
+		else if (e[-1].type != e->type)
+			g->typerows[e->type]++;
+		g->nentries++;
+	}
+
+	pg_qsort(groups, ngroups, sizeof(PathGroup), compareGroupsByRows);
+	num_paths = Min(num_paths, ngroups);
+
+	MemoryContextSwitchTo(stats->anl_context);
+	{
+		Datum	   *values;
+		float4	   *numbers;
+
+		values = (Datum *) palloc(sizeof(Datum) * num_paths);
+		numbers = (float4 *) palloc(sizeof(float4) * (num_paths + 2));
+
+		for (i = 0; i < num_paths; i++)
+		{
+			MemoryContextSwitchTo(collect_context);
+			values[i] = makePathStats(&groups[i], nonnull_cnt,
+									  num_mcv, num_hist);
+			MemoryContextSwitchTo(stats->anl_context);
+			values[i] = datumCopy(values[i], false, -1);
+			numbers[i] = (double) groups[i].nrows / nonnull_cnt;
+		}
+
+		/* frequency to assume for a path missing from the slot */
+		numbers[num_paths] = (num_paths < ngroups) ?
+			(double) groups[num_paths].nrows / nonnull_cnt :
+			0.5 / nonnull_cnt;
+		/* lowest frequency the sample can tell */
+		numbers[num_paths + 1] = 1.0 / nonnull_cnt;
+
+		stats->stakind[slot] = STATISTIC_KIND_JSQUERY_PATHS;
+		stats->staop[slot] = InvalidOid;
+		stats->stavalues[slot] = values;
+		stats->numvalues[slot] = num_paths;
+		stats->stanumbers[slot] = numbers;
+		stats->numnumbers[slot] = num_paths + 2;
+		stats->statypid[slot] = JSONBOID;
+		stats->statyplen[slot] = -1;
+		stats->statypbyval[slot] = false;
+		stats->statypalign[slot] = 'i';
+	}
+
+	MemoryContextSwitchTo(old_context);
+	MemoryContextDelete(collect_context);
+}
+
+/*
+ * Get field of the path statistics object.
+ */
+static JsonbValue *
+getStatsField(PathStats *ps, const char *name)
+{
+	JsonbValue	key;
+
+	key.type = jbvString;
+	key.val.string.val = (char *) name;
+	key.val.string.len = strlen(name);
+
+	return findJsonbValueFromContainer(&ps->stats->root, JB_FOBJECT, &key);
+}
+
+static float8
+getNumber(JsonbValue *v)
+{
+	if (!v || v->type != jbvNumeric)
+		return 0.0;
+	return DatumGetFloat8(DirectFunctionCall1(numeric_float8,
+									NumericGetDatum(v->val.numeric)));
+}
+
+static int
+getArraySize(JsonbValue *v, JsonbContainer **container)
+{
+	if (!v || v->type != jbvBinary ||
+		!(v->val.binary.data->header & JB_FARRAY))
+		return 0;
+	*container = v->val.binary.data;
+	return v->val.binary.data->header & JB_CMASK;
+}
+
+/*
+ * Check if the path of the statistics matches jsquery path items, starting
+ * from its step number i.
+ */
+static bool
+matchPath(PathItem **items, int nitems, PathStats *ps, int i)
+{
+	PathItem   *item;
+	JsonbValue *step;
+
+	check_stack_depth();
+
+	if (nitems == 0)
+		return i == ps->npath;
+
+	item = items[0];
+	if (item->type == iAny)
+	{
+		int			j;
+
+		for (j = i; j <= ps->npath; j++)
+		{
+			if (matchPath(items + 1, nitems - 1, ps, j))
+				return true;
+		}
+		return false;
+	}
+
+	if (i >= ps->npath)
+		return false;
+
+	step = getIthJsonbValueFromContainer(ps->path, i);
+	switch (item->type)
+	{
+		case iKey:
+			if (step->type != jbvString ||
+				step->val.string.len != item->len ||
+				memcmp(step->val.string.val, item->s, item->len) != 0)
+				return false;
+			break;
+		case iAnyKey:
+			if (step->type != jbvString)
+				return false;
+			break;
+		case iAnyArray:
+			if (step->type != jbvNull)
+				return false;
+			break;
+		default:
+			elog(ERROR, "Wrong state");
+	}
+
+	return matchPath(items + 1, nitems - 1, ps, i + 1);
+}
+
+/*
+ * Fraction of the histogram values lying below the value.
+ */
+static Selectivity
+histogramFraction(JsonbContainer *hist, int nhist, float8 value)
+{
+	int			i;
+	float8		lo,
+				hi;
+
+	lo = getNumber(getIthJsonbValueFromContainer(hist, 0));
+	if (value <= lo)
+		return 0.0;
+
+	for (i = 1; i < nhist; i++)
+	{
+		hi = getNumber(getIthJsonbValueFromContainer(hist, i));
+		if (value < hi)
+			return (i - 1 + (value - lo) / (hi - lo)) / (nhist - 1);
+		lo = hi;
+	}
+
+	return 1.0;
+}
+
+/*
+ * Selectivity of the condition on non-null values having this path.
+ */
+static Selectivity
+leafSelectivity(ExtractedNode *node, PathStats *ps)
+{
+	JsonbContainer *mcv = NULL,
+			   *mcv_freq = NULL,
+			   *hist = NULL;
+	int			nmcv,
+				nhist,
+				i;
+	float8		ndistinct;
+	float8		typefreq;
+	float8		histfreq;
+	float8		left = 0.0,
+				right = 0.0;
+	JsonbValue *types;
+	Selectivity sel,
+				histsel;
+
+	switch (node->type)
+	{
+		case eAny:
+			return ps->freq;
+
+		case eIs:
+			types = getStatsField(ps, "types");
+			if (!types || types->type != jbvBinary)
+				return 0.0;
+			for (i = 0; i < JSV_NTYPES; i++)
+			{
+				static const int jbvTypes[JSV_NTYPES] = {
+					jbvNull, jbvString, jbvNumeric, jbvBool, jbvArray, jbvObject
+				};
+				JsonbValue	key;
+
+				if (jbvTypes[i] != node->isType)
+					continue;
+				key.type = jbvString;
+				key.val.string.val = (char *) valueTypeNames[i];
+				key.val.string.len = strlen(valueTypeNames[i]);
+				return getNumber(findJsonbValueFromContainer(
+										types->val.binary.data,
+										JB_FOBJECT, &key));
+			}
+			return 0.0;
+
+		case eExactValue:
+		case eEmptyArray:
+			nmcv = getArraySize(getStatsField(ps, "mcv"), &mcv);
+			if (getArraySize(getStatsField(ps, "mcv_freq"), &mcv_freq) != nmcv)
+				return 0.0;
+			for (i = 0; i < nmcv; i++)
+			{
+				JsonbValue *v = getIthJsonbValueFromContainer(mcv, i);
+				bool		match;
+
+				if (node->type == eEmptyArray)
+					match = (v->type == jbvBinary &&
+							 (v->val.binary.data->header & JB_FARRAY) &&
+							 (v->val.binary.data->header & JB_CMASK) == 0);
+				else
+					match = checkScalarEquality(node->exactValue, v);
+
+				if (match)
+					return getNumber(getIthJsonbValueFromContainer(mcv_freq, i));
+			}
+			ndistinct = getNumber(getStatsField(ps, "ndistinct"));
+			return getNumber(getStatsField(ps, "nonmcv_freq")) /
+				Max(ndistinct - nmcv, 1.0);
+
+		case eInequality:
+			types = getStatsField(ps, "types");
+			if (!types || types->type != jbvBinary)
+				return 0.0;
+			{
+				JsonbValue	key;
+
+				key.type = jbvString;
+				key.val.string.val = (char *) valueTypeNames[jsvNumeric];
+				key.val.string.len = strlen(valueTypeNames[jsvNumeric]);
+				typefreq = getNumber(findJsonbValueFromContainer(
+										types->val.binary.data,
+										JB_FOBJECT, &key));
+			}
+
+			if ((node->bounds.leftBound &&
+				 node->bounds.leftBound->type != jqiNumeric) ||
+				(node->bounds.rightBound &&
+				 node->bounds.rightBound->type != jqiNumeric))
+				return typefreq * DEFAULT_INEQ_SEL;
+
+			if (node->bounds.leftBound)
+				left = DatumGetFloat8(DirectFunctionCall1(numeric_float8,
+					NumericGetDatum(jsqGetNumeric(node->bounds.leftBound))));
+			if (node->bounds.rightBound)
+				right = DatumGetFloat8(DirectFunctionCall1(numeric_float8,
+					NumericGetDatum(jsqGetNumeric(node->bounds.rightBound))));
+
+			/* numeric MCVs within the bounds */
+			sel = 0.0;
+			nmcv = getArraySize(getStatsField(ps, "mcv"), &mcv);
+			if (getArraySize(getStatsField(ps, "mcv_freq"), &mcv_freq) != nmcv)
+				nmcv = 0;
+			for (i = 0; i < nmcv; i++)
+			{
+				JsonbValue *v = getIthJsonbValueFromContainer(mcv, i);
+				float8		num;
+
+				if (v->type != jbvNumeric)
+					continue;
+				num = getNumber(v);
+				if (node->bounds.leftBound &&
+					(node->bounds.leftInclusive ? num < left : num <= left))
+					continue;
+				if (node->bounds.rightBound &&
+					(node->bounds.rightInclusive ? num > right : num >= right))
+					continue;
+				sel += getNumber(getIthJsonbValueFromContainer(mcv_freq, i));
+			}
+
+			/* and the part of the histogram between them */
+			histfreq = getNumber(getStatsField(ps, "hist_freq"));
+			nhist = getArraySize(getStatsField(ps, "hist"), &hist);
+			if (nhist < 2)
+				return sel + histfreq * DEFAULT_INEQ_SEL;
+
+			histsel = 1.0;
+			if (node->bounds.rightBound)
+				histsel = histogramFraction(hist, nhist, right);
+			if (node->bounds.leftBound)
+				histsel -= histogramFraction(hist, nhist, left);
+			return sel + histfreq * Max(histsel, 0.0);
+
+		default:
+			elog(ERROR, "Wrong state");
+			return 0.0;
+	}
+}
+
+/*
+ * Selectivity of the extracted tree, treating conditions as independent.
+ */
+static Selectivity
+treeSelectivity(ExtractedNode *node, ColumnStats *cs)
+{
+	Selectivity sel,
+				s;
+	int			i;
+
+	check_stack_depth();
+
+	if (node->type == eAnd || node->type == eOr)
+	{
+		sel = (node->type == eAnd) ? 1.0 : 0.0;
+		for (i = 0; i < node->args.count; i++)
+		{
+			if (!node->args.items[i])
+				continue;
+			s = treeSelectivity(node->args.items[i], cs);
+			if (node->type == eAnd)
+				sel *= s;
+			else
+				sel = sel + s - sel * s;
+		}
+	}
+	else
+	{
+		PathItem  **items;
+		PathItem   *item;
+		int			nitems = 0;
+
+		for (item = node->path; item; item = item->parent)
+			nitems++;
+		items = (PathItem **) palloc(sizeof(PathItem *) * (nitems + 1));
+		i = nitems;
+		for (item = node->path; item; item = item->parent)
+			items[--i] = item;
+
+		/* a wildcard path takes the most selective match */
+		sel = -1.0;
+		for (i = 0; i < cs->npaths; i++)
+		{
+			if (matchPath(items, nitems, &cs->paths[i], 0))
+				sel = Max(sel, leafSelectivity(node, &cs->paths[i]));
+		}
+		if (sel < 0.0)
+			sel = cs->missingfreq;
+
+		sel = Max(sel, cs->minfreq / 2.0);
+		pfree(items);
+	}
+
+	CLAMP_PROBABILITY(sel);
+	return sel;
+}
+
+static Selectivity
+jsquerySelectivity(VariableStatData *vardata, JsQuery *jq)
+{
+	Form_pg_statistic stats;
+	ExtractedNode *root;
+	ColumnStats cs;
+	Datum	   *values;
+	int			nvalues;
+	float4	   *numbers;
+	int			nnumbers;
+	Selectivity sel = DEFAULT_JSQUERY_SEL;
+	int			i;
+
+	if (!get_attstatsslot(vardata->statsTuple,
+						  vardata->atttype, vardata->atttypmod,
+						  STATISTIC_KIND_JSQUERY_PATHS, InvalidOid,
+						  NULL,
+						  &values, &nvalues,
+						  &numbers, &nnumbers))
+		return sel;
+
+	root = extractJsQueryTree(jq);
+	if (root && nnumbers == nvalues + 2)
+	{
+		cs.npaths = nvalues;
+		cs.paths = (PathStats *) palloc(sizeof(PathStats) * nvalues);
+		for (i = 0; i < nvalues; i++)
+		{
+			PathStats  *ps = &cs.paths[i];
+
+			ps->stats = DatumGetJsonb(values[i]);
+			ps->freq = numbers[i];
+			ps->npath = getArraySize(getStatsField(ps, "path"), &ps->path);
+		}
+		cs.missingfreq = numbers[nvalues];
+		cs.minfreq = numbers[nvalues + 1];
+
+		stats = (Form_pg_statistic) GETSTRUCT(vardata->statsTuple);
+		sel = treeSelectivity(root, &cs) * (1.0 - stats->stanullfrac);
+	}
+
+	free_attstatsslot(vardata->atttype, values, nvalues, numbers, nnumbers);
+
+	return sel;
+}
+
+/*
+ * Restriction selectivity of jsonb @@ jsquery and jsquery @@ jsonb.
+ */
+PG_FUNCTION_INFO_V1(jsquery_sel);
+Datum
+jsquery_sel(PG_FUNCTION_ARGS)
+{
+	PlannerInfo *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+	List	   *args = (List *) PG_GETARG_POINTER(2);
+	int			varRelid = PG_GETARG_INT32(3);
+	VariableStatData vardata;
+	Node	   *other;
+	bool		varonleft;
+	Selectivity sel = DEFAULT_JSQUERY_SEL;
+
+	if (!get_restriction_variable(root, args, varRelid,
+								  &vardata, &other, &varonleft))
+		PG_RETURN_FLOAT8(DEFAULT_JSQUERY_SEL);
+
+	if (IsA(other, Const) && !((Const *) other)->constisnull &&
+		vardata.atttype == JSONBOID &&
+		HeapTupleIsValid(vardata.statsTuple))
+		sel = jsquerySelectivity(&vardata,
+						DatumGetJsQueryP(((Const *) other)->constvalue));
+
+	ReleaseVariableStats(vardata);
+
+	CLAMP_PROBABILITY(sel);
+
+	PG_RETURN_FLOAT8((float8) sel);
+}
@@ -510,4 +510,217 @@ select v from test_jsquery where v @@ 'array && [2,3]' order by v;
 select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
 select v from test_jsquery where v @@ 'array = [2,3]' order by v;
 
+drop index t_idx;
+
+create index t_idx on test_jsquery using gin (v jsonb_value_path_compact_ops);
+set enable_seqscan = off;
+
+explain (costs off) select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes < 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes >= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes <= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes = 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16' AND
+										v @@ 'review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16 and review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes ($ > 16 and $ < 20)';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids(# = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#($ = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"] and product_sales_rank > 300000';
+select count(*) from test_jsquery where v @@ 'similar_product_ids <@ ["B00000DG0U", "B00004SQXU", "B0001XAM18", "B00000FDBU", "B00000FDBV", "B000002H2H", "B000002H6C", "B000002H5E", "B000002H97", "B000002HMH"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids @> ["B000002H2H", "B000002H6C"]';
+select count(*) from test_jsquery where v @@ 'customer_id = null';
+select count(*) from test_jsquery where v @@ 'review_votes = true';
+select count(*) from test_jsquery where v @@ 'product_group = false';
+select count(*) from test_jsquery where v @@ 't = *';
+select count(*) from test_jsquery where v @@ 't is boolean';
+select count(*) from test_jsquery where v @@ 't is string';
+select count(*) from test_jsquery where v @@ 't is numeric';
+select count(*) from test_jsquery where v @@ 't is array';
+select count(*) from test_jsquery where v @@ 't is object';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is numeric';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is string';
+select count(*) from test_jsquery where v @@ 'NOT similar_product_ids.#: (NOT $ = "0440180295")';
+
+explain (costs off) select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
+select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
+drop index t_idx;
+
+create index t_idx on test_jsquery using gin (v jsonb_path_value_compact_ops);
+set enable_seqscan = off;
+
+explain (costs off) select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes < 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes >= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes <= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes = 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16' AND
+										v @@ 'review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16 and review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes ($ > 16 and $ < 20)';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids(# = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#($ = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"] and product_sales_rank > 300000';
+select count(*) from test_jsquery where v @@ 'similar_product_ids <@ ["B00000DG0U", "B00004SQXU", "B0001XAM18", "B00000FDBU", "B00000FDBV", "B000002H2H", "B000002H6C", "B000002H5E", "B000002H97", "B000002HMH"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids @> ["B000002H2H", "B000002H6C"]';
+select count(*) from test_jsquery where v @@ 'customer_id = null';
+select count(*) from test_jsquery where v @@ 'review_votes = true';
+select count(*) from test_jsquery where v @@ 'product_group = false';
+select count(*) from test_jsquery where v @@ 't = *';
+select count(*) from test_jsquery where v @@ 't is boolean';
+select count(*) from test_jsquery where v @@ 't is string';
+select count(*) from test_jsquery where v @@ 't is numeric';
+select count(*) from test_jsquery where v @@ 't is array';
+select count(*) from test_jsquery where v @@ 't is object';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is numeric';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is string';
+select count(*) from test_jsquery where v @@ 'NOT similar_product_ids.#: (NOT $ = "0440180295")';
+
+explain (costs off) select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
+select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
+drop index t_idx;
+
+create index t_idx on test_jsquery using gin (v jsonb_value_path_hash_ops);
+set enable_seqscan = off;
+
+explain (costs off) select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes < 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes >= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes <= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes = 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16' AND
+										v @@ 'review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16 and review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes ($ > 16 and $ < 20)';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids(# = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#($ = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"] and product_sales_rank > 300000';
+select count(*) from test_jsquery where v @@ 'similar_product_ids <@ ["B00000DG0U", "B00004SQXU", "B0001XAM18", "B00000FDBU", "B00000FDBV", "B000002H2H", "B000002H6C", "B000002H5E", "B000002H97", "B000002HMH"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids @> ["B000002H2H", "B000002H6C"]';
+select count(*) from test_jsquery where v @@ 'customer_id = null';
+select count(*) from test_jsquery where v @@ 'review_votes = true';
+select count(*) from test_jsquery where v @@ 'product_group = false';
+select count(*) from test_jsquery where v @@ 't = *';
+select count(*) from test_jsquery where v @@ 't is boolean';
+select count(*) from test_jsquery where v @@ 't is string';
+select count(*) from test_jsquery where v @@ 't is numeric';
+select count(*) from test_jsquery where v @@ 't is array';
+select count(*) from test_jsquery where v @@ 't is object';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is numeric';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is string';
+select count(*) from test_jsquery where v @@ 'NOT similar_product_ids.#: (NOT $ = "0440180295")';
+
+explain (costs off) select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
+select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
+drop index t_idx;
+
+create index t_idx on test_jsquery using gin (v jsonb_path_value_hash_ops);
+set enable_seqscan = off;
+
+explain (costs off) select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 0';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes < 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes >= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes <= 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes = 19';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16' AND
+										v @@ 'review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes > 16 and review_helpful_votes < 20';
+select count(*) from test_jsquery where v @@ 'review_helpful_votes ($ > 16 and $ < 20)';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids(# = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#($ = "0440180295") ';
+select count(*) from test_jsquery where v @@ 'similar_product_ids && ["0440180295"] and product_sales_rank > 300000';
+select count(*) from test_jsquery where v @@ 'similar_product_ids <@ ["B00000DG0U", "B00004SQXU", "B0001XAM18", "B00000FDBU", "B00000FDBV", "B000002H2H", "B000002H6C", "B000002H5E", "B000002H97", "B000002HMH"]';
+select count(*) from test_jsquery where v @@ 'similar_product_ids @> ["B000002H2H", "B000002H6C"]';
+select count(*) from test_jsquery where v @@ 'customer_id = null';
+select count(*) from test_jsquery where v @@ 'review_votes = true';
+select count(*) from test_jsquery where v @@ 'product_group = false';
+select count(*) from test_jsquery where v @@ 't = *';
+select count(*) from test_jsquery where v @@ 't is boolean';
+select count(*) from test_jsquery where v @@ 't is string';
+select count(*) from test_jsquery where v @@ 't is numeric';
+select count(*) from test_jsquery where v @@ 't is array';
+select count(*) from test_jsquery where v @@ 't is object';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is numeric';
+select count(*) from test_jsquery where v @@ 'similar_product_ids.#: is string';
+select count(*) from test_jsquery where v @@ 'NOT similar_product_ids.#: (NOT $ = "0440180295")';
+
+explain (costs off) select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+explain (costs off) select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
+select v from test_jsquery where v @@ 'array <@ [2,3]' order by v;
+select v from test_jsquery where v @@ 'array && [2,3]' order by v;
+select v from test_jsquery where v @@ 'array @> [2,3]' order by v;
+select v from test_jsquery where v @@ 'array = [2,3]' order by v;
+
 RESET enable_seqscan;
+
+-- row estimates of @@ from the path statistics collected by ANALYZE
+analyze test_jsquery;
+
+create function jsquery_estimate(q jsquery) returns int
+language plpgsql as $$
+declare
+	plan json;
+begin
+	execute format('explain (format json) select * from test_jsquery where v @@ %L', q)
+		into plan;
+	return (plan->0->'Plan'->>'Plan Rows')::int;
+end;
+$$;
+
+select q, jsquery_estimate(q) as estimated,
+	(select count(*) from test_jsquery where v @@ q) as actual
+from (values
+	('review_helpful_votes > 0'::jsquery),
+	('review_helpful_votes > 19'),
+	('review_helpful_votes = 19'),
+	('review_helpful_votes > 16 and review_helpful_votes < 20'),
+	('similar_product_ids && ["0440180295"]'),
+	('similar_product_ids.# = "0440180295"'),
+	('customer_id = null'),
+	('review_votes = true'),
+	('t is string'),
+	('product_group = "Book"'),
+	('not_a_key = 1')) t(q);
@@ -322,8 +322,12 @@ do_backup_database(parray *backup_list, pgBackupOption bkupopt)
 	if (num_threads < 1)
 		num_threads = 1;
 
-	/* sort by size for load balancing */
-	parray_qsort(backup_files_list, pgFileCompareSize);
+	/*
+	 * Sort by size for load balancing: largest files go first, so that
+	 * segments of big relations are spread among all threads instead of
+	 * being left for the last one.
+	 */
+	parray_qsort(backup_files_list, pgFileCompareSizeDesc);
 
 	/* init thread args with own file lists */
 	for (i = 0; i < num_threads; i++)
@@ -439,6 +443,11 @@ do_backup(pgBackupOption bkupopt)
 		elog(ERROR, "Required parameter not specified: BACKUP_MODE "
 						 "(-b, --backup-mode)");
 
+#ifndef HAVE_LIBZ
+	if (current.compress_data)
+		elog(ERROR, "this build does not support compression");
+#endif
+
 	/* Confirm data block size and xlog block size are compatible */
 	check_server_version();
 
@@ -291,6 +291,7 @@ pgBackupWriteConfigSection(FILE *out, pgBackup *backup)
 
 	fprintf(out, "# configuration\n");
 	fprintf(out, "BACKUP_MODE=%s\n", modes[backup->backup_mode]);
+	fprintf(out, "COMPRESS_DATA=%s\n", backup->compress_data ? "true" : "false");
 }
 
 /*
@@ -374,6 +375,7 @@ catalog_read_ini(const char *path)
 	pgut_option options[] =
 	{
 		{ 's', 0, "backup-mode"			, NULL, SOURCE_ENV },
+		{ 'b', 0, "compress-data"		, NULL, SOURCE_ENV },
 		{ 'u', 0, "timelineid"			, NULL, SOURCE_ENV },
 		{ 's', 0, "start-lsn"			, NULL, SOURCE_ENV },
 		{ 's', 0, "stop-lsn"			, NULL, SOURCE_ENV },
@@ -397,6 +399,7 @@ catalog_read_ini(const char *path)
 
 	i = 0;
 	options[i++].var = &backup_mode;
+	options[i++].var = &backup->compress_data;
 	options[i++].var = &backup->tli;
 	options[i++].var = &start_lsn;
 	options[i++].var = &stop_lsn;
@@ -551,4 +554,5 @@ catalog_init_config(pgBackup *backup)
 	backup->recovery_xid = 0;
 	backup->recovery_time = (time_t) 0;
 	backup->data_bytes = BYTES_INVALID;
+	backup->compress_data = false;
 }
@@ -19,6 +19,17 @@
 #include "storage/bufpage.h"
 #include "storage/checksum_impl.h"
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+/*
+ * Every backed-up page is stored as BackupPageHeader followed by the page
+ * image without its hole. If the backup is compressed (see compress_data),
+ * the header is followed by the uint16 size of the compressed image and
+ * the image itself; pages that don't shrink are stored as is, with the size
+ * equal to BLCKSZ - hole_length.
+ */
 typedef struct BackupPageHeader
 {
 	BlockNumber	block;			/* block number */
@@ -53,6 +64,171 @@ parse_page(const DataPage *page,
 	return false;
 }
 
+/*
+ * Write a page excluding hole (and compressed if asked) to the backup file,
+ * and update CRC and size of the file.
+ */
+static void
+backup_data_page(pgFile *file, FILE *in, FILE *out, const char *to_path,
+				 BackupPageHeader *header, DataPage *page, bool compress,
+				 pg_crc32 *crc)
+{
+	char		write_buffer[sizeof(BackupPageHeader) + sizeof(uint16) + BLCKSZ];
+	char	   *image;
+	size_t		write_size;
+	int			upper_offset;
+	int			upper_length;
+	uint16		page_length;
+
+	upper_offset = header->hole_offset + header->hole_length;
+	upper_length = BLCKSZ - upper_offset;
+	page_length = header->hole_offset + upper_length;
+
+	memcpy(write_buffer, header, sizeof(BackupPageHeader));
+	write_size = sizeof(BackupPageHeader);
+
+	if (compress)
+	{
+		char		raw[BLCKSZ];
+		uint16		compressed_size = page_length;
+
+		memcpy(raw, page->data, header->hole_offset);
+		memcpy(raw + header->hole_offset, page->data + upper_offset, upper_length);
+
+		image = write_buffer + write_size + sizeof(uint16);
+#ifdef HAVE_LIBZ
+		{
+			uLongf		dest_len = page_length - 1;
+
+			/* Keep the page as is if it doesn't fit into page_length - 1 */
+			if (compress2((Bytef *) image, &dest_len, (Bytef *) raw,
+						  page_length, Z_BEST_SPEED) == Z_OK)
+				compressed_size = (uint16) dest_len;
+		}
+#endif
+		if (compressed_size == page_length)
+			memcpy(image, raw, page_length);
+
+		memcpy(write_buffer + write_size, &compressed_size, sizeof(uint16));
+		write_size += sizeof(uint16) + compressed_size;
+	}
+	else
+	{
+		image = write_buffer + write_size;
+		if (header->hole_offset)
+			memcpy(image, page->data, header->hole_offset);
+		if (upper_length)
+			memcpy(image + header->hole_offset, page->data + upper_offset, upper_length);
+		write_size += page_length;
+	}
+
+	/* write data page excluding hole */
+	if (fwrite(write_buffer, 1, write_size, out) != write_size)
+	{
+		int errno_tmp = errno;
+		/* oops */
+		fclose(in);
+		fclose(out);
+		elog(ERROR, "cannot write at block %u of \"%s\": %s",
+			 header->block, to_path, strerror(errno_tmp));
+	}
+
+	/* update CRC */
+	COMP_CRC32C(*crc, write_buffer, write_size);
+
+	file->write_size += write_size;
+}
+
+/*
+ * Read the next page written by backup_data_page() and restore its hole.
+ * blknum is the lowest block number the page may have. Returns false at EOF.
+ */
+static bool
+read_data_page(FILE *in, const char *path, bool compressed, BlockNumber blknum,
+			   BackupPageHeader *header, DataPage *page)
+{
+	size_t		read_len;
+	int			upper_offset;
+	int			upper_length;
+
+	/* read BackupPageHeader */
+	read_len = fread(header, 1, sizeof(BackupPageHeader), in);
+	if (read_len != sizeof(BackupPageHeader))
+	{
+		int errno_tmp = errno;
+		if (read_len == 0 && feof(in))
+			return false;		/* EOF found */
+		else if (read_len != 0 && feof(in))
+		{
+			elog(ERROR,
+				 "odd size page found at block %u of \"%s\"",
+				 blknum, path);
+		}
+		else
+		{
+			elog(ERROR, "cannot read block %u of \"%s\": %s",
+				 blknum, path, strerror(errno_tmp));
+		}
+	}
+
+	if (header->block < blknum || header->hole_offset > BLCKSZ ||
+		(int) header->hole_offset + (int) header->hole_length > BLCKSZ)
+	{
+		elog(ERROR, "backup is broken at block %u",
+			 blknum);
+	}
+
+	upper_offset = header->hole_offset + header->hole_length;
+	upper_length = BLCKSZ - upper_offset;
+
+	/* read lower/upper into page->data and restore hole */
+	memset(page->data + header->hole_offset, 0, header->hole_length);
+
+	if (compressed)
+	{
+		char		compressed_image[BLCKSZ];
+		char		raw[BLCKSZ];
+		uint16		compressed_size;
+		uint16		page_length = header->hole_offset + upper_length;
+
+		if (fread(&compressed_size, 1, sizeof(uint16), in) != sizeof(uint16) ||
+			compressed_size > page_length ||
+			fread(compressed_image, 1, compressed_size, in) != compressed_size)
+		{
+			elog(ERROR, "cannot read block %u of \"%s\": %s",
+				 blknum, path, strerror(errno));
+		}
+
+		if (compressed_size == page_length)
+			memcpy(raw, compressed_image, page_length);
+		else
+		{
+#ifdef HAVE_LIBZ
+			uLongf		raw_len = page_length;
+
+			if (uncompress((Bytef *) raw, &raw_len, (Bytef *) compressed_image,
+						   compressed_size) != Z_OK ||
+				raw_len != page_length)
+				elog(ERROR, "cannot decompress block %u of \"%s\"",
+					 blknum, path);
+#else
+			elog(ERROR, "this build does not support compressed backups");
+#endif
+		}
+
+		memcpy(page->data, raw, header->hole_offset);
+		memcpy(page->data + upper_offset, raw + header->hole_offset, upper_length);
+	}
+	else if (fread(page->data, 1, header->hole_offset, in) != header->hole_offset ||
+			 fread(page->data + upper_offset, 1, upper_length, in) != upper_length)
+	{
+		elog(ERROR, "cannot read block %u of \"%s\": %s",
+			 blknum, path, strerror(errno));
+	}
+
+	return true;
+}
+
 /*
  * Backup data file in the from_root directory to the to_root directory with
  * same relative path.
@@ -72,8 +248,6 @@ backup_data_file(const char *from_root, const char *to_root,
 	size_t				read_len = 0;
 	pg_crc32			crc;
 	off_t				offset;
-	char				write_buffer[sizeof(header)+BLCKSZ];
-	size_t				write_buffer_real_size;
 
 	INIT_CRC32C(crc);
 
@@ -129,8 +303,6 @@ backup_data_file(const char *from_root, const char *to_root,
 			 ++blknum)
 		{
 			XLogRecPtr	page_lsn;
-			int		upper_offset;
-			int		upper_length;
 			int		try_checksum = 100;
 			bool	stop_backup = false;
 
@@ -212,33 +384,8 @@ backup_data_file(const char *from_root, const char *to_root,
 			if(stop_backup)
 				break;
 
-			upper_offset = header.hole_offset + header.hole_length;
-			upper_length = BLCKSZ - upper_offset;
-
-			write_buffer_real_size = sizeof(header)+header.hole_offset+upper_length;
-			memcpy(write_buffer, &header, sizeof(header));
-			if (header.hole_offset)
-				memcpy(write_buffer+sizeof(header), page.data, header.hole_offset);
-			if (upper_length)
-				memcpy(write_buffer+sizeof(header)+header.hole_offset, page.data + upper_offset, upper_length);
-
-			/* write data page excluding hole */
-			if(fwrite(write_buffer, 1, write_buffer_real_size, out) != write_buffer_real_size)
-			{
-				int errno_tmp = errno;
-				/* oops */
-				fclose(in);
-				fclose(out);
-				elog(ERROR, "cannot write at block %u of \"%s\": %s",
-					 blknum, to_path, strerror(errno_tmp));
-			}
-
-			/* update CRC */
-			COMP_CRC32C(crc, &header, sizeof(header));
-			COMP_CRC32C(crc, page.data, header.hole_offset);
-			COMP_CRC32C(crc, page.data + upper_offset, upper_length);
-
-			file->write_size += sizeof(header) + read_len - header.hole_length;
+			backup_data_page(file, in, out, to_path, &header, &page,
+							 current.compress_data, &crc);
 		}
 	}
 	else
@@ -248,8 +395,6 @@ backup_data_file(const char *from_root, const char *to_root,
 		while (datapagemap_next(iter, &blknum))
 		{
 			XLogRecPtr	page_lsn;
-			int		upper_offset;
-			int		upper_length;
 			int 	ret;
 			int		try_checksum = 100;
 			bool	stop_backup = false;
@@ -335,33 +480,8 @@ backup_data_file(const char *from_root, const char *to_root,
 
 			end_checks2:
 			
-			upper_offset = header.hole_offset + header.hole_length;
-			upper_length = BLCKSZ - upper_offset;
-
-			write_buffer_real_size = sizeof(header)+header.hole_offset+upper_length;
-			memcpy(write_buffer, &header, sizeof(header));
-			if (header.hole_offset)
-				memcpy(write_buffer+sizeof(header), page.data, header.hole_offset);
-			if (upper_length)
-				memcpy(write_buffer+sizeof(header)+header.hole_offset, page.data + upper_offset, upper_length);
-
-			/* write data page excluding hole */
-			if(fwrite(write_buffer, 1, write_buffer_real_size, out) != write_buffer_real_size)
-			{
-				int errno_tmp = errno;
-				/* oops */
-				fclose(in);
-				fclose(out);
-				elog(ERROR, "cannot write at block %u of \"%s\": %s",
-					 blknum, to_path, strerror(errno_tmp));
-			}
-
-			/* update CRC */
-			COMP_CRC32C(crc, &header, sizeof(header));
-			COMP_CRC32C(crc, page.data, header.hole_offset);
-			COMP_CRC32C(crc, page.data + upper_offset, upper_length);
-
-			file->write_size += sizeof(header) + read_len - header.hole_length;
+			backup_data_page(file, in, out, to_path, &header, &page,
+							 current.compress_data, &crc);
 		}
 		pg_free(iter);
 		/*
@@ -463,50 +583,11 @@ restore_data_file(const char *from_root,
 
 	for (blknum = 0; ; blknum++)
 	{
-		size_t		read_len;
 		DataPage	page;		/* used as read buffer */
-		int			upper_offset;
-		int			upper_length;
 
-		/* read BackupPageHeader */
-		read_len = fread(&header, 1, sizeof(header), in);
-		if (read_len != sizeof(header))
-		{
-			int errno_tmp = errno;
-			if (read_len == 0 && feof(in))
-				break;		/* EOF found */
-			else if (read_len != 0 && feof(in))
-			{
-				elog(ERROR,
-					 "odd size page found at block %u of \"%s\"",
-					 blknum, file->path);
-			}
-			else
-			{
-				elog(ERROR, "cannot read block %u of \"%s\": %s",
-					 blknum, file->path, strerror(errno_tmp));
-			}
-		}
-
-		if (header.block < blknum || header.hole_offset > BLCKSZ ||
-			(int) header.hole_offset + (int) header.hole_length > BLCKSZ)
-		{
-			elog(ERROR, "backup is broken at block %u",
-				 blknum);
-		}
-
-		upper_offset = header.hole_offset + header.hole_length;
-		upper_length = BLCKSZ - upper_offset;
-
-		/* read lower/upper into page.data and restore hole */
-		memset(page.data + header.hole_offset, 0, header.hole_length);
-
-		if (fread(page.data, 1, header.hole_offset, in) != header.hole_offset ||
-			fread(page.data + upper_offset, 1, upper_length, in) != upper_length)
-		{
-			elog(ERROR, "cannot read block %u of \"%s\": %s",
-				 blknum, file->path, strerror(errno));
-		}
+		if (!read_data_page(in, file->path, backup->compress_data, blknum,
+							&header, &page))
+			break;		/* EOF found */
 
 		/* update checksum because we are not save whole */
 		if(backup->checksum_version)
@@ -552,6 +633,149 @@ restore_data_file(const char *from_root,
 	fclose(out);
 }
 
+/*
+ * Version of a data file being merged by merge_data_file().
+ */
+typedef struct MergeSource
+{
+	FILE	   *in;
+	pgFile	   *file;
+	bool		compressed;		/* pages are compressed */
+	bool		eof;
+	BlockNumber	blknum;			/* lowest block number of the next page */
+	BackupPageHeader header;	/* current page */
+	DataPage	page;
+} MergeSource;
+
+/* Move the source to its next page */
+static void
+merge_source_next(MergeSource *source)
+{
+	size_t		read_len;
+	XLogRecPtr	page_lsn;
+
+	if (source->file->is_datafile)
+	{
+		if (!read_data_page(source->in, source->file->path, source->compressed,
+							source->blknum, &source->header, &source->page))
+			source->eof = true;
+		else
+			source->blknum = source->header.block + 1;
+		return;
+	}
+
+	/* plain copy of the file, pages follow each other without header */
+	read_len = fread(&source->page, 1, sizeof(DataPage), source->in);
+	if (read_len == 0 && feof(source->in))
+	{
+		source->eof = true;
+		return;
+	}
+	if (read_len != sizeof(DataPage))
+		elog(ERROR, "odd size page found at block %u of \"%s\"",
+			 source->blknum, source->file->path);
+
+	source->header.block = source->blknum++;
+	parse_page(&source->page, &page_lsn,
+			   &source->header.hole_offset, &source->header.hole_length);
+}
+
+/*
+ * Merge versions of a data file taken by a chain of backups into to_path.
+ * versions are sorted from the oldest to the newest backup and the copy of
+ * a block in the newest version wins, which gives the same file as restoring
+ * the backups one after another. Only the oldest version may be a plain copy
+ * made by copy_file(). The pages are written as backup_data_file() does, and
+ * the size and CRC of the result are stored into file.
+ */
+void
+merge_data_file(pgFile **versions, pgBackup **backups, int nversions,
+				const char *to_path, pgFile *file, bool compress)
+{
+	MergeSource	   *sources;
+	FILE		   *out;
+	pg_crc32		crc;
+	int				i;
+
+	INIT_CRC32C(crc);
+
+	/* reset size summary */
+	file->read_size = 0;
+	file->write_size = 0;
+
+	sources = pgut_malloc(sizeof(MergeSource) * nversions);
+	for (i = 0; i < nversions; i++)
+	{
+		if (i > 0 && !versions[i]->is_datafile)
+			elog(ERROR, "cannot merge plain copy \"%s\" into older versions",
+				 versions[i]->path);
+
+		sources[i].in = fopen(versions[i]->path, "r");
+		if (sources[i].in == NULL)
+			elog(ERROR, "cannot open backup file \"%s\": %s",
+				 versions[i]->path, strerror(errno));
+		sources[i].file = versions[i];
+		sources[i].compressed = backups[i]->compress_data;
+		sources[i].eof = false;
+		sources[i].blknum = 0;
+		merge_source_next(&sources[i]);
+	}
+
+	out = fopen(to_path, "w");
+	if (out == NULL)
+		elog(ERROR, "cannot open merged file \"%s\": %s",
+			 to_path, strerror(errno));
+
+	/* all versions are sorted by block number, so merge them in one pass */
+	for (;;)
+	{
+		MergeSource	   *newest = NULL;
+		BlockNumber		blknum;
+
+		for (i = 0; i < nversions; i++)
+		{
+			if (sources[i].eof)
+				continue;
+			/* on equal block numbers the later, newer version wins */
+			if (newest == NULL ||
+				sources[i].header.block <= newest->header.block)
+				newest = &sources[i];
+		}
+		if (newest == NULL)
+			break;
+
+		if (interrupted)
+			elog(ERROR, "interrupted during merge");
+
+		blknum = newest->header.block;
+		backup_data_page(file, newest->in, out, to_path, &newest->header,
+						 &newest->page, compress, &crc);
+		file->read_size += BLCKSZ;
+
+		for (i = 0; i < nversions; i++)
+		{
+			if (!sources[i].eof && sources[i].header.block == blknum)
+				merge_source_next(&sources[i]);
+		}
+	}
+
+	if (chmod(to_path, FILE_PERMISSION) == -1)
+		elog(ERROR, "cannot change mode of \"%s\": %s", to_path,
+			 strerror(errno));
+
+	for (i = 0; i < nversions; i++)
+		fclose(sources[i].in);
+	fclose(out);
+	free(sources);
+
+	/* finish CRC calculation and store into pgFile */
+	FIN_CRC32C(crc);
+	file->crc = crc;
+
+	/* Treat empty file as not-datafile, like backup_data_file() */
+	file->is_datafile = (file->write_size > 0);
+}
+
 bool
 copy_file(const char *from_root, const char *to_root, pgFile *file)
 {
@@ -208,6 +208,13 @@ pgFileCompareSize(const void *f1, const void *f2)
 		return 0;
 }
 
+/* Compare two pgFile with their size in descending order. */
+int
+pgFileCompareSizeDesc(const void *f1, const void *f2)
+{
+	return -pgFileCompareSize(f1, f2);
+}
+
 /* Compare two pgFile with their modify timestamp. */
 int
 pgFileCompareMtime(const void *f1, const void *f2)
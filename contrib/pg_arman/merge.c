@@ -0,0 +1,305 @@
+/*-------------------------------------------------------------------------
+ *
+ * merge.c: merge differential backups into a full backup.
+ *
+ * Portions Copyright (c) 2016, Postgres Professional
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "pg_arman.h"
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+static void merge_backups(parray *chain);
+
+/*
+ * Fold the chain of the latest differential backup taken before DATE (or the
+ * latest one at all) into it, so it becomes a full backup. Older backups of
+ * the chain are kept, they can be removed with the delete command.
+ */
+int
+do_merge(pgBackupRange *range)
+{
+	int			i;
+	int			ret;
+	parray	   *backup_list;
+	parray	   *chain;
+	pgBackup   *target = NULL;
+
+	/* Lock backup catalog */
+	ret = catalog_lock();
+	if (ret == -1)
+		elog(ERROR, "can't lock backup catalog.");
+	else if (ret == 1)
+		elog(ERROR,
+			"another pg_arman is running, stop merge.");
+
+	/* Get complete list of backups, (index == 0) is the last backup */
+	backup_list = catalog_get_backup_list(NULL);
+	if (!backup_list)
+		elog(ERROR, "No backup list found, can't process any more.");
+
+	/*
+	 * Collect the chain the same way restore does: the target, the
+	 * differential backups of its timeline before it, up to the full one.
+	 */
+	chain = parray_new();
+	for (i = 0; i < parray_num(backup_list); i++)
+	{
+		pgBackup *backup = (pgBackup *) parray_get(backup_list, i);
+
+		if (backup->status != BACKUP_STATUS_OK)
+			continue;
+
+		if (target == NULL)
+		{
+			if (backup->backup_mode == BACKUP_MODE_FULL ||
+				(pgBackupRangeIsValid(range) &&
+				 backup->start_time > range->begin))
+				continue;
+			target = backup;
+		}
+		else if (backup->tli != target->tli)
+			continue;
+
+		/* the chain is stored from the oldest to the newest backup */
+		parray_insert(chain, 0, backup);
+
+		if (backup->backup_mode == BACKUP_MODE_FULL)
+			break;
+	}
+
+	if (target == NULL)
+		elog(ERROR, "no differential backup found, nothing to merge.");
+	if (((pgBackup *) parray_get(chain, 0))->backup_mode != BACKUP_MODE_FULL)
+		elog(ERROR, "no full backup found, cannot merge.");
+
+	merge_backups(chain);
+
+	/* release catalog lock */
+	catalog_unlock();
+
+	/* cleanup */
+	parray_free(chain);
+	parray_walk(backup_list, pgBackupFree);
+	parray_free(backup_list);
+
+	return 0;
+}
+
+/*
+ * Read the file list of a backup with paths relative to its database
+ * directory, sorted by path.
+ */
+static parray *
+read_backup_file_list(pgBackup *backup)
+{
+	char		list_path[MAXPGPATH];
+	parray	   *files;
+
+	pgBackupGetPath(backup, list_path, lengthof(list_path), DATABASE_FILE_LIST);
+	files = dir_read_file_list(NULL, list_path);
+	parray_qsort(files, pgFileComparePath);
+
+	return files;
+}
+
+/*
+ * Rewrite the newest backup of the chain as a full backup. Every file it
+ * lists gets the content restore would give to it from the whole chain:
+ * files skipped as unchanged are taken from the newest backup having them,
+ * and pages of data files are merged from all the backups since the last
+ * plain copy of the file. New and merged data files are first written aside
+ * and only renamed over the target's files once all are done, so the target
+ * stays restorable as a differential backup until the very end.
+ */
+static void
+merge_backups(parray *chain)
+{
+	int			nbackups = parray_num(chain);
+	pgBackup  **backups = (pgBackup **) pgut_malloc(sizeof(pgBackup *) * nbackups);
+	parray	  **file_lists = (parray **) pgut_malloc(sizeof(parray *) * nbackups);
+	pgFile	   *copies = (pgFile *) pgut_malloc(sizeof(pgFile) * nbackups);
+	pgFile	  **versions = (pgFile **) pgut_malloc(sizeof(pgFile *) * nbackups);
+	int		   *owners = (int *) pgut_malloc(sizeof(int) * nbackups);
+	char	  (*roots)[MAXPGPATH] = pgut_malloc(MAXPGPATH * nbackups);
+	pgBackup   *target;
+	parray	   *files;
+	parray	   *merged = parray_new();
+	char		timestamp[100];
+	char		path[MAXPGPATH];
+	FILE	   *fp;
+	int			i;
+	int			j;
+
+	for (i = 0; i < nbackups; i++)
+	{
+		backups[i] = (pgBackup *) parray_get(chain, i);
+		if (backups[i]->block_size != BLCKSZ)
+			elog(ERROR, "BLCKSZ(%d) is not compatible(%d expected)",
+				 backups[i]->block_size, BLCKSZ);
+
+		time2iso(timestamp, lengthof(timestamp), backups[i]->start_time);
+		elog(INFO, "merge: %s %s backup", timestamp,
+			 i == 0 ? "base" : "differential");
+
+		/* size is enough here, restore does not check more */
+		pgBackupValidate(backups[i], true, false);
+		if (backups[i]->status != BACKUP_STATUS_OK)
+			elog(ERROR, "backup %s is corrupted, cannot merge", timestamp);
+
+		pgBackupGetPath(backups[i], roots[i], MAXPGPATH, DATABASE_DIR);
+		file_lists[i] = read_backup_file_list(backups[i]);
+	}
+
+	target = backups[nbackups - 1];
+	files = file_lists[nbackups - 1];
+
+	for (i = 0; i < parray_num(files); i++)
+	{
+		pgFile	   *file = (pgFile *) parray_get(files, i);
+		int			nversions = 0;
+
+		if (interrupted)
+			elog(ERROR, "interrupted during merge");
+
+		if (!S_ISREG(file->mode))
+			continue;
+
+		/* a plain file taken by the target is complete already */
+		if (!file->is_datafile && file->write_size != BYTES_INVALID)
+			continue;
+
+		/* collect versions of the file from the oldest to the newest */
+		for (j = 0; j < nbackups; j++)
+		{
+			pgFile	  **p;
+			pgFile	   *version;
+
+			p = (pgFile **) parray_bsearch(file_lists[j], file, pgFileComparePath);
+			if (p == NULL || (*p)->write_size == BYTES_INVALID)
+				continue;
+
+			/* a plain copy overwrites whatever older backups had */
+			if (!(*p)->is_datafile)
+			{
+				for (; nversions > 0; nversions--)
+					free(copies[nversions - 1].path);
+			}
+
+			/* work on a copy having the absolute path in the backup */
+			version = &copies[nversions];
+			*version = **p;
+			version->path = pgut_malloc(strlen(roots[j]) + strlen((*p)->path) + 2);
+			sprintf(version->path, "%s/%s", roots[j], (*p)->path);
+
+			owners[nversions] = j;
+			versions[nversions++] = version;
+		}
+
+		/*
+		 * Nothing to do if the file was skipped in the whole chain, restore
+		 * skips it too, or if the target has its only version.
+		 */
+		if (nversions == 0 || (nversions == 1 && owners[0] == nbackups - 1))
+		{
+			for (j = 0; j < nversions; j++)
+				free(copies[j].path);
+			continue;
+		}
+
+		if (verbose)
+			elog(LOG, "(%d/%lu) %s", i + 1, (unsigned long) parray_num(files),
+				 file->path);
+
+		if (!versions[0]->is_datafile && nversions == 1)
+		{
+			/* target has no version of the file, so copy it in place */
+			if (!copy_file(roots[owners[0]], roots[nbackups - 1], versions[0]))
+				elog(ERROR, "backup file \"%s\" vanished", versions[0]->path);
+			file->write_size = versions[0]->write_size;
+			file->crc = versions[0]->crc;
+			file->is_datafile = false;
+		}
+		else
+		{
+			pgBackup   *sources[nversions];
+
+			for (j = 0; j < nversions; j++)
+				sources[j] = backups[owners[j]];
+
+			snprintf(path, lengthof(path), "%s/%s.merge",
+					 roots[nbackups - 1], file->path);
+			merge_data_file(versions, sources, nversions, path, file,
+							target->compress_data);
+			parray_append(merged, file);
+		}
+
+		for (j = 0; j < nversions; j++)
+			free(copies[j].path);
+	}
+
+	/* write the new file list aside as well */
+	pgBackupGetPath(target, path, lengthof(path), DATABASE_FILE_LIST ".merge");
+	fp = fopen(path, "wt");
+	if (fp == NULL)
+		elog(ERROR, "can't open file list \"%s\": %s", path, strerror(errno));
+	dir_print_file_list(fp, files, NULL, NULL);
+	fclose(fp);
+
+	/* now put all merged files in place */
+	for (i = 0; i < parray_num(merged); i++)
+	{
+		pgFile	   *file = (pgFile *) parray_get(merged, i);
+		char		to_path[MAXPGPATH];
+
+		join_path_components(to_path, roots[nbackups - 1], file->path);
+		if (snprintf(path, lengthof(path), "%s.merge", to_path) >= lengthof(path))
+			elog(ERROR, "path \"%s.merge\" is too long", to_path);
+		if (rename(path, to_path) == -1)
+			elog(ERROR, "cannot rename \"%s\" to \"%s\": %s",
+				 path, to_path, strerror(errno));
+	}
+
+	{
+		char		list_path[MAXPGPATH];
+
+		pgBackupGetPath(target, list_path, lengthof(list_path), DATABASE_FILE_LIST);
+		if (snprintf(path, lengthof(path), "%s.merge", list_path) >= lengthof(path))
+			elog(ERROR, "path \"%s.merge\" is too long", list_path);
+		if (rename(path, list_path) == -1)
+			elog(ERROR, "cannot rename \"%s\" to \"%s\": %s",
+				 path, list_path, strerror(errno));
+	}
+
+	/* the target is a full backup from now */
+	target->backup_mode = BACKUP_MODE_FULL;
+	target->data_bytes = 0;
+	for (i = 0; i < parray_num(files); i++)
+	{
+		pgFile	   *file = (pgFile *) parray_get(files, i);
+
+		if (S_ISREG(file->mode) && file->write_size != BYTES_INVALID)
+			target->data_bytes += file->write_size;
+	}
+	pgBackupWriteIni(target);
+
+	time2iso(timestamp, lengthof(timestamp), target->start_time);
+	elog(INFO, "merge: backup %s is now a full backup", timestamp);
+
+	/* cleanup */
+	parray_free(merged);
+	for (i = 0; i < nbackups; i++)
+	{
+		parray_walk(file_lists[i], pgFileFree);
+		parray_free(file_lists[i]);
+	}
+	free(roots);
+	free(owners);
+	free(versions);
+	free(copies);
+	free(file_lists);
+	free(backups);
+}
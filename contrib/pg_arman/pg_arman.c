@@ -69,6 +69,7 @@ static pgut_option options[] =
 	{ 'b', 10, "backup-pg-log",			&backup_logs },
 	{ 'f', 'b', "backup-mode",			opt_backup_mode,		SOURCE_ENV },
 	{ 'b', 'C', "smooth-checkpoint",	&smooth_checkpoint,		SOURCE_ENV },
+	{ 'b', 12, "compress",				&current.compress_data,	SOURCE_ENV },
 	/* options with only long name (keep-xxx) */
 	{ 'i',  1, "keep-data-generations", &keep_data_generations, SOURCE_ENV },
 	{ 'i',  2, "keep-data-days",		&keep_data_days,		SOURCE_ENV },
@@ -213,6 +214,8 @@ main(int argc, char *argv[])
 		return do_validate(&range);
 	else if (pg_strcasecmp(cmd, "delete") == 0)
 		return do_delete(&range);
+	else if (pg_strcasecmp(cmd, "merge") == 0)
+		return do_merge(&range);
 	else
 		elog(ERROR, "invalid command \"%s\"", cmd);
 
@@ -230,6 +233,7 @@ pgut_help(bool details)
 	printf(_("  %s OPTION show [DATE]\n"), PROGRAM_NAME);
 	printf(_("  %s OPTION validate [DATE]\n"), PROGRAM_NAME);
 	printf(_("  %s OPTION delete DATE\n"), PROGRAM_NAME);
+	printf(_("  %s OPTION merge [DATE]\n"), PROGRAM_NAME);
 
 	if (!details)
 		return;
@@ -250,6 +254,7 @@ pgut_help(bool details)
 	printf(_("  --keep-data-days=DAY      keep enough data backup to recover to DAY days age\n"));
 	printf(_("  --disable-ptrack-clear    disable clear ptrack for postgres without ptrack\n"));
 	printf(_("  --backup-pg-log           start backup pg_log directory\n"));
+	printf(_("  --compress                compress data pages in the backup catalog\n"));
 	printf(_("\nRestore options:\n"));
 	printf(_("  --recovery-target-time    time stamp up to which recovery will proceed\n"));
 	printf(_("  --recovery-target-xid     transaction ID up to which recovery will proceed\n"));
@@ -143,6 +143,9 @@ typedef struct pgBackup
 	uint32		block_size;
 	uint32		wal_block_size;
 	uint32		checksum_version;
+
+	/* data pages are compressed (see data.c) */
+	bool		compress_data;
 } pgBackup;
 
 typedef struct pgBackupOption
@@ -238,6 +241,9 @@ extern int do_show(pgBackupRange *range, bool show_all);
 extern int do_delete(pgBackupRange *range);
 extern void pgBackupDelete(int keep_generations, int keep_days);
 
+/* in merge.c */
+extern int do_merge(pgBackupRange *range);
+
 /* in fetch.c */
 extern char *slurpFile(const char *datadir,
 					   const char *path,
@@ -287,6 +293,7 @@ extern pg_crc32 pgFileGetCRC(pgFile *file);
 extern int pgFileComparePath(const void *f1, const void *f2);
 extern int pgFileComparePathDesc(const void *f1, const void *f2);
 extern int pgFileCompareSize(const void *f1, const void *f2);
+extern int pgFileCompareSizeDesc(const void *f1, const void *f2);
 extern int pgFileCompareMtime(const void *f1, const void *f2);
 extern int pgFileCompareMtimeDesc(const void *f1, const void *f2);
 
@@ -297,6 +304,9 @@ extern void restore_data_file(const char *from_root, const char *to_root,
 							  pgFile *file, pgBackup *backup);
 extern bool copy_file(const char *from_root, const char *to_root,
 					  pgFile *file);
+extern void merge_data_file(pgFile **versions, pgBackup **backups,
+							int nversions, const char *to_path,
+							pgFile *file, bool compress);
 
 extern bool calc_file(pgFile *file);
 
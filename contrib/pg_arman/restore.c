@@ -315,6 +315,9 @@ restore_database(pgBackup *backup)
 	if (num_threads < 1)
 		num_threads = 1;
 
+	/* restore (and decompress) largest files first for load balancing */
+	parray_qsort(files, pgFileCompareSizeDesc);
+
 	for (i = 0; i < parray_num(files); i++)
 	{
 		pgFile *file = (pgFile *) parray_get(files, i);
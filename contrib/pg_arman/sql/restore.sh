@@ -235,6 +235,45 @@ psql --no-psqlrc -p ${TEST_PGPORT} -d pgbench -c "SELECT sum(delta) FROM pgbench
 diff ${TEST_BASE}/TEST-0009-count1.out ${TEST_BASE}/TEST-0009-count2.out
 echo ''
 
+echo '###### RESTORE COMMAND TEST-0012 ######'
+echo '###### recovery to latest from compressed full + ptrack backups ######'
+init_backup
+pgbench_objs 0012
+pg_arman backup -B ${BACKUP_PATH} -b full -j 4 --compress -p ${TEST_PGPORT} -d postgres --verbose > ${TEST_BASE}/TEST-0012-run.out 2>&1;echo $?
+pg_arman validate -B ${BACKUP_PATH} --verbose >> ${TEST_BASE}/TEST-0012-run.out 2>&1
+pgbench -p ${TEST_PGPORT} -d pgbench > /dev/null 2>&1
+pg_arman backup -B ${BACKUP_PATH} -b ptrack -j 4 --compress -p ${TEST_PGPORT} -d postgres --verbose >> ${TEST_BASE}/TEST-0012-run.out 2>&1;echo $?
+pg_arman validate -B ${BACKUP_PATH} --verbose >> ${TEST_BASE}/TEST-0012-run.out 2>&1
+psql --no-psqlrc -p ${TEST_PGPORT} -d pgbench -c "SELECT * FROM pgbench_branches;" > ${TEST_BASE}/TEST-0012-before.out
+pg_ctl stop -m immediate > /dev/null 2>&1
+pg_arman restore -B ${BACKUP_PATH} -j 4 --verbose >> ${TEST_BASE}/TEST-0012-run.out 2>&1;echo $?
+pg_ctl start -w -t 600 > /dev/null 2>&1
+psql --no-psqlrc -p ${TEST_PGPORT} -d pgbench -c "SELECT * FROM pgbench_branches;" > ${TEST_BASE}/TEST-0012-after.out
+diff ${TEST_BASE}/TEST-0012-before.out ${TEST_BASE}/TEST-0012-after.out
+echo ''
+
+echo '###### RESTORE COMMAND TEST-0013 ######'
+echo '###### recovery to latest from full + ptrack backups merged into one ######'
+init_backup
+pgbench_objs 0013
+pg_arman backup -B ${BACKUP_PATH} -b full -j 4 -p ${TEST_PGPORT} -d postgres --verbose > ${TEST_BASE}/TEST-0013-run.out 2>&1;echo $?
+pg_arman validate -B ${BACKUP_PATH} --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1
+pgbench -p ${TEST_PGPORT} -d pgbench > /dev/null 2>&1
+pg_arman backup -B ${BACKUP_PATH} -b ptrack -j 4 -p ${TEST_PGPORT} -d postgres --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1;echo $?
+pg_arman validate -B ${BACKUP_PATH} --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1
+pgbench -p ${TEST_PGPORT} -d pgbench > /dev/null 2>&1
+pg_arman backup -B ${BACKUP_PATH} -b ptrack -j 4 -p ${TEST_PGPORT} -d postgres --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1;echo $?
+pg_arman validate -B ${BACKUP_PATH} --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1
+pg_arman merge -B ${BACKUP_PATH} --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1;echo $?
+pg_arman validate -B ${BACKUP_PATH} --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1
+psql --no-psqlrc -p ${TEST_PGPORT} -d pgbench -c "SELECT * FROM pgbench_branches;" > ${TEST_BASE}/TEST-0013-before.out
+pg_ctl stop -m immediate > /dev/null 2>&1
+pg_arman restore -B ${BACKUP_PATH} -j 4 --verbose >> ${TEST_BASE}/TEST-0013-run.out 2>&1;echo $?
+pg_ctl start -w -t 600 > /dev/null 2>&1
+psql --no-psqlrc -p ${TEST_PGPORT} -d pgbench -c "SELECT * FROM pgbench_branches;" > ${TEST_BASE}/TEST-0013-after.out
+diff ${TEST_BASE}/TEST-0013-before.out ${TEST_BASE}/TEST-0013-after.out
+echo ''
+
 echo '###### RESTORE COMMAND TEST-0008 ######'
 echo '###### recovery with target inclusive false ######'
 init_backup
@@ -11,12 +11,17 @@
 #include "access/htup_details.h"
 #include "catalog/pg_type.h"
 #include "funcapi.h"
+#include "miscadmin.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "utils/hsearch.h"
 
 
 #define NUM_BUFFERCACHE_PAGES_MIN_ELEM	8
 #define NUM_BUFFERCACHE_PAGES_ELEM	9
+#define NUM_BUFFERCACHE_SUMMARY_ELEM	5
+#define NUM_BUFFERCACHE_USAGE_COUNTS_ELEM	4
+#define NUM_BUFFERCACHE_RELATIONS_ELEM	8
 
 PG_MODULE_MAGIC;
 
@@ -54,11 +59,37 @@ typedef struct
 } BufferCachePagesContext;
 
 
+/*
+ * Hash table entry of pg_buffercache_relations(), one per relation fork.
+ */
+typedef struct
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+} BufferCacheRelationKey;
+
+typedef struct
+{
+	BufferCacheRelationKey key; /* hash key, must be first */
+	int32		buffers;
+	int32		dirty;
+	int32		pinned;
+	int64		usagecount_total;
+} BufferCacheRelationEntry;
+
+
+static Tuplestorestate *buffercache_materialize(FunctionCallInfo fcinfo,
+						TupleDesc *tupdesc);
+
+
 /*
  * Function returning data from the shared buffer cache - buffer number,
  * relation node/tablespace/database/blocknum and dirty indicator.
  */
 PG_FUNCTION_INFO_V1(pg_buffercache_pages);
+PG_FUNCTION_INFO_V1(pg_buffercache_summary);
+PG_FUNCTION_INFO_V1(pg_buffercache_usage_counts);
+PG_FUNCTION_INFO_V1(pg_buffercache_relations);
 
 Datum
 pg_buffercache_pages(PG_FUNCTION_ARGS)
@@ -252,3 +283,266 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 	else
 		SRF_RETURN_DONE(funcctx);
 }
+
+/*
+ * The summary functions below read each buffer's state word without taking
+ * the buffer header lock or the buffer mapping locks.  Locking wouldn't give
+ * a more useful answer, since the state can change as soon as the lock is
+ * released, but it would make the functions far more expensive and disturb
+ * concurrent buffer activity.  The results are therefore approximate, which
+ * is fine for monitoring, and the functions are cheap enough to be polled.
+ */
+
+/*
+ * Return a single row summarizing the state of the shared buffer cache.
+ */
+Datum
+pg_buffercache_summary(PG_FUNCTION_ARGS)
+{
+	Datum		result;
+	TupleDesc	tupledesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_BUFFERCACHE_SUMMARY_ELEM];
+	bool		nulls[NUM_BUFFERCACHE_SUMMARY_ELEM];
+	int32		buffers_used = 0;
+	int32		buffers_unused = 0;
+	int32		buffers_dirty = 0;
+	int32		buffers_pinned = 0;
+	int64		usagecount_total = 0;
+	int			i;
+
+	if (get_call_result_type(fcinfo, NULL, &tupledesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	for (i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+
+		if (buf_state & BM_VALID)
+		{
+			buffers_used++;
+			usagecount_total += BUF_STATE_GET_USAGECOUNT(buf_state);
+
+			if (buf_state & BM_DIRTY)
+				buffers_dirty++;
+		}
+		else
+			buffers_unused++;
+
+		if (BUF_STATE_GET_REFCOUNT(buf_state) > 0)
+			buffers_pinned++;
+	}
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int32GetDatum(buffers_used);
+	values[1] = Int32GetDatum(buffers_unused);
+	values[2] = Int32GetDatum(buffers_dirty);
+	values[3] = Int32GetDatum(buffers_pinned);
+
+	if (buffers_used != 0)
+		values[4] = Float8GetDatum((double) usagecount_total / buffers_used);
+	else
+		nulls[4] = true;
+
+	/* Build and return the tuple. */
+	tuple = heap_form_tuple(tupledesc, values, nulls);
+	result = HeapTupleGetDatum(tuple);
+
+	PG_RETURN_DATUM(result);
+}
+
+/*
+ * Return one row per possible usage count, with the number of buffers having
+ * that usage count and how many of them are dirty or pinned.
+ */
+Datum
+pg_buffercache_usage_counts(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+	int32		buffers[BM_MAX_USAGE_COUNT + 1] = {0};
+	int32		dirty[BM_MAX_USAGE_COUNT + 1] = {0};
+	int32		pinned[BM_MAX_USAGE_COUNT + 1] = {0};
+	Datum		values[NUM_BUFFERCACHE_USAGE_COUNTS_ELEM];
+	bool		nulls[NUM_BUFFERCACHE_USAGE_COUNTS_ELEM];
+	int			i;
+
+	tupstore = buffercache_materialize(fcinfo, &tupdesc);
+
+	for (i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+		int			usage_count;
+
+		usage_count = BUF_STATE_GET_USAGECOUNT(buf_state);
+		buffers[usage_count]++;
+
+		if (buf_state & BM_DIRTY)
+			dirty[usage_count]++;
+
+		if (BUF_STATE_GET_REFCOUNT(buf_state) > 0)
+			pinned[usage_count]++;
+	}
+
+	memset(nulls, 0, sizeof(nulls));
+	for (i = 0; i < BM_MAX_USAGE_COUNT + 1; i++)
+	{
+		values[0] = Int32GetDatum(i);
+		values[1] = Int32GetDatum(buffers[i]);
+		values[2] = Int32GetDatum(dirty[i]);
+		values[3] = Int32GetDatum(pinned[i]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Return one row per relation fork present in the shared buffer cache, with
+ * the number of its buffers, how many of them are dirty or pinned, and their
+ * average usage count.
+ *
+ * The buffer tag is copied without the header lock too.  A tag is only
+ * changed while the header is locked, so we skip buffers whose header is
+ * locked before or after the copy; a buffer retagged in between can still
+ * be attributed to the wrong relation, which is an accepted inaccuracy.
+ */
+Datum
+pg_buffercache_relations(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+	HASHCTL		ctl;
+	HTAB	   *relations;
+	HASH_SEQ_STATUS hash_seq;
+	BufferCacheRelationEntry *entry;
+	Datum		values[NUM_BUFFERCACHE_RELATIONS_ELEM];
+	bool		nulls[NUM_BUFFERCACHE_RELATIONS_ELEM];
+	int			i;
+
+	tupstore = buffercache_materialize(fcinfo, &tupdesc);
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(BufferCacheRelationKey);
+	ctl.entrysize = sizeof(BufferCacheRelationEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	relations = hash_create("pg_buffercache relations", 1024, &ctl,
+							HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	for (i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		uint32		buf_state;
+		BufferCacheRelationKey key;
+		bool		found;
+
+		if ((i & 1023) == 0)
+			CHECK_FOR_INTERRUPTS();
+
+		buf_state = pg_atomic_read_u32(&bufHdr->state);
+		if ((buf_state & (BM_VALID | BM_TAG_VALID)) !=
+			(BM_VALID | BM_TAG_VALID) ||
+			(buf_state & BM_LOCKED))
+			continue;
+
+		pg_read_barrier();
+		/* zero the padding, the key is hashed as a blob */
+		memset(&key, 0, sizeof(key));
+		key.rnode = bufHdr->tag.rnode;
+		key.forknum = bufHdr->tag.forkNum;
+		pg_read_barrier();
+
+		buf_state = pg_atomic_read_u32(&bufHdr->state);
+		if ((buf_state & (BM_VALID | BM_TAG_VALID)) !=
+			(BM_VALID | BM_TAG_VALID) ||
+			(buf_state & BM_LOCKED))
+			continue;
+
+		entry = (BufferCacheRelationEntry *)
+			hash_search(relations, &key, HASH_ENTER, &found);
+		if (!found)
+		{
+			entry->buffers = 0;
+			entry->dirty = 0;
+			entry->pinned = 0;
+			entry->usagecount_total = 0;
+		}
+
+		entry->buffers++;
+		entry->usagecount_total += BUF_STATE_GET_USAGECOUNT(buf_state);
+
+		if (buf_state & BM_DIRTY)
+			entry->dirty++;
+
+		if (BUF_STATE_GET_REFCOUNT(buf_state) > 0)
+			entry->pinned++;
+	}
+
+	memset(nulls, 0, sizeof(nulls));
+	hash_seq_init(&hash_seq, relations);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		values[0] = ObjectIdGetDatum(entry->key.rnode.relNode);
+		values[1] = ObjectIdGetDatum(entry->key.rnode.spcNode);
+		values[2] = ObjectIdGetDatum(entry->key.rnode.dbNode);
+		values[3] = Int16GetDatum(entry->key.forknum);
+		values[4] = Int32GetDatum(entry->buffers);
+		values[5] = Int32GetDatum(entry->dirty);
+		values[6] = Int32GetDatum(entry->pinned);
+		values[7] = Float8GetDatum((double) entry->usagecount_total /
+								   entry->buffers);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	hash_destroy(relations);
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Set up materialize-mode return of a set-returning function, and return
+ * the tuplestore and tuple descriptor to fill.
+ */
+static Tuplestorestate *
+buffercache_materialize(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Tuplestorestate *tupstore;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Switch into long-lived context to construct returned data structures */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
@@ -229,6 +229,52 @@ set pg_pathman.enable = true
 set enable_hashjoin = off
 set enable_mergejoin = off;
 
+create or replace function test.pathman_test_6() returns text as $$
+declare
+	plan jsonb;
+	num int;
+	res text;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_4 where id >= (select 2) order by id desc limit 3');
+
+												/* Limit -> Custom Scan */
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->1->'Custom Plan Provider')::text,
+							   '"RuntimeMergeAppend"',
+							   'wrong plan provider');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->1->'Partition Order')::text,
+							   '"Descending"',
+							   'wrong partition order');
+
+	/* Only the last partition should have been opened */
+	select count(*) from jsonb_array_elements_text(plan->0->'Plan'->'Plans'->1->'Plans') into num;
+	perform test.pathman_equal(num::text, '1', 'expected 1 child plan for custom scan');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->1->'Plans'->0->'Relation Name')::text,
+							   '"runtime_test_4_10"',
+							   'wrong partition');
+
+
+	select array(select id from test.runtime_test_4
+				 where id >= (select 9000) order by id limit 3)::text
+	into res; /* crosses partition bound */
+
+	perform test.pathman_equal(res, '{9000,9001,9002}', 'wrong ascending order');
+
+
+	select array(select id from test.runtime_test_4
+				 where id <= (select 1001) order by id desc limit 3)::text
+	into res; /* crosses partition bound */
+
+	perform test.pathman_equal(res, '{1001,1000,999}', 'wrong descending order');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true
+set enable_hashjoin = off
+set enable_mergejoin = off;
+
 
 
 create table test.run_values as select generate_series(1, 10000) val;
@@ -248,6 +294,10 @@ insert into test.runtime_test_3(id, val) select * from generate_series(1, 10000)
 select pathman.create_hash_partitions('test.runtime_test_3', 'id', 4);
 create index on test.runtime_test_3 (id);
 create index on test.runtime_test_3_0 (id);
+create table test.runtime_test_4(id int not null, val real);
+insert into test.runtime_test_4 select generate_series(1, 10000), random();
+create index on test.runtime_test_4 (id);
+select pathman.create_range_partitions('test.runtime_test_4', 'id', 1, 1000);
 
 
 analyze test.run_values;
@@ -255,6 +305,7 @@ analyze test.runtime_test_1;
 analyze test.runtime_test_2;
 analyze test.runtime_test_3;
 analyze test.runtime_test_3_0;
+analyze test.runtime_test_4;
 
 set pg_pathman.enable_runtimeappend = on;
 set pg_pathman.enable_runtimemergeappend = on;
@@ -264,6 +315,7 @@ select test.pathman_test_2(); /* RuntimeAppend (select ... where id = any(subque
 select test.pathman_test_3(); /* RuntimeAppend (a join b on a.id = b.val) */
 select test.pathman_test_4(); /* RuntimeMergeAppend (lateral) */
 select test.pathman_test_5(); /* projection tests for RuntimeXXX nodes */
+select test.pathman_test_6(); /* RuntimeMergeAppend (ordered RANGE partitions) */
 
 
 DROP SCHEMA test CASCADE;
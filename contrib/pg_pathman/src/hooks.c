@@ -351,6 +351,7 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 			Relids			inner_required = PATH_REQ_OUTER((Path *) cur_path);
 			ParamPathInfo  *ppi = get_appendrel_parampathinfo(rel, inner_required);
 			Path		   *inner_path = NULL;
+			ScanDirection	ordered_dir = NoMovementScanDirection;
 
 			/* Skip if rel contains some join-related stuff or path type mismatched */
 			if (!(IsA(cur_path, AppendPath) || IsA(cur_path, MergeAppendPath)) ||
@@ -368,10 +369,29 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 													   prel, rel->relid))))
 				continue;
 
-			if (IsA(cur_path, AppendPath) && pg_pathman_enable_runtimeappend)
+			/*
+			 * RANGE partitions are sorted by their bounds, so if the leading
+			 * sort key is the partitioning key (and the parent isn't scanned)
+			 * we can simply scan children one by one in bound order.
+			 */
+			if (cur_path->path.pathkeys && !prel->enable_parent)
+			{
+				PathKey *pathkey = (PathKey *) linitial(cur_path->path.pathkeys);
+
+				if (pathkey == pathkeyAsc)
+					ordered_dir = ForwardScanDirection;
+				else if (pathkey == pathkeyDesc)
+					ordered_dir = BackwardScanDirection;
+			}
+
+			/* Ordered Append can't be replaced with RuntimeAppend */
+			if (IsA(cur_path, AppendPath) &&
+				ordered_dir == NoMovementScanDirection &&
+				pg_pathman_enable_runtimeappend)
 				inner_path = create_runtimeappend_path(root, cur_path,
 													   ppi, paramsel);
-			else if (IsA(cur_path, MergeAppendPath) &&
+			else if ((IsA(cur_path, MergeAppendPath) ||
+					  ordered_dir != NoMovementScanDirection) &&
 					 pg_pathman_enable_runtime_merge_append)
 			{
 				/* Check struct layout compatibility */
@@ -381,7 +401,8 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 								"MergeAppendPath differ");
 
 				inner_path = create_runtimemergeappend_path(root, cur_path,
-															ppi, paramsel);
+															ppi, paramsel,
+															ordered_dir);
 			}
 
 			if (inner_path)
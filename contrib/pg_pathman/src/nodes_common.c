@@ -540,8 +540,13 @@ end_append_common(CustomScanState *node)
 	hash_destroy(scan_state->children_table);
 }
 
+/*
+ * Select partitions matching 'custom_exprs', but don't init their plan
+ * states yet; the caller should use init_append_child_common() on
+ * each child before executing it.
+ */
 void
-rescan_append_common(CustomScanState *node)
+select_append_plans_common(CustomScanState *node)
 {
 	RuntimeAppendState	   *scan_state = (RuntimeAppendState *) node;
 	ExprContext			   *econtext = node->ss.ps.ps_ExprContext;
@@ -580,13 +585,32 @@ rescan_append_common(CustomScanState *node)
 												  &scan_state->ncur_plans);
 	pfree(parts);
 
+	scan_state->running_idx = 0;
+}
+
+/*
+ * Make an executable plan state out of a child selected
+ * by select_append_plans_common() (or ReScan an existing one).
+ */
+void
+init_append_child_common(CustomScanState *node, ChildScanCommon child)
+{
+	transform_plans_into_states((RuntimeAppendState *) node, &child, 1,
+								node->ss.ps.state);
+}
+
+void
+rescan_append_common(CustomScanState *node)
+{
+	RuntimeAppendState	   *scan_state = (RuntimeAppendState *) node;
+
+	select_append_plans_common(node);
+
 	/* Transform selected plans into executable plan states */
 	transform_plans_into_states(scan_state,
 								scan_state->cur_plans,
 								scan_state->ncur_plans,
 								scan_state->css.ss.ps.state);
-
-	scan_state->running_idx = 0;
 }
 
 void
@@ -94,6 +94,10 @@ TupleTableSlot * exec_append_common(CustomScanState *node,
 
 void end_append_common(CustomScanState *node);
 
+void select_append_plans_common(CustomScanState *node);
+
+void init_append_child_common(CustomScanState *node, ChildScanCommon child);
+
 void rescan_append_common(CustomScanState *node);
 
 void explain_append_common(CustomScanState *node,
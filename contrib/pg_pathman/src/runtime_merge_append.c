@@ -48,6 +48,7 @@ typedef struct
 	Oid		   *sortOperators;
 	Oid		   *collations;
 	bool	   *nullsFirst;
+	ScanDirection ordered_dir;
 } MergeAppendGuts;
 
 static Plan * prepare_sort_from_pathkeys(PlannerInfo *root, Plan *lefttree, List *pathkeys,
@@ -132,11 +133,12 @@ pack_runtimemergeappend_private(CustomScan *cscan, MergeAppendGuts *mag)
 		nullsFirst		= lappend_int(nullsFirst, mag->nullsFirst[i]);
 	}
 
-	runtimemergeappend_private = list_make2(makeInteger(mag->numCols),
+	runtimemergeappend_private = list_make3(makeInteger(mag->numCols),
 											list_make4(sortColIdx,
 													   sortOperators,
 													   collations,
-													   nullsFirst));
+													   nullsFirst),
+											makeInteger(mag->ordered_dir));
 
 	/*
 	 * Append RuntimeMergeAppend's data to the 'custom_private' (2nd).
@@ -189,6 +191,8 @@ unpack_runtimemergeappend_private(RuntimeMergeAppendState *scan_state,
 	FillStateField(sortOperators,	Oid,		lfirst_oid);
 	FillStateField(collations,		Oid,		lfirst_oid);
 	FillStateField(nullsFirst,		bool,		lfirst_int);
+
+	scan_state->ordered_dir = (ScanDirection) intVal(lthird(runtimemergeappend_private));
 }
 
 void
@@ -225,11 +229,13 @@ Path *
 create_runtimemergeappend_path(PlannerInfo *root,
 							   AppendPath *inner_append,
 							   ParamPathInfo *param_info,
-							   double sel)
+							   double sel,
+							   ScanDirection ordered_dir)
 {
 	RelOptInfo *rel = inner_append->path.parent;
 	Path	   *path;
 	double		limit_tuples;
+	int			nchildren;
 
 	path = create_append_path_common(root, inner_append,
 									 param_info,
@@ -243,6 +249,15 @@ create_runtimemergeappend_path(PlannerInfo *root,
 		limit_tuples = -1.0;
 
 	((RuntimeMergeAppendPath *) path)->limit_tuples = limit_tuples;
+	((RuntimeMergeAppendPath *) path)->ordered_dir = ordered_dir;
+
+	/*
+	 * Ordered scan starts children one by one, so we
+	 * expect to pay the startup cost of a single child.
+	 */
+	nchildren = ((RuntimeAppendPath *) path)->nchildren;
+	if (ordered_dir != NoMovementScanDirection && nchildren > 0)
+		path->startup_cost /= nchildren;
 
 	return path;
 }
@@ -268,6 +283,7 @@ create_runtimemergeappend_plan(PlannerInfo *root, RelOptInfo *rel,
 									 &runtime_merge_append_plan_methods);
 
 	node = (CustomScan *) plan;
+	mag.ordered_dir = ((RuntimeMergeAppendPath *) best_path)->ordered_dir;
 
 	(void) prepare_sort_from_pathkeys(root, plan, pathkeys,
 									  best_path->path.parent->relids,
@@ -358,6 +374,69 @@ runtimemergeappend_begin(CustomScanState *node, EState *estate, int eflags)
 	begin_append_common(node, estate, eflags);
 }
 
+/*
+ * Scan children one by one in bound order (RANGE partitioning
+ * key is the leading sort key), starting each child only when
+ * we actually reach it.
+ */
+static void
+fetch_next_tuple_ordered(CustomScanState *node)
+{
+	RuntimeMergeAppendState	   *scan_state = (RuntimeMergeAppendState *) node;
+	RuntimeAppendState		   *rstate = &scan_state->rstate;
+	TupleTableSlot			   *slot = NULL;
+
+	while (rstate->running_idx < rstate->ncur_plans)
+	{
+		ChildScanCommon		child;
+		PlanState		   *state;
+		bool				quals;
+		int					idx;
+
+		/* Partitions are selected in ascending bound order */
+		if (ScanDirectionIsForward(scan_state->ordered_dir))
+			idx = rstate->running_idx;
+		else
+			idx = rstate->ncur_plans - rstate->running_idx - 1;
+
+		child = rstate->cur_plans[idx];
+
+		/* Init or ReScan this child only once we need it */
+		if (!scan_state->ms_initialized)
+		{
+			init_append_child_common(node, child);
+			scan_state->ms_initialized = true;
+		}
+
+		state = child->content.plan_state;
+
+		for (;;)
+		{
+			slot = ExecProcNode(state);
+
+			if (TupIsNull(slot))
+				break;
+
+			node->ss.ps.ps_ExprContext->ecxt_scantuple = slot;
+			quals = ExecQual(rstate->custom_expr_states,
+							 node->ss.ps.ps_ExprContext, false);
+
+			ResetExprContext(node->ss.ps.ps_ExprContext);
+
+			if (quals)
+			{
+				rstate->slot = slot;
+				return;
+			}
+		}
+
+		rstate->running_idx++;
+		scan_state->ms_initialized = false;
+	}
+
+	rstate->slot = slot;
+}
+
 static void
 fetch_next_tuple(CustomScanState *node)
 {
@@ -366,6 +445,12 @@ fetch_next_tuple(CustomScanState *node)
 	PlanState				   *ps;
 	int							i;
 
+	if (scan_state->ordered_dir != NoMovementScanDirection)
+	{
+		fetch_next_tuple_ordered(node);
+		return;
+	}
+
 	if (!scan_state->ms_initialized)
 	{
 		for (i = 0; i < scan_state->rstate.ncur_plans; i++)
@@ -451,6 +536,14 @@ runtimemergeappend_rescan(CustomScanState *node)
 	int							nplans;
 	int							i;
 
+	/* Ordered scan needs neither a binary heap nor sort keys */
+	if (scan_state->ordered_dir != NoMovementScanDirection)
+	{
+		select_append_plans_common(node);
+		scan_state->ms_initialized = false;
+		return;
+	}
+
 	rescan_append_common(node);
 
 	nplans = scan_state->rstate.ncur_plans;
@@ -497,6 +590,12 @@ runtimemergeappend_explain(CustomScanState *node, List *ancestors, ExplainState
 
 	explain_append_common(node, scan_state->rstate.children_table, es);
 
+	if (scan_state->ordered_dir != NoMovementScanDirection)
+		ExplainPropertyText("Partition Order",
+							ScanDirectionIsForward(scan_state->ordered_dir) ?
+								"Ascending" : "Descending",
+							es);
+
 	/* We should print sort keys as well */
 	show_sort_group_keys((PlanState *) &node->ss.ps, "Sort Key",
 						 scan_state->numCols, scan_state->sortColIdx,
@@ -17,6 +17,7 @@
 #include "pathman.h"
 
 #include "postgres.h"
+#include "access/sdir.h"
 
 
 typedef struct
@@ -24,6 +25,13 @@ typedef struct
 	RuntimeAppendPath	rpath;
 
 	double				limit_tuples;
+
+	/*
+	 * Forward\Backward if the leading sort key is the RANGE partitioning
+	 * key, so children could be scanned one by one in bound order without
+	 * merging; NoMovementScanDirection otherwise.
+	 */
+	ScanDirection		ordered_dir;
 } RuntimeMergeAppendPath;
 
 typedef struct
@@ -36,6 +44,8 @@ typedef struct
 	Oid				   *collations;		/* OIDs of collations */
 	bool			   *nullsFirst;		/* NULLS FIRST/LAST directions */
 
+	ScanDirection		ordered_dir;	/* see RuntimeMergeAppendPath */
+
 	int					ms_nkeys;
 	SortSupport			ms_sortkeys;
 	TupleTableSlot	  **ms_slots;
@@ -56,7 +66,8 @@ void init_runtime_merge_append_static_data(void);
 Path * create_runtimemergeappend_path(PlannerInfo *root,
 									  AppendPath *inner_append,
 									  ParamPathInfo *param_info,
-									  double sel);
+									  double sel,
+									  ScanDirection ordered_dir);
 
 Plan * create_runtimemergeappend_plan(PlannerInfo *root, RelOptInfo *rel,
 									  CustomPath *best_path, List *tlist,
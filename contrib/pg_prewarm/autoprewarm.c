@@ -0,0 +1,1037 @@
+/*-------------------------------------------------------------------------
+ *
+ * autoprewarm.c
+ *		Periodically dump information about the blocks present in
+ *		shared_buffers, and reload them on server restart.
+ *
+ *		Due to locking considerations, we can't actually begin prewarming
+ *		until the server reaches a consistent state.  We need the catalogs
+ *		to be consistent so that we can figure out which relation to lock,
+ *		and we need to lock the relations so that we don't try to prewarm
+ *		pages from a relation that is in the process of being dropped.
+ *
+ *		While prewarming, autoprewarm will use several background workers
+ *		for each database.  Blocks are loaded in sorted order, and each
+ *		worker claims a run of consecutive blocks at a time, so the reads
+ *		issued by every worker stay mostly sequential.  Once prewarming is
+ *		complete, the master process remains and periodically dumps the
+ *		list of blocks in shared_buffers to a file.
+ *
+ * Copyright (c) 2016, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		contrib/pg_prewarm/autoprewarm.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "access/heapam.h"
+#include "access/xact.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/postmaster.h"
+#include "storage/buf_internals.h"
+#include "storage/bufmgr.h"
+#include "storage/dsm.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/procsignal.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/relfilenodemap.h"
+#include "utils/resowner.h"
+
+#define AUTOPREWARM_FILE "autoprewarm.blocks"
+
+/*
+ * Number of block records a per-database worker claims at once.  Large
+ * enough that workers rarely contend for the mutex, small enough that the
+ * work of a single large relation is still spread across all of them.
+ */
+#define AUTOPREWARM_CHUNK_SIZE	1024
+
+/* Metadata for each block we dump. */
+typedef struct BlockInfoRecord
+{
+	Oid			database;
+	Oid			tablespace;
+	Oid			filenode;
+	ForkNumber	forknum;
+	BlockNumber blocknum;
+} BlockInfoRecord;
+
+/* Shared state information for autoprewarm bgworker. */
+typedef struct AutoPrewarmSharedState
+{
+	slock_t		mutex;			/* protects the fields below */
+	pid_t		bgworker_pid;	/* for main bgworker */
+	pid_t		pid_using_dumpfile; /* for autoprewarm or block dump */
+
+	/* Following items are for communication with per-database workers */
+	dsm_handle	block_info_handle;
+	Oid			database;
+	int			prewarm_next_idx;	/* next record not claimed by a worker */
+	int			prewarm_stop_idx;	/* end of the current database's records */
+	int			prewarmed_blocks;
+	bool		out_of_buffers; /* shared_buffers is full, stop loading */
+} AutoPrewarmSharedState;
+
+void		_PG_init(void);
+void		autoprewarm_main(Datum main_arg);
+void		autoprewarm_database_main(Datum main_arg);
+
+PG_FUNCTION_INFO_V1(autoprewarm_start_worker);
+PG_FUNCTION_INFO_V1(autoprewarm_dump_now);
+
+static void apw_load_buffers(void);
+static void apw_run_database_workers(int num_records);
+static int	apw_load_range(BlockInfoRecord *block_info, int start, int stop);
+static int64 apw_dump_now(bool is_bgworker, bool dump_unlogged);
+static void apw_start_master_worker(void);
+static bool apw_init_shmem(void);
+static void apw_detach_shmem(int code, Datum arg);
+static int	apw_compare_blockinfo(const void *p, const void *q);
+static void apw_sigterm_handler(SIGNAL_ARGS);
+static void apw_sighup_handler(SIGNAL_ARGS);
+
+/* Flags set by signal handlers */
+static volatile sig_atomic_t got_sigterm = false;
+static volatile sig_atomic_t got_sighup = false;
+
+/* Pointer to shared-memory state. */
+static AutoPrewarmSharedState *apw_state = NULL;
+
+/* GUC variables. */
+static bool autoprewarm = true; /* start worker? */
+static int	autoprewarm_interval;	/* dump interval */
+static int	autoprewarm_workers;	/* loaders per database */
+
+/*
+ * Module load callback.
+ */
+void
+_PG_init(void)
+{
+	DefineCustomIntVariable("pg_prewarm.autoprewarm_interval",
+							"Sets the interval between dumps of shared buffers",
+							"If set to zero, time-based dumping is disabled.",
+							&autoprewarm_interval,
+							300,
+							0, INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_prewarm.autoprewarm_workers",
+				   "Sets the number of workers loading blocks of a database",
+							NULL,
+							&autoprewarm_workers,
+							4,
+							1, MAX_BACKENDS,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	/* can't define PGC_POSTMASTER variable after startup */
+	DefineCustomBoolVariable("pg_prewarm.autoprewarm",
+							 "Starts the autoprewarm worker.",
+							 NULL,
+							 &autoprewarm,
+							 true,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	EmitWarningsOnPlaceholders("pg_prewarm");
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(AutoPrewarmSharedState)));
+
+	/* Register autoprewarm worker, if enabled. */
+	if (autoprewarm)
+		apw_start_master_worker();
+}
+
+/*
+ * Main entry point for the master autoprewarm process.  Per-database workers
+ * have a separate entry point.
+ */
+void
+autoprewarm_main(Datum main_arg)
+{
+	bool		first_time = true;
+	bool		final_dump_allowed = true;
+	TimestampTz last_dump_time = 0;
+
+	/* Establish signal handlers; once that's done, unblock signals. */
+	pqsignal(SIGTERM, apw_sigterm_handler);
+	pqsignal(SIGHUP, apw_sighup_handler);
+	pqsignal(SIGUSR1, procsignal_sigusr1_handler);
+	BackgroundWorkerUnblockSignals();
+
+	/* Create (if necessary) and attach to our shared memory area. */
+	if (apw_init_shmem())
+		first_time = false;
+
+	/* Set on-detach hook so that our PID will be cleared on exit. */
+	on_shmem_exit(apw_detach_shmem, 0);
+
+	/*
+	 * Store our PID in the shared memory area --- unless there's already
+	 * another worker running, in which case just exit.
+	 */
+	SpinLockAcquire(&apw_state->mutex);
+	if (apw_state->bgworker_pid != InvalidPid)
+	{
+		pid_t		pid = apw_state->bgworker_pid;
+
+		SpinLockRelease(&apw_state->mutex);
+		ereport(LOG,
+				(errmsg("autoprewarm worker is already running under PID %lu",
+						(unsigned long) pid)));
+		return;
+	}
+	apw_state->bgworker_pid = MyProcPid;
+	SpinLockRelease(&apw_state->mutex);
+
+	/*
+	 * The master never runs a transaction, but dsm_create() needs a resource
+	 * owner to track the segment holding the block list.
+	 */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "autoprewarm");
+
+	/*
+	 * Preload buffers from the dump file only if we just started up.
+	 * Otherwise, some other process has already done it.
+	 */
+	if (first_time)
+	{
+		apw_load_buffers();
+		final_dump_allowed = !got_sigterm;
+		last_dump_time = GetCurrentTimestamp();
+	}
+
+	/* Periodically dump buffers until terminated. */
+	while (!got_sigterm)
+	{
+		int			rc;
+
+		/* In case of a SIGHUP, just reload the configuration. */
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (autoprewarm_interval <= 0)
+		{
+			/* We're only dumping at shutdown, so just wait forever. */
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH,
+						   -1L);
+		}
+		else
+		{
+			long		delay_in_ms = 0;
+			TimestampTz next_dump_time = 0;
+			long		secs = 0;
+			int			usecs = 0;
+
+			/* Compute the next dump time. */
+			next_dump_time =
+				TimestampTzPlusMilliseconds(last_dump_time,
+											autoprewarm_interval * 1000);
+			TimestampDifference(GetCurrentTimestamp(), next_dump_time,
+								&secs, &usecs);
+			delay_in_ms = secs * 1000 + (usecs / 1000);
+
+			/* Perform a dump if it's time. */
+			if (delay_in_ms <= 0)
+			{
+				last_dump_time = GetCurrentTimestamp();
+				apw_dump_now(true, false);
+				continue;
+			}
+
+			/* Sleep until the next dump time. */
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+						   delay_in_ms);
+		}
+
+		/* Reset the latch, bail out if postmaster died, otherwise loop. */
+		ResetLatch(MyLatch);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+	}
+
+	/*
+	 * Dump one last time.  We assume this is probably the result of an
+	 * orderly shutdown; if the load was cut short, though, the buffers
+	 * don't reflect the working set yet and the old dump is better.
+	 */
+	if (final_dump_allowed)
+		apw_dump_now(true, true);
+}
+
+/*
+ * Read the dump file and launch per-database workers to load the blocks
+ * listed there.
+ */
+static void
+apw_load_buffers(void)
+{
+	FILE	   *file = NULL;
+	int			num_elements,
+				i;
+	BlockInfoRecord *blkinfo;
+	dsm_segment *seg;
+	int			start;
+	int			prewarmed_blocks;
+	pid_t		pid;
+
+	/*
+	 * Skip the prewarm if the dump file is in use; otherwise, prevent any
+	 * other process from writing it while we're using it.
+	 */
+	SpinLockAcquire(&apw_state->mutex);
+	pid = apw_state->pid_using_dumpfile;
+	if (pid == InvalidPid)
+		apw_state->pid_using_dumpfile = MyProcPid;
+	SpinLockRelease(&apw_state->mutex);
+
+	if (pid != InvalidPid)
+	{
+		ereport(LOG,
+				(errmsg("skipping prewarm because block dump file is being written by PID %lu",
+						(unsigned long) pid)));
+		return;
+	}
+
+	/*
+	 * Open the block dump file.  Exit quietly if it doesn't exist, but
+	 * report any other error.
+	 */
+	file = AllocateFile(AUTOPREWARM_FILE, "r");
+	if (!file)
+	{
+		if (errno == ENOENT)
+		{
+			SpinLockAcquire(&apw_state->mutex);
+			apw_state->pid_using_dumpfile = InvalidPid;
+			SpinLockRelease(&apw_state->mutex);
+			return;				/* No file to load. */
+		}
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m",
+						AUTOPREWARM_FILE)));
+	}
+
+	/* First line of the file is a record count. */
+	if (fscanf(file, "<<%d>>\n", &num_elements) != 1)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from file \"%s\": %m",
+						AUTOPREWARM_FILE)));
+
+	/* Allocate a dynamic shared memory segment to store the record data. */
+	seg = dsm_create(sizeof(BlockInfoRecord) * Max(num_elements, 1), 0);
+	blkinfo = (BlockInfoRecord *) dsm_segment_address(seg);
+
+	/* Read records, one per line. */
+	for (i = 0; i < num_elements; i++)
+	{
+		unsigned	forknum;
+
+		if (fscanf(file, "%u,%u,%u,%u,%u\n", &blkinfo[i].database,
+				   &blkinfo[i].tablespace, &blkinfo[i].filenode,
+				   &forknum, &blkinfo[i].blocknum) != 5)
+			ereport(ERROR,
+					(errmsg("autoprewarm block dump file is corrupted at line %d",
+							i + 1)));
+		blkinfo[i].forknum = forknum;
+	}
+
+	FreeFile(file);
+
+	/* Sort the blocks to be loaded. */
+	pg_qsort(blkinfo, num_elements, sizeof(BlockInfoRecord),
+			 apw_compare_blockinfo);
+
+	/* Populate shared memory state. */
+	SpinLockAcquire(&apw_state->mutex);
+	apw_state->block_info_handle = dsm_segment_handle(seg);
+	apw_state->prewarmed_blocks = 0;
+	apw_state->out_of_buffers = false;
+	SpinLockRelease(&apw_state->mutex);
+
+	/* Load one database at a time, with several workers for each. */
+	start = 0;
+	while (!got_sigterm && start < num_elements)
+	{
+		int			j = start;
+		Oid			current_db = blkinfo[j].database;
+		bool		out_of_buffers;
+
+		/*
+		 * Advance j to the first BlockInfoRecord that does not belong to
+		 * this database.
+		 */
+		j++;
+		while (j < num_elements)
+		{
+			if (current_db != blkinfo[j].database)
+			{
+				/*
+				 * Combine BlockInfoRecords for global objects with those of
+				 * the database.
+				 */
+				if (current_db != InvalidOid)
+					break;
+				current_db = blkinfo[j].database;
+			}
+
+			j++;
+		}
+
+		/*
+		 * If we reach this point with current_db == InvalidOid, then only
+		 * BlockInfoRecords belonging to global objects exist.  We can't
+		 * prewarm without a database connection, so just bail out.
+		 */
+		if (current_db == InvalidOid)
+			break;
+
+		/* If we've run out of free buffers, don't launch another worker. */
+		if (!have_free_buffer())
+			break;
+
+		/* Hand this database's records over to the per-database workers. */
+		SpinLockAcquire(&apw_state->mutex);
+		apw_state->database = current_db;
+		apw_state->prewarm_next_idx = start;
+		apw_state->prewarm_stop_idx = j;
+		SpinLockRelease(&apw_state->mutex);
+
+		/* This returns once all workers for the database have exited. */
+		apw_run_database_workers(j - start);
+
+		SpinLockAcquire(&apw_state->mutex);
+		out_of_buffers = apw_state->out_of_buffers;
+		SpinLockRelease(&apw_state->mutex);
+		if (out_of_buffers)
+			break;
+
+		/* Prepare for next database. */
+		start = j;
+	}
+
+	/* Clean up. */
+	dsm_detach(seg);
+	SpinLockAcquire(&apw_state->mutex);
+	apw_state->pid_using_dumpfile = InvalidPid;
+	prewarmed_blocks = apw_state->prewarmed_blocks;
+	SpinLockRelease(&apw_state->mutex);
+
+	/* Report our success. */
+	ereport(LOG,
+	   (errmsg("autoprewarm successfully prewarmed %d of %d previously-loaded blocks",
+			   prewarmed_blocks, num_elements)));
+}
+
+/*
+ * Start up to autoprewarm_workers per-database workers for the records
+ * described in shared memory, and wait for all of them to exit.
+ */
+static void
+apw_run_database_workers(int num_records)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle **handles;
+	int			nworkers;
+	int			nlaunched;
+	int			i;
+
+	nworkers = Min(autoprewarm_workers,
+				   (num_records + AUTOPREWARM_CHUNK_SIZE - 1) /
+				   AUTOPREWARM_CHUNK_SIZE);
+	handles = (BackgroundWorkerHandle **)
+		palloc(sizeof(BackgroundWorkerHandle *) * nworkers);
+
+	MemSet(&worker, 0, sizeof(BackgroundWorker));
+	worker.bgw_flags =
+		BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	worker.bgw_main = NULL;
+	strcpy(worker.bgw_library_name, "pg_prewarm");
+	strcpy(worker.bgw_function_name, "autoprewarm_database_main");
+	strcpy(worker.bgw_name, "autoprewarm worker");
+
+	/* must set notify PID to wait for shutdown */
+	worker.bgw_notify_pid = MyProcPid;
+
+	/* Make do with fewer workers if we run out of background worker slots. */
+	for (nlaunched = 0; nlaunched < nworkers; nlaunched++)
+	{
+		if (!RegisterDynamicBackgroundWorker(&worker, &handles[nlaunched]))
+			break;
+	}
+
+	if (nlaunched == 0)
+		ereport(LOG,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("registering dynamic bgworker autoprewarm failed"),
+				 errhint("Consider increasing configuration parameter \"max_worker_processes\".")));
+
+	for (i = 0; i < nlaunched; i++)
+	{
+		/*
+		 * Ignore return value; if the worker failed to start or died, the
+		 * others simply take over its share of the records.
+		 */
+		if (WaitForBackgroundWorkerShutdown(handles[i]) ==
+			BGWH_POSTMASTER_DIED)
+			ereport(FATAL,
+					(errcode(ERRCODE_ADMIN_SHUTDOWN),
+					 errmsg("cannot start bgworker autoprewarm without postmaster"),
+					 errhint("Kill all remaining database processes and restart the database.")));
+		pfree(handles[i]);
+	}
+
+	pfree(handles);
+}
+
+/*
+ * Prewarm all blocks for one database (and possibly also global objects, if
+ * those got grouped with this database).  Several of these workers run
+ * concurrently, each claiming chunks of the shared record array.
+ */
+void
+autoprewarm_database_main(Datum main_arg)
+{
+	Oid			database;
+	dsm_segment *seg;
+	BlockInfoRecord *block_info;
+	int			prewarmed_blocks = 0;
+
+	/* Establish signal handlers; once that's done, unblock signals. */
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* Connect to correct database and get block information. */
+	apw_init_shmem();
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "autoprewarm");
+	seg = dsm_attach(apw_state->block_info_handle);
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+
+	/* Transactions below replace the resource owner; keep the mapping. */
+	dsm_pin_mapping(seg);
+
+	SpinLockAcquire(&apw_state->mutex);
+	database = apw_state->database;
+	SpinLockRelease(&apw_state->mutex);
+
+	BackgroundWorkerInitializeConnectionByOid(database, InvalidOid);
+	block_info = (BlockInfoRecord *) dsm_segment_address(seg);
+
+	for (;;)
+	{
+		int			start;
+		int			stop;
+
+		/* Claim the next chunk of records, unless there's nothing left. */
+		SpinLockAcquire(&apw_state->mutex);
+		start = apw_state->prewarm_next_idx;
+		stop = Min(start + AUTOPREWARM_CHUNK_SIZE,
+				   apw_state->prewarm_stop_idx);
+		if (apw_state->out_of_buffers || start >= stop)
+		{
+			SpinLockRelease(&apw_state->mutex);
+			break;
+		}
+		apw_state->prewarm_next_idx = stop;
+		SpinLockRelease(&apw_state->mutex);
+
+		prewarmed_blocks += apw_load_range(block_info, start, stop);
+	}
+
+	dsm_detach(seg);
+
+	/* Tell the master how much we did. */
+	SpinLockAcquire(&apw_state->mutex);
+	apw_state->prewarmed_blocks += prewarmed_blocks;
+	SpinLockRelease(&apw_state->mutex);
+}
+
+/*
+ * Load the blocks of records [start, stop), which all belong to the database
+ * we're connected to or to global objects.  Returns the number of blocks
+ * read into shared buffers.
+ */
+static int
+apw_load_range(BlockInfoRecord *block_info, int start, int stop)
+{
+	Relation	rel = NULL;
+	bool		in_xact = false;
+	Oid			tablespace = InvalidOid;
+	Oid			filenode = InvalidOid;
+	ForkNumber	forknum = InvalidForkNumber;
+	BlockNumber nblocks = 0;
+	int			prewarmed_blocks = 0;
+	int			pos;
+
+	for (pos = start; pos < stop; pos++)
+	{
+		BlockInfoRecord *blk = &block_info[pos];
+		Buffer		buf;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/*
+		 * As soon as we encounter a block of a new relation, close the old
+		 * relation.  Note that rel will be NULL if try_relation_open failed
+		 * previously; in that case, there is nothing to close.
+		 */
+		if (in_xact &&
+			(blk->filenode != filenode || blk->tablespace != tablespace))
+		{
+			if (rel)
+				relation_close(rel, AccessShareLock);
+			rel = NULL;
+			CommitTransactionCommand();
+			in_xact = false;
+		}
+
+		/*
+		 * Try to open each new relation, but only once, when we first
+		 * encounter it.  If it's been dropped, skip the associated blocks.
+		 */
+		if (!in_xact)
+		{
+			Oid			reloid;
+
+			StartTransactionCommand();
+			in_xact = true;
+			tablespace = blk->tablespace;
+			filenode = blk->filenode;
+			forknum = InvalidForkNumber;
+
+			reloid = RelidByRelfilenode(blk->tablespace, blk->filenode);
+			if (OidIsValid(reloid))
+				rel = try_relation_open(reloid, AccessShareLock);
+		}
+		if (!rel)
+			continue;
+
+		/* Once per fork, check for fork existence and size. */
+		if (blk->forknum != forknum)
+		{
+			RelationOpenSmgr(rel);
+
+			/*
+			 * smgrexists is not safe for illegal forknum, hence check whether
+			 * the passed forknum is valid before using it in smgrexists.
+			 */
+			if (blk->forknum > InvalidForkNumber &&
+				blk->forknum <= MAX_FORKNUM &&
+				smgrexists(rel->rd_smgr, blk->forknum))
+				nblocks = RelationGetNumberOfBlocksInFork(rel, blk->forknum);
+			else
+				nblocks = 0;
+			forknum = blk->forknum;
+		}
+
+		/* Check whether blocknum is valid and within fork file size. */
+		if (blk->blocknum >= nblocks)
+			continue;
+
+		/*
+		 * Prewarm buffer only while there are free ones; once they are gone
+		 * we'd only be evicting blocks we loaded earlier.
+		 */
+		if (!have_free_buffer())
+		{
+			SpinLockAcquire(&apw_state->mutex);
+			apw_state->out_of_buffers = true;
+			SpinLockRelease(&apw_state->mutex);
+			break;
+		}
+
+		buf = ReadBufferExtended(rel, blk->forknum, blk->blocknum, RBM_NORMAL,
+								 NULL);
+		if (BufferIsValid(buf))
+		{
+			prewarmed_blocks++;
+			ReleaseBuffer(buf);
+		}
+	}
+
+	if (in_xact)
+	{
+		if (rel)
+			relation_close(rel, AccessShareLock);
+		CommitTransactionCommand();
+	}
+
+	return prewarmed_blocks;
+}
+
+/*
+ * Dump information on blocks in shared buffers.  We use a text format here
+ * so that it's easy to understand and even change the file contents if
+ * necessary.
+ * Returns the number of blocks dumped.
+ */
+static int64
+apw_dump_now(bool is_bgworker, bool dump_unlogged)
+{
+	int			num_blocks;
+	int			i;
+	int			ret;
+	BlockInfoRecord *block_info_array;
+	BufferDesc *bufHdr;
+	FILE	   *file;
+	char		transient_dump_file_path[MAXPGPATH];
+	pid_t		pid;
+
+	SpinLockAcquire(&apw_state->mutex);
+	pid = apw_state->pid_using_dumpfile;
+	if (pid == InvalidPid)
+		apw_state->pid_using_dumpfile = MyProcPid;
+	SpinLockRelease(&apw_state->mutex);
+
+	if (pid != InvalidPid)
+	{
+		if (!is_bgworker)
+			ereport(ERROR,
+					(errmsg("could not perform block dump because dump file is being used by PID %lu",
+							(unsigned long) pid)));
+
+		ereport(LOG,
+				(errmsg("skipping block dump because it is already being performed by PID %lu",
+						(unsigned long) pid)));
+		return 0;
+	}
+
+	block_info_array = (BlockInfoRecord *)
+		MemoryContextAllocHuge(CurrentMemoryContext,
+							   sizeof(BlockInfoRecord) * NBuffers);
+
+	for (num_blocks = 0, i = 0; i < NBuffers; i++)
+	{
+		uint32		buf_state;
+
+		CHECK_FOR_INTERRUPTS();
+
+		bufHdr = GetBufferDescriptor(i);
+
+		/* Lock each buffer header before inspecting. */
+		buf_state = LockBufHdr(bufHdr);
+
+		/*
+		 * Unlogged tables will be automatically truncated after a crash or
+		 * unclean shutdown. In such cases we need not prewarm them. Dump
+		 * them only if requested by caller.
+		 */
+		if (buf_state & BM_TAG_VALID &&
+			((buf_state & BM_PERMANENT) || dump_unlogged))
+		{
+			block_info_array[num_blocks].database = bufHdr->tag.rnode.dbNode;
+			block_info_array[num_blocks].tablespace = bufHdr->tag.rnode.spcNode;
+			block_info_array[num_blocks].filenode = bufHdr->tag.rnode.relNode;
+			block_info_array[num_blocks].forknum = bufHdr->tag.forkNum;
+			block_info_array[num_blocks].blocknum = bufHdr->tag.blockNum;
+			++num_blocks;
+		}
+
+		UnlockBufHdr(bufHdr, buf_state);
+	}
+
+	snprintf(transient_dump_file_path, MAXPGPATH, "%s.tmp", AUTOPREWARM_FILE);
+	file = AllocateFile(transient_dump_file_path, "w");
+	if (!file)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m",
+						transient_dump_file_path)));
+
+	ret = fprintf(file, "<<%d>>\n", num_blocks);
+	if (ret < 0)
+	{
+		int			save_errno = errno;
+
+		FreeFile(file);
+		unlink(transient_dump_file_path);
+		errno = save_errno;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m",
+						transient_dump_file_path)));
+	}
+
+	for (i = 0; i < num_blocks; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		ret = fprintf(file, "%u,%u,%u,%u,%u\n",
+					  block_info_array[i].database,
+					  block_info_array[i].tablespace,
+					  block_info_array[i].filenode,
+					  (uint32) block_info_array[i].forknum,
+					  block_info_array[i].blocknum);
+		if (ret < 0)
+		{
+			int			save_errno = errno;
+
+			FreeFile(file);
+			unlink(transient_dump_file_path);
+			errno = save_errno;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							transient_dump_file_path)));
+		}
+	}
+
+	pfree(block_info_array);
+
+	/*
+	 * Rename transient_dump_file_path to AUTOPREWARM_FILE to make things
+	 * permanent.
+	 */
+	ret = FreeFile(file);
+	if (ret != 0)
+	{
+		int			save_errno = errno;
+
+		unlink(transient_dump_file_path);
+		errno = save_errno;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m",
+						transient_dump_file_path)));
+	}
+
+	(void) durable_rename(transient_dump_file_path, AUTOPREWARM_FILE, ERROR);
+
+	SpinLockAcquire(&apw_state->mutex);
+	apw_state->pid_using_dumpfile = InvalidPid;
+	SpinLockRelease(&apw_state->mutex);
+
+	ereport(DEBUG1,
+			(errmsg("wrote block details for %d blocks", num_blocks)));
+	return num_blocks;
+}
+
+/*
+ * SQL-callable function to launch autoprewarm.
+ */
+Datum
+autoprewarm_start_worker(PG_FUNCTION_ARGS)
+{
+	pid_t		pid;
+
+	if (!autoprewarm)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("autoprewarm is disabled")));
+
+	apw_init_shmem();
+	SpinLockAcquire(&apw_state->mutex);
+	pid = apw_state->bgworker_pid;
+	SpinLockRelease(&apw_state->mutex);
+
+	if (pid != InvalidPid)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("autoprewarm worker is already running under PID %lu",
+						(unsigned long) pid)));
+
+	apw_start_master_worker();
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * SQL-callable function to perform an immediate block dump.
+ */
+Datum
+autoprewarm_dump_now(PG_FUNCTION_ARGS)
+{
+	int64		num_blocks;
+
+	apw_init_shmem();
+
+	PG_ENSURE_ERROR_CLEANUP(apw_detach_shmem, 0);
+	{
+		num_blocks = apw_dump_now(false, true);
+	}
+	PG_END_ENSURE_ERROR_CLEANUP(apw_detach_shmem, 0);
+
+	PG_RETURN_INT64(num_blocks);
+}
+
+/*
+ * Allocate and initialize autoprewarm related shared memory, if not already
+ * done, and set up backend-local pointer to that state.  Returns true if an
+ * existing shared memory segment was found.
+ */
+static bool
+apw_init_shmem(void)
+{
+	bool		found;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	apw_state = ShmemInitStruct("autoprewarm",
+								sizeof(AutoPrewarmSharedState),
+								&found);
+	if (!found)
+	{
+		/* First time through ... */
+		SpinLockInit(&apw_state->mutex);
+		apw_state->bgworker_pid = InvalidPid;
+		apw_state->pid_using_dumpfile = InvalidPid;
+	}
+	LWLockRelease(AddinShmemInitLock);
+
+	return found;
+}
+
+/*
+ * Clear our PID from autoprewarm shared state.
+ */
+static void
+apw_detach_shmem(int code, Datum arg)
+{
+	SpinLockAcquire(&apw_state->mutex);
+	if (apw_state->pid_using_dumpfile == MyProcPid)
+		apw_state->pid_using_dumpfile = InvalidPid;
+	if (apw_state->bgworker_pid == MyProcPid)
+		apw_state->bgworker_pid = InvalidPid;
+	SpinLockRelease(&apw_state->mutex);
+}
+
+/*
+ * Start autoprewarm master worker process.
+ */
+static void
+apw_start_master_worker(void)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle *handle;
+	BgwHandleStatus status;
+	pid_t		pid;
+
+	MemSet(&worker, 0, sizeof(BackgroundWorker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	worker.bgw_main = NULL;
+	strcpy(worker.bgw_library_name, "pg_prewarm");
+	strcpy(worker.bgw_function_name, "autoprewarm_main");
+	strcpy(worker.bgw_name, "autoprewarm master");
+
+	if (process_shared_preload_libraries_in_progress)
+	{
+		RegisterBackgroundWorker(&worker);
+		return;
+	}
+
+	/* must set notify PID to wait for startup */
+	worker.bgw_notify_pid = MyProcPid;
+
+	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("could not register background process"),
+				 errhint("You may need to increase max_worker_processes.")));
+
+	status = WaitForBackgroundWorkerStartup(handle, &pid);
+	if (status != BGWH_STARTED)
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("could not start background process"),
+				 errhint("More details may be available in the server log.")));
+}
+
+/*
+ * Compare function used for qsort().  This sorts by database, tablespace,
+ * filenode, fork number and block number, which is also the order in which
+ * a relation's blocks lie on disk.
+ */
+static int
+apw_compare_blockinfo(const void *p, const void *q)
+{
+	const BlockInfoRecord *a = (const BlockInfoRecord *) p;
+	const BlockInfoRecord *b = (const BlockInfoRecord *) q;
+
+#define cmp_member_elem(fld)	\
+do { \
+	if (a->fld < b->fld)		\
+		return -1;				\
+	else if (a->fld > b->fld)	\
+		return 1;				\
+} while(0)
+
+	cmp_member_elem(database);
+	cmp_member_elem(tablespace);
+	cmp_member_elem(filenode);
+	cmp_member_elem(forknum);
+	cmp_member_elem(blocknum);
+
+	return 0;
+}
+
+/*
+ * Signal handler for SIGTERM
+ */
+static void
+apw_sigterm_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sigterm = true;
+
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Signal handler for SIGHUP
+ */
+static void
+apw_sighup_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sighup = true;
+
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
@@ -0,0 +1,18 @@
+/* contrib/pg_prewarm/pg_prewarm--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_prewarm UPDATE TO '1.1'" to load this file. \quit
+
+CREATE FUNCTION autoprewarm_start_worker()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'autoprewarm_start_worker'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION autoprewarm_dump_now()
+RETURNS int8
+AS 'MODULE_PATHNAME', 'autoprewarm_dump_now'
+LANGUAGE C STRICT;
+
+-- Don't want these to be available to public.
+REVOKE ALL ON FUNCTION autoprewarm_start_worker() FROM PUBLIC;
+REVOKE ALL ON FUNCTION autoprewarm_dump_now() FROM PUBLIC;
@@ -0,0 +1,28 @@
+/* contrib/pg_prewarm/pg_prewarm--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION pg_prewarm" to load this file. \quit
+
+-- Register the function.
+CREATE FUNCTION pg_prewarm(regclass,
+						   mode text default 'buffer',
+						   fork text default 'main',
+						   first_block int8 default null,
+						   last_block int8 default null)
+RETURNS int8
+AS 'MODULE_PATHNAME', 'pg_prewarm'
+LANGUAGE C;
+
+CREATE FUNCTION autoprewarm_start_worker()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'autoprewarm_start_worker'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION autoprewarm_dump_now()
+RETURNS int8
+AS 'MODULE_PATHNAME', 'autoprewarm_dump_now'
+LANGUAGE C STRICT;
+
+-- Don't want these to be available to public.
+REVOKE ALL ON FUNCTION autoprewarm_start_worker() FROM PUBLIC;
+REVOKE ALL ON FUNCTION autoprewarm_dump_now() FROM PUBLIC;
@@ -0,0 +1,17 @@
+/* contrib/pg_query_state/pg_query_state--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_query_state UPDATE TO '1.1'" to load this file. \quit
+
+CREATE FUNCTION pg_query_state_snapshot(pid integer)
+	RETURNS TABLE (node_id integer
+				 , parent_id integer
+				 , node_type text
+				 , running boolean
+				 , loops float8
+				 , rows float8
+				 , plan_rows float8
+				 , total_time float8
+				 , snapshot_time timestamptz)
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C STRICT VOLATILE;
@@ -16,11 +16,15 @@
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/autovacuum.h"
 #include "storage/ipc.h"
 #include "storage/procarray.h"
 #include "storage/procsignal.h"
 #include "storage/shm_toc.h"
+#include "utils/builtins.h"
 #include "utils/guc.h"
+#include "utils/timeout.h"
 
 #ifdef PG_MODULE_MAGIC
 PG_MODULE_MAGIC;
@@ -39,6 +43,7 @@ bool pg_qs_enable = true;
 bool pg_qs_timing = false;
 bool pg_qs_buffers = false;
 bool pg_qs_trace = false;
+int pg_qs_snapshot_interval = 0;
 
 /* Saved hook values in case of unload */
 static ExecutorStart_hook_type prev_ExecutorStart = NULL;
@@ -57,10 +62,14 @@ static void qs_ExecutorRun(QueryDesc *queryDesc, ScanDirection direction, long c
 static void qs_ExecutorFinish(QueryDesc *queryDesc);
 static void qs_ExecutorEnd(QueryDesc *queryDesc);
 static void qs_postExecProcNode(PlanState *planstate, TupleTableSlot *result);
+static void qs_snapshot_handler(void);
 
 /* Global variables */
 List 					*QueryDescStack = NIL;
 static ProcSignalReason QueryStatePollReason;
+static ProcSignalReason QueryStateSnapshotReason = INVALID_PROCSIGNAL;
+static TimeoutId		snapshot_timeout;
+static bool				snapshot_timeout_registered = false;
 static bool 			module_initialized = false;
 static const char		*be_state_str[] = {						/* BackendState -> string repr */
 							"undefined",						/* STATE_UNDEFINED */
@@ -97,6 +106,17 @@ user_data		*caller = NULL;
 pg_qs_params	*params = NULL;
 trace_request	*trace_req = NULL;
 shm_mq 			*mq = NULL;
+qs_snapshot		*snapshots = NULL;
+
+/*
+ * Number of snapshot slots, one per backend.  MaxBackends is not computed
+ * yet when shared memory is requested in _PG_init, so count it the same way.
+ */
+static int
+pg_qs_snapshot_slots()
+{
+	return MaxConnections + autovacuum_max_workers + 1 + max_worker_processes;
+}
 
 /*
  * Estimate amount of shared memory needed.
@@ -110,12 +130,13 @@ pg_qs_shmem_size()
 
 	shm_toc_initialize_estimator(&e);
 
-	nkeys = 4;
+	nkeys = 5;
 
 	shm_toc_estimate_chunk(&e, sizeof(user_data));
 	shm_toc_estimate_chunk(&e, sizeof(pg_qs_params));
 	shm_toc_estimate_chunk(&e, sizeof(trace_request));
 	shm_toc_estimate_chunk(&e, (Size) QUEUE_SIZE);
+	shm_toc_estimate_chunk(&e, mul_size(sizeof(qs_snapshot), pg_qs_snapshot_slots()));
 
 	shm_toc_estimate_keys(&e, nkeys);
 	size = shm_toc_estimate(&e);
@@ -147,6 +168,9 @@ pg_qs_shmem_startup(void)
 		MemSet(trace_req, 0, sizeof(trace_request));
 		mq = shm_toc_allocate(toc, QUEUE_SIZE);
 		shm_toc_insert(toc, 3, mq);
+		snapshots = shm_toc_allocate(toc, sizeof(qs_snapshot) * pg_qs_snapshot_slots());
+		shm_toc_insert(toc, 4, snapshots);
+		MemSet(snapshots, 0, sizeof(qs_snapshot) * pg_qs_snapshot_slots());
 	}
 	else
 	{
@@ -156,6 +180,7 @@ pg_qs_shmem_startup(void)
 		params = shm_toc_lookup(toc, 1);
 		trace_req = shm_toc_lookup(toc, 2);
 		mq = shm_toc_lookup(toc, 3);
+		snapshots = shm_toc_lookup(toc, 4);
 	}
 
 	if (prev_shmem_startup_hook)
@@ -189,6 +214,12 @@ _PG_init(void)
 		return;
 	}
 
+	/* Register interrupt on custom signal of publishing progress snapshot */
+	QueryStateSnapshotReason = RegisterCustomProcSignalHandler(qs_snapshot_handler);
+	if (QueryStateSnapshotReason == INVALID_PROCSIGNAL)
+		ereport(WARNING, (errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					errmsg("pg_query_state snapshots are disabled: insufficient custom ProcSignal slots")));
+
 	/* Define custom GUC variables */
 	DefineCustomBoolVariable("pg_query_state.enable",
 							 "Enable module.",
@@ -230,6 +261,18 @@ _PG_init(void)
 							 NULL,
 							 NULL,
 							 NULL);
+	DefineCustomIntVariable("pg_query_state.snapshot_interval",
+							"Sets the interval between progress snapshots published to shared memory.",
+							"Zero turns off snapshots.",
+							&pg_qs_snapshot_interval,
+							0,
+							0,
+							INT_MAX,
+							PGC_SUSET,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
 	EmitWarningsOnPlaceholders("pg_query_state");
 
 	/* Install hooks */
@@ -257,6 +300,8 @@ _PG_fini(void)
 	/* clear global state */
 	list_free(QueryDescStack);
 	AssignCustomProcSignalHandler(QueryStatePollReason, NULL);
+	if (QueryStateSnapshotReason != INVALID_PROCSIGNAL)
+		AssignCustomProcSignalHandler(QueryStateSnapshotReason, NULL);
 
 	/* Uninstall hooks. */
 	ExecutorStart_hook = prev_ExecutorStart;
@@ -267,6 +312,68 @@ _PG_fini(void)
 	postExecProcNode_hook = prev_postExecProcNode;
 }
 
+/*
+ * Timeout handler of progress snapshots: just ask ourselves to publish
+ * snapshot at the next CHECK_FOR_INTERRUPTS, executor state is not safe to
+ * read from the signal handler.
+ */
+static void
+qs_snapshot_timeout_handler(void)
+{
+	SendProcSignal(MyProcPid, QueryStateSnapshotReason, MyBackendId);
+}
+
+/*
+ * Custom signal handler of QueryStateSnapshotReason:
+ * 		publish snapshot and schedule the next one while query is running
+ */
+static void
+qs_snapshot_handler(void)
+{
+	PublishQueryStateSnapshot();
+
+	if (pg_qs_enable && pg_qs_snapshot_interval > 0
+		&& list_length(QueryDescStack) > 0)
+		enable_timeout_after(snapshot_timeout, pg_qs_snapshot_interval);
+}
+
+/*
+ * Start publishing progress snapshots of upper level query if they are on
+ */
+static void
+start_query_snapshots(QueryDesc *queryDesc)
+{
+	if (!module_initialized || QueryStateSnapshotReason == INVALID_PROCSIGNAL
+		|| MyBackendId == InvalidBackendId)
+		return;
+
+	if (!pg_qs_enable || pg_qs_snapshot_interval <= 0
+		|| (queryDesc->instrument_options & INSTRUMENT_ROWS) == 0)
+		return;
+
+	/* timeouts are set up per backend, so register ours on first use */
+	if (!snapshot_timeout_registered)
+	{
+		snapshot_timeout = RegisterTimeout(USER_TIMEOUT, qs_snapshot_timeout_handler);
+		snapshot_timeout_registered = true;
+	}
+
+	enable_timeout_after(snapshot_timeout, pg_qs_snapshot_interval);
+}
+
+/*
+ * Stop publishing progress snapshots and withdraw the last one
+ */
+static void
+stop_query_snapshots()
+{
+	if (!snapshot_timeout_registered)
+		return;
+
+	disable_timeout(snapshot_timeout, false);
+	ClearQueryStateSnapshot();
+}
+
 /*
  * In trace mode suspend query execution until other backend resumes it
  */
@@ -352,8 +459,11 @@ qs_ExecutorStart(QueryDesc *queryDesc, int eflags)
 
 		/* set/reset hook for trace mode before start of upper level query */
 		if (list_length(QueryDescStack) == 1)
+		{
 			postExecProcNode_hook = (pg_qs_enable && pg_qs_trace) ?
 										qs_postExecProcNode : prev_postExecProcNode;
+			start_query_snapshots(queryDesc);
+		}
 
 		/* suspend traceable query if it is not continued (hook is not thrown off) */
 		if (postExecProcNode_hook == qs_postExecProcNode)
@@ -362,6 +472,7 @@ qs_ExecutorStart(QueryDesc *queryDesc, int eflags)
 	PG_CATCH();
 	{
 		QueryDescStack = NIL;
+		stop_query_snapshots();
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
@@ -384,6 +495,7 @@ qs_ExecutorRun(QueryDesc *queryDesc, ScanDirection direction, long count)
 	PG_CATCH();
 	{
 		QueryDescStack = NIL;
+		stop_query_snapshots();
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
@@ -406,6 +518,7 @@ qs_ExecutorFinish(QueryDesc *queryDesc)
 	PG_CATCH();
 	{
 		QueryDescStack = NIL;
+		stop_query_snapshots();
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
@@ -422,6 +535,10 @@ qs_ExecutorEnd(QueryDesc *queryDesc)
 	{
 		QueryDescStack = list_delete_first(QueryDescStack);
 
+		/* upper level query is done */
+		if (list_length(QueryDescStack) == 0)
+			stop_query_snapshots();
+
 		if (prev_ExecutorEnd)
 			prev_ExecutorEnd(queryDesc);
 		else
@@ -430,6 +547,7 @@ qs_ExecutorEnd(QueryDesc *queryDesc)
 	PG_CATCH();
 	{
 		QueryDescStack = NIL;
+		stop_query_snapshots();
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
@@ -706,6 +824,167 @@ pg_query_state(PG_FUNCTION_ARGS)
 		SRF_RETURN_DONE(funcctx);
 }
 
+/*
+ * Name of plan node type as shown by EXPLAIN
+ */
+static const char *
+plan_node_name(NodeTag type)
+{
+	switch (type)
+	{
+		case T_Result:			return "Result";
+		case T_ModifyTable:		return "ModifyTable";
+		case T_Append:			return "Append";
+		case T_MergeAppend:		return "Merge Append";
+		case T_RecursiveUnion:	return "Recursive Union";
+		case T_BitmapAnd:		return "BitmapAnd";
+		case T_BitmapOr:		return "BitmapOr";
+		case T_SeqScan:			return "Seq Scan";
+		case T_SampleScan:		return "Sample Scan";
+		case T_IndexScan:		return "Index Scan";
+		case T_IndexOnlyScan:	return "Index Only Scan";
+		case T_BitmapIndexScan:	return "Bitmap Index Scan";
+		case T_BitmapHeapScan:	return "Bitmap Heap Scan";
+		case T_TidScan:			return "Tid Scan";
+		case T_SubqueryScan:	return "Subquery Scan";
+		case T_FunctionScan:	return "Function Scan";
+		case T_ValuesScan:		return "Values Scan";
+		case T_CteScan:			return "CTE Scan";
+		case T_WorkTableScan:	return "WorkTable Scan";
+		case T_ForeignScan:		return "Foreign Scan";
+		case T_CustomScan:		return "Custom Scan";
+		case T_NestLoop:		return "Nested Loop";
+		case T_MergeJoin:		return "Merge Join";
+		case T_HashJoin:		return "Hash Join";
+		case T_Material:		return "Materialize";
+		case T_Sort:			return "Sort";
+		case T_Group:			return "Group";
+		case T_Agg:				return "Aggregate";
+		case T_WindowAgg:		return "WindowAgg";
+		case T_Unique:			return "Unique";
+		case T_Hash:			return "Hash";
+		case T_SetOp:			return "SetOp";
+		case T_LockRows:		return "LockRows";
+		case T_Limit:			return "Limit";
+		default:				return "???";
+	}
+}
+
+/*
+ * Implementation of pg_query_state_snapshot function:
+ * 		read the last progress snapshot published by backend with specified
+ * 		pid without any interaction with it
+ */
+PG_FUNCTION_INFO_V1(pg_query_state_snapshot);
+Datum
+pg_query_state_snapshot(PG_FUNCTION_ARGS)
+{
+	FuncCallContext	*funcctx;
+	qs_snapshot		*snapshot;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		pid_t			pid = PG_GETARG_INT32(0);
+		PGPROC			*proc;
+		volatile qs_snapshot *slot;
+		MemoryContext	oldcontext;
+		TupleDesc		tupdesc;
+
+		if (!module_initialized)
+			ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							errmsg("pg_query_state wasn't initialized yet")));
+
+		proc = BackendPidGetProc(pid);
+		if (!proc || proc->backendId == InvalidBackendId)
+			ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							errmsg("backend with pid=%d not found", pid)));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		/* copy slot until we get a version not changed in the middle */
+		snapshot = (qs_snapshot *) palloc(sizeof(qs_snapshot));
+		slot = &snapshots[proc->backendId - 1];
+		for (;;)
+		{
+			uint32	before_changecount = slot->changecount;
+			uint32	after_changecount;
+
+			pg_read_barrier();
+			memcpy(snapshot, (qs_snapshot *) slot, sizeof(qs_snapshot));
+			pg_read_barrier();
+			after_changecount = slot->changecount;
+
+			if (before_changecount == after_changecount
+				&& (before_changecount & 1) == 0)
+				break;
+
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		if (snapshot->pid != pid)
+		{
+			elog(INFO, "backend has not published snapshot of query state");
+			MemoryContextSwitchTo(oldcontext);
+			SRF_RETURN_DONE(funcctx);
+		}
+
+		if (!(superuser() || GetUserId() == snapshot->user_id))
+			ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+							errmsg("permission denied")));
+
+		funcctx->user_fctx = snapshot;
+		funcctx->max_calls = snapshot->nnodes;
+
+		/* Make tuple descriptor */
+		tupdesc = CreateTemplateTupleDesc(9, false);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "node_id", INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "parent_id", INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 3, "node_type", TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "running", BOOLOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "loops", FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "rows", FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 7, "plan_rows", FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 8, "total_time", FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 9, "snapshot_time", TIMESTAMPTZOID, -1, 0);
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	/* restore function multicall context */
+	funcctx = SRF_PERCALL_SETUP();
+	snapshot = funcctx->user_fctx;
+
+	if (funcctx->call_cntr < funcctx->max_calls)
+	{
+		HeapTuple 			tuple;
+		Datum				values[9];
+		bool				nulls[9];
+		qs_node_snapshot	*node = &snapshot->nodes[funcctx->call_cntr];
+
+		/* Make and return next tuple to caller */
+		MemSet(values, 0, sizeof(values));
+		MemSet(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(funcctx->call_cntr);
+		values[1] = Int32GetDatum(node->parent);
+		nulls[1] = (node->parent < 0);
+		values[2] = CStringGetTextDatum(plan_node_name(node->type));
+		values[3] = BoolGetDatum(node->running);
+		values[4] = Float8GetDatum(node->loops);
+		values[5] = Float8GetDatum(node->rows);
+		values[6] = Float8GetDatum(node->plan_rows);
+		values[7] = Float8GetDatum(node->total_time);
+		nulls[7] = !snapshot->timing;
+		values[8] = TimestampTzGetDatum(snapshot->snapshot_time);
+		tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+	}
+	else
+		SRF_RETURN_DONE(funcctx);
+}
+
 /*
  * Execute specific tracing command of other backend with specified 'pid'
  */
@@ -15,6 +15,7 @@
 #include "commands/explain.h"
 #include "nodes/pg_list.h"
 #include "storage/shm_mq.h"
+#include "utils/timestamp.h"
 
 #define TIMINIG_OFF_WARNING 1
 #define BUFFERS_OFF_WARNING 2
@@ -62,16 +63,53 @@ typedef struct
 	ExplainFormat format;
 } pg_qs_params;
 
+/* maximum number of plan nodes kept in progress snapshot of one backend */
+#define SNAPSHOT_MAX_NODES 64
+
+/*
+ * Progress counters of plan node published in snapshot
+ */
+typedef struct
+{
+	int		parent;			/* index of parent node in snapshot, -1 for root */
+	NodeTag	type;			/* tag of plan node */
+	bool	running;		/* current loop of node has produced first tuple */
+	double	loops;			/* number of started loops */
+	double	rows;			/* rows produced over all loops so far */
+	double	plan_rows;		/* planner's estimate of rows per loop */
+	double	total_time;		/* time spent in node in ms, if timing is on */
+} qs_node_snapshot;
+
+/*
+ * Progress snapshot of query running in backend, one slot per backend.
+ * Backend bumps 'changecount' before and after update of slot, so reader
+ * copies slot without lock and retries while counter is odd or changed.
+ */
+typedef struct
+{
+	uint32		changecount;
+	int			pid;				/* zero if snapshot is not published */
+	Oid			user_id;
+	bool		timing;
+	TimestampTz	snapshot_time;
+	int			nnodes;
+	qs_node_snapshot nodes[SNAPSHOT_MAX_NODES];
+} qs_snapshot;
+
 /* pg_query_state */
 extern bool 	pg_qs_enable;
 extern bool 	pg_qs_timing;
 extern bool 	pg_qs_buffers;
+extern int		pg_qs_snapshot_interval;
 extern List 	*QueryDescStack;
 extern user_data *caller;
 extern pg_qs_params *params;
 extern shm_mq 	*mq;
+extern qs_snapshot *snapshots;
 
 /* signal_handler.c */
 extern void SendQueryState(void);
+extern void PublishQueryStateSnapshot(void);
+extern void ClearQueryStateSnapshot(void);
 
 #endif
@@ -11,7 +11,11 @@
 #include "pg_query_state.h"
 
 #include "commands/explain.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
+#include "nodes/execnodes.h"
+#include "port/atomics.h"
+#include "storage/backendid.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 
@@ -214,3 +218,147 @@ SendQueryState(void)
 	MemoryContextSwitchTo(oldCxt);
 	MemoryContextDelete(curCxt);
 }
+
+/*
+ * Append progress counters of 'planstate' and its subtree to snapshot
+ */
+static void
+snapshot_plan_node(qs_snapshot *slot, PlanState *planstate, int parent)
+{
+	qs_node_snapshot	*node;
+	Instrumentation		*instr = planstate->instrument;
+	int					index;
+	int					i;
+	ListCell			*lc;
+
+	/* nodes beyond the limit are just not shown */
+	if (slot->nnodes >= SNAPSHOT_MAX_NODES)
+		return;
+
+	index = slot->nnodes++;
+	node = &slot->nodes[index];
+	node->parent = parent;
+	node->type = nodeTag(planstate->plan);
+	node->plan_rows = planstate->plan->plan_rows;
+	if (instr)
+	{
+		/* counters of current loop are not added to totals until its end */
+		node->running = instr->running;
+		node->loops = instr->nloops + (instr->running ? 1 : 0);
+		node->rows = instr->ntuples + instr->tuplecount;
+		node->total_time = 1000.0 * (instr->total + INSTR_TIME_GET_DOUBLE(instr->counter));
+	}
+	else
+	{
+		node->running = false;
+		node->loops = 0;
+		node->rows = 0;
+		node->total_time = 0;
+	}
+
+	/* walk children in the same order as EXPLAIN does */
+	foreach(lc, planstate->initPlan)
+		snapshot_plan_node(slot, ((SubPlanState *) lfirst(lc))->planstate, index);
+	if (outerPlanState(planstate))
+		snapshot_plan_node(slot, outerPlanState(planstate), index);
+	if (innerPlanState(planstate))
+		snapshot_plan_node(slot, innerPlanState(planstate), index);
+
+	switch (nodeTag(planstate))
+	{
+		case T_ModifyTableState:
+			for (i = 0; i < ((ModifyTableState *) planstate)->mt_nplans; i++)
+				snapshot_plan_node(slot, ((ModifyTableState *) planstate)->mt_plans[i], index);
+			break;
+		case T_AppendState:
+			for (i = 0; i < ((AppendState *) planstate)->as_nplans; i++)
+				snapshot_plan_node(slot, ((AppendState *) planstate)->appendplans[i], index);
+			break;
+		case T_MergeAppendState:
+			for (i = 0; i < ((MergeAppendState *) planstate)->ms_nplans; i++)
+				snapshot_plan_node(slot, ((MergeAppendState *) planstate)->mergeplans[i], index);
+			break;
+		case T_BitmapAndState:
+			for (i = 0; i < ((BitmapAndState *) planstate)->nplans; i++)
+				snapshot_plan_node(slot, ((BitmapAndState *) planstate)->bitmapplans[i], index);
+			break;
+		case T_BitmapOrState:
+			for (i = 0; i < ((BitmapOrState *) planstate)->nplans; i++)
+				snapshot_plan_node(slot, ((BitmapOrState *) planstate)->bitmapplans[i], index);
+			break;
+		case T_SubqueryScanState:
+			snapshot_plan_node(slot, ((SubqueryScanState *) planstate)->subplan, index);
+			break;
+		case T_CustomScanState:
+			foreach(lc, ((CustomScanState *) planstate)->custom_ps)
+				snapshot_plan_node(slot, (PlanState *) lfirst(lc), index);
+			break;
+		default:
+			break;
+	}
+
+	foreach(lc, planstate->subPlan)
+		snapshot_plan_node(slot, ((SubPlanState *) lfirst(lc))->planstate, index);
+}
+
+/*
+ * Publish progress counters of outermost running query into shared memory.
+ * This function is called when fire custom signal QueryStateSnapshotReason
+ * which backend sends to itself on timeout, so it runs at the same safe
+ * point as SendQueryState but nobody waits for it.
+ */
+void
+PublishQueryStateSnapshot(void)
+{
+	volatile qs_snapshot *slot;
+	QueryDesc	*queryDesc;
+
+	if (MyBackendId == InvalidBackendId)
+		return;
+
+	if (!pg_qs_enable || pg_qs_snapshot_interval <= 0
+		|| list_length(QueryDescStack) == 0)
+	{
+		ClearQueryStateSnapshot();
+		return;
+	}
+
+	queryDesc = (QueryDesc *) llast(QueryDescStack);
+	slot = &snapshots[MyBackendId - 1];
+
+	slot->changecount++;
+	pg_write_barrier();
+
+	slot->pid = MyProcPid;
+	slot->user_id = GetUserId();
+	slot->timing = (queryDesc->instrument_options & INSTRUMENT_TIMER) != 0;
+	slot->snapshot_time = GetCurrentTimestamp();
+	slot->nnodes = 0;
+	snapshot_plan_node((qs_snapshot *) slot, queryDesc->planstate, -1);
+
+	pg_write_barrier();
+	slot->changecount++;
+}
+
+/*
+ * Withdraw snapshot of current backend, if any
+ */
+void
+ClearQueryStateSnapshot(void)
+{
+	volatile qs_snapshot *slot;
+
+	if (MyBackendId == InvalidBackendId)
+		return;
+
+	slot = &snapshots[MyBackendId - 1];
+	if (slot->pid == 0)
+		return;
+
+	slot->changecount++;
+	pg_write_barrier();
+	slot->pid = 0;
+	slot->nnodes = 0;
+	pg_write_barrier();
+	slot->changecount++;
+}
@@ -48,6 +48,7 @@ tests = [
         test_timing,
         test_formats,
         test_timing_buffers_conflicts,
+        test_snapshot,
 		]
 
 def setup(con):
@@ -449,3 +449,51 @@ def test_timing_buffers_conflicts(config):
 							 and 'WARNING:  buffers statistics disabled\n' in notices
 
 	n_close((acon,))
+
+def test_snapshot(config):
+	"""test progress snapshot"""
+
+	acon, = n_async_connect(config)
+	query = 'select count(*) from foo join bar on foo.c1=bar.c1'
+	num_steps = 10
+	expected = [
+			(0, None, 'Aggregate', 0),
+			(1, 0, 'Hash Join', 0),
+			(2, 1, 'Seq Scan', 1),
+			(3, 1, 'Hash', 0),
+			(4, 3, 'Seq Scan', 9),
+			]
+
+	set_guc(acon, 'enable_mergejoin', 'off')
+	set_guc(acon, 'pg_query_state.snapshot_interval', '10')
+	set_guc(acon, 'pg_query_state.executor_trace', 'on')
+
+	conn = psycopg2.connect(**config)
+	curs = conn.cursor()
+
+	acurs = acon.cursor()
+	acurs.execute(query)
+	for _ in xrange(num_steps):
+		curs.callproc('executor_step', (acon.get_backend_pid(),))
+
+	# let suspended backend publish snapshot of its current state
+	time.sleep(0.1)
+	curs.execute('select node_id, parent_id, node_type, rows from pg_query_state_snapshot(%s)',
+				 (acon.get_backend_pid(),))
+	snapshot = curs.fetchall()
+
+	curs.callproc('executor_continue', (acon.get_backend_pid(),))
+	wait(acon)
+
+	assert	snapshot == expected
+
+	# snapshot is withdrawn once query is done
+	curs.execute('select * from pg_query_state_snapshot(%s)', (acon.get_backend_pid(),))
+	assert	len(curs.fetchall()) == 0
+
+	set_guc(acon, 'pg_query_state.executor_trace', 'off')
+	set_guc(acon, 'pg_query_state.snapshot_interval', '0')
+	set_guc(acon, 'enable_mergejoin', 'on')
+
+	conn.close()
+	n_close((acon,))
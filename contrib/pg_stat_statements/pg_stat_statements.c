@@ -28,10 +28,16 @@
  *
  * To facilitate presenting entries to users, we create "representative" query
  * strings in which constants are replaced with '?' characters, to make it
- * clearer what a normalized entry can represent.  To save on shared memory,
- * and to avoid having to truncate oversized query strings, we store these
- * strings in a temporary external query-texts file.  Offsets into this
- * file are kept in shared memory.
+ * clearer what a normalized entry can represent.  These strings are kept
+ * in a separate shared memory area (pg_stat_statements.query_texts_size),
+ * packed one after another; the entries keep offsets into this area.  When
+ * the area fills up, the live texts are compacted, and if that's not enough,
+ * the least used entries are discarded.  Reading the view thus doesn't
+ * require any I/O.
+ *
+ * To avoid contention on hot entries, backends may accumulate the counters
+ * of already known statements locally, and add them to the shared entries
+ * once per pg_stat_statements.flush_interval (and at exit).
  *
  * Note about locking issues: to create or delete an entry in the shared
  * hashtable, one must hold pgss->lock exclusively.  Modifying any field
@@ -39,13 +45,13 @@
  * one must hold the lock shared.  To read or update the counters within
  * an entry, one must hold the lock shared or exclusive (so the entry doesn't
  * disappear!) and also take the entry's mutex spinlock.
- * The shared state variable pgss->extent (the next free spot in the external
- * query-text file) should be accessed only while holding either the
- * pgss->mutex spinlock, or exclusive lock on pgss->lock.  We use the mutex to
- * allow reserving file space while holding only shared lock on pgss->lock.
- * Rewriting the entire external query-text file, eg for garbage collection,
- * requires holding pgss->lock exclusively; this allows individual entries
- * in the file to be read or written while holding only shared lock.
+ * The shared state variable pgss->extent (the next free spot in the query
+ * text area) should be accessed only while holding either the pgss->mutex
+ * spinlock, or exclusive lock on pgss->lock.  We use the mutex to allow
+ * reserving space while holding only shared lock on pgss->lock.  Moving the
+ * texts, eg for garbage collection, requires holding pgss->lock exclusively;
+ * this allows individual texts to be read or written while holding only
+ * shared lock.
  *
  *
  * Copyright (c) 2008-2015, PostgreSQL Global Development Group
@@ -73,10 +79,12 @@
 #include "pgstat.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
+#include "storage/procsignal.h"
 #include "storage/spin.h"
 #include "tcop/utility.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
+#include "utils/timeout.h"
 
 PG_MODULE_MAGIC;
 
@@ -84,12 +92,8 @@ PG_MODULE_MAGIC;
 #define PGSS_DUMP_FILE	PGSTAT_STAT_PERMANENT_DIRECTORY "/pg_stat_statements.stat"
 
 /*
- * Location of external query text file.  We don't keep it in the core
- * system's stats_temp_directory.  The core system can safely use that GUC
- * setting, because the statistics collector temp file paths are set only once
- * as part of changing the GUC, but pg_stat_statements has no way of avoiding
- * race conditions.  Besides, we only expect modest, infrequent I/O for query
- * strings, so placing the file on a faster filesystem is not compelling.
+ * Location of external query text file used by older versions, which kept
+ * the query texts on disk.  We only remove it if it's left over.
  */
 #define PGSS_TEXT_FILE	PG_STAT_TMP_DIR "/pgss_query_texts.stat"
 
@@ -162,20 +166,29 @@ typedef struct Counters
 /*
  * Statistics per statement
  *
- * Note: in event of a failure in garbage collection of the query text file,
- * we reset query_offset to zero and query_len to -1.  This will be seen as
- * an invalid state by qtext_fetch().
+ * Note: query_len of -1 means the entry has no query text.  This will be
+ * seen as an invalid state by qtext_fetch().
  */
 typedef struct pgssEntry
 {
 	pgssHashKey key;			/* hash key of entry - MUST BE FIRST */
 	Counters	counters;		/* the statistics for this query */
-	Size		query_offset;	/* query text offset in external file */
+	Size		query_offset;	/* query text offset in query text area */
 	int			query_len;		/* # of valid bytes in query string, or -1 */
 	int			encoding;		/* query text encoding */
 	slock_t		mutex;			/* protects the counters only */
 } pgssEntry;
 
+/*
+ * Counters accumulated by a backend for a statement, not yet added to the
+ * shared entry
+ */
+typedef struct pgssLocalEntry
+{
+	pgssHashKey key;			/* hash key of entry - MUST BE FIRST */
+	Counters	counters;		/* calls is zero if nothing to flush */
+} pgssLocalEntry;
+
 /*
  * Global shared state
  */
@@ -184,10 +197,10 @@ typedef struct pgssSharedState
 	LWLock	   *lock;			/* protects hashtable search/modification */
 	double		cur_median_usage;		/* current median usage in hashtable */
 	Size		mean_query_len; /* current mean entry text length */
+	int			reset_count;	/* number of resets, to drop stale counters */
 	slock_t		mutex;			/* protects following fields only: */
-	Size		extent;			/* current extent of query file */
-	int			n_writers;		/* number of active writers to query file */
-	int			gc_count;		/* query file garbage collection cycle count */
+	Size		extent;			/* current extent of query text area */
+	int			gc_count;		/* query text garbage collection cycle count */
 } pgssSharedState;
 
 /*
@@ -238,6 +251,15 @@ static ProcessUtility_hook_type prev_ProcessUtility = NULL;
 /* Links to shared memory state */
 static pgssSharedState *pgss = NULL;
 static HTAB *pgss_hash = NULL;
+static char *pgss_qtexts = NULL;
+
+/* Counters accumulated by this backend (see pgss_flush_local) */
+static HTAB *pgss_local_hash = NULL;
+static int	pgss_local_reset_count = 0;
+static bool pgss_flush_pending = false;
+static ProcSignalReason pgss_flush_reason = INVALID_PROCSIGNAL;
+static TimeoutId pgss_flush_timeout;
+static bool pgss_flush_timeout_registered = false;
 
 /*---- GUC variables ----*/
 
@@ -260,6 +282,8 @@ static int	pgss_max;			/* max # statements to track */
 static int	pgss_track;			/* tracking level */
 static bool pgss_track_utility; /* whether to track utility commands */
 static bool pgss_save;			/* whether to save stats across shutdown */
+static int	pgss_query_texts_size;	/* size of query text area, in kB */
+static int	pgss_flush_interval;	/* how long to accumulate counters locally */
 
 
 #define pgss_enabled() \
@@ -307,16 +331,27 @@ static void pg_stat_statements_internal(FunctionCallInfo fcinfo,
 							pgssVersion api_version,
 							bool showtext);
 static Size pgss_memsize(void);
+static Size pgss_qtexts_size(void);
+static void entry_accum(volatile Counters *counters, double total_time,
+			uint64 rows, const BufferUsage *bufusage);
+static void entry_merge(volatile Counters *counters, const Counters *delta);
+static bool pgss_local_enabled(void);
+static void local_entry_add(pgssHashKey *key, int reset_count);
+static void local_entries_discard(void);
+static void pgss_schedule_flush(void);
+static void pgss_flush_local(void);
+static void pgss_flush_timeout_handler(void);
+static void pgss_backend_shutdown(int code, Datum arg);
 static pgssEntry *entry_alloc(pgssHashKey *key, Size query_offset, int query_len,
 			int encoding, bool sticky);
 static void entry_dealloc(void);
 static bool qtext_store(const char *query, int query_len,
 			Size *query_offset, int *gc_count);
-static char *qtext_load_file(Size *buffer_size);
-static char *qtext_fetch(Size query_offset, int query_len,
-			char *buffer, Size buffer_size);
+static char *qtext_fetch(Size query_offset, int query_len);
 static bool need_gc_qtexts(void);
 static void gc_qtexts(void);
+static int	qtext_offset_cmp(const void *lhs, const void *rhs);
+static void qtext_compact(void);
 static void entry_reset(void);
 static void AppendJumble(pgssJumbleState *jstate,
 			 const unsigned char *item, Size size);
@@ -397,8 +432,42 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomIntVariable("pg_stat_statements.query_texts_size",
+	 "Sets the amount of shared memory for the texts of tracked statements.",
+							"-1 means 1kB per tracked statement.",
+							&pgss_query_texts_size,
+							-1,
+							-1,
+							MAX_KILOBYTES,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_stat_statements.flush_interval",
+							"Sets how long a backend may accumulate statement statistics before adding them to the shared entries.",
+							"Zero updates the shared entries immediately.",
+							&pgss_flush_interval,
+							1000,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
 	EmitWarningsOnPlaceholders("pg_stat_statements");
 
+	/*
+	 * Backends flush their local counters from a custom signal handler, which
+	 * they send to themselves when the flush interval expires (a timeout
+	 * handler can't take locks).  Without a free slot counters are always
+	 * added to the shared entries immediately.
+	 */
+	pgss_flush_reason = RegisterCustomProcSignalHandler(pgss_flush_local);
+
 	/*
 	 * Request additional shared resources.  (These are no-ops if we're not in
 	 * the postmaster process.)  We'll allocate or attach to the shared
@@ -444,9 +513,7 @@ _PG_fini(void)
 
 /*
  * shmem_startup hook: allocate or attach to shared memory,
- * then load any pre-existing statistics from file.
- * Also create and load the query-texts file, which is expected to exist
- * (even if empty) while the module is enabled.
+ * then load any pre-existing statistics and query texts from file.
  */
 static void
 pgss_shmem_startup(void)
@@ -454,7 +521,6 @@ pgss_shmem_startup(void)
 	bool		found;
 	HASHCTL		info;
 	FILE	   *file = NULL;
-	FILE	   *qfile = NULL;
 	uint32		header;
 	int32		num;
 	int32		pgver;
@@ -468,6 +534,7 @@ pgss_shmem_startup(void)
 	/* reset in case this is a restart within the postmaster */
 	pgss = NULL;
 	pgss_hash = NULL;
+	pgss_qtexts = NULL;
 
 	/*
 	 * Create or attach to the shared memory state, including hash table
@@ -485,11 +552,15 @@ pgss_shmem_startup(void)
 		pgss->cur_median_usage = ASSUMED_MEDIAN_INIT;
 		pgss->mean_query_len = ASSUMED_LENGTH_INIT;
 		SpinLockInit(&pgss->mutex);
+		pgss->reset_count = 0;
 		pgss->extent = 0;
-		pgss->n_writers = 0;
 		pgss->gc_count = 0;
 	}
 
+	pgss_qtexts = ShmemInitStruct("pg_stat_statements query texts",
+								  pgss_qtexts_size(),
+								  &found);
+
 	memset(&info, 0, sizeof(info));
 	info.keysize = sizeof(pgssHashKey);
 	info.entrysize = sizeof(pgssEntry);
@@ -520,24 +591,16 @@ pgss_shmem_startup(void)
 	 * processes running when this code is reached.
 	 */
 
-	/* Unlink query text file possibly left over from crash */
+	/* Unlink query text file possibly left over by an older version */
 	unlink(PGSS_TEXT_FILE);
 
-	/* Allocate new query text temp file */
-	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
-	if (qfile == NULL)
-		goto write_error;
-
 	/*
 	 * If we were told not to load old statistics, we're done.  (Note we do
 	 * not try to unlink any old dump file in this case.  This seems a bit
 	 * questionable but it's the historical behavior.)
 	 */
 	if (!pgss_save)
-	{
-		FreeFile(qfile);
 		return;
-	}
 
 	/*
 	 * Attempt to load old statistics from the dump file.
@@ -548,7 +611,6 @@ pgss_shmem_startup(void)
 		if (errno != ENOENT)
 			goto read_error;
 		/* No existing persisted stats file, so we're done */
-		FreeFile(qfile);
 		return;
 	}
 
@@ -594,11 +656,12 @@ pgss_shmem_startup(void)
 		if (temp.counters.calls == 0)
 			continue;
 
-		/* Store the query text */
-		query_offset = pgss->extent;
-		if (fwrite(buffer, 1, temp.query_len + 1, qfile) != temp.query_len + 1)
-			goto write_error;
-		pgss->extent += temp.query_len + 1;
+		/*
+		 * Store the query text.  If the text area has been made smaller
+		 * since the dump was written, drop the entries that don't fit.
+		 */
+		if (!qtext_store(buffer, temp.query_len, &query_offset, NULL))
+			continue;
 
 		/* make the hashtable entry (discards old entries if too many) */
 		entry = entry_alloc(&temp.key, query_offset, temp.query_len,
@@ -611,20 +674,11 @@ pgss_shmem_startup(void)
 
 	pfree(buffer);
 	FreeFile(file);
-	FreeFile(qfile);
 
 	/*
 	 * Remove the persisted stats file so it's not included in
 	 * backups/replication slaves, etc.  A new file will be written on next
 	 * shutdown.
-	 *
-	 * Note: it's okay if the PGSS_TEXT_FILE is included in a basebackup,
-	 * because we remove that file on startup; it acts inversely to
-	 * PGSS_DUMP_FILE, in that it is only supposed to be around when the
-	 * server is running, whereas PGSS_DUMP_FILE is only supposed to be around
-	 * when the server is not running.  Leaving the file creates no danger of
-	 * a newly restored database having a spurious record of execution costs,
-	 * which is what we're really concerned about here.
 	 */
 	unlink(PGSS_DUMP_FILE);
 
@@ -641,26 +695,13 @@ data_error:
 			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 			 errmsg("ignoring invalid data in pg_stat_statement file \"%s\"",
 					PGSS_DUMP_FILE)));
-	goto fail;
-write_error:
-	ereport(LOG,
-			(errcode_for_file_access(),
-			 errmsg("could not write pg_stat_statement file \"%s\": %m",
-					PGSS_TEXT_FILE)));
 fail:
 	if (buffer)
 		pfree(buffer);
 	if (file)
 		FreeFile(file);
-	if (qfile)
-		FreeFile(qfile);
 	/* If possible, throw away the bogus file; ignore any error */
 	unlink(PGSS_DUMP_FILE);
-
-	/*
-	 * Don't unlink PGSS_TEXT_FILE here; it should always be around while the
-	 * server is running with pg_stat_statements enabled
-	 */
 }
 
 /*
@@ -673,8 +714,6 @@ static void
 pgss_shmem_shutdown(int code, Datum arg)
 {
 	FILE	   *file;
-	char	   *qbuffer = NULL;
-	Size		qbuffer_size = 0;
 	HASH_SEQ_STATUS hash_seq;
 	int32		num_entries;
 	pgssEntry  *entry;
@@ -703,10 +742,6 @@ pgss_shmem_shutdown(int code, Datum arg)
 	if (fwrite(&num_entries, sizeof(int32), 1, file) != 1)
 		goto error;
 
-	qbuffer = qtext_load_file(&qbuffer_size);
-	if (qbuffer == NULL)
-		goto error;
-
 	/*
 	 * When serializing to disk, we store query texts immediately after their
 	 * entry data.  Any orphaned query texts are thereby excluded.
@@ -715,8 +750,7 @@ pgss_shmem_shutdown(int code, Datum arg)
 	while ((entry = hash_seq_search(&hash_seq)) != NULL)
 	{
 		int			len = entry->query_len;
-		char	   *qstr = qtext_fetch(entry->query_offset, len,
-									   qbuffer, qbuffer_size);
+		char	   *qstr = qtext_fetch(entry->query_offset, len);
 
 		if (qstr == NULL)
 			continue;			/* Ignore any entries with bogus texts */
@@ -730,9 +764,6 @@ pgss_shmem_shutdown(int code, Datum arg)
 		}
 	}
 
-	free(qbuffer);
-	qbuffer = NULL;
-
 	if (FreeFile(file))
 	{
 		file = NULL;
@@ -744,9 +775,6 @@ pgss_shmem_shutdown(int code, Datum arg)
 	 */
 	(void) durable_rename(PGSS_DUMP_FILE ".tmp", PGSS_DUMP_FILE, LOG);
 
-	/* Unlink query-texts file; it's not needed while shutdown */
-	unlink(PGSS_TEXT_FILE);
-
 	return;
 
 error:
@@ -754,12 +782,9 @@ error:
 			(errcode_for_file_access(),
 			 errmsg("could not write pg_stat_statement file \"%s\": %m",
 					PGSS_DUMP_FILE ".tmp")));
-	if (qbuffer)
-		free(qbuffer);
 	if (file)
 		FreeFile(file);
 	unlink(PGSS_DUMP_FILE ".tmp");
-	unlink(PGSS_TEXT_FILE);
 }
 
 /*
@@ -1120,6 +1145,7 @@ pgss_store(const char *query, uint32 queryId,
 	char	   *norm_query = NULL;
 	int			encoding = GetDatabaseEncoding();
 	int			query_len;
+	int			reset_count = 0;
 
 	Assert(query != NULL);
 
@@ -1127,13 +1153,35 @@ pgss_store(const char *query, uint32 queryId,
 	if (!pgss || !pgss_hash)
 		return;
 
-	query_len = strlen(query);
-
 	/* Set up key for hashtable search */
 	key.userid = GetUserId();
 	key.dbid = MyDatabaseId;
 	key.queryid = queryId;
 
+	/*
+	 * If the statement is known to have a shared entry, just accumulate the
+	 * counters locally; pgss_flush_local adds them to the shared entry
+	 * later.  An unlocked look at reset_count is enough here: at worst a few
+	 * executions just after a reset are accounted to the stale generation,
+	 * and then discarded.
+	 */
+	if (!jstate && pgss_local_enabled() && pgss_local_hash &&
+		pgss_local_reset_count == pgss->reset_count)
+	{
+		pgssLocalEntry *local;
+
+		local = (pgssLocalEntry *) hash_search(pgss_local_hash, &key,
+											   HASH_FIND, NULL);
+		if (local)
+		{
+			entry_accum(&local->counters, total_time, rows, bufusage);
+			pgss_schedule_flush();
+			return;
+		}
+	}
+
+	query_len = strlen(query);
+
 	/* Lookup the hash table entry with shared lock. */
 	LWLockAcquire(pgss->lock, LW_SHARED);
 
@@ -1163,14 +1211,14 @@ pgss_store(const char *query, uint32 queryId,
 			LWLockAcquire(pgss->lock, LW_SHARED);
 		}
 
-		/* Append new query text to file with only shared lock held */
+		/* Append new query text with only shared lock held */
 		stored = qtext_store(norm_query ? norm_query : query, query_len,
 							 &query_offset, &gc_count);
 
 		/*
-		 * Determine whether we need to garbage collect external query texts
-		 * while the shared lock is still held.  This micro-optimization
-		 * avoids taking the time to decide this while holding exclusive lock.
+		 * Determine whether we need to garbage collect query texts while the
+		 * shared lock is still held.  This micro-optimization avoids taking
+		 * the time to decide this while holding exclusive lock.
 		 */
 		do_gc = need_gc_qtexts();
 
@@ -1189,7 +1237,43 @@ pgss_store(const char *query, uint32 queryId,
 			stored = qtext_store(norm_query ? norm_query : query, query_len,
 								 &query_offset, NULL);
 
-		/* If we failed to write to the text file, give up */
+		/*
+		 * If the text area is full, reclaim the space of texts left behind
+		 * by deallocated entries, and if that's not enough, deallocate some
+		 * more entries.
+		 */
+		if (!stored)
+		{
+			qtext_compact();
+			stored = qtext_store(norm_query ? norm_query : query, query_len,
+								 &query_offset, NULL);
+		}
+		if (!stored)
+		{
+			entry_dealloc();
+			qtext_compact();
+			stored = qtext_store(norm_query ? norm_query : query, query_len,
+								 &query_offset, NULL);
+		}
+
+		/*
+		 * A text that doesn't fit even then is truncated to the remaining
+		 * space, rather than not tracking the statement at all.
+		 */
+		if (!stored)
+		{
+			const char *qstr = norm_query ? norm_query : query;
+			Size		avail = pgss_qtexts_size() - pgss->extent;
+
+			if (avail > 1)
+			{
+				query_len = pg_encoding_mbcliplen(encoding, qstr, query_len,
+												  avail - 1);
+				stored = qtext_store(qstr, query_len, &query_offset, NULL);
+			}
+		}
+
+		/* If we failed to store the query text, give up */
 		if (!stored)
 			goto done;
 
@@ -1217,49 +1301,11 @@ pgss_store(const char *query, uint32 queryId,
 		if (e->counters.calls == 0)
 			e->counters.usage = USAGE_INIT;
 
-		e->counters.calls += 1;
-		e->counters.total_time += total_time;
-		if (e->counters.calls == 1)
-		{
-			e->counters.min_time = total_time;
-			e->counters.max_time = total_time;
-			e->counters.mean_time = total_time;
-		}
-		else
-		{
-			/*
-			 * Welford's method for accurately computing variance. See
-			 * <http://www.johndcook.com/blog/standard_deviation/>
-			 */
-			double		old_mean = e->counters.mean_time;
-
-			e->counters.mean_time +=
-				(total_time - old_mean) / e->counters.calls;
-			e->counters.sum_var_time +=
-				(total_time - old_mean) * (total_time - e->counters.mean_time);
-
-			/* calculate min and max time */
-			if (e->counters.min_time > total_time)
-				e->counters.min_time = total_time;
-			if (e->counters.max_time < total_time)
-				e->counters.max_time = total_time;
-		}
-		e->counters.rows += rows;
-		e->counters.shared_blks_hit += bufusage->shared_blks_hit;
-		e->counters.shared_blks_read += bufusage->shared_blks_read;
-		e->counters.shared_blks_dirtied += bufusage->shared_blks_dirtied;
-		e->counters.shared_blks_written += bufusage->shared_blks_written;
-		e->counters.local_blks_hit += bufusage->local_blks_hit;
-		e->counters.local_blks_read += bufusage->local_blks_read;
-		e->counters.local_blks_dirtied += bufusage->local_blks_dirtied;
-		e->counters.local_blks_written += bufusage->local_blks_written;
-		e->counters.temp_blks_read += bufusage->temp_blks_read;
-		e->counters.temp_blks_written += bufusage->temp_blks_written;
-		e->counters.blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_read_time);
-		e->counters.blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_write_time);
-		e->counters.usage += USAGE_EXEC(total_time);
+		entry_accum(&e->counters, total_time, rows, bufusage);
 
 		SpinLockRelease(&e->mutex);
+
+		reset_count = pgss->reset_count;
 	}
 
 done:
@@ -1268,6 +1314,299 @@ done:
 	/* We postpone this clean-up until we're out of the lock */
 	if (norm_query)
 		pfree(norm_query);
+
+	/* Accumulate further executions of the statement locally */
+	if (!jstate && entry && pgss_local_enabled())
+		local_entry_add(&key, reset_count);
+}
+
+/*
+ * Add the statistics of one execution to a set of counters.
+ */
+static void
+entry_accum(volatile Counters *counters, double total_time, uint64 rows,
+			const BufferUsage *bufusage)
+{
+	counters->calls += 1;
+	counters->total_time += total_time;
+	if (counters->calls == 1)
+	{
+		counters->min_time = total_time;
+		counters->max_time = total_time;
+		counters->mean_time = total_time;
+	}
+	else
+	{
+		/*
+		 * Welford's method for accurately computing variance. See
+		 * <http://www.johndcook.com/blog/standard_deviation/>
+		 */
+		double		old_mean = counters->mean_time;
+
+		counters->mean_time +=
+			(total_time - old_mean) / counters->calls;
+		counters->sum_var_time +=
+			(total_time - old_mean) * (total_time - counters->mean_time);
+
+		/* calculate min and max time */
+		if (counters->min_time > total_time)
+			counters->min_time = total_time;
+		if (counters->max_time < total_time)
+			counters->max_time = total_time;
+	}
+	counters->rows += rows;
+	counters->shared_blks_hit += bufusage->shared_blks_hit;
+	counters->shared_blks_read += bufusage->shared_blks_read;
+	counters->shared_blks_dirtied += bufusage->shared_blks_dirtied;
+	counters->shared_blks_written += bufusage->shared_blks_written;
+	counters->local_blks_hit += bufusage->local_blks_hit;
+	counters->local_blks_read += bufusage->local_blks_read;
+	counters->local_blks_dirtied += bufusage->local_blks_dirtied;
+	counters->local_blks_written += bufusage->local_blks_written;
+	counters->temp_blks_read += bufusage->temp_blks_read;
+	counters->temp_blks_written += bufusage->temp_blks_written;
+	counters->blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_read_time);
+	counters->blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_write_time);
+	counters->usage += USAGE_EXEC(total_time);
+}
+
+/*
+ * Add a set of counters accumulated separately to an entry's counters.
+ */
+static void
+entry_merge(volatile Counters *counters, const Counters *delta)
+{
+	int64		calls;
+	double		diff;
+
+	if (delta->calls == 0)
+		return;
+
+	/* "Unstick" entry if it was previously sticky */
+	if (counters->calls == 0)
+	{
+		counters->usage = USAGE_INIT;
+		counters->min_time = delta->min_time;
+		counters->max_time = delta->max_time;
+	}
+	else
+	{
+		if (counters->min_time > delta->min_time)
+			counters->min_time = delta->min_time;
+		if (counters->max_time < delta->max_time)
+			counters->max_time = delta->max_time;
+	}
+
+	/*
+	 * Combine the means and variances of the two samples as described by
+	 * Chan, Golub and LeVeque.  See
+	 * <https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance>
+	 */
+	calls = counters->calls + delta->calls;
+	diff = delta->mean_time - counters->mean_time;
+	counters->mean_time += diff * delta->calls / calls;
+	counters->sum_var_time += delta->sum_var_time +
+		diff * diff * counters->calls * delta->calls / calls;
+	counters->calls = calls;
+
+	counters->total_time += delta->total_time;
+	counters->rows += delta->rows;
+	counters->shared_blks_hit += delta->shared_blks_hit;
+	counters->shared_blks_read += delta->shared_blks_read;
+	counters->shared_blks_dirtied += delta->shared_blks_dirtied;
+	counters->shared_blks_written += delta->shared_blks_written;
+	counters->local_blks_hit += delta->local_blks_hit;
+	counters->local_blks_read += delta->local_blks_read;
+	counters->local_blks_dirtied += delta->local_blks_dirtied;
+	counters->local_blks_written += delta->local_blks_written;
+	counters->temp_blks_read += delta->temp_blks_read;
+	counters->temp_blks_written += delta->temp_blks_written;
+	counters->blk_read_time += delta->blk_read_time;
+	counters->blk_write_time += delta->blk_write_time;
+	counters->usage += delta->usage;
+}
+
+/*
+ * Can this backend accumulate counters locally?
+ */
+static bool
+pgss_local_enabled(void)
+{
+	return pgss_flush_interval > 0 &&
+		pgss_flush_reason != INVALID_PROCSIGNAL &&
+		MyBackendId != InvalidBackendId;
+}
+
+/*
+ * Note that a statement has a shared entry, so that its further executions
+ * in this backend are accumulated locally.  reset_count is the generation of
+ * the shared entry, as seen while the lock was held.
+ */
+static void
+local_entry_add(pgssHashKey *key, int reset_count)
+{
+	pgssLocalEntry *local;
+	bool		found;
+
+	if (pgss_local_hash == NULL)
+	{
+		HASHCTL		info;
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(pgssHashKey);
+		info.entrysize = sizeof(pgssLocalEntry);
+		info.hash = pgss_hash_fn;
+		info.match = pgss_match_fn;
+		info.hcxt = TopMemoryContext;
+		pgss_local_hash = hash_create("pg_stat_statements local hash",
+									  64, &info,
+									  HASH_ELEM | HASH_FUNCTION |
+									  HASH_COMPARE | HASH_CONTEXT);
+		pgss_local_reset_count = reset_count;
+
+		before_shmem_exit(pgss_backend_shutdown, (Datum) 0);
+	}
+	else if (pgss_local_reset_count != reset_count)
+	{
+		/* Whatever we have accumulated predates a reset */
+		local_entries_discard();
+		pgss_local_reset_count = reset_count;
+	}
+
+	/* The shared entries would be evicted long before we get this far */
+	if (hash_get_num_entries(pgss_local_hash) >= pgss_max)
+		return;
+
+	local = (pgssLocalEntry *) hash_search(pgss_local_hash, key,
+										   HASH_ENTER, &found);
+	if (!found)
+		memset(&local->counters, 0, sizeof(Counters));
+}
+
+/*
+ * Forget all the statements of the local hash table.
+ */
+static void
+local_entries_discard(void)
+{
+	HASH_SEQ_STATUS hash_seq;
+	pgssLocalEntry *local;
+
+	hash_seq_init(&hash_seq, pgss_local_hash);
+	while ((local = hash_seq_search(&hash_seq)) != NULL)
+		hash_search(pgss_local_hash, &local->key, HASH_REMOVE, NULL);
+}
+
+/*
+ * Arrange for the local counters to be flushed after flush_interval.
+ */
+static void
+pgss_schedule_flush(void)
+{
+	if (pgss_flush_pending)
+		return;
+
+	if (!pgss_flush_timeout_registered)
+	{
+		pgss_flush_timeout = RegisterTimeout(USER_TIMEOUT,
+											 pgss_flush_timeout_handler);
+		pgss_flush_timeout_registered = true;
+	}
+
+	enable_timeout_after(pgss_flush_timeout, pgss_flush_interval);
+	pgss_flush_pending = true;
+}
+
+/*
+ * Timeout handler: we can't take locks here, so ask ourselves to do the
+ * flush at the next CHECK_FOR_INTERRUPTS().
+ */
+static void
+pgss_flush_timeout_handler(void)
+{
+	SendProcSignal(MyProcPid, pgss_flush_reason, MyBackendId);
+}
+
+/*
+ * Add the counters accumulated by this backend to the shared entries.
+ *
+ * This is the custom signal handler requested by pgss_flush_timeout_handler;
+ * it's also called directly before reading the statistics and at backend
+ * exit.  Local entries of statements not executed since the previous flush
+ * are removed, so the local hash only keeps the statements in active use.
+ */
+static void
+pgss_flush_local(void)
+{
+	HASH_SEQ_STATUS hash_seq;
+	pgssLocalEntry *local;
+
+	pgss_flush_pending = false;
+
+	if (!pgss || !pgss_hash || !pgss_local_hash)
+		return;
+
+	/* We may have been interrupted while holding the lock; try again later */
+	if (LWLockHeldByMe(pgss->lock))
+	{
+		pgss_schedule_flush();
+		return;
+	}
+
+	LWLockAcquire(pgss->lock, LW_SHARED);
+
+	if (pgss->reset_count != pgss_local_reset_count)
+	{
+		/* Whatever we have accumulated predates a reset */
+		pgss_local_reset_count = pgss->reset_count;
+		LWLockRelease(pgss->lock);
+		local_entries_discard();
+		return;
+	}
+
+	hash_seq_init(&hash_seq, pgss_local_hash);
+	while ((local = hash_seq_search(&hash_seq)) != NULL)
+	{
+		pgssEntry  *entry = NULL;
+
+		if (local->counters.calls > 0)
+			entry = (pgssEntry *) hash_search(pgss_hash, &local->key,
+											  HASH_FIND, NULL);
+
+		/*
+		 * If the shared entry has been deallocated meanwhile, the counters
+		 * are lost just as if we had added them before.
+		 */
+		if (entry == NULL)
+		{
+			hash_search(pgss_local_hash, &local->key, HASH_REMOVE, NULL);
+			continue;
+		}
+
+		{
+			volatile pgssEntry *e = (volatile pgssEntry *) entry;
+
+			SpinLockAcquire(&e->mutex);
+			entry_merge(&e->counters, &local->counters);
+			SpinLockRelease(&e->mutex);
+		}
+
+		memset(&local->counters, 0, sizeof(Counters));
+	}
+
+	LWLockRelease(pgss->lock);
+}
+
+/*
+ * before_shmem_exit hook: flush the local counters.
+ */
+static void
+pgss_backend_shutdown(int code, Datum arg)
+{
+	if (pgss && LWLockHeldByMe(pgss->lock))
+		return;
+
+	pgss_flush_local();
 }
 
 /*
@@ -1347,10 +1686,6 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 	MemoryContext oldcontext;
 	Oid			userid = GetUserId();
 	bool		is_superuser = superuser();
-	char	   *qbuffer = NULL;
-	Size		qbuffer_size = 0;
-	Size		extent = 0;
-	int			gc_count = 0;
 	HASH_SEQ_STATUS hash_seq;
 	pgssEntry  *entry;
 
@@ -1415,39 +1750,11 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 
 	MemoryContextSwitchTo(oldcontext);
 
-	/*
-	 * We'd like to load the query text file (if needed) while not holding any
-	 * lock on pgss->lock.  In the worst case we'll have to do this again
-	 * after we have the lock, but it's unlikely enough to make this a win
-	 * despite occasional duplicated work.  We need to reload if anybody
-	 * writes to the file (either a retail qtext_store(), or a garbage
-	 * collection) between this point and where we've gotten shared lock.  If
-	 * a qtext_store is actually in progress when we look, we might as well
-	 * skip the speculative load entirely.
-	 */
-	if (showtext)
-	{
-		int			n_writers;
-
-		/* Take the mutex so we can examine variables */
-		{
-			volatile pgssSharedState *s = (volatile pgssSharedState *) pgss;
-
-			SpinLockAcquire(&s->mutex);
-			extent = s->extent;
-			n_writers = s->n_writers;
-			gc_count = s->gc_count;
-			SpinLockRelease(&s->mutex);
-		}
-
-		/* No point in loading file now if there are active writers */
-		if (n_writers == 0)
-			qbuffer = qtext_load_file(&qbuffer_size);
-	}
+	/* Make our own executions visible */
+	pgss_flush_local();
 
 	/*
-	 * Get shared lock, load or reload the query text file if we must, and
-	 * iterate over the hashtable entries.
+	 * Get shared lock and iterate over the hashtable entries.
 	 *
 	 * With a large hash table, we might be holding the lock rather longer
 	 * than one could wish.  However, this only blocks creation of new hash
@@ -1458,28 +1765,6 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 	 */
 	LWLockAcquire(pgss->lock, LW_SHARED);
 
-	if (showtext)
-	{
-		/*
-		 * Here it is safe to examine extent and gc_count without taking the
-		 * mutex.  Note that although other processes might change
-		 * pgss->extent just after we look at it, the strings they then write
-		 * into the file cannot yet be referenced in the hashtable, so we
-		 * don't care whether we see them or not.
-		 *
-		 * If qtext_load_file fails, we just press on; we'll return NULL for
-		 * every query text.
-		 */
-		if (qbuffer == NULL ||
-			pgss->extent != extent ||
-			pgss->gc_count != gc_count)
-		{
-			if (qbuffer)
-				free(qbuffer);
-			qbuffer = qtext_load_file(&qbuffer_size);
-		}
-	}
-
 	hash_seq_init(&hash_seq, pgss_hash);
 	while ((entry = hash_seq_search(&hash_seq)) != NULL)
 	{
@@ -1504,9 +1789,7 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			if (showtext)
 			{
 				char	   *qstr = qtext_fetch(entry->query_offset,
-											   entry->query_len,
-											   qbuffer,
-											   qbuffer_size);
+											   entry->query_len);
 
 				if (qstr)
 				{
@@ -1613,9 +1896,6 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 	/* clean up and return the tuplestore */
 	LWLockRelease(pgss->lock);
 
-	if (qbuffer)
-		free(qbuffer);
-
 	tuplestore_donestoring(tupstore);
 }
 
@@ -1629,10 +1909,23 @@ pgss_memsize(void)
 
 	size = MAXALIGN(sizeof(pgssSharedState));
 	size = add_size(size, hash_estimate_size(pgss_max, sizeof(pgssEntry)));
+	size = add_size(size, pgss_qtexts_size());
 
 	return size;
 }
 
+/*
+ * Size of the query text area.
+ */
+static Size
+pgss_qtexts_size(void)
+{
+	if (pgss_query_texts_size < 0)
+		return mul_size(pgss_max, ASSUMED_LENGTH_INIT);
+
+	return mul_size(pgss_query_texts_size, 1024);
+}
+
 /*
  * Allocate a new hashtable entry.
  * caller must hold an exclusive lock on pgss->lock
@@ -1777,203 +2070,84 @@ entry_dealloc(void)
 }
 
 /*
- * Given a null-terminated string, allocate a new entry in the external query
- * text file and store the string there.
+ * Given a string, allocate space for it in the shared query text area and
+ * store it there, null-terminated.
  *
- * Although we could compute the string length via strlen(), callers already
- * have it handy, so we require them to pass it too.
+ * The string need not be null-terminated; we copy query_len bytes, which
+ * lets callers store a truncated text.
  *
- * If successful, returns true, and stores the new entry's offset in the file
+ * If successful, returns true, and stores the new text's offset in the area
  * into *query_offset.  Also, if gc_count isn't NULL, *gc_count is set to the
  * number of garbage collections that have occurred so far.
  *
- * On failure, returns false.
+ * Returns false if there's not enough free space left in the area.
  *
  * At least a shared lock on pgss->lock must be held by the caller, so as
  * to prevent a concurrent garbage collection.  Share-lock-holding callers
  * should pass a gc_count pointer to obtain the number of garbage collections,
  * so that they can recheck the count after obtaining exclusive lock to
- * detect whether a garbage collection occurred (and removed this entry).
+ * detect whether a garbage collection occurred (and moved other texts over
+ * this one).
  */
 static bool
 qtext_store(const char *query, int query_len,
 			Size *query_offset, int *gc_count)
 {
 	Size		off;
-	int			fd;
+	bool		fits;
 
 	/*
-	 * We use a spinlock to protect extent/n_writers/gc_count, so that
-	 * multiple processes may execute this function concurrently.
+	 * We use a spinlock to protect extent/gc_count, so that multiple
+	 * processes may execute this function concurrently.
 	 */
 	{
 		volatile pgssSharedState *s = (volatile pgssSharedState *) pgss;
 
 		SpinLockAcquire(&s->mutex);
 		off = s->extent;
-		s->extent += query_len + 1;
-		s->n_writers++;
+		fits = (off + query_len + 1 <= pgss_qtexts_size());
+		if (fits)
+			s->extent += query_len + 1;
 		if (gc_count)
 			*gc_count = s->gc_count;
 		SpinLockRelease(&s->mutex);
 	}
 
-	*query_offset = off;
-
-	/* Now write the data into the successfully-reserved part of the file */
-	fd = OpenTransientFile(PGSS_TEXT_FILE, O_RDWR | O_CREAT | PG_BINARY,
-						   S_IRUSR | S_IWUSR);
-	if (fd < 0)
-		goto error;
-
-	if (lseek(fd, off, SEEK_SET) != off)
-		goto error;
-
-	if (write(fd, query, query_len + 1) != query_len + 1)
-		goto error;
-
-	CloseTransientFile(fd);
+	if (!fits)
+		return false;
 
-	/* Mark our write complete */
-	{
-		volatile pgssSharedState *s = (volatile pgssSharedState *) pgss;
+	*query_offset = off;
 
-		SpinLockAcquire(&s->mutex);
-		s->n_writers--;
-		SpinLockRelease(&s->mutex);
-	}
+	/* Now copy the text into the successfully-reserved space */
+	memcpy(pgss_qtexts + off, query, query_len);
+	pgss_qtexts[off + query_len] = '\0';
 
 	return true;
-
-error:
-	ereport(LOG,
-			(errcode_for_file_access(),
-			 errmsg("could not write pg_stat_statement file \"%s\": %m",
-					PGSS_TEXT_FILE)));
-
-	if (fd >= 0)
-		CloseTransientFile(fd);
-
-	/* Mark our write complete */
-	{
-		volatile pgssSharedState *s = (volatile pgssSharedState *) pgss;
-
-		SpinLockAcquire(&s->mutex);
-		s->n_writers--;
-		SpinLockRelease(&s->mutex);
-	}
-
-	return false;
 }
 
 /*
- * Read the external query text file into a malloc'd buffer.
- *
- * Returns NULL (without throwing an error) if unable to read, eg
- * file not there or insufficient memory.
- *
- * On success, the buffer size is also returned into *buffer_size.
- *
- * This can be called without any lock on pgss->lock, but in that case
- * the caller is responsible for verifying that the result is sane.
- */
-static char *
-qtext_load_file(Size *buffer_size)
-{
-	char	   *buf;
-	int			fd;
-	struct stat stat;
-
-	fd = OpenTransientFile(PGSS_TEXT_FILE, O_RDONLY | PG_BINARY, 0);
-	if (fd < 0)
-	{
-		if (errno != ENOENT)
-			ereport(LOG,
-					(errcode_for_file_access(),
-				   errmsg("could not read pg_stat_statement file \"%s\": %m",
-						  PGSS_TEXT_FILE)));
-		return NULL;
-	}
-
-	/* Get file length */
-	if (fstat(fd, &stat))
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not stat pg_stat_statement file \"%s\": %m",
-						PGSS_TEXT_FILE)));
-		CloseTransientFile(fd);
-		return NULL;
-	}
-
-	/* Allocate buffer; beware that off_t might be wider than size_t */
-	if (stat.st_size <= MaxAllocHugeSize)
-		buf = (char *) malloc(stat.st_size);
-	else
-		buf = NULL;
-	if (buf == NULL)
-	{
-		ereport(LOG,
-				(errcode(ERRCODE_OUT_OF_MEMORY),
-				 errmsg("out of memory"),
-				 errdetail("Could not allocate enough memory to read pg_stat_statement file \"%s\".",
-						   PGSS_TEXT_FILE)));
-		CloseTransientFile(fd);
-		return NULL;
-	}
-
-	/*
-	 * OK, slurp in the file.  If we get a short read and errno doesn't get
-	 * set, the reason is probably that garbage collection truncated the file
-	 * since we did the fstat(), so we don't log a complaint --- but we don't
-	 * return the data, either, since it's most likely corrupt due to
-	 * concurrent writes from garbage collection.
-	 */
-	errno = 0;
-	if (read(fd, buf, stat.st_size) != stat.st_size)
-	{
-		if (errno)
-			ereport(LOG,
-					(errcode_for_file_access(),
-				   errmsg("could not read pg_stat_statement file \"%s\": %m",
-						  PGSS_TEXT_FILE)));
-		free(buf);
-		CloseTransientFile(fd);
-		return NULL;
-	}
-
-	CloseTransientFile(fd);
-
-	*buffer_size = stat.st_size;
-	return buf;
-}
-
-/*
- * Locate a query text in the file image previously read by qtext_load_file().
+ * Locate a query text in the shared query text area.
  *
  * We validate the given offset/length, and return NULL if bogus.  Otherwise,
- * the result points to a null-terminated string within the buffer.
+ * the result points to a null-terminated string within the area, which
+ * stays valid as long as the caller holds pgss->lock.
  */
 static char *
-qtext_fetch(Size query_offset, int query_len,
-			char *buffer, Size buffer_size)
+qtext_fetch(Size query_offset, int query_len)
 {
-	/* File read failed? */
-	if (buffer == NULL)
-		return NULL;
 	/* Bogus offset/length? */
 	if (query_len < 0 ||
-		query_offset + query_len >= buffer_size)
+		query_offset + query_len >= pgss_qtexts_size())
 		return NULL;
 	/* As a further sanity check, make sure there's a trailing null */
-	if (buffer[query_offset + query_len] != '\0')
+	if (pgss_qtexts[query_offset + query_len] != '\0')
 		return NULL;
 	/* Looks OK */
-	return buffer + query_offset;
+	return pgss_qtexts + query_offset;
 }
 
 /*
- * Do we need to garbage-collect the external query text file?
+ * Do we need to garbage-collect the query text area?
  *
  * Caller should hold at least a shared lock on pgss->lock.
  */
@@ -1991,50 +2165,35 @@ need_gc_qtexts(void)
 		SpinLockRelease(&s->mutex);
 	}
 
-	/* Don't proceed if file does not exceed 512 bytes per possible entry */
-	if (extent < 512 * pgss_max)
+	/* Don't proceed until three quarters of the area are used */
+	if (extent < pgss_qtexts_size() / 4 * 3)
 		return false;
 
 	/*
-	 * Don't proceed if file is less than about 50% bloat.  Nothing can or
+	 * Don't proceed if the area is less than about 50% bloat.  Nothing can or
 	 * should be done in the event of unusually large query texts accounting
-	 * for file's large size.  We go to the trouble of maintaining the mean
-	 * query length in order to prevent garbage collection from thrashing
-	 * uselessly.
+	 * for the usage.  We go to the trouble of maintaining the mean query
+	 * length in order to prevent garbage collection from thrashing uselessly.
 	 */
-	if (extent < pgss->mean_query_len * pgss_max * 2)
+	if (extent < pgss->mean_query_len * hash_get_num_entries(pgss_hash) * 2)
 		return false;
 
 	return true;
 }
 
 /*
- * Garbage-collect orphaned query texts in external file.
+ * Garbage-collect orphaned query texts in the query text area, if there are
+ * enough of them to be worth it.
  *
  * This won't be called often in the typical case, since it's likely that
- * there won't be too much churn, and besides, a similar compaction process
- * occurs when serializing to disk at shutdown or as part of resetting.
- * Despite this, it seems prudent to plan for the edge case where the file
- * becomes unreasonably large, with no other method of compaction likely to
- * occur in the foreseeable future.
+ * there won't be too much churn.  pgss_store also compacts the area
+ * unconditionally, when it runs out of space.
  *
  * The caller must hold an exclusive lock on pgss->lock.
- *
- * At the first sign of trouble we unlink the query text file to get a clean
- * slate (although existing statistics are retained), rather than risk
- * thrashing by allowing the same problem case to recur indefinitely.
  */
 static void
 gc_qtexts(void)
 {
-	char	   *qbuffer;
-	Size		qbuffer_size;
-	FILE	   *qfile = NULL;
-	HASH_SEQ_STATUS hash_seq;
-	pgssEntry  *entry;
-	Size		extent;
-	int			nentries;
-
 	/*
 	 * When called from pgss_store, some other session might have proceeded
 	 * with garbage collection in the no-lock-held interim of lock strength
@@ -2043,46 +2202,52 @@ gc_qtexts(void)
 	if (!need_gc_qtexts())
 		return;
 
-	/*
-	 * Load the old texts file.  If we fail (out of memory, for instance),
-	 * invalidate query texts.  Hopefully this is rare.  It might seem better
-	 * to leave things alone on an OOM failure, but the problem is that the
-	 * file is only going to get bigger; hoping for a future non-OOM result is
-	 * risky and can easily lead to complete denial of service.
-	 */
-	qbuffer = qtext_load_file(&qbuffer_size);
-	if (qbuffer == NULL)
-		goto gc_fail;
+	qtext_compact();
+}
 
-	/*
-	 * We overwrite the query texts file in place, so as to reduce the risk of
-	 * an out-of-disk-space failure.  Since the file is guaranteed not to get
-	 * larger, this should always work on traditional filesystems; though we
-	 * could still lose on copy-on-write filesystems.
-	 */
-	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
-	if (qfile == NULL)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not write pg_stat_statement file \"%s\": %m",
-						PGSS_TEXT_FILE)));
-		goto gc_fail;
-	}
+/*
+ * qsort comparator for sorting entries into query text offset order
+ */
+static int
+qtext_offset_cmp(const void *lhs, const void *rhs)
+{
+	Size		l_offset = (*(pgssEntry *const *) lhs)->query_offset;
+	Size		r_offset = (*(pgssEntry *const *) rhs)->query_offset;
 
-	extent = 0;
-	nentries = 0;
+	if (l_offset < r_offset)
+		return -1;
+	else if (l_offset > r_offset)
+		return +1;
+	else
+		return 0;
+}
+
+/*
+ * Move the texts of all entries to the start of the query text area, so that
+ * the space of orphaned texts becomes free.
+ *
+ * The texts are moved in the order of their offsets, so each one only moves
+ * down, over space that's either free or has already been moved from.
+ *
+ * The caller must hold an exclusive lock on pgss->lock.
+ */
+static void
+qtext_compact(void)
+{
+	HASH_SEQ_STATUS hash_seq;
+	pgssEntry **entries;
+	pgssEntry  *entry;
+	Size		extent;
+	int			nentries;
+	int			i;
 
+	entries = palloc(hash_get_num_entries(pgss_hash) * sizeof(pgssEntry *));
+
+	nentries = 0;
 	hash_seq_init(&hash_seq, pgss_hash);
 	while ((entry = hash_seq_search(&hash_seq)) != NULL)
 	{
-		int			query_len = entry->query_len;
-		char	   *qry = qtext_fetch(entry->query_offset,
-									  query_len,
-									  qbuffer,
-									  qbuffer_size);
-
-		if (qry == NULL)
+		if (qtext_fetch(entry->query_offset, entry->query_len) == NULL)
 		{
 			/* Trouble ... drop the text */
 			entry->query_offset = 0;
@@ -2090,43 +2255,26 @@ gc_qtexts(void)
 			/* entry will not be counted in mean query length computation */
 			continue;
 		}
-
-		if (fwrite(qry, 1, query_len + 1, qfile) != query_len + 1)
-		{
-			ereport(LOG,
-					(errcode_for_file_access(),
-				  errmsg("could not write pg_stat_statement file \"%s\": %m",
-						 PGSS_TEXT_FILE)));
-			hash_seq_term(&hash_seq);
-			goto gc_fail;
-		}
-
-		entry->query_offset = extent;
-		extent += query_len + 1;
-		nentries++;
+		entries[nentries++] = entry;
 	}
 
-	/*
-	 * Truncate away any now-unused space.  If this fails for some odd reason,
-	 * we log it, but there's no need to fail.
-	 */
-	if (ftruncate(fileno(qfile), extent) != 0)
-		ereport(LOG,
-				(errcode_for_file_access(),
-			   errmsg("could not truncate pg_stat_statement file \"%s\": %m",
-					  PGSS_TEXT_FILE)));
+	qsort(entries, nentries, sizeof(pgssEntry *), qtext_offset_cmp);
 
-	if (FreeFile(qfile))
+	extent = 0;
+	for (i = 0; i < nentries; i++)
 	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not write pg_stat_statement file \"%s\": %m",
-						PGSS_TEXT_FILE)));
-		qfile = NULL;
-		goto gc_fail;
+		entry = entries[i];
+
+		if (entry->query_offset != extent)
+			memmove(pgss_qtexts + extent, pgss_qtexts + entry->query_offset,
+					entry->query_len + 1);
+		entry->query_offset = extent;
+		extent += entry->query_len + 1;
 	}
 
-	elog(DEBUG1, "pgss gc of queries file shrunk size from %zu to %zu",
+	pfree(entries);
+
+	elog(DEBUG1, "pgss gc of query texts shrunk size from %zu to %zu",
 		 pgss->extent, extent);
 
 	/* Reset the shared extent pointer */
@@ -2141,66 +2289,10 @@ gc_qtexts(void)
 	else
 		pgss->mean_query_len = ASSUMED_LENGTH_INIT;
 
-	free(qbuffer);
-
 	/*
 	 * OK, count a garbage collection cycle.  (Note: even though we have
 	 * exclusive lock on pgss->lock, we must take pgss->mutex for this, since
-	 * other processes may examine gc_count while holding only the mutex.
-	 * Also, we have to advance the count *after* we've rewritten the file,
-	 * else other processes might not realize they read a stale file.)
-	 */
-	record_gc_qtexts();
-
-	return;
-
-gc_fail:
-	/* clean up resources */
-	if (qfile)
-		FreeFile(qfile);
-	if (qbuffer)
-		free(qbuffer);
-
-	/*
-	 * Since the contents of the external file are now uncertain, mark all
-	 * hashtable entries as having invalid texts.
-	 */
-	hash_seq_init(&hash_seq, pgss_hash);
-	while ((entry = hash_seq_search(&hash_seq)) != NULL)
-	{
-		entry->query_offset = 0;
-		entry->query_len = -1;
-	}
-
-	/*
-	 * Destroy the query text file and create a new, empty one
-	 */
-	(void) unlink(PGSS_TEXT_FILE);
-	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
-	if (qfile == NULL)
-		ereport(LOG,
-				(errcode_for_file_access(),
-			  errmsg("could not write new pg_stat_statement file \"%s\": %m",
-					 PGSS_TEXT_FILE)));
-	else
-		FreeFile(qfile);
-
-	/* Reset the shared extent pointer */
-	pgss->extent = 0;
-
-	/* Reset mean_query_len to match the new state */
-	pgss->mean_query_len = ASSUMED_LENGTH_INIT;
-
-	/*
-	 * Bump the GC count even though we failed.
-	 *
-	 * This is needed to make concurrent readers of file without any lock on
-	 * pgss->lock notice existence of new version of file.  Once readers
-	 * subsequently observe a change in GC count with pgss->lock held, that
-	 * forces a safe reopen of file.  Writers also require that we bump here,
-	 * of course.  (As required by locking protocol, readers and writers don't
-	 * trust earlier file contents until gc_count is found unchanged after
-	 * pgss->lock acquired in shared or exclusive mode respectively.)
+	 * other processes may examine gc_count while holding only the mutex.)
 	 */
 	record_gc_qtexts();
 }
@@ -2213,7 +2305,6 @@ entry_reset(void)
 {
 	HASH_SEQ_STATUS hash_seq;
 	pgssEntry  *entry;
-	FILE	   *qfile;
 
 	LWLockAcquire(pgss->lock, LW_EXCLUSIVE);
 
@@ -2223,30 +2314,9 @@ entry_reset(void)
 		hash_search(pgss_hash, &entry->key, HASH_REMOVE, NULL);
 	}
 
-	/*
-	 * Write new empty query file, perhaps even creating a new one to recover
-	 * if the file was missing.
-	 */
-	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
-	if (qfile == NULL)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not create pg_stat_statement file \"%s\": %m",
-						PGSS_TEXT_FILE)));
-		goto done;
-	}
-
-	/* If ftruncate fails, log it, but it's not a fatal problem */
-	if (ftruncate(fileno(qfile), 0) != 0)
-		ereport(LOG,
-				(errcode_for_file_access(),
-			   errmsg("could not truncate pg_stat_statement file \"%s\": %m",
-					  PGSS_TEXT_FILE)));
+	/* Make backends discard the counters they have accumulated locally */
+	pgss->reset_count++;
 
-	FreeFile(qfile);
-
-done:
 	pgss->extent = 0;
 	/* This counts as a query text garbage collection for our purposes */
 	record_gc_qtexts();
@@ -0,0 +1,9 @@
+/* contrib/pg_variables/pg_variables--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_variables UPDATE TO '1.1'" to load this file. \quit
+
+CREATE FUNCTION pgv_load(package text, name text, query text)
+RETURNS bigint
+AS 'MODULE_PATHNAME', 'variable_load'
+LANGUAGE C VOLATILE;
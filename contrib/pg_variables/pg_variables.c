@@ -12,7 +12,10 @@
 #include "funcapi.h"
 
 #include "access/htup_details.h"
+#include "access/tuptoaster.h"
 #include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "miscadmin.h"
 #include "parser/scansup.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
@@ -45,6 +48,7 @@ PG_FUNCTION_INFO_V1(variable_get_jsonb);
 PG_FUNCTION_INFO_V1(variable_insert);
 PG_FUNCTION_INFO_V1(variable_update);
 PG_FUNCTION_INFO_V1(variable_delete);
+PG_FUNCTION_INFO_V1(variable_load);
 
 PG_FUNCTION_INFO_V1(variable_select);
 PG_FUNCTION_INFO_V1(variable_select_by_value);
@@ -690,12 +694,185 @@ variable_delete(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(res);
 }
 
+/* Number of rows fetched at once by variable_load() */
+#define LOAD_BATCH_SIZE		1000
+
+/*
+ * Insert all rows of a query into a record variable. This avoids a function
+ * call and a composite datum per row, which pgv_insert() needs.
+ */
+Datum
+variable_load(PG_FUNCTION_ARGS)
+{
+	text			   *package_name;
+	text			   *var_name;
+	char			   *query;
+	HashPackageEntry   *package;
+	HashVariableEntry  *variable;
+	SPIPlanPtr			plan;
+	Portal				portal;
+	TupleDesc			tupdesc;
+	MemoryContext		batchcxt,
+						oldcxt;
+	int64				nrows = 0;
+
+	/* Checks */
+	CHECK_ARGS_FOR_NULL();
+
+	if (PG_ARGISNULL(2))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("query argument can not be NULL")));
+
+	/* Get arguments */
+	package_name = PG_GETARG_TEXT_PP(0);
+	var_name = PG_GETARG_TEXT_PP(1);
+	query = text_to_cstring(PG_GETARG_TEXT_PP(2));
+
+	package = getPackageByName(package_name, true, false);
+	variable = getVariableByNameWithType(package->variablesHash,
+										 var_name, RECORDOID, true, false);
+	LastPackage = package;
+	LastVariable = variable;
+
+	batchcxt = AllocSetContextCreate(CurrentMemoryContext,
+									 "pg_variables load batch",
+									 ALLOCSET_DEFAULT_MINSIZE,
+									 ALLOCSET_DEFAULT_INITSIZE,
+									 ALLOCSET_DEFAULT_MAXSIZE);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	plan = SPI_prepare(query, 0, NULL);
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare(\"%s\") failed: %s",
+			 query, SPI_result_code_string(SPI_result));
+
+	if (!SPI_is_cursor_plan(plan))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("query \"%s\" does not return rows", query)));
+
+	portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+
+	tupdesc = portal->tupDesc;
+	if (!variable->value.record.tupdesc)
+	{
+		/*
+		 * This is the first record for the var_name. The row type of the
+		 * query has to be registered, so that the records can be returned
+		 * as composite datums.
+		 */
+		tupdesc = BlessTupleDesc(CreateTupleDescCopy(tupdesc));
+		init_attributes(variable, tupdesc, package->hctx);
+	}
+	else
+		check_attributes(variable, tupdesc);
+
+	for (;;)
+	{
+		uint64		i;
+
+		SPI_cursor_fetch(portal, true, LOAD_BATCH_SIZE);
+		if (SPI_processed == 0)
+			break;
+
+		oldcxt = MemoryContextSwitchTo(batchcxt);
+		for (i = 0; i < SPI_processed; i++)
+		{
+			HeapTuple	tuple = SPI_tuptable->vals[i];
+
+			if (HeapTupleHasExternal(tuple))
+				tuple = toast_flatten_tuple(tuple, tupdesc);
+
+			load_record(variable, tuple);
+		}
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextReset(batchcxt);
+
+		nrows += SPI_processed;
+		SPI_freetuptable(SPI_tuptable);
+	}
+
+	SPI_cursor_close(portal);
+	SPI_finish();
+
+	MemoryContextDelete(batchcxt);
+
+	PG_FREE_IF_COPY(package_name, 0);
+	PG_FREE_IF_COPY(var_name, 1);
+
+	PG_RETURN_INT64(nrows);
+}
+
+/*
+ * Put all records of a variable into a tuplestore at once.
+ */
+static void
+select_records_materialize(ReturnSetInfo *rsinfo, RecordVar *record)
+{
+	MemoryContext		oldcontext;
+	Tuplestorestate	   *tupstore;
+	TupleDesc			tupdesc;
+	HASH_SEQ_STATUS		rstat;
+	HashRecordEntry	   *item;
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTupleDescCopy(record->tupdesc);
+	tupstore = tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random,
+									 false, work_mem);
+
+	hash_seq_init(&rstat, record->rhash);
+	while ((item = (HashRecordEntry *) hash_seq_search(&rstat)) != NULL)
+		tuplestore_puttuple(tupstore, item->tuple);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+}
+
 Datum
 variable_select(PG_FUNCTION_ARGS)
 {
 	FuncCallContext	   *funcctx;
 	HASH_SEQ_STATUS	   *rstat;
 	HashRecordEntry	   *item;
+	ReturnSetInfo	   *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	/*
+	 * Return all the records at once if the caller allows it, the records
+	 * need to be copied into a tuplestore anyway.
+	 */
+	if (rsinfo && IsA(rsinfo, ReturnSetInfo) &&
+		(rsinfo->allowedModes & SFRM_Materialize) &&
+		fcinfo->flinfo->fn_extra == NULL)
+	{
+		text			   *package_name;
+		text			   *var_name;
+		HashPackageEntry   *package;
+		HashVariableEntry  *variable;
+
+		CHECK_ARGS_FOR_NULL();
+
+		/* Get arguments */
+		package_name = PG_GETARG_TEXT_PP(0);
+		var_name = PG_GETARG_TEXT_PP(1);
+
+		package = getPackageByName(package_name, false, true);
+		variable = getVariableByNameWithType(package->variablesHash,
+											 var_name, RECORDOID, false, true);
+
+		select_records_materialize(rsinfo, &(variable->value.record));
+
+		PG_FREE_IF_COPY(package_name, 0);
+		PG_FREE_IF_COPY(var_name, 1);
+
+		return (Datum) 0;
+	}
 
 	if (SRF_IS_FIRSTCALL())
 	{
@@ -30,12 +30,26 @@ typedef struct HashPackageEntry
 	MemoryContext	hctx;
 } HashPackageEntry;
 
+/*
+ * Records are allocated densely from blocks of this size, without
+ * a chunk header per record. Records bigger than RECORD_BIG_TUPLE are
+ * allocated separately.
+ */
+#define RECORD_BLOCK_SIZE	(64 * 1024)
+#define RECORD_BIG_TUPLE	(RECORD_BLOCK_SIZE / 8)
+
 typedef struct RecordVar
 {
 	HTAB		   *rhash;
 	TupleDesc		tupdesc;
 	/* Memory context for records hash table for easy memory release */
 	MemoryContext	hctx;
+	/* Memory context for record blocks, replaced by compaction */
+	MemoryContext	tctx;
+	char		   *freeptr;		/* free space in the current block */
+	Size			freespace;
+	Size			livebytes;		/* space used by the records */
+	Size			deadbytes;		/* space of deleted and updated records */
 	/* Hash function info */
 	FmgrInfo		hash_proc;
 	/* Match function info */
@@ -85,6 +99,7 @@ extern void check_record_key(HashVariableEntry *variable, Oid typid);
 
 extern void insert_record(HashVariableEntry* variable,
 						  HeapTupleHeader tupleHeader);
+extern void load_record(HashVariableEntry *variable, HeapTuple tuple);
 extern bool update_record(HashVariableEntry *variable,
 						  HeapTupleHeader tupleHeader);
 extern bool delete_record(HashVariableEntry* variable, Datum value,
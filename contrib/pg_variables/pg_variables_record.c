@@ -84,6 +84,16 @@ init_attributes(HashVariableEntry *variable, TupleDesc tupdesc,
 										 ALLOCSET_DEFAULT_MINSIZE,
 										 ALLOCSET_DEFAULT_INITSIZE,
 										 ALLOCSET_DEFAULT_MAXSIZE);
+	record->tctx = AllocSetContextCreate(record->hctx,
+										 "Records blocks",
+										 ALLOCSET_SMALL_MINSIZE,
+										 ALLOCSET_SMALL_INITSIZE,
+										 ALLOCSET_SMALL_MAXSIZE);
+	record->freeptr = NULL;
+	record->freespace = 0;
+	record->livebytes = 0;
+	record->deadbytes = 0;
+
 	oldcxt = MemoryContextSwitchTo(record->hctx);
 	record->tupdesc = CreateTupleDescCopyConstr(tupdesc);
 
@@ -170,46 +180,120 @@ check_record_key(HashVariableEntry *variable, Oid typid)
 						"key type", variable->name)));
 }
 
+#define RecordTupleSize(len)	MAXALIGN(HEAPTUPLESIZE + (len))
+
 /*
- * Insert a new record. New record key should be unique in the variable.
+ * Allocate a record of the given length. The record is placed in the current
+ * block of the variable, so there is no per record allocation overhead.
  */
-void
-insert_record(HashVariableEntry *variable, HeapTupleHeader tupleHeader)
+static HeapTuple
+alloc_record_tuple(RecordVar *record, uint32 len)
 {
-	TupleDesc			tupdesc;
+	Size				size = RecordTupleSize(len);
 	HeapTuple			tuple;
-	int					tuple_len;
-	Datum				value;
-	bool				isnull;
-	RecordVar		   *record;
-	HashRecordKey		k;
-	HashRecordEntry	   *item;
-	bool				found;
-	MemoryContext		oldcxt;
 
-	Assert(variable->typid == RECORDOID);
+	if (size > RECORD_BIG_TUPLE)
+		tuple = (HeapTuple) MemoryContextAlloc(record->tctx, size);
+	else
+	{
+		if (size > record->freespace)
+		{
+			record->freeptr = MemoryContextAlloc(record->tctx,
+												 RECORD_BLOCK_SIZE);
+			record->freespace = RECORD_BLOCK_SIZE;
+		}
+		tuple = (HeapTuple) record->freeptr;
+		record->freeptr += size;
+		record->freespace -= size;
+	}
+	record->livebytes += size;
 
-	record = &(variable->value.record);
+	tuple->t_len = len;
+	ItemPointerSetInvalid(&(tuple->t_self));
+	tuple->t_tableOid = InvalidOid;
+	tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
 
-	oldcxt = MemoryContextSwitchTo(record->hctx);
+	return tuple;
+}
 
-	tupdesc = record->tupdesc;
+/*
+ * Release a record. Big records and the last allocated one are released
+ * immediately, space of others is reclaimed by compact_records().
+ */
+static void
+free_record_tuple(RecordVar *record, HeapTuple tuple)
+{
+	Size				size = RecordTupleSize(tuple->t_len);
 
-	/* Build a HeapTuple control structure */
-	tuple_len = HeapTupleHeaderGetDatumLength(tupleHeader);
+	record->livebytes -= size;
 
-	tuple = (HeapTuple) palloc(HEAPTUPLESIZE + tuple_len);
-	tuple->t_len = tuple_len;
-	ItemPointerSetInvalid(&(tuple->t_self));
-	tuple->t_tableOid = InvalidOid;
-	tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
-	memcpy((char *) tuple->t_data, (char *) tupleHeader, tuple_len);
+	if (size > RECORD_BIG_TUPLE)
+		pfree(tuple);
+	else if ((char *) tuple + size == record->freeptr)
+	{
+		record->freeptr -= size;
+		record->freespace += size;
+	}
+	else
+		record->deadbytes += size;
+}
+
+/*
+ * Copy live records into new blocks if most of the space is taken by deleted
+ * and updated records.
+ */
+static void
+compact_records(RecordVar *record)
+{
+	MemoryContext		oldtctx;
+	HASH_SEQ_STATUS		rstat;
+	HashRecordEntry	   *item;
+	bool				isnull;
+
+	if (record->deadbytes < RECORD_BLOCK_SIZE ||
+		record->deadbytes < record->livebytes)
+		return;
+
+	oldtctx = record->tctx;
+	record->tctx = AllocSetContextCreate(record->hctx,
+										 "Records blocks",
+										 ALLOCSET_SMALL_MINSIZE,
+										 ALLOCSET_SMALL_INITSIZE,
+										 ALLOCSET_SMALL_MAXSIZE);
+	record->freeptr = NULL;
+	record->freespace = 0;
+	record->livebytes = 0;
+	record->deadbytes = 0;
+
+	hash_seq_init(&rstat, record->rhash);
+	while ((item = (HashRecordEntry *) hash_seq_search(&rstat)) != NULL)
+	{
+		HeapTuple	tuple = alloc_record_tuple(record, item->tuple->t_len);
+
+		memcpy((char *) tuple->t_data, (char *) item->tuple->t_data,
+			   tuple->t_len);
+		item->tuple = tuple;
+		/* Key may point into the record */
+		item->key.value = fastgetattr(tuple, 1, record->tupdesc, &isnull);
+	}
+
+	MemoryContextDelete(oldtctx);
+}
+
+/*
+ * Add a record allocated by alloc_record_tuple() to the hash table. Record
+ * key should be unique in the variable.
+ */
+static void
+store_record(HashVariableEntry *variable, HeapTuple tuple)
+{
+	RecordVar		   *record = &(variable->value.record);
+	HashRecordKey		k;
+	HashRecordEntry	   *item;
+	bool				found;
 
-	/* Inserting a new record */
-	value = fastgetattr(tuple, 1, tupdesc, &isnull);
 	/* First, check if there is a record with same key */
-	k.value = value;
-	k.is_null = isnull;
+	k.value = fastgetattr(tuple, 1, record->tupdesc, &k.is_null);
 	k.hash_proc = &record->hash_proc;
 	k.cmp_proc = &record->cmp_proc;
 
@@ -217,8 +301,7 @@ insert_record(HashVariableEntry *variable, HeapTupleHeader tupleHeader)
 										   HASH_ENTER, &found);
 	if (found)
 	{
-		heap_freetuple(tuple);
-		MemoryContextSwitchTo(oldcxt);
+		free_record_tuple(record, tuple);
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("there is a record in the variable \"%s\" with same "
@@ -226,49 +309,76 @@ insert_record(HashVariableEntry *variable, HeapTupleHeader tupleHeader)
 	}
 	/* Second, insert a new record */
 	item->tuple = tuple;
+}
 
-	MemoryContextSwitchTo(oldcxt);
+/*
+ * Insert a new record. New record key should be unique in the variable.
+ */
+void
+insert_record(HashVariableEntry *variable, HeapTupleHeader tupleHeader)
+{
+	HeapTuple			tuple;
+	RecordVar		   *record;
+
+	Assert(variable->typid == RECORDOID);
+
+	record = &(variable->value.record);
+
+	tuple = alloc_record_tuple(record,
+							   HeapTupleHeaderGetDatumLength(tupleHeader));
+	memcpy((char *) tuple->t_data, (char *) tupleHeader, tuple->t_len);
+
+	store_record(variable, tuple);
 }
 
 /*
- * Insert a record. New record key should be unique in the variable.
+ * Insert a new record from a heap tuple (not a composite datum), e.g. from a
+ * query result. The tuple should not contain external TOAST pointers.
+ */
+void
+load_record(HashVariableEntry *variable, HeapTuple source)
+{
+	HeapTuple			tuple;
+	RecordVar		   *record;
+
+	Assert(variable->typid == RECORDOID);
+	Assert(!HeapTupleHasExternal(source));
+
+	record = &(variable->value.record);
+
+	tuple = alloc_record_tuple(record, source->t_len);
+	memcpy((char *) tuple->t_data, (char *) source->t_data, tuple->t_len);
+
+	/* Make it a composite datum of the variable row type */
+	HeapTupleHeaderSetDatumLength(tuple->t_data, tuple->t_len);
+	HeapTupleHeaderSetTypeId(tuple->t_data, record->tupdesc->tdtypeid);
+	HeapTupleHeaderSetTypMod(tuple->t_data, record->tupdesc->tdtypmod);
+
+	store_record(variable, tuple);
+}
+
+/*
+ * Update a record with the same key.
  */
 bool
 update_record(HashVariableEntry* variable, HeapTupleHeader tupleHeader)
 {
-	TupleDesc			tupdesc;
 	HeapTuple			tuple;
-	int					tuple_len;
-	Datum				value;
-	bool				isnull;
 	RecordVar		   *record;
 	HashRecordKey		k;
 	HashRecordEntry	   *item;
 	bool				found;
-	MemoryContext		oldcxt;
 
 	Assert(variable->typid == RECORDOID);
 
 	record = &(variable->value.record);
 
-	oldcxt = MemoryContextSwitchTo(record->hctx);
-
-	tupdesc = record->tupdesc;
-
-	/* Build a HeapTuple control structure */
-	tuple_len = HeapTupleHeaderGetDatumLength(tupleHeader);
-
-	tuple = (HeapTuple) palloc(HEAPTUPLESIZE + tuple_len);
-	tuple->t_len = tuple_len;
-	ItemPointerSetInvalid(&(tuple->t_self));
-	tuple->t_tableOid = InvalidOid;
-	tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
-	memcpy((char *) tuple->t_data, (char *) tupleHeader, tuple_len);
+	tuple = alloc_record_tuple(record,
+							   HeapTupleHeaderGetDatumLength(tupleHeader));
+	memcpy((char *) tuple->t_data, (char *) tupleHeader, tuple->t_len);
 
 	/* Update a record */
-	value = fastgetattr(tuple, 1, tupdesc, &isnull);
-	k.value = value;
-	k.is_null = isnull;
+	k.value = fastgetattr(tuple, 1, record->tupdesc, &k.is_null);
 	k.hash_proc = &record->hash_proc;
 	k.cmp_proc = &record->cmp_proc;
 
@@ -276,14 +386,16 @@ update_record(HashVariableEntry* variable, HeapTupleHeader tupleHeader)
 										   HASH_FIND, &found);
 	if (!found)
 	{
-		heap_freetuple(tuple);
-		MemoryContextSwitchTo(oldcxt);
+		free_record_tuple(record, tuple);
 		return false;
 	}
 
+	free_record_tuple(record, item->tuple);
 	item->tuple = tuple;
+	item->key.value = k.value;
+
+	compact_records(record);
 
-	MemoryContextSwitchTo(oldcxt);
 	return true;
 }
 
@@ -308,7 +420,10 @@ delete_record(HashVariableEntry *variable, Datum value, bool is_null)
 	item = (HashRecordEntry *) hash_search(record->rhash, &k,
 										   HASH_REMOVE, &found);
 	if (found)
-		heap_freetuple(item->tuple);
+	{
+		free_record_tuple(record, item->tuple);
+		compact_records(record);
+	}
 
 	return found;
 }
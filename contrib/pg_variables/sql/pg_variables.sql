@@ -170,6 +170,17 @@ SELECT pgv_exists('vars3', 'r3');
 SELECT pgv_exists('vars3', 'r1');
 SELECT pgv_select('vars2', 'j1');
 
+-- Bulk load of a query
+SELECT pgv_load('vars4', 'r1', 'SELECT * FROM tab');
+SELECT * FROM pgv_select('vars4', 'r1') AS (id int, t varchar) ORDER BY id;
+SELECT pgv_load('vars4', 'r1', 'SELECT * FROM tab WHERE id = 0');
+SELECT pgv_load('vars4', 'r1', 'SELECT 5, ''str55''::varchar');
+SELECT pgv_select('vars4', 'r1', 5);
+SELECT pgv_load('vars4', 'r1', 'SELECT 1, 2');
+SELECT pgv_load('vars4', 'r2', 'SELECT * FROM tab WHERE false');
+SELECT * FROM pgv_select('vars4', 'r2') AS (id int, t varchar);
+SELECT pgv_remove('vars4');
+
 -- Manipulate variables
 SELECT * FROM pgv_list() order by package, name;
 
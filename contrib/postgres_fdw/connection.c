@@ -17,6 +17,7 @@
 #include "access/xact.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "storage/latch.h"
 #include "utils/hsearch.h"
 #include "utils/memutils.h"
 
@@ -49,6 +50,7 @@ typedef struct ConnCacheEntry
 								 * one level of subxact open, etc */
 	bool		have_prep_stmt; /* have we prepared any stmts in this xact? */
 	bool		have_error;		/* have any subxacts aborted in this xact? */
+	PgFdwConnState state;		/* extra per-connection state */
 } ConnCacheEntry;
 
 /*
@@ -69,6 +71,7 @@ static void check_conn_params(const char **keywords, const char **values);
 static void configure_remote_session(PGconn *conn);
 static void do_sql_command(PGconn *conn, const char *sql);
 static void begin_remote_xact(ConnCacheEntry *entry);
+static void pgfdw_cancel_query(PGconn *conn);
 static void pgfdw_xact_callback(XactEvent event, void *arg);
 static void pgfdw_subxact_callback(SubXactEvent event,
 					   SubTransactionId mySubid,
@@ -86,6 +89,9 @@ static void pgfdw_subxact_callback(SubXactEvent event,
  * statements.  Since those don't go away automatically at transaction end
  * (not even on error), we need this flag to cue manual cleanup.
  *
+ * If state is not NULL, *state receives the per-connection state associated
+ * with the PGconn.
+ *
  * XXX Note that caching connections theoretically requires a mechanism to
  * detect change of FDW objects to invalidate already established connections.
  * We could manage that by watching for invalidation events on the relevant
@@ -95,7 +101,7 @@ static void pgfdw_subxact_callback(SubXactEvent event,
  */
 PGconn *
 GetConnection(ForeignServer *server, UserMapping *user,
-			  bool will_prep_stmt)
+			  bool will_prep_stmt, PgFdwConnState **state)
 {
 	bool		found;
 	ConnCacheEntry *entry;
@@ -141,6 +147,7 @@ GetConnection(ForeignServer *server, UserMapping *user,
 		entry->xact_depth = 0;
 		entry->have_prep_stmt = false;
 		entry->have_error = false;
+		memset(&entry->state, 0, sizeof(entry->state));
 	}
 
 	/*
@@ -159,6 +166,7 @@ GetConnection(ForeignServer *server, UserMapping *user,
 		entry->xact_depth = 0;	/* just to be sure */
 		entry->have_prep_stmt = false;
 		entry->have_error = false;
+		memset(&entry->state, 0, sizeof(entry->state));
 		entry->conn = connect_pg_server(server, user);
 		elog(DEBUG3, "new postgres_fdw connection %p for server \"%s\"",
 			 entry->conn, server->servername);
@@ -172,6 +180,9 @@ GetConnection(ForeignServer *server, UserMapping *user,
 	/* Remember if caller will prepare statements */
 	entry->have_prep_stmt |= will_prep_stmt;
 
+	if (state)
+		*state = &entry->state;
+
 	return entry->conn;
 }
 
@@ -373,6 +384,11 @@ begin_remote_xact(ConnCacheEntry *entry)
 {
 	int			curlevel = GetCurrentTransactionNestLevel();
 
+	/* Collect any FETCH in flight before sending commands of our own */
+	if (entry->state.pending_scan &&
+		(entry->xact_depth <= 0 || entry->xact_depth < curlevel))
+		process_pending_request(entry->state.pending_scan);
+
 	/* Start main transaction if we haven't yet */
 	if (entry->xact_depth <= 0)
 	{
@@ -448,6 +464,81 @@ GetPrepStmtNumber(PGconn *conn)
 	return ++prep_stmt_number;
 }
 
+/*
+ * Wait for the result of a command sent with PQsendQuery and friends.
+ *
+ * Unlike PQgetResult, this waits on the process latch as well as the socket,
+ * so that the wait can be interrupted by a query cancel or backend
+ * termination.  All results of the command are consumed; the last one is
+ * returned, or NULL if there was none.  query is only used for error
+ * reporting.
+ */
+PGresult *
+pgfdw_get_result(PGconn *conn, const char *query)
+{
+	PGresult   *volatile last_res = NULL;
+
+	/* In what follows, do not leak any PGresults on an error. */
+	PG_TRY();
+	{
+		for (;;)
+		{
+			PGresult   *res;
+
+			while (PQisBusy(conn))
+			{
+				int			wc;
+
+				/* Sleep until there's something to do */
+				wc = WaitLatchOrSocket(MyLatch,
+									   WL_LATCH_SET | WL_SOCKET_READABLE,
+									   PQsocket(conn),
+									   -1L);
+				ResetLatch(MyLatch);
+
+				CHECK_FOR_INTERRUPTS();
+
+				/* Data available in socket? */
+				if (wc & WL_SOCKET_READABLE)
+				{
+					if (!PQconsumeInput(conn))
+						pgfdw_report_error(ERROR, NULL, conn, false, query);
+				}
+			}
+
+			res = PQgetResult(conn);
+			if (res == NULL)
+				break;			/* query is complete */
+
+			PQclear(last_res);
+			last_res = res;
+		}
+	}
+	PG_CATCH();
+	{
+		PQclear(last_res);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	return last_res;
+}
+
+/*
+ * Execute a query on the connection, like PQexec, after first collecting the
+ * result of any FETCH a foreign scan has left in flight on it.
+ *
+ * state may be NULL if the caller knows nothing can be pending.
+ */
+PGresult *
+pgfdw_exec_query(PGconn *conn, const char *query, PgFdwConnState *state)
+{
+	if (state && state->pending_scan)
+		process_pending_request(state->pending_scan);
+
+	return PQexec(conn, query);
+}
+
 /*
  * Report an error we got from the remote server.
  *
@@ -548,6 +639,10 @@ pgfdw_xact_callback(XactEvent event, void *arg)
 			{
 				case XACT_EVENT_PARALLEL_PRE_COMMIT:
 				case XACT_EVENT_PRE_COMMIT:
+					/* All scans should have been shut down by now */
+					if (entry->state.pending_scan)
+						process_pending_request(entry->state.pending_scan);
+
 					/* Commit all remote transactions during pre-commit */
 					do_sql_command(entry->conn, "COMMIT TRANSACTION");
 
@@ -599,6 +694,16 @@ pgfdw_xact_callback(XactEvent event, void *arg)
 				case XACT_EVENT_ABORT:
 					/* Assume we might have lost track of prepared statements */
 					entry->have_error = true;
+
+					/*
+					 * If a command is still running, cancel it rather than
+					 * waiting for it to complete.  The scan it was run for
+					 * is going away, so forget about it.
+					 */
+					if (PQtransactionStatus(entry->conn) == PQTRANS_ACTIVE)
+						pgfdw_cancel_query(entry->conn);
+					entry->state.pending_scan = NULL;
+
 					/* If we're aborting, abort all remote transactions too */
 					res = PQexec(entry->conn, "ABORT TRANSACTION");
 					/* Note: can't throw ERROR, it would be infinite loop */
@@ -623,6 +728,7 @@ pgfdw_xact_callback(XactEvent event, void *arg)
 
 		/* Reset state to show we're out of a transaction */
 		entry->xact_depth = 0;
+		memset(&entry->state, 0, sizeof(entry->state));
 
 		/*
 		 * If the connection isn't in a good idle state, discard it to
@@ -692,6 +798,13 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 
 		if (event == SUBXACT_EVENT_PRE_COMMIT_SUB)
 		{
+			/*
+			 * A cursor opened in this subtransaction may outlive it, so
+			 * collect any FETCH it has in flight before releasing.
+			 */
+			if (entry->state.pending_scan)
+				process_pending_request(entry->state.pending_scan);
+
 			/* Commit all remote subtransactions during pre-commit */
 			snprintf(sql, sizeof(sql), "RELEASE SAVEPOINT s%d", curlevel);
 			do_sql_command(entry->conn, sql);
@@ -700,6 +813,15 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 		{
 			/* Assume we might have lost track of prepared statements */
 			entry->have_error = true;
+
+			/*
+			 * Anything in flight was started at this level, since entering
+			 * it collected whatever outer scans had pending; cancel it.
+			 */
+			if (PQtransactionStatus(entry->conn) == PQTRANS_ACTIVE)
+				pgfdw_cancel_query(entry->conn);
+			entry->state.pending_scan = NULL;
+
 			/* Rollback all remote subtransactions during abort */
 			snprintf(sql, sizeof(sql),
 					 "ROLLBACK TO SAVEPOINT s%d; RELEASE SAVEPOINT s%d",
@@ -715,3 +837,25 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 		entry->xact_depth--;
 	}
 }
+
+/*
+ * Try to cancel the command running on the connection.  Failures are only
+ * reported as warnings, since we are called during abort processing; the
+ * subsequent ROLLBACK will wait for the command to finish regardless.
+ */
+static void
+pgfdw_cancel_query(PGconn *conn)
+{
+	PGcancel   *cancel;
+	char		errbuf[256];
+
+	if ((cancel = PQgetCancel(conn)) != NULL)
+	{
+		if (!PQcancel(cancel, errbuf, sizeof(errbuf)))
+			ereport(WARNING,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("could not send cancel request: %s",
+							errbuf)));
+		PQfreeCancel(cancel);
+	}
+}
@@ -47,40 +47,6 @@ PG_MODULE_MAGIC;
 /* Default CPU cost to process 1 row (above and beyond cpu_tuple_cost). */
 #define DEFAULT_FDW_TUPLE_COST		0.01
 
-/*
- * FDW-specific planner information kept in RelOptInfo.fdw_private for a
- * foreign table.  This information is collected by postgresGetForeignRelSize.
- */
-typedef struct PgFdwRelationInfo
-{
-	/* baserestrictinfo clauses, broken down into safe and unsafe subsets. */
-	List	   *remote_conds;
-	List	   *local_conds;
-
-	/* Bitmap of attr numbers we need to fetch from the remote server. */
-	Bitmapset  *attrs_used;
-
-	/* Cost and selectivity of local_conds. */
-	QualCost	local_conds_cost;
-	Selectivity local_conds_sel;
-
-	/* Estimated size and cost for a scan with baserestrictinfo quals. */
-	double		rows;
-	int			width;
-	Cost		startup_cost;
-	Cost		total_cost;
-
-	/* Options extracted from catalogs. */
-	bool		use_remote_estimate;
-	Cost		fdw_startup_cost;
-	Cost		fdw_tuple_cost;
-
-	/* Cached catalog information. */
-	ForeignTable *table;
-	ForeignServer *server;
-	UserMapping *user;			/* only set in use_remote_estimate mode */
-} PgFdwRelationInfo;
-
 /*
  * Indexes of FDW-private information stored in fdw_private lists.
  *
@@ -89,6 +55,7 @@ typedef struct PgFdwRelationInfo
  *
  * 1) SELECT statement text to be sent to the remote server
  * 2) Integer list of attribute numbers retrieved by the SELECT
+ * 3) String describing the joined relations, for EXPLAIN (join scans only)
  *
  * These items are indexed with the enum FdwScanPrivateIndex, so an item
  * can be fetched with list_nth().  For example, to get the SELECT statement:
@@ -99,7 +66,9 @@ enum FdwScanPrivateIndex
 	/* SQL statement to execute remotely (as a String node) */
 	FdwScanPrivateSelectSql,
 	/* Integer list of attribute numbers retrieved by the SELECT */
-	FdwScanPrivateRetrievedAttrs
+	FdwScanPrivateRetrievedAttrs,
+	/* Relation names of a pushed-down join (as a String node) */
+	FdwScanPrivateRelations
 };
 
 /*
@@ -111,6 +80,8 @@ enum FdwScanPrivateIndex
  *	  (NIL for a DELETE)
  * 3) Boolean flag showing if the remote query has a RETURNING clause
  * 4) Integer list of attribute numbers retrieved by RETURNING, if any
+ * 5) Length of the INSERT statement up to the end of its VALUES list, or
+ *	  -1 for an UPDATE or DELETE
  */
 enum FdwModifyPrivateIndex
 {
@@ -121,7 +92,9 @@ enum FdwModifyPrivateIndex
 	/* has-returning flag (as an integer Value node) */
 	FdwModifyPrivateHasReturning,
 	/* Integer list of attribute numbers retrieved by RETURNING */
-	FdwModifyPrivateRetrievedAttrs
+	FdwModifyPrivateRetrievedAttrs,
+	/* Length till the end of VALUES clause (as an integer Value node) */
+	FdwModifyPrivateLen
 };
 
 /*
@@ -129,7 +102,9 @@ enum FdwModifyPrivateIndex
  */
 typedef struct PgFdwScanState
 {
-	Relation	rel;			/* relcache entry for the foreign table */
+	Relation	rel;			/* relcache entry for the foreign table. NULL
+								 * for a foreign join scan. */
+	TupleDesc	tupdesc;		/* tuple descriptor of scan */
 	AttInMetadata *attinmeta;	/* attribute datatype conversion metadata */
 
 	/* extracted fdw_private data */
@@ -138,6 +113,7 @@ typedef struct PgFdwScanState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	unsigned int cursor_number; /* quasi-unique ID for my cursor */
 	bool		cursor_exists;	/* have we created the cursor? */
 	int			numParams;		/* number of parameters passed to query */
@@ -153,9 +129,17 @@ typedef struct PgFdwScanState
 	/* batch-level state, for optimizing rewinds and avoiding useless fetch */
 	int			fetch_ct_2;		/* Min(# of fetches done, 2) */
 	bool		eof_reached;	/* true if last fetch reached EOF */
+	int			fetch_size;		/* number of tuples per fetch */
+
+	/* for asynchronous execution */
+	bool		async_capable;	/* fetch the next batch ahead of need? */
+	HeapTuple  *prefetch_tuples;	/* array of prefetched tuples */
+	int			num_prefetch_tuples;	/* # of tuples in array */
+	bool		prefetch_ready; /* true if the prefetched batch has arrived */
 
 	/* working memory contexts */
 	MemoryContext batch_cxt;	/* context holding current batch of tuples */
+	MemoryContext prefetch_cxt; /* context holding prefetched batch */
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
 } PgFdwScanState;
 
@@ -169,20 +153,31 @@ typedef struct PgFdwModifyState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	char	   *p_name;			/* name of prepared statement, if created */
 
 	/* extracted fdw_private data */
 	char	   *query;			/* text of INSERT/UPDATE/DELETE command */
+	char	   *orig_query;		/* original text of INSERT command */
 	List	   *target_attrs;	/* list of target attribute numbers */
 	bool		has_returning;	/* is there a RETURNING clause? */
 	List	   *retrieved_attrs;	/* attr numbers retrieved by RETURNING */
+	int			values_end;		/* length up to the end of VALUES */
 
 	/* info about parameters for prepared statement */
 	AttrNumber	ctidAttno;		/* attnum of input resjunk ctid column */
 	int			p_nums;			/* number of parameters to transmit */
 	FmgrInfo   *p_flinfo;		/* output conversion functions for them */
 
-	/* working memory context */
+	/* for batched inserts */
+	int			batch_size;		/* number of rows sent per INSERT */
+	int			num_slots;		/* number of rows buffered so far */
+	const char **batch_values;	/* parameter values of buffered rows */
+
+	/*
+	 * working memory context; when inserting in batches, it holds the data
+	 * of all rows buffered so far
+	 */
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
 } PgFdwModifyState;
 
@@ -215,8 +210,16 @@ typedef struct PgFdwAnalyzeState
  */
 typedef struct ConversionLocation
 {
-	Relation	rel;			/* foreign table's relcache entry */
+	Relation	rel;			/* foreign table's relcache entry. */
 	AttrNumber	cur_attno;		/* attribute number being processed, or 0 */
+
+	/*
+	 * In case of foreign join push down, fdw_scan_tlist is used to identify
+	 * the Var node corresponding to the error location and
+	 * fsstate->ss.ps.state gives access to the RTEs of corresponding relation
+	 * to get the relation name and attribute name.
+	 */
+	ForeignScanState *fsstate;
 } ConversionLocation;
 
 /* Callback argument for ec_member_matches_foreign */
@@ -241,7 +244,7 @@ static void postgresGetForeignPaths(PlannerInfo *root,
 						RelOptInfo *baserel,
 						Oid foreigntableid);
 static ForeignScan *postgresGetForeignPlan(PlannerInfo *root,
-					   RelOptInfo *baserel,
+					   RelOptInfo *foreignrel,
 					   Oid foreigntableid,
 					   ForeignPath *best_path,
 					   List *tlist,
@@ -290,17 +293,26 @@ static bool postgresAnalyzeForeignTable(Relation relation,
 							BlockNumber *totalpages);
 static List *postgresImportForeignSchema(ImportForeignSchemaStmt *stmt,
 							Oid serverOid);
+static void postgresGetForeignJoinPaths(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra);
+static bool postgresRecheckForeignScan(ForeignScanState *node,
+						   TupleTableSlot *slot);
 
 /*
  * Helper functions
  */
 static void estimate_path_cost_size(PlannerInfo *root,
-						RelOptInfo *baserel,
-						List *join_conds,
+						RelOptInfo *foreignrel,
+						List *param_join_conds,
 						double *p_rows, int *p_width,
 						Cost *p_startup_cost, Cost *p_total_cost);
 static void get_remote_estimate(const char *sql,
 					PGconn *conn,
+					PgFdwConnState *conn_state,
 					double *rows,
 					int *width,
 					Cost *startup_cost,
@@ -310,8 +322,17 @@ static bool ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
 						  void *arg);
 static void create_cursor(ForeignScanState *node);
 static void fetch_more_data(ForeignScanState *node);
-static void close_cursor(PGconn *conn, unsigned int cursor_number);
+static void fetch_more_data_begin(ForeignScanState *node);
+static void store_fetch_result(ForeignScanState *node, PGresult *res,
+				   MemoryContext cxt,
+				   HeapTuple **tuples, int *num_tuples);
+static void close_cursor(PGconn *conn, unsigned int cursor_number,
+			 PgFdwConnState *conn_state);
 static void prepare_foreign_modify(PgFdwModifyState *fmstate);
+static int get_batch_size(ModifyTableState *mtstate,
+			   ResultRelInfo *resultRelInfo,
+			   List *fdw_private);
+static void execute_batch_insert(PgFdwModifyState *fmstate);
 static const char **convert_prep_stmt_params(PgFdwModifyState *fmstate,
 						 ItemPointer tupleid,
 						 TupleTableSlot *slot);
@@ -328,8 +349,13 @@ static HeapTuple make_tuple_from_result_row(PGresult *res,
 						   Relation rel,
 						   AttInMetadata *attinmeta,
 						   List *retrieved_attrs,
+						   ForeignScanState *fsstate,
 						   MemoryContext temp_context);
 static void conversion_error_callback(void *arg);
+static bool foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel,
+				JoinType jointype, RelOptInfo *outerrel, RelOptInfo *innerrel,
+				JoinPathExtraData *extra);
+static Path *get_local_join_path(RelOptInfo *joinrel);
 
 
 /*
@@ -349,6 +375,7 @@ postgres_fdw_handler(PG_FUNCTION_ARGS)
 	routine->IterateForeignScan = postgresIterateForeignScan;
 	routine->ReScanForeignScan = postgresReScanForeignScan;
 	routine->EndForeignScan = postgresEndForeignScan;
+	routine->RecheckForeignScan = postgresRecheckForeignScan;
 
 	/* Functions for updating foreign tables */
 	routine->AddForeignUpdateTargets = postgresAddForeignUpdateTargets;
@@ -370,6 +397,9 @@ postgres_fdw_handler(PG_FUNCTION_ARGS)
 	/* Support functions for IMPORT FOREIGN SCHEMA */
 	routine->ImportForeignSchema = postgresImportForeignSchema;
 
+	/* Support functions for join push-down */
+	routine->GetForeignJoinPaths = postgresGetForeignJoinPaths;
+
 	PG_RETURN_POINTER(routine);
 }
 
@@ -387,6 +417,10 @@ postgresGetForeignRelSize(PlannerInfo *root,
 {
 	PgFdwRelationInfo *fpinfo;
 	ListCell   *lc;
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	const char *namespace;
+	const char *relname;
+	const char *refname;
 
 	/*
 	 * We use PgFdwRelationInfo to pass various information to subsequent
@@ -395,6 +429,9 @@ postgresGetForeignRelSize(PlannerInfo *root,
 	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
 	baserel->fdw_private = (void *) fpinfo;
 
+	/* Base foreign tables need to be pushed down always. */
+	fpinfo->pushdown_safe = true;
+
 	/* Look up foreign-table catalog info. */
 	fpinfo->table = GetForeignTable(foreigntableid);
 	fpinfo->server = GetForeignServer(fpinfo->table->serverid);
@@ -435,9 +472,9 @@ postgresGetForeignRelSize(PlannerInfo *root,
 	 * should match what ExecCheckRTEPerms() does.  If we fail due to lack of
 	 * permissions, the query would have failed at runtime anyway.
 	 */
+	fpinfo->checkAsUser = rte->checkAsUser;
 	if (fpinfo->use_remote_estimate)
 	{
-		RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
 		Oid			userid = rte->checkAsUser ? rte->checkAsUser : GetUserId();
 
 		fpinfo->user = GetUserMapping(userid, fpinfo->server->serverid);
@@ -532,6 +569,23 @@ postgresGetForeignRelSize(PlannerInfo *root,
 								&fpinfo->rows, &fpinfo->width,
 								&fpinfo->startup_cost, &fpinfo->total_cost);
 	}
+
+	/*
+	 * Set the name of relation in fpinfo, while we are constructing it here.
+	 * It will be used to build the string describing the join relation in
+	 * EXPLAIN output.  We can't know whether VERBOSE option is specified or
+	 * not, so always schema-qualify the foreign table name.
+	 */
+	fpinfo->relation_name = makeStringInfo();
+	namespace = get_namespace_name(get_rel_namespace(foreigntableid));
+	relname = get_rel_name(foreigntableid);
+	refname = rte->eref->aliasname;
+	appendStringInfo(fpinfo->relation_name, "%s.%s",
+					 quote_identifier(namespace),
+					 quote_identifier(relname));
+	if (*refname && strcmp(refname, relname) != 0)
+		appendStringInfo(fpinfo->relation_name, " %s",
+						 quote_identifier(rte->eref->aliasname));
 }
 
 /*
@@ -741,140 +795,164 @@ postgresGetForeignPaths(PlannerInfo *root,
  */
 static ForeignScan *
 postgresGetForeignPlan(PlannerInfo *root,
-					   RelOptInfo *baserel,
+					   RelOptInfo *foreignrel,
 					   Oid foreigntableid,
 					   ForeignPath *best_path,
 					   List *tlist,
 					   List *scan_clauses,
 					   Plan *outer_plan)
 {
-	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
-	Index		scan_relid = baserel->relid;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+	Index		scan_relid;
 	List	   *fdw_private;
 	List	   *remote_conds = NIL;
 	List	   *remote_exprs = NIL;
 	List	   *local_exprs = NIL;
 	List	   *params_list = NIL;
+	List	   *fdw_scan_tlist = NIL;
+	List	   *fdw_recheck_quals = NIL;
 	List	   *retrieved_attrs;
 	StringInfoData sql;
 	ListCell   *lc;
 
-	/*
-	 * Separate the scan_clauses into those that can be executed remotely and
-	 * those that can't.  baserestrictinfo clauses that were previously
-	 * determined to be safe or unsafe by classifyConditions are shown in
-	 * fpinfo->remote_conds and fpinfo->local_conds.  Anything else in the
-	 * scan_clauses list will be a join clause, which we have to check for
-	 * remote-safety.
-	 *
-	 * Note: the join clauses we see here should be the exact same ones
-	 * previously examined by postgresGetForeignPaths.  Possibly it'd be worth
-	 * passing forward the classification work done then, rather than
-	 * repeating it here.
-	 *
-	 * This code must match "extract_actual_clauses(scan_clauses, false)"
-	 * except for the additional decision about remote versus local execution.
-	 * Note however that we don't strip the RestrictInfo nodes from the
-	 * remote_conds list, since appendWhereClause expects a list of
-	 * RestrictInfos.
-	 */
-	foreach(lc, scan_clauses)
+	if (foreignrel->reloptkind == RELOPT_BASEREL ||
+		foreignrel->reloptkind == RELOPT_OTHER_MEMBER_REL)
 	{
-		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		scan_relid = foreignrel->relid;
+
+		/*
+		 * Separate the scan_clauses into those that can be executed remotely
+		 * and those that can't.  baserestrictinfo clauses that were
+		 * previously determined to be safe or unsafe by classifyConditions
+		 * are shown in fpinfo->remote_conds and fpinfo->local_conds.
+		 * Anything else in the scan_clauses list will be a join clause, which
+		 * we have to check for remote-safety.
+		 *
+		 * Note: the join clauses we see here should be the exact same ones
+		 * previously examined by postgresGetForeignPaths.  Possibly it'd be
+		 * worth passing forward the classification work done then, rather
+		 * than repeating it here.
+		 *
+		 * This code must match "extract_actual_clauses(scan_clauses, false)"
+		 * except for the additional decision about remote versus local
+		 * execution.  Note however that we don't strip the RestrictInfo
+		 * nodes from the remote_conds list, since deparseSelectStmtForRel
+		 * does that itself.
+		 */
+		foreach(lc, scan_clauses)
+		{
+			RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
 
-		Assert(IsA(rinfo, RestrictInfo));
+			Assert(IsA(rinfo, RestrictInfo));
 
-		/* Ignore any pseudoconstants, they're dealt with elsewhere */
-		if (rinfo->pseudoconstant)
-			continue;
+			/* Ignore any pseudoconstants, they're dealt with elsewhere */
+			if (rinfo->pseudoconstant)
+				continue;
 
-		if (list_member_ptr(fpinfo->remote_conds, rinfo))
-		{
-			remote_conds = lappend(remote_conds, rinfo);
-			remote_exprs = lappend(remote_exprs, rinfo->clause);
-		}
-		else if (list_member_ptr(fpinfo->local_conds, rinfo))
-			local_exprs = lappend(local_exprs, rinfo->clause);
-		else if (is_foreign_expr(root, baserel, rinfo->clause))
-		{
-			remote_conds = lappend(remote_conds, rinfo);
-			remote_exprs = lappend(remote_exprs, rinfo->clause);
+			if (list_member_ptr(fpinfo->remote_conds, rinfo))
+			{
+				remote_conds = lappend(remote_conds, rinfo);
+				remote_exprs = lappend(remote_exprs, rinfo->clause);
+			}
+			else if (list_member_ptr(fpinfo->local_conds, rinfo))
+				local_exprs = lappend(local_exprs, rinfo->clause);
+			else if (is_foreign_expr(root, foreignrel, rinfo->clause))
+			{
+				remote_conds = lappend(remote_conds, rinfo);
+				remote_exprs = lappend(remote_exprs, rinfo->clause);
+			}
+			else
+				local_exprs = lappend(local_exprs, rinfo->clause);
 		}
-		else
-			local_exprs = lappend(local_exprs, rinfo->clause);
-	}
 
-	/*
-	 * Build the query string to be sent for execution, and identify
-	 * expressions to be sent as parameters.
-	 */
-	initStringInfo(&sql);
-	deparseSelectSql(&sql, root, baserel, fpinfo->attrs_used,
-					 &retrieved_attrs);
-	if (remote_conds)
-		appendWhereClause(&sql, root, baserel, remote_conds,
-						  true, &params_list);
-
-	/*
-	 * Add FOR UPDATE/SHARE if appropriate.  We apply locking during the
-	 * initial row fetch, rather than later on as is done for local tables.
-	 * The extra roundtrips involved in trying to duplicate the local
-	 * semantics exactly don't seem worthwhile (see also comments for
-	 * RowMarkType).
-	 *
-	 * Note: because we actually run the query as a cursor, this assumes that
-	 * DECLARE CURSOR ... FOR UPDATE is supported, which it isn't before 8.3.
-	 */
-	if (baserel->relid == root->parse->resultRelation &&
-		(root->parse->commandType == CMD_UPDATE ||
-		 root->parse->commandType == CMD_DELETE))
-	{
-		/* Relation is UPDATE/DELETE target, so use FOR UPDATE */
-		appendStringInfoString(&sql, " FOR UPDATE");
+		/*
+		 * For a base-relation scan, we have to support EPQ recheck, which
+		 * should recheck all the remote quals.
+		 */
+		fdw_recheck_quals = remote_exprs;
 	}
 	else
 	{
-		PlanRowMark *rc = get_plan_rowmark(root->rowMarks, baserel->relid);
+		/*
+		 * Join relation - set scan_relid to 0.
+		 */
+		scan_relid = 0;
 
-		if (rc)
+		/*
+		 * For a join rel, baserestrictinfo is NIL and we are not considering
+		 * parameterization right now, so there should be no scan_clauses for
+		 * a joinrel.
+		 */
+		Assert(!scan_clauses);
+
+		/*
+		 * Instead we get the conditions to apply from the fdw_private
+		 * structure.
+		 */
+		remote_conds = fpinfo->remote_conds;
+		local_exprs = fpinfo->local_conds;
+
+		/*
+		 * We leave fdw_recheck_quals empty in this case, since we never need
+		 * to apply EPQ recheck clauses.  In the case of a joinrel, EPQ
+		 * recheck is handled by running the local join plan, see
+		 * postgresGetForeignJoinPaths() and postgresRecheckForeignScan().
+		 */
+
+		/* Build the list of columns to be fetched from the foreign server. */
+		fdw_scan_tlist = build_tlist_to_deparse(foreignrel);
+
+		/*
+		 * Ensure that the outer plan produces a tuple whose descriptor
+		 * matches our scan tuple slot.  This is safe because all scans and
+		 * joins support projection, so we never need to insert a Result
+		 * node.  Also, remove the local conditions from outer plan's quals,
+		 * lest they be evaluated twice, once by the local plan and once by
+		 * the scan.
+		 */
+		if (outer_plan)
 		{
-			/*
-			 * Relation is specified as a FOR UPDATE/SHARE target, so handle
-			 * that.  (But we could also see LCS_NONE, meaning this isn't a
-			 * target relation after all.)
-			 *
-			 * For now, just ignore any [NO] KEY specification, since (a) it's
-			 * not clear what that means for a remote table that we don't have
-			 * complete information about, and (b) it wouldn't work anyway on
-			 * older remote servers.  Likewise, we don't worry about NOWAIT.
-			 */
-			switch (rc->strength)
+			outer_plan->targetlist = fdw_scan_tlist;
+
+			foreach(lc, local_exprs)
 			{
-				case LCS_NONE:
-					/* No locking needed */
-					break;
-				case LCS_FORKEYSHARE:
-				case LCS_FORSHARE:
-					appendStringInfoString(&sql, " FOR SHARE");
-					break;
-				case LCS_FORNOKEYUPDATE:
-				case LCS_FORUPDATE:
-					appendStringInfoString(&sql, " FOR UPDATE");
-					break;
+				Join	   *join_plan = (Join *) outer_plan;
+				Node	   *qual = lfirst(lc);
+
+				outer_plan->qual = list_delete(outer_plan->qual, qual);
+
+				/*
+				 * For an inner join the local conditions of foreign scan plan
+				 * can be part of the joinquals as well.
+				 */
+				if (join_plan->jointype == JOIN_INNER)
+					join_plan->joinqual = list_delete(join_plan->joinqual,
+													  qual);
 			}
 		}
 	}
 
+	/*
+	 * Build the query string to be sent for execution, and identify
+	 * expressions to be sent as parameters.  This also adds FOR UPDATE/SHARE
+	 * if appropriate.
+	 */
+	initStringInfo(&sql);
+	deparseSelectStmtForRel(&sql, root, foreignrel, fdw_scan_tlist,
+							remote_conds, &retrieved_attrs, &params_list);
+
 	/*
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match enum FdwScanPrivateIndex, above.
 	 */
 	fdw_private = list_make2(makeString(sql.data),
 							 retrieved_attrs);
+	if (foreignrel->reloptkind == RELOPT_JOINREL)
+		fdw_private = lappend(fdw_private,
+							  makeString(fpinfo->relation_name->data));
 
 	/*
-	 * Create the ForeignScan node from target list, local filtering
-	 * expressions, remote parameter expressions, and FDW private information.
+	 * Create the ForeignScan node for the given relation.
 	 *
 	 * Note that the remote parameter expressions are stored in the fdw_exprs
 	 * field of the finished plan node; we can't keep them in private state
@@ -885,8 +963,8 @@ postgresGetForeignPlan(PlannerInfo *root,
 							scan_relid,
 							params_list,
 							fdw_private,
-							NIL,	/* no custom tlist */
-							remote_exprs,
+							fdw_scan_tlist,
+							fdw_recheck_quals,
 							outer_plan);
 }
 
@@ -905,6 +983,7 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	ForeignTable *table;
 	ForeignServer *server;
 	UserMapping *user;
+	int			rtindex;
 	int			numParams;
 	int			i;
 	ListCell   *lc;
@@ -923,14 +1002,19 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 
 	/*
 	 * Identify which user to do the remote access as.  This should match what
-	 * ExecCheckRTEPerms() does.
+	 * ExecCheckRTEPerms() does.  In case of a join, use the lowest-numbered
+	 * member RTE as a representative; we would get the same result from any,
+	 * since foreign_join_ok insists that all of them use the same user.
 	 */
-	rte = rt_fetch(fsplan->scan.scanrelid, estate->es_range_table);
+	if (fsplan->scan.scanrelid > 0)
+		rtindex = fsplan->scan.scanrelid;
+	else
+		rtindex = bms_next_member(fsplan->fs_relids, -1);
+	rte = rt_fetch(rtindex, estate->es_range_table);
 	userid = rte->checkAsUser ? rte->checkAsUser : GetUserId();
 
 	/* Get info about foreign table. */
-	fsstate->rel = node->ss.ss_currentRelation;
-	table = GetForeignTable(RelationGetRelid(fsstate->rel));
+	table = GetForeignTable(rte->relid);
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(userid, server->serverid);
 
@@ -938,7 +1022,7 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	 * Get connection to the foreign server.  Connection manager will
 	 * establish new connection if necessary.
 	 */
-	fsstate->conn = GetConnection(server, user, false);
+	fsstate->conn = GetConnection(server, user, false, &fsstate->conn_state);
 
 	/* Assign a unique ID for my cursor */
 	fsstate->cursor_number = GetCursorNumber(fsstate->conn);
@@ -950,20 +1034,68 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	fsstate->retrieved_attrs = (List *) list_nth(fsplan->fdw_private,
 											   FdwScanPrivateRetrievedAttrs);
 
+	/* The fetch size is arbitrary, but shouldn't be enormous. */
+	fsstate->fetch_size = 100;
+
+	/*
+	 * By default, batches are fetched only when needed.  This can be
+	 * overridden by a per-server setting, which in turn can be overridden by
+	 * a per-table setting; the latter is only consulted for a scan of a
+	 * single foreign table.
+	 */
+	fsstate->async_capable = false;
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "async_capable") == 0)
+			fsstate->async_capable = defGetBoolean(def);
+	}
+	if (fsplan->scan.scanrelid > 0)
+	{
+		foreach(lc, table->options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "async_capable") == 0)
+				fsstate->async_capable = defGetBoolean(def);
+		}
+	}
+
 	/* Create contexts for batches of tuples and per-tuple temp workspace. */
 	fsstate->batch_cxt = AllocSetContextCreate(estate->es_query_cxt,
 											   "postgres_fdw tuple data",
 											   ALLOCSET_DEFAULT_MINSIZE,
 											   ALLOCSET_DEFAULT_INITSIZE,
 											   ALLOCSET_DEFAULT_MAXSIZE);
+	if (fsstate->async_capable)
+		fsstate->prefetch_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											   "postgres_fdw prefetched data",
+												 ALLOCSET_DEFAULT_MINSIZE,
+												 ALLOCSET_DEFAULT_INITSIZE,
+												 ALLOCSET_DEFAULT_MAXSIZE);
 	fsstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
 											  "postgres_fdw temporary data",
 											  ALLOCSET_SMALL_MINSIZE,
 											  ALLOCSET_SMALL_INITSIZE,
 											  ALLOCSET_SMALL_MAXSIZE);
 
-	/* Get info we'll need for input data conversion. */
-	fsstate->attinmeta = TupleDescGetAttInMetadata(RelationGetDescr(fsstate->rel));
+	/*
+	 * Get info we'll need for converting data fetched from the foreign server
+	 * into local representation and error reporting during that process.
+	 */
+	if (fsplan->scan.scanrelid > 0)
+	{
+		fsstate->rel = node->ss.ss_currentRelation;
+		fsstate->tupdesc = RelationGetDescr(fsstate->rel);
+	}
+	else
+	{
+		fsstate->rel = NULL;
+		fsstate->tupdesc = node->ss.ss_ScanTupleSlot->tts_tupleDescriptor;
+	}
+
+	fsstate->attinmeta = TupleDescGetAttInMetadata(fsstate->tupdesc);
 
 	/* Prepare for output conversion of parameters used in remote query. */
 	numParams = list_length(fsplan->fdw_exprs);
@@ -1001,6 +1133,20 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 		fsstate->param_values = (const char **) palloc0(numParams * sizeof(char *));
 	else
 		fsstate->param_values = NULL;
+
+	/*
+	 * In asynchronous mode, get the remote query going right away, so that
+	 * when several foreign scans are initialized together (for instance as
+	 * children of an Append) the remote servers all work on their first
+	 * batch concurrently, instead of each one waiting for the executor to
+	 * reach its scan.  This isn't possible if the query depends on
+	 * parameter values, which are not available yet.
+	 */
+	if (fsstate->async_capable && numParams == 0)
+	{
+		create_cursor(node);
+		fetch_more_data_begin(node);
+	}
 }
 
 /*
@@ -1026,8 +1172,11 @@ postgresIterateForeignScan(ForeignScanState *node)
 	 */
 	if (fsstate->next_tuple >= fsstate->num_tuples)
 	{
-		/* No point in another fetch if we already detected EOF, though. */
-		if (!fsstate->eof_reached)
+		/*
+		 * No point in another fetch if we already detected EOF, though,
+		 * unless the last batch is still waiting in the prefetch buffer.
+		 */
+		if (!fsstate->eof_reached || fsstate->prefetch_ready)
 			fetch_more_data(node);
 		/* If we didn't get any tuples, must be end of data. */
 		if (fsstate->next_tuple >= fsstate->num_tuples)
@@ -1060,6 +1209,13 @@ postgresReScanForeignScan(ForeignScanState *node)
 	if (!fsstate->cursor_exists)
 		return;
 
+	/*
+	 * If a batch is still in flight, collect it first, so that what we hold
+	 * in memory matches the cursor position assumed below.
+	 */
+	if (fsstate->conn_state->pending_scan == node)
+		process_pending_request(node);
+
 	/*
 	 * If any internal parameters affecting this node have changed, we'd
 	 * better destroy and recreate the cursor.  Otherwise, rewinding it should
@@ -1079,7 +1235,11 @@ postgresReScanForeignScan(ForeignScanState *node)
 	}
 	else
 	{
-		/* Easy: just rescan what we already have in memory, if anything */
+		/*
+		 * Easy: just rescan what we already have in memory, if anything.
+		 * (The single batch fetched so far may also be sitting in the
+		 * prefetch buffer, in which case the next fetch will pick it up.)
+		 */
 		fsstate->next_tuple = 0;
 		return;
 	}
@@ -1088,7 +1248,7 @@ postgresReScanForeignScan(ForeignScanState *node)
 	 * We don't use a PG_TRY block here, so be careful not to throw error
 	 * without releasing the PGresult.
 	 */
-	res = PQexec(fsstate->conn, sql);
+	res = pgfdw_exec_query(fsstate->conn, sql, fsstate->conn_state);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		pgfdw_report_error(ERROR, res, fsstate->conn, true, sql);
 	PQclear(res);
@@ -1099,6 +1259,9 @@ postgresReScanForeignScan(ForeignScanState *node)
 	fsstate->next_tuple = 0;
 	fsstate->fetch_ct_2 = 0;
 	fsstate->eof_reached = false;
+	fsstate->prefetch_tuples = NULL;
+	fsstate->num_prefetch_tuples = 0;
+	fsstate->prefetch_ready = false;
 }
 
 /*
@@ -1114,9 +1277,17 @@ postgresEndForeignScan(ForeignScanState *node)
 	if (fsstate == NULL)
 		return;
 
+	/* Wait out any batch still in flight; we have no use for it */
+	if (fsstate->conn_state->pending_scan == node)
+	{
+		fsstate->conn_state->pending_scan = NULL;
+		PQclear(pgfdw_get_result(fsstate->conn, fsstate->query));
+	}
+
 	/* Close the cursor if open, to prevent accumulation of cursors */
 	if (fsstate->cursor_exists)
-		close_cursor(fsstate->conn, fsstate->cursor_number);
+		close_cursor(fsstate->conn, fsstate->cursor_number,
+					 fsstate->conn_state);
 
 	/* Release remote connection */
 	ReleaseConnection(fsstate->conn);
@@ -1125,6 +1296,38 @@ postgresEndForeignScan(ForeignScanState *node)
 	/* MemoryContexts will be deleted automatically. */
 }
 
+/*
+ * postgresRecheckForeignScan
+ *		Execute a local join execution plan for a foreign join
+ *
+ * For base foreign relations it suffices to set fdw_recheck_quals; for a
+ * pushed-down join, the row is reconstructed from the EPQ tuples of the
+ * base relations by running the alternative local join plan.
+ */
+static bool
+postgresRecheckForeignScan(ForeignScanState *node, TupleTableSlot *slot)
+{
+	Index		scanrelid = ((Scan *) node->ss.ps.plan)->scanrelid;
+	PlanState  *outerPlan = outerPlanState(node);
+	TupleTableSlot *result;
+
+	/* For base foreign relations, it suffices to set fdw_recheck_quals */
+	if (scanrelid > 0)
+		return true;
+
+	Assert(outerPlan != NULL);
+
+	/* Execute a local join execution plan */
+	result = ExecProcNode(outerPlan);
+	if (TupIsNull(result))
+		return false;
+
+	/* Store result in the given slot */
+	ExecCopySlot(slot, result);
+
+	return true;
+}
+
 /*
  * postgresAddForeignUpdateTargets
  *		Add resjunk column(s) needed for update/delete on a foreign table
@@ -1187,6 +1390,7 @@ postgresPlanForeignModify(PlannerInfo *root,
 	List	   *returningList = NIL;
 	List	   *retrieved_attrs = NIL;
 	bool		doNothing = false;
+	int			values_end_len = -1;
 
 	initStringInfo(&sql);
 
@@ -1258,7 +1462,7 @@ postgresPlanForeignModify(PlannerInfo *root,
 		case CMD_INSERT:
 			deparseInsertSql(&sql, root, resultRelation, rel,
 							 targetAttrs, doNothing, returningList,
-							 &retrieved_attrs);
+							 &retrieved_attrs, &values_end_len);
 			break;
 		case CMD_UPDATE:
 			deparseUpdateSql(&sql, root, resultRelation, rel,
@@ -1281,10 +1485,11 @@ postgresPlanForeignModify(PlannerInfo *root,
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match enum FdwModifyPrivateIndex, above.
 	 */
-	return list_make4(makeString(sql.data),
-					  targetAttrs,
-					  makeInteger((retrieved_attrs != NIL)),
-					  retrieved_attrs);
+	return lappend(list_make4(makeString(sql.data),
+							  targetAttrs,
+							  makeInteger((retrieved_attrs != NIL)),
+							  retrieved_attrs),
+				   makeInteger(values_end_len));
 }
 
 /*
@@ -1336,18 +1541,21 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 	user = GetUserMapping(userid, server->serverid);
 
 	/* Open connection; report that we'll create a prepared statement. */
-	fmstate->conn = GetConnection(server, user, true);
+	fmstate->conn = GetConnection(server, user, true, &fmstate->conn_state);
 	fmstate->p_name = NULL;		/* prepared statement not made yet */
 
 	/* Deconstruct fdw_private data. */
 	fmstate->query = strVal(list_nth(fdw_private,
 									 FdwModifyPrivateUpdateSql));
+	fmstate->orig_query = fmstate->query;
 	fmstate->target_attrs = (List *) list_nth(fdw_private,
 											  FdwModifyPrivateTargetAttnums);
 	fmstate->has_returning = intVal(list_nth(fdw_private,
 											 FdwModifyPrivateHasReturning));
 	fmstate->retrieved_attrs = (List *) list_nth(fdw_private,
 											 FdwModifyPrivateRetrievedAttrs);
+	fmstate->values_end = intVal(list_nth(fdw_private,
+										  FdwModifyPrivateLen));
 
 	/* Create context for per-tuple temp workspace. */
 	fmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
@@ -1399,6 +1607,25 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 
 	Assert(fmstate->p_nums <= n_params);
 
+	/*
+	 * Set up for inserting rows in batches, if wanted.  The statement we
+	 * prepare then inserts a whole batch of rows at once.
+	 */
+	fmstate->batch_size = get_batch_size(mtstate, resultRelInfo, fdw_private);
+	fmstate->num_slots = 0;
+	if (fmstate->batch_size > 1)
+	{
+		StringInfoData sql;
+
+		initStringInfo(&sql);
+		rebuildInsertSql(&sql, fmstate->orig_query, fmstate->values_end,
+						 fmstate->p_nums, fmstate->batch_size);
+		fmstate->query = sql.data;
+
+		fmstate->batch_values = (const char **)
+			palloc(sizeof(char *) * fmstate->p_nums * fmstate->batch_size);
+	}
+
 	resultRelInfo->ri_FdwState = fmstate;
 }
 
@@ -1417,6 +1644,24 @@ postgresExecForeignInsert(EState *estate,
 	PGresult   *res;
 	int			n_rows;
 
+	/*
+	 * When inserting in batches, just add the row to the current batch, and
+	 * send the batch once it is full.  The row is reported as inserted right
+	 * away; any error inserting it will be raised when the batch is sent.
+	 */
+	if (fmstate->batch_size > 1)
+	{
+		p_values = convert_prep_stmt_params(fmstate, NULL, slot);
+		memcpy(fmstate->batch_values + fmstate->num_slots * fmstate->p_nums,
+			   p_values, sizeof(char *) * fmstate->p_nums);
+		fmstate->num_slots++;
+
+		if (fmstate->num_slots >= fmstate->batch_size)
+			execute_batch_insert(fmstate);
+
+		return slot;
+	}
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
 		prepare_foreign_modify(fmstate);
@@ -1424,6 +1669,10 @@ postgresExecForeignInsert(EState *estate,
 	/* Convert parameters needed by prepared statement to text form */
 	p_values = convert_prep_stmt_params(fmstate, NULL, slot);
 
+	/* First, collect any FETCH a scan has in flight on the connection */
+	if (fmstate->conn_state->pending_scan)
+		process_pending_request(fmstate->conn_state->pending_scan);
+
 	/*
 	 * Execute the prepared statement, and check for success.
 	 *
@@ -1494,6 +1743,10 @@ postgresExecForeignUpdate(EState *estate,
 										(ItemPointer) DatumGetPointer(datum),
 										slot);
 
+	/* First, collect any FETCH a scan has in flight on the connection */
+	if (fmstate->conn_state->pending_scan)
+		process_pending_request(fmstate->conn_state->pending_scan);
+
 	/*
 	 * Execute the prepared statement, and check for success.
 	 *
@@ -1564,6 +1817,10 @@ postgresExecForeignDelete(EState *estate,
 										(ItemPointer) DatumGetPointer(datum),
 										NULL);
 
+	/* First, collect any FETCH a scan has in flight on the connection */
+	if (fmstate->conn_state->pending_scan)
+		process_pending_request(fmstate->conn_state->pending_scan);
+
 	/*
 	 * Execute the prepared statement, and check for success.
 	 *
@@ -1614,6 +1871,10 @@ postgresEndForeignModify(EState *estate,
 	if (fmstate == NULL)
 		return;
 
+	/* Send the last, partial batch of rows, if any */
+	if (fmstate->num_slots > 0)
+		execute_batch_insert(fmstate);
+
 	/* If we created a prepared statement, destroy it */
 	if (fmstate->p_name)
 	{
@@ -1626,7 +1887,7 @@ postgresEndForeignModify(EState *estate,
 		 * We don't use a PG_TRY block here, so be careful not to throw error
 		 * without releasing the PGresult.
 		 */
-		res = PQexec(fmstate->conn, sql);
+		res = pgfdw_exec_query(fmstate->conn, sql, fmstate->conn_state);
 		if (PQresultStatus(res) != PGRES_COMMAND_OK)
 			pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
 		PQclear(res);
@@ -1692,10 +1953,25 @@ postgresExplainForeignScan(ForeignScanState *node, ExplainState *es)
 {
 	List	   *fdw_private;
 	char	   *sql;
+	char	   *relations;
+
+	fdw_private = ((ForeignScan *) node->ss.ps.plan)->fdw_private;
+
+	/*
+	 * Add names of relation handled by the foreign scan when the scan is a
+	 * join
+	 */
+	if (list_length(fdw_private) > FdwScanPrivateRelations)
+	{
+		relations = strVal(list_nth(fdw_private, FdwScanPrivateRelations));
+		ExplainPropertyText("Relations", relations, es);
+	}
 
+	/*
+	 * Add remote query, when VERBOSE option is specified.
+	 */
 	if (es->verbose)
 	{
-		fdw_private = ((ForeignScan *) node->ss.ps.plan)->fdw_private;
 		sql = strVal(list_nth(fdw_private, FdwScanPrivateSelectSql));
 		ExplainPropertyText("Remote SQL", sql, es);
 	}
@@ -1716,27 +1992,36 @@ postgresExplainForeignModify(ModifyTableState *mtstate,
 	{
 		char	   *sql = strVal(list_nth(fdw_private,
 										  FdwModifyPrivateUpdateSql));
+		int			batch_size;
 
 		ExplainPropertyText("Remote SQL", sql, es);
+
+		/* Mention the batch size, if rows are inserted in batches */
+		batch_size = get_batch_size(mtstate, rinfo, fdw_private);
+		if (batch_size > 1)
+			ExplainPropertyInteger("Batch Size", batch_size, es);
 	}
 }
 
 
 /*
  * estimate_path_cost_size
- *		Get cost and size estimates for a foreign scan
+ *		Get cost and size estimates for a foreign scan on given foreign
+ *		relation either a base relation or a join between foreign relations.
  *
- * We assume that all the baserestrictinfo clauses will be applied, plus
- * any join clauses listed in join_conds.
+ * param_join_conds are the parameterization clauses with outer relations.
+ *
+ * The function returns the cost and size estimates in p_row, p_width,
+ * p_startup_cost and p_total_cost variables.
  */
 static void
 estimate_path_cost_size(PlannerInfo *root,
-						RelOptInfo *baserel,
-						List *join_conds,
+						RelOptInfo *foreignrel,
+						List *param_join_conds,
 						double *p_rows, int *p_width,
 						Cost *p_startup_cost, Cost *p_total_cost)
 {
-	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
 	double		rows;
 	double		retrieved_rows;
 	int			width;
@@ -1754,20 +2039,37 @@ estimate_path_cost_size(PlannerInfo *root,
 	 */
 	if (fpinfo->use_remote_estimate)
 	{
-		List	   *remote_join_conds;
-		List	   *local_join_conds;
+		List	   *remote_param_join_conds;
+		List	   *local_param_join_conds;
 		StringInfoData sql;
-		List	   *retrieved_attrs;
 		PGconn	   *conn;
+		PgFdwConnState *conn_state;
 		Selectivity local_sel;
 		QualCost	local_cost;
+		List	   *fdw_scan_tlist = NIL;
+		List	   *remote_conds;
+
+		/* Required only to be passed to deparseSelectStmtForRel */
+		List	   *retrieved_attrs;
+
+		/*
+		 * param_join_conds might contain both clauses that are safe to send
+		 * across, and clauses that aren't.
+		 */
+		classifyConditions(root, foreignrel, param_join_conds,
+						   &remote_param_join_conds, &local_param_join_conds);
+
+		/* Build the list of columns to be fetched from the foreign server. */
+		if (foreignrel->reloptkind == RELOPT_JOINREL)
+			fdw_scan_tlist = build_tlist_to_deparse(foreignrel);
 
 		/*
-		 * join_conds might contain both clauses that are safe to send across,
-		 * and clauses that aren't.
+		 * The complete list of remote conditions includes everything from
+		 * baserestrictinfo plus any extra join_conds relevant to this
+		 * particular path.
 		 */
-		classifyConditions(root, baserel, join_conds,
-						   &remote_join_conds, &local_join_conds);
+		remote_conds = list_concat(list_copy(remote_param_join_conds),
+								   fpinfo->remote_conds);
 
 		/*
 		 * Construct EXPLAIN query including the desired SELECT, FROM, and
@@ -1776,18 +2078,13 @@ estimate_path_cost_size(PlannerInfo *root,
 		 */
 		initStringInfo(&sql);
 		appendStringInfoString(&sql, "EXPLAIN ");
-		deparseSelectSql(&sql, root, baserel, fpinfo->attrs_used,
-						 &retrieved_attrs);
-		if (fpinfo->remote_conds)
-			appendWhereClause(&sql, root, baserel, fpinfo->remote_conds,
-							  true, NULL);
-		if (remote_join_conds)
-			appendWhereClause(&sql, root, baserel, remote_join_conds,
-							  (fpinfo->remote_conds == NIL), NULL);
+		deparseSelectStmtForRel(&sql, root, foreignrel, fdw_scan_tlist,
+								remote_conds, &retrieved_attrs, NULL);
 
 		/* Get the remote estimate */
-		conn = GetConnection(fpinfo->server, fpinfo->user, false);
-		get_remote_estimate(sql.data, conn, &rows, &width,
+		conn = GetConnection(fpinfo->server, fpinfo->user, false,
+							 &conn_state);
+		get_remote_estimate(sql.data, conn, conn_state, &rows, &width,
 							&startup_cost, &total_cost);
 		ReleaseConnection(conn);
 
@@ -1795,8 +2092,8 @@ estimate_path_cost_size(PlannerInfo *root,
 
 		/* Factor in the selectivity of the locally-checked quals */
 		local_sel = clauselist_selectivity(root,
-										   local_join_conds,
-										   baserel->relid,
+										   local_param_join_conds,
+										   foreignrel->relid,
 										   JOIN_INNER,
 										   NULL);
 		local_sel *= fpinfo->local_conds_sel;
@@ -1806,28 +2103,28 @@ estimate_path_cost_size(PlannerInfo *root,
 		/* Add in the eval cost of the locally-checked quals */
 		startup_cost += fpinfo->local_conds_cost.startup;
 		total_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
-		cost_qual_eval(&local_cost, local_join_conds, root);
+		cost_qual_eval(&local_cost, local_param_join_conds, root);
 		startup_cost += local_cost.startup;
 		total_cost += local_cost.per_tuple * retrieved_rows;
 	}
-	else
+	else if (foreignrel->reloptkind != RELOPT_JOINREL)
 	{
 		/*
 		 * We don't support join conditions in this mode (hence, no
 		 * parameterized paths can be made).
 		 */
-		Assert(join_conds == NIL);
+		Assert(param_join_conds == NIL);
 
 		/* Use rows/width estimates made by set_baserel_size_estimates. */
-		rows = baserel->rows;
-		width = baserel->width;
+		rows = foreignrel->rows;
+		width = foreignrel->width;
 
 		/*
 		 * Back into an estimate of the number of retrieved rows.  Just in
-		 * case this is nuts, clamp to at most baserel->tuples.
+		 * case this is nuts, clamp to at most foreignrel->tuples.
 		 */
 		retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
-		retrieved_rows = Min(retrieved_rows, baserel->tuples);
+		retrieved_rows = Min(retrieved_rows, foreignrel->tuples);
 
 		/*
 		 * Cost as though this were a seqscan, which is pessimistic.  We
@@ -1836,15 +2133,99 @@ estimate_path_cost_size(PlannerInfo *root,
 		 */
 		startup_cost = 0;
 		run_cost = 0;
-		run_cost += seq_page_cost * baserel->pages;
+		run_cost += seq_page_cost * foreignrel->pages;
+
+		startup_cost += foreignrel->baserestrictcost.startup;
+		cpu_per_tuple = cpu_tuple_cost + foreignrel->baserestrictcost.per_tuple;
+		run_cost += cpu_per_tuple * foreignrel->tuples;
+
+		total_cost = startup_cost + run_cost;
+	}
+	else
+	{
+		PgFdwRelationInfo *fpinfo_i;
+		PgFdwRelationInfo *fpinfo_o;
+		QualCost	join_cost;
+		QualCost	remote_conds_cost;
+		double		nrows;
+
+		/* For join we expect inner and outer relations set */
+		Assert(fpinfo->innerrel && fpinfo->outerrel);
+
+		fpinfo_i = (PgFdwRelationInfo *) fpinfo->innerrel->fdw_private;
+		fpinfo_o = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+
+		/* Use rows/width estimates made by set_joinrel_size_estimates. */
+		rows = foreignrel->rows;
+		width = foreignrel->width;
 
-		startup_cost += baserel->baserestrictcost.startup;
-		cpu_per_tuple = cpu_tuple_cost + baserel->baserestrictcost.per_tuple;
-		run_cost += cpu_per_tuple * baserel->tuples;
+		/*
+		 * Back into an estimate of the number of retrieved rows, and clamp
+		 * it to at most the size of the cross product.
+		 */
+		nrows = fpinfo_i->rows * fpinfo_o->rows;
+		retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
+		retrieved_rows = Min(retrieved_rows, nrows);
+
+		/*
+		 * The cost of foreign join is estimated as cost of generating rows
+		 * for the joining relations + cost for applying quals on the rows.
+		 */
+
+		/* Calculate the cost of clauses pushed down to the foreign server */
+		cost_qual_eval(&remote_conds_cost, fpinfo->remote_conds, root);
+		/* Calculate the cost of applying join clauses */
+		cost_qual_eval(&join_cost, fpinfo->joinclauses, root);
+
+		/*
+		 * Startup cost includes startup cost of joining relations and the
+		 * startup cost for join and other clauses.  We do not include the
+		 * startup cost specific to join strategy (e.g. setting up hash
+		 * tables) since we do not know what strategy the foreign server is
+		 * going to use.
+		 */
+		startup_cost = fpinfo_i->rel_startup_cost + fpinfo_o->rel_startup_cost;
+		startup_cost += join_cost.startup;
+		startup_cost += remote_conds_cost.startup;
+		startup_cost += fpinfo->local_conds_cost.startup;
+
+		/*
+		 * Run time cost includes:
+		 *
+		 * 1. Run time cost (total_cost - startup_cost) of relations being
+		 * joined
+		 *
+		 * 2. Run time cost of applying join clauses on the cross product of
+		 * the joining relations.
+		 *
+		 * 3. Run time cost of applying pushed down other clauses on the
+		 * result of join
+		 *
+		 * 4. Run time cost of applying nonpushable other clauses locally on
+		 * the result fetched from the foreign server.
+		 */
+		run_cost = fpinfo_i->rel_total_cost - fpinfo_i->rel_startup_cost;
+		run_cost += fpinfo_o->rel_total_cost - fpinfo_o->rel_startup_cost;
+		run_cost += nrows * join_cost.per_tuple;
+		nrows = clamp_row_est(nrows * fpinfo->joinclause_sel);
+		run_cost += nrows * remote_conds_cost.per_tuple;
+		run_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
 
 		total_cost = startup_cost + run_cost;
 	}
 
+	/*
+	 * Cache the costs for the unparameterized scan before adding the costs
+	 * for transferring data from the foreign server.  These costs are useful
+	 * for costing a join between this relation and another foreign relation,
+	 * when the costs can not be obtained from the foreign server.
+	 */
+	if (param_join_conds == NIL)
+	{
+		fpinfo->rel_startup_cost = startup_cost;
+		fpinfo->rel_total_cost = total_cost;
+	}
+
 	/*
 	 * Add some additional cost factors to account for connection overhead
 	 * (fdw_startup_cost), transferring data across the network
@@ -1869,7 +2250,7 @@ estimate_path_cost_size(PlannerInfo *root,
  */
 static void
 get_remote_estimate(const char *sql, PGconn *conn,
-					double *rows, int *width,
+					PgFdwConnState *conn_state, double *rows, int *width,
 					Cost *startup_cost, Cost *total_cost)
 {
 	PGresult   *volatile res = NULL;
@@ -1884,7 +2265,7 @@ get_remote_estimate(const char *sql, PGconn *conn,
 		/*
 		 * Execute EXPLAIN remotely.
 		 */
-		res = PQexec(conn, sql);
+		res = pgfdw_exec_query(conn, sql, conn_state);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, sql);
 
@@ -1959,6 +2340,10 @@ create_cursor(ForeignScanState *node)
 	StringInfoData buf;
 	PGresult   *res;
 
+	/* First, collect any FETCH another scan has in flight on the connection */
+	if (fsstate->conn_state->pending_scan)
+		process_pending_request(fsstate->conn_state->pending_scan);
+
 	/*
 	 * Construct array of query parameter values in text format.  We do the
 	 * conversions in the short-lived per-tuple context, so as not to cause a
@@ -2037,76 +2422,196 @@ create_cursor(ForeignScanState *node)
 
 /*
  * Fetch some more rows from the node's cursor.
+ *
+ * If a batch was prefetched, it becomes the current batch; otherwise the
+ * next batch is fetched synchronously.  In asynchronous mode, the FETCH for
+ * the following batch is then sent right away, so that the remote server
+ * works on it while we consume this one.
  */
 static void
 fetch_more_data(ForeignScanState *node)
 {
 	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
-	PGresult   *volatile res = NULL;
-	MemoryContext oldcontext;
 
-	/*
-	 * We'll store the tuples in the batch_cxt.  First, flush the previous
-	 * batch.
-	 */
-	fsstate->tuples = NULL;
-	MemoryContextReset(fsstate->batch_cxt);
-	oldcontext = MemoryContextSwitchTo(fsstate->batch_cxt);
+	/* Wait for the prefetched batch, if it hasn't arrived yet. */
+	if (fsstate->conn_state->pending_scan == node)
+		process_pending_request(node);
 
-	/* PGresult must be released before leaving this function. */
-	PG_TRY();
+	if (fsstate->prefetch_ready)
+	{
+		MemoryContext cxt;
+
+		/*
+		 * Swap the prefetched batch in.  The previous batch's context then
+		 * becomes the prefetch context, and is flushed.
+		 */
+		cxt = fsstate->batch_cxt;
+		fsstate->batch_cxt = fsstate->prefetch_cxt;
+		fsstate->prefetch_cxt = cxt;
+		MemoryContextReset(fsstate->prefetch_cxt);
+
+		fsstate->tuples = fsstate->prefetch_tuples;
+		fsstate->num_tuples = fsstate->num_prefetch_tuples;
+		fsstate->next_tuple = 0;
+
+		fsstate->prefetch_tuples = NULL;
+		fsstate->num_prefetch_tuples = 0;
+		fsstate->prefetch_ready = false;
+	}
+	else
 	{
 		PGconn	   *conn = fsstate->conn;
 		char		sql[64];
-		int			fetch_size;
-		int			numrows;
-		int			i;
+		PGresult   *res;
 
-		/* The fetch size is arbitrary, but shouldn't be enormous. */
-		fetch_size = 100;
+		/*
+		 * We'll store the tuples in the batch_cxt.  First, flush the
+		 * previous batch.
+		 */
+		fsstate->tuples = NULL;
+		fsstate->num_tuples = 0;
+		fsstate->next_tuple = 0;
+		MemoryContextReset(fsstate->batch_cxt);
 
 		snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
-				 fetch_size, fsstate->cursor_number);
+				 fsstate->fetch_size, fsstate->cursor_number);
 
-		res = PQexec(conn, sql);
+		/*
+		 * We don't use a PG_TRY block here, so be careful not to throw error
+		 * without releasing the PGresult.
+		 */
+		res = pgfdw_exec_query(conn, sql, fsstate->conn_state);
 		/* On error, report the original query, not the FETCH. */
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
-			pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
-
-		/* Convert the data into HeapTuples */
-		numrows = PQntuples(res);
-		fsstate->tuples = (HeapTuple *) palloc0(numrows * sizeof(HeapTuple));
-		fsstate->num_tuples = numrows;
-		fsstate->next_tuple = 0;
-
-		for (i = 0; i < numrows; i++)
-		{
-			fsstate->tuples[i] =
-				make_tuple_from_result_row(res, i,
-										   fsstate->rel,
-										   fsstate->attinmeta,
-										   fsstate->retrieved_attrs,
-										   fsstate->temp_cxt);
-		}
+			pgfdw_report_error(ERROR, res, conn, true, fsstate->query);
 
 		/* Update fetch_ct_2 */
 		if (fsstate->fetch_ct_2 < 2)
 			fsstate->fetch_ct_2++;
 
-		/* Must be EOF if we didn't get as many tuples as we asked for. */
-		fsstate->eof_reached = (numrows < fetch_size);
+		store_fetch_result(node, res, fsstate->batch_cxt,
+						   &fsstate->tuples, &fsstate->num_tuples);
+	}
 
-		PQclear(res);
-		res = NULL;
+	/* Start on the next batch while this one is being consumed. */
+	if (fsstate->async_capable && !fsstate->eof_reached &&
+		fsstate->conn_state->pending_scan == NULL)
+		fetch_more_data_begin(node);
+}
+
+/*
+ * Send a FETCH for the next batch of rows from the node's cursor, without
+ * waiting for the result.
+ *
+ * The result is collected by process_pending_request, either when the scan
+ * needs it or when someone else needs the connection.
+ */
+static void
+fetch_more_data_begin(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	char		sql[64];
+
+	Assert(fsstate->cursor_exists);
+	Assert(fsstate->conn_state->pending_scan == NULL);
+	Assert(!fsstate->prefetch_ready);
+
+	snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+			 fsstate->fetch_size, fsstate->cursor_number);
+
+	if (!PQsendQuery(fsstate->conn, sql))
+		pgfdw_report_error(ERROR, NULL, fsstate->conn, false, fsstate->query);
+
+	fsstate->conn_state->pending_scan = node;
+
+	/* The cursor has moved on as far as rewinding is concerned */
+	if (fsstate->fetch_ct_2 < 2)
+		fsstate->fetch_ct_2++;
+}
+
+/*
+ * Collect the result of the FETCH sent by fetch_more_data_begin for the
+ * given scan, and store the rows in its prefetch buffer.
+ *
+ * This must be done before any other command can be sent on the connection,
+ * so it is called both by the scan itself and by anyone else wanting to use
+ * the connection.
+ */
+void
+process_pending_request(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	PGresult   *res;
+
+	Assert(fsstate->conn_state->pending_scan == node);
+
+	/* Whatever happens below, the request is no longer pending */
+	fsstate->conn_state->pending_scan = NULL;
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_get_result(fsstate->conn, fsstate->query);
+	/* On error, report the original query, not the FETCH. */
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pgfdw_report_error(ERROR, res, fsstate->conn, true, fsstate->query);
+
+	MemoryContextReset(fsstate->prefetch_cxt);
+	store_fetch_result(node, res, fsstate->prefetch_cxt,
+					   &fsstate->prefetch_tuples,
+					   &fsstate->num_prefetch_tuples);
+	fsstate->prefetch_ready = true;
+}
+
+/*
+ * Convert the rows of a FETCH result into HeapTuples allocated in cxt, and
+ * return them in *tuples and *num_tuples.  The PGresult is released, also
+ * on error.
+ */
+static void
+store_fetch_result(ForeignScanState *node, PGresult *res, MemoryContext cxt,
+				   HeapTuple **tuples, int *num_tuples)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	MemoryContext oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(cxt);
+
+	/* PGresult must be released before leaving this function. */
+	PG_TRY();
+	{
+		int			numrows;
+		int			i;
+
+		/* Convert the data into HeapTuples */
+		numrows = PQntuples(res);
+		*tuples = (HeapTuple *) palloc0(numrows * sizeof(HeapTuple));
+		*num_tuples = numrows;
+
+		for (i = 0; i < numrows; i++)
+		{
+			(*tuples)[i] =
+				make_tuple_from_result_row(res, i,
+										   fsstate->rel,
+										   fsstate->attinmeta,
+										   fsstate->retrieved_attrs,
+										   node,
+										   fsstate->temp_cxt);
+		}
+
+		/* Must be EOF if we didn't get as many tuples as we asked for. */
+		fsstate->eof_reached = (numrows < fsstate->fetch_size);
 	}
 	PG_CATCH();
 	{
-		if (res)
-			PQclear(res);
+		PQclear(res);
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
 
+	PQclear(res);
+
 	MemoryContextSwitchTo(oldcontext);
 }
 
@@ -2164,7 +2669,8 @@ reset_transmission_modes(int nestlevel)
  * Utility routine to close a cursor.
  */
 static void
-close_cursor(PGconn *conn, unsigned int cursor_number)
+close_cursor(PGconn *conn, unsigned int cursor_number,
+			 PgFdwConnState *conn_state)
 {
 	char		sql[64];
 	PGresult   *res;
@@ -2175,7 +2681,7 @@ close_cursor(PGconn *conn, unsigned int cursor_number)
 	 * We don't use a PG_TRY block here, so be careful not to throw error
 	 * without releasing the PGresult.
 	 */
-	res = PQexec(conn, sql);
+	res = pgfdw_exec_query(conn, sql, conn_state);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		pgfdw_report_error(ERROR, res, conn, true, sql);
 	PQclear(res);
@@ -2207,6 +2713,8 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 	 * We don't use a PG_TRY block here, so be careful not to throw error
 	 * without releasing the PGresult.
 	 */
+	if (fmstate->conn_state->pending_scan)
+		process_pending_request(fmstate->conn_state->pending_scan);
 	res = PQprepare(fmstate->conn,
 					p_name,
 					fmstate->query,
@@ -2221,6 +2729,137 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 	fmstate->p_name = p_name;
 }
 
+/*
+ * get_batch_size
+ *		Determine the number of rows to insert per remote INSERT statement
+ *
+ * The batch_size option of the server can be overridden by that of the
+ * foreign table.  Rows are only inserted in batches if nothing needs to be
+ * known about the outcome for each row as it is inserted: there must be no
+ * RETURNING clause, ON CONFLICT clause, WITH CHECK OPTION constraint or
+ * AFTER trigger.  The latter restriction extends to statement-level
+ * triggers, since those fire before the last batch is sent.
+ */
+static int
+get_batch_size(ModifyTableState *mtstate, ResultRelInfo *resultRelInfo,
+			   List *fdw_private)
+{
+	Relation	rel = resultRelInfo->ri_RelationDesc;
+	TriggerDesc *trigdesc = rel->trigdesc;
+	ForeignTable *table;
+	ForeignServer *server;
+	List	   *target_attrs;
+	int			batch_size = 1;
+	ListCell   *lc;
+
+	if (mtstate->operation != CMD_INSERT ||
+		intVal(list_nth(fdw_private, FdwModifyPrivateHasReturning)) ||
+		mtstate->mt_onconflict != ONCONFLICT_NONE ||
+		resultRelInfo->ri_WithCheckOptions != NIL ||
+		(trigdesc && (trigdesc->trig_insert_after_row ||
+					  trigdesc->trig_insert_after_statement)))
+		return 1;
+
+	/* Nothing to batch if there are no parameters, as in DEFAULT VALUES */
+	target_attrs = (List *) list_nth(fdw_private,
+									 FdwModifyPrivateTargetAttnums);
+	if (target_attrs == NIL)
+		return 1;
+
+	table = GetForeignTable(RelationGetRelid(rel));
+	server = GetForeignServer(table->serverid);
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = atoi(defGetString(def));
+	}
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = atoi(defGetString(def));
+	}
+
+	/* The protocol can't carry more than 65535 parameters per statement */
+	batch_size = Min(batch_size, 65535 / list_length(target_attrs));
+
+	return Max(batch_size, 1);
+}
+
+/*
+ * execute_batch_insert
+ *		Send the rows buffered so far to the remote server
+ *
+ * A full batch is sent with the prepared statement; a partial one, which can
+ * only occur at the end of the insertion, with a one-off statement.
+ */
+static void
+execute_batch_insert(PgFdwModifyState *fmstate)
+{
+	int			num_params = fmstate->num_slots * fmstate->p_nums;
+	PGresult   *res;
+
+	Assert(fmstate->num_slots > 0);
+
+	if (fmstate->num_slots == fmstate->batch_size)
+	{
+		/* Set up the prepared statement, if we didn't yet */
+		if (!fmstate->p_name)
+			prepare_foreign_modify(fmstate);
+
+		if (fmstate->conn_state->pending_scan)
+			process_pending_request(fmstate->conn_state->pending_scan);
+
+		/*
+		 * We don't use a PG_TRY block here, so be careful not to throw error
+		 * without releasing the PGresult.
+		 */
+		res = PQexecPrepared(fmstate->conn,
+							 fmstate->p_name,
+							 num_params,
+							 fmstate->batch_values,
+							 NULL,
+							 NULL,
+							 0);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			pgfdw_report_error(ERROR, res, fmstate->conn, true,
+							   fmstate->query);
+	}
+	else
+	{
+		StringInfoData sql;
+
+		initStringInfo(&sql);
+		rebuildInsertSql(&sql, fmstate->orig_query, fmstate->values_end,
+						 fmstate->p_nums, fmstate->num_slots);
+
+		if (fmstate->conn_state->pending_scan)
+			process_pending_request(fmstate->conn_state->pending_scan);
+
+		/* As in prepare_foreign_modify, leave parameter types to the remote */
+		res = PQexecParams(fmstate->conn,
+						   sql.data,
+						   num_params,
+						   NULL,
+						   fmstate->batch_values,
+						   NULL,
+						   NULL,
+						   0);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			pgfdw_report_error(ERROR, res, fmstate->conn, true, sql.data);
+		pfree(sql.data);
+	}
+	PQclear(res);
+
+	/* The parameter values of the batch live in temp_cxt */
+	fmstate->num_slots = 0;
+	MemoryContextReset(fmstate->temp_cxt);
+}
+
 /*
  * convert_prep_stmt_params
  *		Create array of text strings representing parameter values
@@ -2304,6 +2943,7 @@ store_returning_result(PgFdwModifyState *fmstate,
 											fmstate->rel,
 											fmstate->attinmeta,
 											fmstate->retrieved_attrs,
+											NULL,
 											fmstate->temp_cxt);
 		/* tuple will be deleted when it is cleared from the slot */
 		ExecStoreTuple(newtup, slot, InvalidBuffer, true);
@@ -2330,6 +2970,7 @@ postgresAnalyzeForeignTable(Relation relation,
 	ForeignServer *server;
 	UserMapping *user;
 	PGconn	   *conn;
+	PgFdwConnState *conn_state;
 	StringInfoData sql;
 	PGresult   *volatile res = NULL;
 
@@ -2350,7 +2991,7 @@ postgresAnalyzeForeignTable(Relation relation,
 	table = GetForeignTable(RelationGetRelid(relation));
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(relation->rd_rel->relowner, server->serverid);
-	conn = GetConnection(server, user, false);
+	conn = GetConnection(server, user, false, &conn_state);
 
 	/*
 	 * Construct command to get page count for relation.
@@ -2361,7 +3002,7 @@ postgresAnalyzeForeignTable(Relation relation,
 	/* In what follows, do not risk leaking any PGresults. */
 	PG_TRY();
 	{
-		res = PQexec(conn, sql.data);
+		res = pgfdw_exec_query(conn, sql.data, conn_state);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, sql.data);
 
@@ -2412,6 +3053,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 	ForeignServer *server;
 	UserMapping *user;
 	PGconn	   *conn;
+	PgFdwConnState *conn_state;
 	unsigned int cursor_number;
 	StringInfoData sql;
 	PGresult   *volatile res = NULL;
@@ -2442,7 +3084,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 	table = GetForeignTable(RelationGetRelid(relation));
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(relation->rd_rel->relowner, server->serverid);
-	conn = GetConnection(server, user, false);
+	conn = GetConnection(server, user, false, &conn_state);
 
 	/*
 	 * Construct cursor that retrieves whole rows from remote.
@@ -2455,7 +3097,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 	/* In what follows, do not risk leaking any PGresults. */
 	PG_TRY();
 	{
-		res = PQexec(conn, sql.data);
+		res = pgfdw_exec_query(conn, sql.data, conn_state);
 		if (PQresultStatus(res) != PGRES_COMMAND_OK)
 			pgfdw_report_error(ERROR, res, conn, false, sql.data);
 		PQclear(res);
@@ -2485,7 +3127,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 			snprintf(fetch_sql, sizeof(fetch_sql), "FETCH %d FROM c%u",
 					 fetch_size, cursor_number);
 
-			res = PQexec(conn, fetch_sql);
+			res = pgfdw_exec_query(conn, fetch_sql, conn_state);
 			/* On error, report the original query, not the FETCH. */
 			if (PQresultStatus(res) != PGRES_TUPLES_OK)
 				pgfdw_report_error(ERROR, res, conn, false, sql.data);
@@ -2504,7 +3146,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 		}
 
 		/* Close the cursor, just to be tidy. */
-		close_cursor(conn, cursor_number);
+		close_cursor(conn, cursor_number, conn_state);
 	}
 	PG_CATCH();
 	{
@@ -2595,6 +3237,7 @@ analyze_row_processor(PGresult *res, int row, PgFdwAnalyzeState *astate)
 													   astate->rel,
 													   astate->attinmeta,
 													 astate->retrieved_attrs,
+													   NULL,
 													   astate->temp_cxt);
 
 		MemoryContextSwitchTo(oldcontext);
@@ -2614,6 +3257,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	ForeignServer *server;
 	UserMapping *mapping;
 	PGconn	   *conn;
+	PgFdwConnState *conn_state;
 	StringInfoData buf;
 	PGresult   *volatile res = NULL;
 	int			numrows,
@@ -2643,7 +3287,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	 */
 	server = GetForeignServer(serverOid);
 	mapping = GetUserMapping(GetUserId(), server->serverid);
-	conn = GetConnection(server, mapping, false);
+	conn = GetConnection(server, mapping, false, &conn_state);
 
 	/* Don't attempt to import collation if remote server hasn't got it */
 	if (PQserverVersion(conn) < 90100)
@@ -2659,7 +3303,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		appendStringInfoString(&buf, "SELECT 1 FROM pg_catalog.pg_namespace WHERE nspname = ");
 		deparseStringLiteral(&buf, stmt->remote_schema);
 
-		res = PQexec(conn, buf.data);
+		res = pgfdw_exec_query(conn, buf.data, conn_state);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, buf.data);
 
@@ -2758,7 +3402,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		appendStringInfoString(&buf, " ORDER BY c.relname, a.attnum");
 
 		/* Fetch the data */
-		res = PQexec(conn, buf.data);
+		res = pgfdw_exec_query(conn, buf.data, conn_state);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, buf.data);
 
@@ -2869,12 +3513,472 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	return commands;
 }
 
+/*
+ * Assess whether the join between inner and outer relations can be pushed down
+ * to the foreign server.  As a side effect, save information we obtain in this
+ * function to PgFdwRelationInfo passed in.
+ */
+static bool
+foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel, JoinType jointype,
+				RelOptInfo *outerrel, RelOptInfo *innerrel,
+				JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	PgFdwRelationInfo *fpinfo_o;
+	PgFdwRelationInfo *fpinfo_i;
+	ListCell   *lc;
+	List	   *joinclauses;
+	List	   *otherclauses;
+
+	/*
+	 * We support pushing down INNER, LEFT, RIGHT and FULL OUTER joins.
+	 * Constructing queries representing SEMI and ANTI joins is hard, hence
+	 * not considered right now.
+	 */
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT &&
+		jointype != JOIN_RIGHT && jointype != JOIN_FULL)
+		return false;
+
+	/*
+	 * If either of the joining relations is marked as unsafe to pushdown, the
+	 * join can not be pushed down.
+	 */
+	fpinfo = (PgFdwRelationInfo *) joinrel->fdw_private;
+	fpinfo_o = (PgFdwRelationInfo *) outerrel->fdw_private;
+	fpinfo_i = (PgFdwRelationInfo *) innerrel->fdw_private;
+	if (!fpinfo_o || !fpinfo_o->pushdown_safe ||
+		!fpinfo_i || !fpinfo_i->pushdown_safe)
+		return false;
+
+	/*
+	 * The remote query is run as a single user, so all the joined tables
+	 * must be checked as the same role; otherwise they might map to
+	 * different user mappings.
+	 */
+	if (fpinfo_o->checkAsUser != fpinfo_i->checkAsUser)
+		return false;
+
+	/*
+	 * If joining relations have local conditions, those conditions are
+	 * required to be applied before joining the relations.  Hence the join
+	 * can not be pushed down.
+	 */
+	if (fpinfo_o->local_conds || fpinfo_i->local_conds)
+		return false;
+
+	/*
+	 * We only build unparameterized paths, so give up on joins that have to
+	 * be parameterized by a lateral reference.
+	 */
+	if (!bms_is_empty(joinrel->lateral_relids))
+		return false;
+
+	/*
+	 * Pseudoconstant quals would only be enforced by a gating Result node
+	 * above a join plan, which a foreign scan doesn't get; leave such joins
+	 * to the local executor.
+	 */
+	foreach(lc, extra->restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (rinfo->pseudoconstant)
+			return false;
+	}
+
+	/* Separate restrict list into join quals and quals on join relation */
+	if (IS_OUTER_JOIN(jointype))
+		extract_actual_join_clauses(extra->restrictlist, &joinclauses,
+									&otherclauses);
+	else
+	{
+		/*
+		 * Unlike an outer join, for inner join, the join result contains
+		 * only the rows which satisfy join clauses, similar to the other
+		 * clause.  Hence all clauses can be treated as other quals.  This
+		 * helps to push a join down to the foreign server even if some of
+		 * its join quals are not safe to pushdown.
+		 */
+		otherclauses = extract_actual_clauses(extra->restrictlist, false);
+		joinclauses = NIL;
+	}
+
+	/* Join quals must be safe to push down. */
+	foreach(lc, joinclauses)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+
+		if (!is_foreign_expr(root, joinrel, expr))
+			return false;
+	}
+
+	/*
+	 * deparseExplicitTargetList() isn't smart enough to handle anything other
+	 * than a Var.  In particular, if there's some PlaceHolderVar that would
+	 * need to be evaluated within this join tree (because there's an upper
+	 * reference to a quantity that may go to NULL as a result of an outer
+	 * join), then we can't try to push the join down because we'll fail when
+	 * we get to deparseExplicitTargetList().  However, a PlaceHolderVar that
+	 * needs to be evaluated *at the top* of this join tree is OK, because we
+	 * can do that locally after fetching the results from the remote side.
+	 */
+	foreach(lc, root->placeholder_list)
+	{
+		PlaceHolderInfo *phinfo = lfirst(lc);
+		Relids		relids = joinrel->relids;
+
+		if (bms_is_subset(phinfo->ph_eval_at, relids) &&
+			bms_nonempty_difference(relids, phinfo->ph_eval_at))
+			return false;
+	}
+
+	/* Save the join clauses, for later use. */
+	fpinfo->joinclauses = joinclauses;
+
+	/*
+	 * Other clauses are applied after the join has been performed and thus
+	 * need not be all pushable.  We will push those which can be pushed to
+	 * reduce the number of rows fetched from the foreign server.  Rest of
+	 * them will be applied locally after fetching join result.  Add them to
+	 * fpinfo so that other joins involving this joinrel will know that this
+	 * joinrel has local clauses.
+	 */
+	foreach(lc, otherclauses)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+
+		if (!is_foreign_expr(root, joinrel, expr))
+			fpinfo->local_conds = lappend(fpinfo->local_conds, expr);
+		else
+			fpinfo->remote_conds = lappend(fpinfo->remote_conds, expr);
+	}
+
+	fpinfo->outerrel = outerrel;
+	fpinfo->innerrel = innerrel;
+	fpinfo->jointype = jointype;
+
+	/*
+	 * Pull the other remote conditions from the joining relations into join
+	 * clauses or other remote clauses (remote_conds) of this relation
+	 * wherever possible.  This avoids building subqueries at every join step,
+	 * which the deparser does not support.
+	 *
+	 * For an inner join, clauses from both the relations are added to the
+	 * other remote clauses.  For LEFT and RIGHT OUTER join, the clauses from
+	 * the outer side are added to remote_conds since those can be evaluated
+	 * after the join is evaluated.  The clauses from inner side are added to
+	 * the joinclauses, since they need to be evaluated while constructing the
+	 * join.
+	 *
+	 * For a FULL OUTER JOIN, the other clauses from either relation can not
+	 * be added to the joinclauses or remote_conds, since each relation acts
+	 * as an outer relation for the other.  Consider such full outer join as
+	 * unshippable because of the reasons mentioned above in this comment.
+	 *
+	 * The joining sides can not have local conditions, thus no need to test
+	 * shippability of the clauses being pulled up.
+	 */
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										   list_copy(fpinfo_i->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										   list_copy(fpinfo_o->remote_conds));
+			break;
+
+		case JOIN_LEFT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+										   list_copy(fpinfo_i->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										   list_copy(fpinfo_o->remote_conds));
+			break;
+
+		case JOIN_RIGHT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+										   list_copy(fpinfo_o->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										   list_copy(fpinfo_i->remote_conds));
+			break;
+
+		case JOIN_FULL:
+			if (fpinfo_o->remote_conds || fpinfo_i->remote_conds)
+				return false;
+			break;
+
+		default:
+			/* Should not happen, we have just checked this above */
+			elog(ERROR, "unsupported join type %d", jointype);
+	}
+
+	/*
+	 * For an inner join, all restrictions can be treated alike.  Treating
+	 * the pushed down conditions as join conditions allows a top level full
+	 * outer join to be deparsed without requiring subqueries.
+	 */
+	if (jointype == JOIN_INNER)
+	{
+		Assert(!fpinfo->joinclauses);
+		fpinfo->joinclauses = fpinfo->remote_conds;
+		fpinfo->remote_conds = NIL;
+	}
+
+	/* Mark that this join can be pushed down safely */
+	fpinfo->pushdown_safe = true;
+
+	/*
+	 * If user is willing to estimate cost for a scan of either of the joining
+	 * relations using EXPLAIN, he intends to estimate scans on that relation
+	 * more accurately.  Then, it makes sense to estimate the cost of the join
+	 * with that relation more accurately using EXPLAIN.
+	 */
+	fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate ||
+		fpinfo_i->use_remote_estimate;
+
+	/* Get server, user mapping and cost options from the joining relations */
+	fpinfo->server = fpinfo_o->server;
+	fpinfo->user = fpinfo_o->user ? fpinfo_o->user : fpinfo_i->user;
+	fpinfo->checkAsUser = fpinfo_o->checkAsUser;
+	fpinfo->fdw_startup_cost = fpinfo_o->fdw_startup_cost;
+	fpinfo->fdw_tuple_cost = fpinfo_o->fdw_tuple_cost;
+
+	/*
+	 * Set the string describing this join relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.
+	 */
+	fpinfo->relation_name = makeStringInfo();
+	appendStringInfo(fpinfo->relation_name, "(%s) %s JOIN (%s)",
+					 fpinfo_o->relation_name->data,
+					 get_jointype_name(fpinfo->jointype),
+					 fpinfo_i->relation_name->data);
+
+	return true;
+}
+
+/*
+ * Find an unparameterized local join path of the given join relation, to be
+ * used as the alternative plan of a foreign join when EvalPlanQual needs to
+ * reconstruct a joined row from the base relations' EPQ tuples.
+ *
+ * The returned path is a shallow copy, since the original path may be freed
+ * by add_path once the foreign join path dominates it.  If either input of
+ * the join is itself a pushed-down foreign join, it is replaced with that
+ * join's own local alternative, so that the whole tree consists of local
+ * join strategies.
+ */
+static Path *
+get_local_join_path(RelOptInfo *joinrel)
+{
+	ListCell   *lc;
+
+	Assert(joinrel->reloptkind == RELOPT_JOINREL);
+
+	foreach(lc, joinrel->pathlist)
+	{
+		Path	   *path = (Path *) lfirst(lc);
+		JoinPath   *joinpath = NULL;
+
+		/* Skip parameterised paths. */
+		if (path->param_info != NULL)
+			continue;
+
+		switch (path->pathtype)
+		{
+			case T_HashJoin:
+				{
+					HashPath   *hash_path = makeNode(HashPath);
+
+					memcpy(hash_path, path, sizeof(HashPath));
+					joinpath = (JoinPath *) hash_path;
+				}
+				break;
+
+			case T_NestLoop:
+				{
+					NestPath   *nest_path = makeNode(NestPath);
+
+					memcpy(nest_path, path, sizeof(NestPath));
+					joinpath = (JoinPath *) nest_path;
+				}
+				break;
+
+			case T_MergeJoin:
+				{
+					MergePath  *merge_path = makeNode(MergePath);
+
+					memcpy(merge_path, path, sizeof(MergePath));
+					joinpath = (JoinPath *) merge_path;
+				}
+				break;
+
+			default:
+				/* Just skip anything else. */
+				break;
+		}
+
+		/* This path isn't good for us, check next. */
+		if (!joinpath)
+			continue;
+
+		if (IsA(joinpath->outerjoinpath, ForeignPath))
+		{
+			ForeignPath *foreign_path = (ForeignPath *) joinpath->outerjoinpath;
+
+			if (foreign_path->path.parent->reloptkind == RELOPT_JOINREL)
+				joinpath->outerjoinpath = foreign_path->fdw_outerpath;
+		}
+
+		if (IsA(joinpath->innerjoinpath, ForeignPath))
+		{
+			ForeignPath *foreign_path = (ForeignPath *) joinpath->innerjoinpath;
+
+			if (foreign_path->path.parent->reloptkind == RELOPT_JOINREL)
+				joinpath->innerjoinpath = foreign_path->fdw_outerpath;
+		}
+
+		/* Give up if a pushed-down input has no local alternative */
+		if (joinpath->outerjoinpath == NULL || joinpath->innerjoinpath == NULL)
+		{
+			pfree(joinpath);
+			continue;
+		}
+
+		return (Path *) joinpath;
+	}
+
+	return NULL;
+}
+
+/*
+ * postgresGetForeignJoinPaths
+ *		Add possible ForeignPath to joinrel, if join is safe to push down.
+ */
+static void
+postgresGetForeignJoinPaths(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	ForeignPath *joinpath;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+	Path	   *epq_path;		/* Path to create plan to be executed when
+								 * EvalPlanQual gets triggered. */
+
+	/*
+	 * Skip if this join combination has been considered already.
+	 */
+	if (joinrel->fdw_private)
+		return;
+
+	/*
+	 * Create unfinished PgFdwRelationInfo entry which is used to indicate
+	 * that the join relation is already considered, so that we won't waste
+	 * time in judging safety of join pushdown and adding the same paths again
+	 * if found safe.  Once we know that this join can be pushed down, we fill
+	 * the entry.
+	 */
+	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
+	fpinfo->pushdown_safe = false;
+	joinrel->fdw_private = fpinfo;
+	/* attrs_used is only for base relations. */
+	fpinfo->attrs_used = NULL;
+
+	/*
+	 * If there is a possibility that EvalPlanQual will be executed, we need
+	 * to be able to reconstruct the row using scans of the base relations.
+	 * Find an alternative local path before we add the ForeignPath, lest the
+	 * new path kick out possibly the only local path.  Do this before calling
+	 * foreign_join_ok(), since that function updates fpinfo and marks it as
+	 * pushable if the join is found to be pushable.
+	 */
+	if (root->parse->commandType == CMD_DELETE ||
+		root->parse->commandType == CMD_UPDATE ||
+		root->rowMarks)
+	{
+		epq_path = get_local_join_path(joinrel);
+		if (!epq_path)
+		{
+			elog(DEBUG3, "could not push down foreign join because a local path suitable for EPQ checks was not found");
+			return;
+		}
+	}
+	else
+		epq_path = NULL;
+
+	if (!foreign_join_ok(root, joinrel, jointype, outerrel, innerrel, extra))
+	{
+		/* Free path required for EPQ if we copied one; we don't need it now */
+		if (epq_path)
+			pfree(epq_path);
+		return;
+	}
+
+	/*
+	 * Compute the selectivity and cost of the local_conds, so we don't have
+	 * to do it over again for each path.  The best we can do for these
+	 * conditions is to estimate selectivity on the basis of local statistics.
+	 * The local conditions are applied after the join has been computed on
+	 * the remote side like quals in WHERE clause, so pass jointype as
+	 * JOIN_INNER.
+	 */
+	fpinfo->local_conds_sel = clauselist_selectivity(root,
+													 fpinfo->local_conds,
+													 0,
+													 JOIN_INNER,
+													 NULL);
+	cost_qual_eval(&fpinfo->local_conds_cost, fpinfo->local_conds, root);
+
+	/*
+	 * If we are going to estimate costs locally, estimate the join clause
+	 * selectivity here while we have special join info.
+	 */
+	if (!fpinfo->use_remote_estimate)
+		fpinfo->joinclause_sel = clauselist_selectivity(root,
+														fpinfo->joinclauses,
+														0,
+														fpinfo->jointype,
+														extra->sjinfo);
+
+	/* Estimate costs for bare join relation */
+	estimate_path_cost_size(root, joinrel, NIL,
+							&rows, &width, &startup_cost, &total_cost);
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/*
+	 * Create a new join path and add it to the joinrel which represents a
+	 * join between foreign tables.
+	 */
+	joinpath = create_foreignscan_path(root,
+									   joinrel,
+									   rows,
+									   startup_cost,
+									   total_cost,
+									   NIL,		/* no pathkeys */
+									   NULL,	/* no required_outer */
+									   epq_path,
+									   NIL);	/* no fdw_private */
+
+	/* Add generated path into joinrel by add_path(). */
+	add_path(joinrel, (Path *) joinpath);
+}
+
 /*
  * Create a tuple from the specified row of the PGresult.
  *
  * rel is the local representation of the foreign table, attinmeta is
  * conversion data for the rel's tupdesc, and retrieved_attrs is an
  * integer list of the table column numbers present in the PGresult.
+ * fsstate is the ForeignScan plan node's execution state; for a foreign
+ * join rel is NULL and the tuple descriptor is taken from fsstate instead.
  * temp_context is a working context that can be reset after each tuple.
  */
 static HeapTuple
@@ -2883,10 +3987,11 @@ make_tuple_from_result_row(PGresult *res,
 						   Relation rel,
 						   AttInMetadata *attinmeta,
 						   List *retrieved_attrs,
+						   ForeignScanState *fsstate,
 						   MemoryContext temp_context)
 {
 	HeapTuple	tuple;
-	TupleDesc	tupdesc = RelationGetDescr(rel);
+	TupleDesc	tupdesc;
 	Datum	   *values;
 	bool	   *nulls;
 	ItemPointer ctid = NULL;
@@ -2898,6 +4003,18 @@ make_tuple_from_result_row(PGresult *res,
 
 	Assert(row < PQntuples(res));
 
+	/*
+	 * Get the tuple descriptor for the row.  Use the rel's tupdesc if rel is
+	 * provided, otherwise look to the scan node's ScanTupleSlot.
+	 */
+	if (rel)
+		tupdesc = RelationGetDescr(rel);
+	else
+	{
+		Assert(fsstate);
+		tupdesc = ((PgFdwScanState *) fsstate->fdw_state)->tupdesc;
+	}
+
 	/*
 	 * Do the following work in a temp context that we reset after each tuple.
 	 * This cleans up not only the data we have direct access to, but any
@@ -2915,6 +4032,7 @@ make_tuple_from_result_row(PGresult *res,
 	 */
 	errpos.rel = rel;
 	errpos.cur_attno = 0;
+	errpos.fsstate = fsstate;
 	errcallback.callback = conversion_error_callback;
 	errcallback.arg = (void *) &errpos;
 	errcallback.previous = error_context_stack;
@@ -3004,10 +4122,39 @@ static void
 conversion_error_callback(void *arg)
 {
 	ConversionLocation *errpos = (ConversionLocation *) arg;
-	TupleDesc	tupdesc = RelationGetDescr(errpos->rel);
 
-	if (errpos->cur_attno > 0 && errpos->cur_attno <= tupdesc->natts)
-		errcontext("column \"%s\" of foreign table \"%s\"",
-				   NameStr(tupdesc->attrs[errpos->cur_attno - 1]->attname),
-				   RelationGetRelationName(errpos->rel));
+	if (errpos->rel)
+	{
+		/* error occurred in a scan against a foreign table */
+		TupleDesc	tupdesc = RelationGetDescr(errpos->rel);
+
+		if (errpos->cur_attno > 0 && errpos->cur_attno <= tupdesc->natts)
+			errcontext("column \"%s\" of foreign table \"%s\"",
+					   NameStr(tupdesc->attrs[errpos->cur_attno - 1]->attname),
+					   RelationGetRelationName(errpos->rel));
+	}
+	else if (errpos->fsstate && errpos->cur_attno > 0)
+	{
+		/* error occurred in a scan against a foreign join */
+		ForeignScanState *fsstate = errpos->fsstate;
+		ForeignScan *fsplan = (ForeignScan *) fsstate->ss.ps.plan;
+		EState	   *estate = fsstate->ss.ps.state;
+		TargetEntry *tle;
+		Var		   *var;
+		RangeTblEntry *rte;
+
+		tle = (TargetEntry *) list_nth(fsplan->fdw_scan_tlist,
+									   errpos->cur_attno - 1);
+		var = (Var *) tle->expr;
+		Assert(IsA(var, Var));
+		rte = rt_fetch(var->varno, estate->es_range_table);
+
+		if (var->varattno == 0)
+			errcontext("whole-row reference to foreign table \"%s\"",
+					   get_rel_name(rte->relid));
+		else
+			errcontext("column \"%s\" of foreign table \"%s\"",
+					   get_relid_attribute_name(rte->relid, var->varattno),
+					   get_rel_name(rte->relid));
+	}
 }
@@ -203,8 +203,8 @@ EXPLAIN (VERBOSE, COSTS false) SELECT * FROM ft1 t1 WHERE c6 = E'foo''s\\bar';
 EXPLAIN (VERBOSE, COSTS false) SELECT * FROM ft1 t1 WHERE c8 = 'foo';  -- can't be sent to remote
 -- parameterized remote path
 EXPLAIN (VERBOSE, COSTS false)
-  SELECT * FROM ft2 a, ft2 b WHERE a.c1 = 47 AND b.c1 = a.c2;
-SELECT * FROM ft2 a, ft2 b WHERE a.c1 = 47 AND b.c1 = a.c2;
+  SELECT * FROM "S 1"."T 1" a, ft2 b WHERE a."C 1" = 47 AND b.c1 = a.c2;
+SELECT * FROM "S 1"."T 1" a, ft2 b WHERE a."C 1" = 47 AND b.c1 = a.c2;
 -- check both safe and unsafe join conditions
 EXPLAIN (VERBOSE, COSTS false)
   SELECT * FROM ft2 a, ft2 b
@@ -215,6 +215,30 @@ WHERE a.c2 = 6 AND b.c1 = a.c1 AND a.c8 = 'foo' AND b.c7 = upper(a.c7);
 SELECT * FROM ft1 WHERE c1 = ANY (ARRAY(SELECT c1 FROM ft2 WHERE c1 < 5));
 SELECT * FROM ft2 WHERE c1 = ANY (ARRAY(SELECT c1 FROM ft1 WHERE c1 < 5));
 
+-- ===================================================================
+-- JOIN queries
+-- ===================================================================
+-- join between two foreign tables on the same server is pushed down
+EXPLAIN (VERBOSE, COSTS false)
+SELECT t1.c1, t2.c1 FROM ft1 t1 JOIN ft2 t2 ON (t1.c1 = t2.c1) ORDER BY t1.c3, t1.c1 OFFSET 100 LIMIT 10;
+SELECT t1.c1, t2.c1 FROM ft1 t1 JOIN ft2 t2 ON (t1.c1 = t2.c1) ORDER BY t1.c3, t1.c1 OFFSET 100 LIMIT 10;
+-- left outer join
+EXPLAIN (VERBOSE, COSTS false)
+SELECT t1.c1, t2.c1 FROM ft1 t1 LEFT JOIN ft2 t2 ON (t1.c1 = t2.c1 AND t2.c1 < 10) ORDER BY t1.c1 OFFSET 5 LIMIT 10;
+SELECT t1.c1, t2.c1 FROM ft1 t1 LEFT JOIN ft2 t2 ON (t1.c1 = t2.c1 AND t2.c1 < 10) ORDER BY t1.c1 OFFSET 5 LIMIT 10;
+-- full outer join
+EXPLAIN (VERBOSE, COSTS false)
+SELECT t1.c1, t2.c1 FROM ft1 t1 FULL JOIN ft2 t2 ON (t1.c1 = t2.c1) ORDER BY t1.c1, t2.c1 OFFSET 100 LIMIT 10;
+SELECT t1.c1, t2.c1 FROM ft1 t1 FULL JOIN ft2 t2 ON (t1.c1 = t2.c1) ORDER BY t1.c1, t2.c1 OFFSET 100 LIMIT 10;
+-- join with a condition that can't be sent to remote; it is applied locally
+EXPLAIN (VERBOSE, COSTS false)
+SELECT t1.c1, t2.c1 FROM ft1 t1 JOIN ft2 t2 ON (t1.c1 = t2.c1) WHERE t1.c8 = t2.c8 ORDER BY t1.c3, t1.c1 OFFSET 100 LIMIT 10;
+SELECT t1.c1, t2.c1 FROM ft1 t1 JOIN ft2 t2 ON (t1.c1 = t2.c1) WHERE t1.c8 = t2.c8 ORDER BY t1.c3, t1.c1 OFFSET 100 LIMIT 10;
+-- whole-row references
+EXPLAIN (VERBOSE, COSTS false)
+SELECT t1, t2 FROM ft1 t1 JOIN ft2 t2 ON (t1.c1 = t2.c1) ORDER BY t1.c1 OFFSET 100 LIMIT 10;
+SELECT t1, t2 FROM ft1 t1 JOIN ft2 t2 ON (t1.c1 = t2.c1) ORDER BY t1.c1 OFFSET 100 LIMIT 10;
+
 -- ===================================================================
 -- parameterized queries
 -- ===================================================================
@@ -848,3 +872,50 @@ DROP TYPE "Colors" CASCADE;
 IMPORT FOREIGN SCHEMA import_source LIMIT TO (t5)
   FROM SERVER loopback INTO import_dest5;  -- ERROR
 ROLLBACK;
+
+-- ===================================================================
+-- test batched inserts
+-- ===================================================================
+CREATE TABLE batch_table (x int);
+CREATE FOREIGN TABLE ftable (x int) SERVER loopback
+  OPTIONS (table_name 'batch_table', batch_size '10');
+EXPLAIN (VERBOSE, COSTS OFF) INSERT INTO ftable VALUES (1);
+EXPLAIN (VERBOSE, COSTS OFF) INSERT INTO ftable VALUES (1) RETURNING x;
+INSERT INTO ftable SELECT * FROM generate_series(1, 10) i;
+INSERT INTO ftable SELECT * FROM generate_series(11, 31) i;
+INSERT INTO ftable VALUES (32);
+SELECT count(*), sum(x) FROM ftable;
+-- a partial batch is flushed at the end of the statement; the rows are only
+-- visible through the remote transaction until it commits
+BEGIN;
+INSERT INTO ftable SELECT * FROM generate_series(33, 37) i;
+SELECT count(*) FROM ftable;
+SELECT count(*) FROM batch_table;
+ROLLBACK;
+DROP FOREIGN TABLE ftable;
+DROP TABLE batch_table;
+
+-- ===================================================================
+-- test asynchronous foreign scans
+-- ===================================================================
+CREATE TABLE async_pt (a int, b text);
+CREATE TABLE base_tbl1 (a int, b text);
+CREATE TABLE base_tbl2 (a int, b text);
+CREATE FOREIGN TABLE async_p1 () INHERITS (async_pt)
+  SERVER loopback OPTIONS (table_name 'base_tbl1', async_capable 'true');
+CREATE FOREIGN TABLE async_p2 () INHERITS (async_pt)
+  SERVER loopback OPTIONS (table_name 'base_tbl2', async_capable 'true');
+-- more rows than one FETCH returns, so that prefetching kicks in
+INSERT INTO base_tbl1 SELECT i, to_char(i, 'FM0000') FROM generate_series(1000, 1299) i;
+INSERT INTO base_tbl2 SELECT i, to_char(i, 'FM0000') FROM generate_series(2000, 2299) i;
+SELECT count(*), sum(a) FROM async_pt;
+SELECT * FROM async_pt WHERE a % 100 = 0 ORDER BY a;
+-- scans ended early leave a FETCH in flight, which must be drained
+SELECT a FROM async_p1 LIMIT 3;
+SELECT count(*) FROM async_p2;
+BEGIN;
+SELECT a FROM async_p2 LIMIT 1;
+SELECT count(*) FROM async_p1;
+COMMIT;
+DROP FOREIGN TABLE async_p1, async_p2;
+DROP TABLE async_pt, base_tbl1, base_tbl2;
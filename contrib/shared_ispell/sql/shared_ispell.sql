@@ -53,4 +53,10 @@ SELECT stop_name, words FROM shared_ispell_stoplists();
 SELECT shared_ispell_reset();
 
 SELECT ts_lexize('shared_ispell', 'skies');
-SELECT ts_lexize('shared_hunspell', 'skies');
\ No newline at end of file
+SELECT ts_lexize('shared_hunspell', 'skies');
+
+-- Another session maps the images loaded by this one
+\c
+SELECT ts_lexize('shared_ispell', 'bookings');
+SELECT ts_lexize('shared_hunspell', 'footballyklubber');
+SELECT dict_name, affix_name, words, affixes FROM shared_ispell_dicts();
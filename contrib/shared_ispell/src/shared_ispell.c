@@ -30,16 +30,30 @@
  *              -> NIStartBuild
  *              -> NIImportDictionary
  *              -> NIImportAffixes
+ *              -> read_image (compiled word list, if up to date)
+ *              -> NIStartBuild
+ *              -> NIImportDictionary
  *              -> NISortDictionary
- *              -> NISortAffixes
  *              -> NIFinishBuild
- *              -> sizeIspellDict
- *              -> copyIspellDict
- *                  -> copySPNode
+ *              -> build_image
+ *                  -> sizeIspellDict
+ *                  -> copyIspellDict
+ *                      -> copySPNode
+ *              -> write_image
+ *              -> map_image / copy_image
+ *                  -> relocateIspellDict
+ *              -> NISortAffixes
  *          -> get_shared_stop_list
  *              -> readstoplist
  *              -> copyStopList
  *
+ * The word list is compiled into an image (see ImageHeader), stored in the
+ * IMAGE_DIR directory, so the dictionary is parsed only once and not again
+ * after a restart or a reset (unless the source files change). With
+ * shared_ispell.max_mapped_size > 0 the image is not copied into the shared
+ * segment, but relocated into a file that all the backends map read-only at
+ * the same address (within an area reserved by the postmaster).
+ *
  * ===== dictionary reinit after reset (backend) =====
  *
  * dispell_lexize
@@ -50,7 +64,15 @@
 */
 
 #include "postgres.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef EXEC_BACKEND
+#include <sys/mman.h>
+#endif
+
 #include "miscadmin.h"
+#include "storage/fd.h"
 #include "storage/ipc.h"
 
 #include "commands/defrem.h"
@@ -70,12 +92,40 @@ void _PG_fini(void);
 /* Memory for dictionaries in kbytes */
 static int max_ispell_mem_size_kb;
 
+/* Address space for mapped dictionaries in kbytes */
+static int max_mapped_size_kb;
+
+/*
+ * Address range reserved by the postmaster for the mapped images (NULL if
+ * disabled). The backends inherit it, so the images are mapped at the same
+ * address everywhere.
+ */
+static char *mapped_area = NULL;
+
+/* Images mapped by this backend since the last reset */
+static Timestamp mapped_reset = 0;
+static Size *mapped_offsets = NULL;
+static int nmapped = 0;
+static int maxmapped = 0;
+
 /* Saved hook values in case of unload */
 static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 
 /* These are used to allocate data within shared segment */
 static SegmentInfo *segment_info = NULL;
 
+/* Area the copy methods allocate from (shared segment or an image) */
+static AllocArea *alloc_area = NULL;
+
+/* Pointer relocation of an image (see relocateIspellDict) */
+typedef struct Relocation
+{
+	char	   *image;			/* image in local memory */
+	Size		size;
+	Size		from;			/* current base of the pointers */
+	Size		to;				/* new base of the pointers */
+} Relocation;
+
 static void ispell_shmem_startup(void);
 
 static char *shalloc(int bytes);
@@ -87,6 +137,9 @@ static SharedStopList *copyStopList(StopList *list, char *stopFile, int bytes);
 static int sizeIspellDict(IspellDict *dict, char *dictFile, char *affixFile);
 static int sizeStopList(StopList *list, char *stopFile);
 
+static void relocateIspellDict(SharedIspellDict *shdict, Relocation *reloc);
+static void remove_mapped_files(void);
+
 /*
  * Get memory for dictionaries in bytes
  */
@@ -96,6 +149,15 @@ max_ispell_mem_size()
 	return (Size)max_ispell_mem_size_kb * 1024L;
 }
 
+/*
+ * Get address space for mapped dictionaries in bytes
+ */
+static Size
+max_mapped_size()
+{
+	return (Size)max_mapped_size_kb * 1024L;
+}
+
 /*
  * Module load callback
  */
@@ -124,8 +186,43 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	/* How much address space to reserve for the mapped dictionaries (zero
+	 * means the dictionaries are copied into the shared segment). */
+	DefineCustomIntVariable("shared_ispell.max_mapped_size",
+							"address space to reserve for mapped ispell dictionaries",
+							NULL,
+							&max_mapped_size_kb,
+							1024 * 1024,		/* default 1GB */
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
 	EmitWarningsOnPlaceholders("shared_ispell");
 
+#ifndef EXEC_BACKEND
+	/*
+	 * Reserve the address range for the mapped images. It's only address
+	 * space (no memory is allocated), and the backends inherit it so that
+	 * the pointers within the images are valid in all of them.
+	 */
+	if (max_mapped_size() > 0)
+	{
+		mapped_area = mmap(NULL, max_mapped_size(), PROT_NONE,
+						   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (mapped_area == MAP_FAILED)
+		{
+			ereport(LOG,
+					(errmsg("could not reserve %zu B for mapped ispell dictionaries: %m",
+							max_mapped_size())));
+			mapped_area = NULL;
+		}
+	}
+#endif
+
 	/*
 	 * Request additional shared resources.  (These are no-ops if we're not in
 	 * the postmaster process.)  We'll allocate or attach to the shared
@@ -191,13 +288,18 @@ ispell_shmem_startup()
 		#else
 		segment_info->lock  = LWLockAssign();
 		#endif
-		segment_info->firstfree = segment + MAXALIGN(sizeof(SegmentInfo));
-		segment_info->available = max_ispell_mem_size()
-			- (int)(segment_info->firstfree - segment);
+		segment_info->area.firstfree = segment + MAXALIGN(sizeof(SegmentInfo));
+		segment_info->area.available = max_ispell_mem_size()
+			- (int)(segment_info->area.firstfree - segment);
 
 		segment_info->lastReset = GetCurrentTimestamp();
+
+		/* mapped files of the previous run are useless, the images are kept */
+		remove_mapped_files();
 	}
 
+	alloc_area = &segment_info->area;
+
 	LWLockRelease(AddinShmemInitLock);
 }
 
@@ -271,6 +373,371 @@ clean_dict_affix(IspellDict *dict)
 	dict->avail = 0;
 }
 
+/*
+ * Builds path of the image compiled from the given dictionary / affixes.
+ */
+static void
+image_path(char *path, char *dictFile, char *affFile)
+{
+	snprintf(path, MAXPGPATH, IMAGE_DIR "/%s.%s.image", dictFile, affFile);
+}
+
+/*
+ * Fills identity of the source files into the image header, so that we can
+ * recognize images compiled from an older version of the files.
+ */
+static void
+source_identity(ImageHeader *hdr, char *dictFile, char *affFile)
+{
+	struct stat	st;
+	char	   *path;
+
+	memset(hdr, 0, sizeof(ImageHeader));
+
+	hdr->magic = IMAGE_MAGIC;
+	hdr->version = IMAGE_VERSION;
+	hdr->ptrsize = sizeof(void *);
+
+	path = get_tsearch_config_filename(dictFile, "dict");
+	if (stat(path, &st) == 0)
+	{
+		hdr->dictSize = st.st_size;
+		hdr->dictMtime = st.st_mtime;
+	}
+
+	path = get_tsearch_config_filename(affFile, "affix");
+	if (stat(path, &st) == 0)
+	{
+		hdr->affixSize = st.st_size;
+		hdr->affixMtime = st.st_mtime;
+	}
+}
+
+/*
+ * Reads a compiled image, but only if it matches the expected identity of the
+ * source files. Returns NULL if there's no such (usable) image.
+ */
+static char *
+read_image(char *path, ImageHeader *expect)
+{
+	int			fd;
+	ImageHeader	hdr;
+	char	   *image;
+
+	fd = OpenTransientFile(path, O_RDONLY | PG_BINARY, 0);
+	if (fd < 0)
+	{
+		if (errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", path)));
+		return NULL;
+	}
+
+	if (read(fd, &hdr, sizeof(ImageHeader)) != sizeof(ImageHeader) ||
+		hdr.magic != expect->magic ||
+		hdr.version != expect->version ||
+		hdr.ptrsize != expect->ptrsize ||
+		hdr.base != 0 ||
+		hdr.size < MAXALIGN(sizeof(ImageHeader)) + sizeof(SharedIspellDict) ||
+		hdr.dictSize != expect->dictSize ||
+		hdr.dictMtime != expect->dictMtime ||
+		hdr.affixSize != expect->affixSize ||
+		hdr.affixMtime != expect->affixMtime)
+	{
+		CloseTransientFile(fd);
+		return NULL;
+	}
+
+	image = palloc(hdr.size);
+	memcpy(image, &hdr, sizeof(ImageHeader));
+
+	if (read(fd, image + sizeof(ImageHeader), hdr.size - sizeof(ImageHeader))
+		!= hdr.size - sizeof(ImageHeader))
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", path)));
+		CloseTransientFile(fd);
+		pfree(image);
+		return NULL;
+	}
+
+	CloseTransientFile(fd);
+
+	return image;
+}
+
+/*
+ * Writes the image into a file (through a temporary file, so that neither
+ * the readers nor the backends mapping the file see a partial image).
+ *
+ * Returns false if the image could not be written (reported with elevel).
+ */
+static bool
+write_image(char *path, char *image, int elevel)
+{
+	int			fd;
+	char		tmppath[MAXPGPATH];
+	Size		size = ((ImageHeader *) image)->size;
+
+	snprintf(tmppath, MAXPGPATH, "%s.tmp", path);
+
+	fd = OpenTransientFile(tmppath, O_CREAT | O_TRUNC | O_WRONLY | PG_BINARY,
+						   S_IRUSR | S_IWUSR);
+	if (fd < 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", tmppath)));
+		return false;
+	}
+
+	if (write(fd, image, size) != size)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", tmppath)));
+		CloseTransientFile(fd);
+		unlink(tmppath);
+		return false;
+	}
+
+	CloseTransientFile(fd);
+
+	if (rename(tmppath, path) < 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						tmppath, path)));
+		unlink(tmppath);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Removes the mapped files (relocated copies of the images), which are only
+ * valid until the next reset.
+ */
+static void
+remove_mapped_files(void)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	char		path[MAXPGPATH];
+
+	if (mkdir(IMAGE_DIR, S_IRWXU) < 0 && errno != EEXIST)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m", IMAGE_DIR)));
+		return;
+	}
+
+	dir = AllocateDir(IMAGE_DIR);
+	while ((de = ReadDir(dir, IMAGE_DIR)) != NULL)
+	{
+		size_t	len = strlen(de->d_name);
+
+		if (len > 4 && strcmp(de->d_name + len - 4, ".map") == 0)
+		{
+			snprintf(path, MAXPGPATH, IMAGE_DIR "/%s", de->d_name);
+			unlink(path);
+		}
+	}
+	FreeDir(dir);
+}
+
+/*
+ * Compiles the parsed dictionary (word list) into an image, i.e. does the
+ * deep copy into local memory and makes the pointers relative to the image.
+ */
+static char *
+build_image(IspellDict *dict, char *dictFile, char *affFile,
+			ImageHeader *identity)
+{
+	Size		hdrsize = MAXALIGN(sizeof(ImageHeader));
+	int			size = sizeIspellDict(dict, dictFile, affFile);
+	char	   *image = palloc0(hdrsize + size);
+	AllocArea	area;
+	Relocation	reloc;
+
+	area.firstfree = image + hdrsize;
+	area.available = size;
+
+	alloc_area = &area;
+	copyIspellDict(dict, dictFile, affFile, size, dict->nspell);
+	alloc_area = &segment_info->area;
+
+	memcpy(image, identity, sizeof(ImageHeader));
+	((ImageHeader *) image)->size = hdrsize + size;
+
+	reloc.image = image;
+	reloc.size = hdrsize + size;
+	reloc.from = (Size) image;
+	reloc.to = 0;
+	relocateIspellDict((SharedIspellDict *) (image + hdrsize), &reloc);
+
+	return image;
+}
+
+/*
+ * Rebases all the pointers in an image (in local memory) to a new address.
+ */
+static SharedIspellDict *
+relocate_image(char *image, Size to)
+{
+	ImageHeader	   *hdr = (ImageHeader *) image;
+	Relocation		reloc;
+
+	reloc.image = image;
+	reloc.size = hdr->size;
+	reloc.from = hdr->base;
+	reloc.to = to;
+	relocateIspellDict((SharedIspellDict *) (image + MAXALIGN(sizeof(ImageHeader))),
+					   &reloc);
+
+	hdr->base = to;
+
+	return (SharedIspellDict *) (image + MAXALIGN(sizeof(ImageHeader)));
+}
+
+/*
+ * Copies the image into the shared segment (used when the images are not
+ * mapped).
+ */
+static SharedIspellDict *
+copy_image(char *image, char *dictFile, char *affFile)
+{
+	Size		hdrsize = MAXALIGN(sizeof(ImageHeader));
+	Size		size = ((ImageHeader *) image)->size - hdrsize;
+	char	   *copy;
+
+	if (size > segment_info->area.available)
+		elog(ERROR, "shared dictionary %s.dict / %s.affix needs %zu B, only %zu B available",
+			dictFile, affFile, size, segment_info->area.available);
+
+	copy = shalloc(size);
+
+	relocate_image(image, (Size) (copy - hdrsize));
+	memcpy(copy, image + hdrsize, size);
+
+	return (SharedIspellDict *) copy;
+}
+
+/*
+ * Makes sure the image of the dictionary is mapped in this backend. After
+ * a reset all the mapped images are dropped, as the offsets get reused.
+ */
+static void
+map_shared_dict(SharedIspellDict *shdict)
+{
+#ifndef EXEC_BACKEND
+	int		fd;
+	int		i;
+	char   *addr;
+
+	if (mapped_reset != segment_info->lastReset)
+	{
+		/* replace all the mappings with a fresh reservation */
+		if (mmap(mapped_area, max_mapped_size(), PROT_NONE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+				 -1, 0) == MAP_FAILED)
+			elog(ERROR, "could not reset mapped ispell dictionaries: %m");
+
+		nmapped = 0;
+		mapped_reset = segment_info->lastReset;
+	}
+
+	for (i = 0; i < nmapped; i++)
+		if (mapped_offsets[i] == shdict->mapOffset)
+			return;
+
+	if (nmapped == maxmapped)
+	{
+		maxmapped = (maxmapped > 0) ? 2 * maxmapped : 8;
+		if (mapped_offsets == NULL)
+			mapped_offsets = MemoryContextAlloc(TopMemoryContext,
+												maxmapped * sizeof(Size));
+		else
+			mapped_offsets = repalloc(mapped_offsets, maxmapped * sizeof(Size));
+	}
+
+	fd = OpenTransientFile(shdict->mapFile, O_RDONLY | PG_BINARY, 0);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", shdict->mapFile)));
+
+	addr = mmap(mapped_area + shdict->mapOffset, shdict->mapSize, PROT_READ,
+				MAP_SHARED | MAP_FIXED, fd, 0);
+
+	CloseTransientFile(fd);
+
+	if (addr == MAP_FAILED)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not map file \"%s\": %m", shdict->mapFile)));
+
+	mapped_offsets[nmapped++] = shdict->mapOffset;
+#else
+	elog(ERROR, "mapped ispell dictionaries are not supported");
+#endif
+}
+
+/*
+ * Relocates the image to the next free part of the mapped area, writes it
+ * into a file and maps it. Only a small descriptor is kept in the shared
+ * segment, the image itself is shared through the page cache.
+ */
+static SharedIspellDict *
+map_image(char *image, char *dictFile, char *affFile)
+{
+	ImageHeader	   *hdr = (ImageHeader *) image;
+	SharedIspellDict *imgdict;
+	SharedIspellDict *shdict;
+	Size		offset = segment_info->mapped;
+	Size		mapsize = TYPEALIGN(sysconf(_SC_PAGESIZE), hdr->size);
+	char		path[MAXPGPATH];
+	int			size;
+
+	if (mapsize > max_mapped_size() - offset)
+		elog(ERROR, "shared dictionary %s.dict / %s.affix needs %zu B, only %zu B of address space available",
+			 dictFile, affFile, mapsize, max_mapped_size() - offset);
+
+	snprintf(path, MAXPGPATH, IMAGE_DIR "/%zu.map", offset);
+
+	size = MAXALIGN(sizeof(SharedIspellDict)) + MAXALIGN(strlen(dictFile) + 1) +
+		MAXALIGN(strlen(affFile) + 1) + MAXALIGN(strlen(path) + 1);
+	if (size > segment_info->area.available)
+		elog(ERROR, "shared dictionary %s.dict / %s.affix needs %d B, only %zd B available",
+			dictFile, affFile, size, segment_info->area.available);
+
+	imgdict = relocate_image(image, (Size) (mapped_area + offset));
+	write_image(path, image, ERROR);
+
+	shdict = (SharedIspellDict *) shalloc(sizeof(SharedIspellDict));
+	memcpy(shdict, imgdict, sizeof(SharedIspellDict));
+
+	shdict->dictFile = shstrcpy(dictFile);
+	shdict->affixFile = shstrcpy(affFile);
+	shdict->mapFile = shstrcpy(path);
+	shdict->mapOffset = offset;
+	shdict->mapSize = hdr->size;
+	shdict->nbytes = hdr->size;
+	shdict->next = NULL;
+
+	map_shared_dict(shdict);
+
+	/* only claim the address range once the image is mapped */
+	segment_info->mapped += mapsize;
+
+	return shdict;
+}
+
 /*
  * Initializes the dictionary for use in backends - checks whether such dictionary
  * and list of stopwords is already used, and if not then parses it and loads it into
@@ -294,6 +761,12 @@ init_shared_dict(DictInfo *info, char *dictFile, char *affFile, char *stopFile)
 	IspellDict *dict;
 	StopList	stoplist;
 
+	ImageHeader	identity;
+	char		path[MAXPGPATH];
+	char	   *image;
+
+	alloc_area = &segment_info->area;
+
 	/* DICTIONARY + AFFIXES */
 
 	/* TODO This should probably check that the filenames are not NULL, and maybe that
@@ -311,6 +784,18 @@ init_shared_dict(DictInfo *info, char *dictFile, char *affFile, char *stopFile)
 
 	/* load the dictionary (word list) if not yet defined */
 	if (shdict == NULL)
+	{
+		/* the image compiled from the current source files, if any */
+		source_identity(&identity, dictFile, affFile);
+		image_path(path, dictFile, affFile);
+
+		image = read_image(path, &identity);
+	}
+	else
+		image = NULL;
+
+	/* otherwise parse the word list and compile it */
+	if (shdict == NULL && image == NULL)
 	{
 		dict = (IspellDict *) palloc0(sizeof(IspellDict));
 
@@ -345,22 +830,33 @@ init_shared_dict(DictInfo *info, char *dictFile, char *affFile, char *stopFile)
 		}
 
 		NISortDictionary(dict);
+
+		image = build_image(dict, dictFile, affFile, &identity);
 		NIFinishBuild(dict);
 
-		/* check available space in shared segment */
-		size = sizeIspellDict(dict, dictFile, affFile);
-		if (size > segment_info->available)
-			elog(ERROR, "shared dictionary %s.dict / %s.affix needs %d B, only %zd B available",
-				dictFile, affFile, size, segment_info->available);
+		/* failing to keep the image only means we'll parse it again */
+		write_image(path, image, LOG);
+	}
+
+	if (shdict == NULL)
+	{
+		/* map the image, or copy it into the shared segment */
+		if (mapped_area != NULL)
+			shdict = map_image(image, dictFile, affFile);
+		else
+			shdict = copy_image(image, dictFile, affFile);
+
+		pfree(image);
 
-		/* fine, there's enough space - copy the dictionary */
-		shdict = copyIspellDict(dict, dictFile, affFile, size, dict->nspell);
 		shdict->dict.naffixes = info->dict.naffixes;
 
 		/* add the new dictionary to the linked list (of SharedIspellDict structures) */
 		shdict->next = segment_info->shdict;
 		segment_info->shdict = shdict;
 	}
+	else if (shdict->mapSize > 0)
+		map_shared_dict(shdict);
+
 	/* continue load affix list to a current backend process */
 
 	/* NISortAffixes is used AffixData. Therefore we need to copy pointer */
@@ -385,9 +881,9 @@ init_shared_dict(DictInfo *info, char *dictFile, char *affFile, char *stopFile)
 			readstoplist(stopFile, &stoplist, lowerstr);
 
 			size = sizeStopList(&stoplist, stopFile);
-			if (size > segment_info->available)
+			if (size > segment_info->area.available)
 				elog(ERROR, "shared stoplist %s.stop needs %d B, only %zd B available",
-					stopFile, size, segment_info->available);
+					stopFile, size, segment_info->area.available);
 
 			/* fine, there's enough space - copy the stoplist */
 			shstop = copyStopList(&stoplist, stopFile, size);
@@ -438,15 +934,23 @@ PG_FUNCTION_INFO_V1(dispell_list_stoplists);
 Datum
 dispell_reset(PG_FUNCTION_ARGS)
 {
+	SharedIspellDict *shdict;
+
 	LWLockAcquire(segment_info->lock, LW_EXCLUSIVE);
 
+	/* backends still mapping the files keep them until they notice the reset */
+	for (shdict = segment_info->shdict; shdict != NULL; shdict = shdict->next)
+		if (shdict->mapSize > 0)
+			unlink(shdict->mapFile);
+
 	segment_info->shdict = NULL;
 	segment_info->shstop = NULL;
 	segment_info->lastReset = GetCurrentTimestamp();
-	segment_info->firstfree = ((char*) segment_info) + MAXALIGN(sizeof(SegmentInfo));
-	segment_info->available = max_ispell_mem_size() - (int)(segment_info->firstfree - (char*) segment_info);
+	segment_info->mapped = 0;
+	segment_info->area.firstfree = ((char*) segment_info) + MAXALIGN(sizeof(SegmentInfo));
+	segment_info->area.available = max_ispell_mem_size() - (int)(segment_info->area.firstfree - (char*) segment_info);
 
-	memset(segment_info->firstfree, 0, segment_info->available);
+	memset(segment_info->area.firstfree, 0, segment_info->area.available);
 
 	LWLockRelease(segment_info->lock);
 
@@ -462,7 +966,7 @@ dispell_mem_available(PG_FUNCTION_ARGS)
 	int result = 0;
 	LWLockAcquire(segment_info->lock, LW_SHARED);
 
-	result = segment_info->available;
+	result = segment_info->area.available;
 
 	LWLockRelease(segment_info->lock);
 
@@ -478,7 +982,7 @@ dispell_mem_used(PG_FUNCTION_ARGS)
 	int result = 0;
 	LWLockAcquire(segment_info->lock, LW_SHARED);
 
-	result = max_ispell_mem_size() - segment_info->available;
+	result = max_ispell_mem_size() - segment_info->area.available;
 
 	LWLockRelease(segment_info->lock);
 
@@ -638,9 +1142,10 @@ dispell_lexize(PG_FUNCTION_ARGS)
 }
 
 /*
- * This 'allocates' memory in the shared segment - i.e. the memory is
- * already allocated and this just gives nbytes to the caller. This is
- * used exclusively by the 'copy' methods defined below.
+ * This 'allocates' memory in the shared segment (or in an image being
+ * built, see alloc_area) - i.e. the memory is already allocated and this
+ * just gives nbytes to the caller. This is used exclusively by the 'copy'
+ * methods defined below.
  *
  * The memory is kept aligned thanks to MAXALIGN. Also, this assumes
  * the segment was locked properly by the caller.
@@ -654,12 +1159,12 @@ shalloc(int bytes)
 	/* This shouldn't really happen, as the init_shared_dict checks the size
 	 * prior to copy. So let's just throw error here, as something went
 	 * obviously wrong. */
-	if (bytes > segment_info->available)
+	if (bytes > alloc_area->available)
 		elog(ERROR, "the shared segment (shared ispell) is too small");
 
-	result = segment_info->firstfree;
-	segment_info->firstfree += bytes;
-	segment_info->available -= bytes;
+	result = alloc_area->firstfree;
+	alloc_area->firstfree += bytes;
+	alloc_area->available -= bytes;
 
 	memset(result, 0, bytes);
 
@@ -819,6 +1324,63 @@ sizeIspellDict(IspellDict *dict, char *dictFile, char *affixFile)
 	return size;
 }
 
+/*
+ * The following methods rebase the pointers within a copied dictionary, so
+ * that an image may be stored position independent and then used at the
+ * address it gets mapped (or copied) to. The image is walked in local memory,
+ * the pointers are rewritten to point to the new address.
+ */
+
+static void *
+relocatePointer(void **ptr, Relocation *reloc)
+{
+	Size	offset;
+
+	if (*ptr == NULL)
+		return NULL;
+
+	offset = (Size) *ptr - reloc->from;
+	if (offset > reloc->size)
+		elog(ERROR, "invalid pointer in ispell dictionary image");
+
+	*ptr = (void *) (reloc->to + offset);
+
+	return reloc->image + offset;
+}
+
+static void
+relocateSPNode(SPNode *node, Relocation *reloc)
+{
+	int		i;
+
+	for (i = 0; i < node->length; i++)
+	{
+		SPNode *child = relocatePointer((void **) &node->data[i].node, reloc);
+
+		if (child != NULL)
+			relocateSPNode(child, reloc);
+	}
+}
+
+static void
+relocateIspellDict(SharedIspellDict *shdict, Relocation *reloc)
+{
+	int		i;
+	SPNode *root;
+	char  **affixData;
+
+	relocatePointer((void **) &shdict->dictFile, reloc);
+	relocatePointer((void **) &shdict->affixFile, reloc);
+
+	root = relocatePointer((void **) &shdict->dict.Dictionary, reloc);
+	if (root != NULL)
+		relocateSPNode(root, reloc);
+
+	affixData = relocatePointer((void **) &shdict->dict.AffixData, reloc);
+	for (i = 0; i < shdict->dict.nAffixData; i++)
+		relocatePointer((void **) &affixData[i], reloc);
+}
+
 /* SRF function returning a list of shared dictionaries currently loaded in memory. */
 Datum
 dispell_list_dicts(PG_FUNCTION_ARGS)
@@ -13,6 +13,34 @@
 
 #define MAXLEN 255
 
+/* Directory (relative to the data directory) with compiled dictionaries */
+#define IMAGE_DIR		"pg_shared_ispell"
+
+#define IMAGE_MAGIC		0x49535045
+#define IMAGE_VERSION	1
+
+/*
+ * Header of a compiled dictionary (word list) image. The SharedIspellDict
+ * with all the data it references follows the header, and the pointers in it
+ * are stored relative to 'base' - zero for the images stored on disk (so
+ * they are position independent), the mapping address for the images mapped
+ * by the backends.
+ */
+typedef struct ImageHeader
+{
+	uint32	magic;
+	uint32	version;
+	uint32	ptrsize;
+	Size	size;				/* whole image, including the header */
+	Size	base;				/* address the pointers are relative to */
+
+	/* identity of the source files the image was compiled from */
+	off_t	dictSize;
+	pg_time_t dictMtime;
+	off_t	affixSize;
+	pg_time_t affixMtime;
+} ImageHeader;
+
 typedef struct SharedIspellDict
 {
 	/* this is used for selecting the dictionary */
@@ -21,6 +49,11 @@ typedef struct SharedIspellDict
 	int		nbytes;
 	int		nwords;
 
+	/* mapped image with the word list (mapSize is 0 if in the segment) */
+	char   *mapFile;
+	Size	mapOffset;
+	Size	mapSize;
+
 	/* next dictionary in the chain (essentially a linked list) */
 	struct SharedIspellDict *next;
 
@@ -37,12 +70,18 @@ typedef struct SharedStopList
 	StopList stop;
 } SharedStopList;
 
-/* used to allocate memory in the shared segment */
-typedef struct SegmentInfo
+/* used to allocate memory in the shared segment or in an image */
+typedef struct AllocArea
 {
-	LWLockId	lock;
 	char	   *firstfree;        /* first free address (always maxaligned) */
 	size_t		available;        /* free space remaining at firstfree */
+} AllocArea;
+
+typedef struct SegmentInfo
+{
+	LWLockId	lock;
+	AllocArea	area;             /* free space in the shared segment */
+	Size		mapped;           /* used part of the mapped area */
 	Timestamp	lastReset;        /* last reset of the dictionary */
 
 	/* the shared segment (info and data) */
@@ -18,10 +18,32 @@ SELECT * FROM test_table WHERE test_attr1 = _p(15);
 SELECT * FROM test_table WHERE test_attr1 = 10;
 SELECT * FROM test_table WHERE test_attr1 = 15;
 
+UPDATE sr_plans SET enable = false;
+SELECT * FROM test_table WHERE test_attr1 = _p(10);
+UPDATE sr_plans SET enable = true;
+SELECT * FROM test_table WHERE test_attr1 = _p(10);
+
 DROP TABLE test_table;
 CREATE TABLE test_table(test_attr1 int, test_attr2 int);
 
 SELECT * FROM test_table WHERE test_attr1 = _p(10);
 SELECT * FROM test_table WHERE test_attr1 = 10;
 SELECT * FROM test_table WHERE test_attr1 = 10;
-SELECT * FROM test_table WHERE test_attr1 = 15;
\ No newline at end of file
+SELECT * FROM test_table WHERE test_attr1 = 15;
+-- FROM ONLY and result column names are part of the saved query
+CREATE TABLE test_parent(a int);
+CREATE TABLE test_child() INHERITS (test_parent);
+INSERT INTO test_parent VALUES (1);
+INSERT INTO test_child VALUES (2);
+
+SET sr_plan.write_mode = true;
+SELECT * FROM test_parent ORDER BY a;
+SET sr_plan.write_mode = false;
+UPDATE sr_plans SET enable = true;
+
+SELECT * FROM test_parent ORDER BY a;
+SELECT * FROM ONLY test_parent ORDER BY a;
+SELECT a AS b FROM test_parent ORDER BY a;
+
+DROP TABLE test_child;
+DROP TABLE test_parent;
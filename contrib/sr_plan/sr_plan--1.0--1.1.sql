@@ -0,0 +1,11 @@
+/* contrib/sr_plan/sr_plan--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION sr_plan UPDATE TO '1.1'" to load this file. \quit
+
+CREATE FUNCTION sr_plan_invalidate_cache() RETURNS trigger
+	AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE TRIGGER sr_plans_invalidate_cache
+	AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON sr_plans
+	FOR EACH STATEMENT EXECUTE PROCEDURE sr_plan_invalidate_cache();
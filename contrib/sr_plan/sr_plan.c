@@ -1,5 +1,8 @@
 #include "sr_plan.h"
 #include "commands/event_trigger.h"
+#include "commands/trigger.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
 
 PG_MODULE_MAGIC;
 
@@ -25,6 +28,25 @@ void walker_callback(void *node);
 static Oid sr_plan_fake_func = 0;
 static Oid dropped_objects_func = 0;
 
+/* Upper bound of cached queries, the cache is just emptied beyond it */
+#define SR_PLAN_CACHE_SIZE 1024
+
+/*
+ * Entry of backend local cache of saved plans keyed by query hash. Queries
+ * without enabled plan are cached too, so most of them do not touch
+ * sr_plans at all. The cache is emptied on any change of sr_plans, which
+ * sr_plans_invalidate_cache trigger reports through relcache invalidation.
+ */
+typedef struct SrPlanCacheEntry
+{
+	int			query_hash;		/* hash key */
+	Jsonb	   *plan;			/* enabled saved plan or NULL if none */
+} SrPlanCacheEntry;
+
+static HTAB *sr_plan_cache = NULL;
+static MemoryContext sr_plan_cache_context = NULL;
+static Oid sr_plans_oid = InvalidOid;
+
 struct QueryParams
 {
 	int location;
@@ -34,6 +56,109 @@ struct QueryParams
 List *query_params;
 const char *query_text;
 
+/* Forget all cached plans */
+static void
+sr_plan_cache_reset(void)
+{
+	if (sr_plan_cache_context != NULL)
+		MemoryContextReset(sr_plan_cache_context);
+	sr_plan_cache = NULL;
+	sr_plans_oid = InvalidOid;
+}
+
+/*
+ * Look up query hash in cache. Return false on cache miss, otherwise set
+ * *plan to a copy of the saved plan or to NULL if the query has none.
+ */
+static bool
+sr_plan_cache_lookup(int query_hash, Jsonb **plan)
+{
+	SrPlanCacheEntry *entry;
+
+	if (sr_plan_cache == NULL)
+		return false;
+
+	entry = (SrPlanCacheEntry *) hash_search(sr_plan_cache, &query_hash,
+											 HASH_FIND, NULL);
+	if (entry == NULL)
+		return false;
+
+	/* copy the plan, the cache may be reset while it is deserialized */
+	*plan = NULL;
+	if (entry->plan != NULL)
+	{
+		*plan = (Jsonb *) palloc(VARSIZE(entry->plan));
+		memcpy(*plan, entry->plan, VARSIZE(entry->plan));
+	}
+	return true;
+}
+
+/* Remember saved plan (or its absence) of query found in sr_plans */
+static void
+sr_plan_cache_store(int query_hash, Jsonb *plan, Oid relid)
+{
+	SrPlanCacheEntry *entry;
+	bool		found;
+
+	if (sr_plan_cache_context == NULL)
+		sr_plan_cache_context = AllocSetContextCreate(CacheMemoryContext,
+													  "sr_plan cache",
+													  ALLOCSET_DEFAULT_MINSIZE,
+													  ALLOCSET_DEFAULT_INITSIZE,
+													  ALLOCSET_DEFAULT_MAXSIZE);
+
+	if (sr_plan_cache != NULL &&
+		hash_get_num_entries(sr_plan_cache) >= SR_PLAN_CACHE_SIZE)
+		sr_plan_cache_reset();
+
+	if (sr_plan_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(int);
+		ctl.entrysize = sizeof(SrPlanCacheEntry);
+		ctl.hcxt = sr_plan_cache_context;
+		sr_plan_cache = hash_create("sr_plan cache", 256, &ctl,
+									HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+	sr_plans_oid = relid;
+
+	entry = (SrPlanCacheEntry *) hash_search(sr_plan_cache, &query_hash,
+											 HASH_ENTER, &found);
+	entry->plan = NULL;
+	if (plan != NULL)
+	{
+		entry->plan = (Jsonb *) MemoryContextAlloc(sr_plan_cache_context,
+												   VARSIZE(plan));
+		memcpy(entry->plan, plan, VARSIZE(plan));
+	}
+}
+
+/* Relcache callback: sr_plans was changed or dropped */
+static void
+sr_plan_relcache_callback(Datum arg, Oid relid)
+{
+	if (relid == InvalidOid || relid == sr_plans_oid)
+		sr_plan_cache_reset();
+}
+
+/* Syscache callback: _p() may be recreated with another oid */
+static void
+sr_plan_proc_callback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	if (!sr_plan_fake_func)
+		return;
+
+	if (hashvalue == 0 ||
+		hashvalue == GetSysCacheHashValue1(PROCOID,
+										   ObjectIdGetDatum(sr_plan_fake_func)))
+	{
+		sr_plan_fake_func = 0;
+		sr_plan_cache_reset();
+	}
+}
+
 void sr_analyze(ParseState *pstate, Query *query)
 {
 	query_text = pstate->p_sourcetext;
@@ -44,7 +169,6 @@ PlannedStmt *sr_planner(Query *parse,
 						ParamListInfo boundParams)
 {
 	PlannedStmt *pl_stmt;
-	Jsonb *out_jsonb;
 	Jsonb *out_jsonb2;
 	int query_hash;
 	RangeVar *sr_plans_table_rv;
@@ -71,15 +195,26 @@ PlannedStmt *sr_planner(Query *parse,
 		Oid args[1] = {ANYELEMENTOID};
 		sr_plan_fake_func = LookupFuncName(list_make1(makeString("_p")), 1, args, true);
 	}
-	
-	
-	out_jsonb = node_tree_to_jsonb(parse, sr_plan_fake_func, true);
-	query_hash = DatumGetInt32(DirectFunctionCall1(jsonb_hash, PointerGetDatum(out_jsonb)));
-	
+
+	query_hash = query_fingerprint(parse, sr_plan_fake_func);
+
 	query_params = NULL;
 	/* Make list with all _p functions and his position */
 	sr_query_walker((Query *)parse, NULL);
 
+	/* Only cache misses have to look into sr_plans */
+	if (!sr_plan_write_mode && sr_plan_cache_lookup(query_hash, &out_jsonb2))
+	{
+		if (out_jsonb2 == NULL)
+			return standard_planner(parse, cursorOptions, boundParams);
+
+		elog(WARNING, "Ok we find saved plan.");
+		if (query_params != NULL)
+			return jsonb_to_node_tree(out_jsonb2, &replace_fake);
+		else
+			return jsonb_to_node_tree(out_jsonb2, NULL);
+	}
+
 	sr_plans_table_rv = makeRangeVar("public", "sr_plans", -1);
 	sr_plans_heap = heap_openrv(sr_plans_table_rv, heap_lock);
 
@@ -195,7 +330,11 @@ PlannedStmt *sr_planner(Query *parse,
 	{
 		pl_stmt = standard_planner(parse, cursorOptions, boundParams);
 	}
-	
+
+	if (!sr_plan_write_mode)
+		sr_plan_cache_store(query_hash, find_ok ? out_jsonb2 : NULL,
+							RelationGetRelid(sr_plans_heap));
+
 	index_close(query_index_rel, heap_lock);
 	heap_close(sr_plans_heap, heap_lock);
 	return pl_stmt;
@@ -273,6 +412,9 @@ void _PG_init(void) {
 
 	planner_hook = &sr_planner;
 	post_parse_analyze_hook = &sr_analyze;
+
+	CacheRegisterRelcacheCallback(sr_plan_relcache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(PROCOID, sr_plan_proc_callback, (Datum) 0);
 }
 
 void _PG_fini(void) {
@@ -475,6 +617,8 @@ sr_plan_invalid_table(PG_FUNCTION_ARGS)
 					newtuple = heap_modify_tuple(local_tuple, RelationGetDescr(sr_plans_heap),
 										 search_values, search_nulls, search_replaces);
 					simple_heap_update(sr_plans_heap, &newtuple->t_self, newtuple);
+					/* let backends drop the plan from their caches */
+					CacheInvalidateRelcache(sr_plans_heap);
 				}
 			}
 		}
@@ -484,3 +628,23 @@ sr_plan_invalid_table(PG_FUNCTION_ARGS)
 
 	PG_RETURN_NULL();
 }
+
+
+PG_FUNCTION_INFO_V1(sr_plan_invalidate_cache);
+
+/*
+ * Statement trigger on sr_plans: plans enabled, disabled or removed by hand
+ * must not be served from caches of backends any more.
+ */
+Datum
+sr_plan_invalidate_cache(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))  /* internal error */
+		elog(ERROR, "not fired by trigger manager");
+
+	CacheInvalidateRelcache(trigdata->tg_relation);
+
+	PG_RETURN_POINTER(NULL);
+}
@@ -33,5 +33,6 @@
 Jsonb *node_tree_to_jsonb(const void *obj, Oid fake_func, bool skip_location_from_node);
 void *jsonb_to_node_tree(Jsonb *json, void *(*hookPtr) (void *));
 void common_walker(const void *obj, void (*callback) (void *));
+int query_fingerprint(Query *query, Oid fake_func);
 
 #endif
\ No newline at end of file
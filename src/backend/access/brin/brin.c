@@ -27,6 +27,7 @@
 #include "catalog/index.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "utils/memutils.h"
@@ -34,6 +35,9 @@
 #include "utils/snapmgr.h"
 
 
+/* a "page range" argument meaning all of them */
+#define BRIN_ALL_BLOCKRANGES	InvalidBlockNumber
+
 /*
  * We use a BrinBuildState during initial construction of a BRIN index.
  * The running state is kept in a BrinMemTuple.
@@ -63,7 +67,7 @@ typedef struct BrinOpaque
 static BrinBuildState *initialize_brin_buildstate(Relation idxRel,
 						   BrinRevmap *revmap, BlockNumber pagesPerRange);
 static void terminate_brin_buildstate(BrinBuildState *state);
-static void brinsummarize(Relation index, Relation heapRel,
+static void brinsummarize(Relation index, Relation heapRel, BlockNumber pageRange,
 			  double *numSummarized, double *numExisting);
 static void form_and_insert_tuple(BrinBuildState *state);
 static void union_tuples(BrinDesc *bdesc, BrinMemTuple *a,
@@ -78,7 +82,11 @@ static void brin_vacuum_scan(Relation idxrel, BufferAccessStrategy strategy);
  * the summary tuple, we need to update the index tuple.
  *
  * If the range is not currently summarized (i.e. the revmap returns NULL for
- * it), there's nothing to do.
+ * it), there's nothing to do for this tuple.
+ *
+ * If the autosummarize option is set and this is the first tuple inserted in
+ * the first block of a page range, the previous range has presumably been
+ * filled up; if it is not summarized yet, ask autovacuum to do it.
  */
 Datum
 brininsert(PG_FUNCTION_ARGS)
@@ -90,6 +98,8 @@ brininsert(PG_FUNCTION_ARGS)
 
 	/* we ignore the rest of our arguments */
 	BlockNumber pagesPerRange;
+	BlockNumber origHeapBlk;
+	BlockNumber heapBlk;
 	BrinDesc   *bdesc = NULL;
 	BrinRevmap *revmap;
 	Buffer		buf = InvalidBuffer;
@@ -98,20 +108,47 @@ brininsert(PG_FUNCTION_ARGS)
 
 	revmap = brinRevmapInitialize(idxRel, &pagesPerRange);
 
+	origHeapBlk = ItemPointerGetBlockNumber(heaptid);
+	/* normalize the block number to be the first block in the range */
+	heapBlk = (origHeapBlk / pagesPerRange) * pagesPerRange;
+
+	if (BrinGetAutoSummarize(idxRel) &&
+		heapBlk > 0 &&
+		heapBlk == origHeapBlk &&
+		ItemPointerGetOffsetNumber(heaptid) == FirstOffsetNumber)
+	{
+		BlockNumber lastPageRange = heapBlk - 1;
+		BrinTuple  *lastPageTuple;
+		OffsetNumber off;
+
+		lastPageTuple = brinGetTupleForHeapBlock(revmap, lastPageRange,
+												 &buf, &off, NULL,
+												 BUFFER_LOCK_SHARE);
+		if (!lastPageTuple)
+		{
+			if (!AutoVacuumRequestWork(AVW_BRINSummarizeRange,
+									   RelationGetRelid(idxRel),
+									   lastPageRange))
+				ereport(LOG,
+						(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+						 errmsg("request for BRIN range summarization for index \"%s\" page %u was not recorded",
+								RelationGetRelationName(idxRel),
+								lastPageRange)));
+		}
+		else
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+	}
+
 	for (;;)
 	{
 		bool		need_insert = false;
 		OffsetNumber off;
 		BrinTuple  *brtup;
 		BrinMemTuple *dtup;
-		BlockNumber heapBlk;
 		int			keyno;
 
 		CHECK_FOR_INTERRUPTS();
 
-		heapBlk = ItemPointerGetBlockNumber(heaptid);
-		/* normalize the block number to be the first block in the range */
-		heapBlk = (heapBlk / pagesPerRange) * pagesPerRange;
 		brtup = brinGetTupleForHeapBlock(revmap, heapBlk, &buf, &off, NULL,
 										 BUFFER_LOCK_SHARE);
 
@@ -739,7 +776,7 @@ brinvacuumcleanup(PG_FUNCTION_ARGS)
 
 	brin_vacuum_scan(info->index, info->strategy);
 
-	brinsummarize(info->index, heapRel,
+	brinsummarize(info->index, heapRel, BRIN_ALL_BLOCKRANGES,
 				  &stats->num_index_tuples, &stats->num_index_tuples);
 
 	heap_close(heapRel, AccessShareLock);
@@ -759,7 +796,8 @@ brinoptions(PG_FUNCTION_ARGS)
 	BrinOptions *rdopts;
 	int			numoptions;
 	static const relopt_parse_elt tab[] = {
-		{"pages_per_range", RELOPT_TYPE_INT, offsetof(BrinOptions, pagesPerRange)}
+		{"pages_per_range", RELOPT_TYPE_INT, offsetof(BrinOptions, pagesPerRange)},
+		{"autosummarize", RELOPT_TYPE_BOOL, offsetof(BrinOptions, autosummarize)}
 	};
 
 	options = parseRelOptions(reloptions, validate, RELOPT_KIND_BRIN,
@@ -785,13 +823,40 @@ brinoptions(PG_FUNCTION_ARGS)
  */
 Datum
 brin_summarize_new_values(PG_FUNCTION_ARGS)
+{
+	Datum		relation = PG_GETARG_DATUM(0);
+
+	return DirectFunctionCall2(brin_summarize_range,
+							   relation,
+							   Int64GetDatum((int64) BRIN_ALL_BLOCKRANGES));
+}
+
+/*
+ * SQL-callable function to summarize the indicated page range, if not already
+ * summarized.  If the second argument is BRIN_ALL_BLOCKRANGES, all
+ * unsummarized ranges are summarized.
+ */
+Datum
+brin_summarize_range(PG_FUNCTION_ARGS)
 {
 	Oid			indexoid = PG_GETARG_OID(0);
+	int64		heapBlk64 = PG_GETARG_INT64(1);
+	BlockNumber heapBlk;
 	Oid			heapoid;
 	Relation	indexRel;
 	Relation	heapRel;
 	double		numSummarized = 0;
 
+	if (heapBlk64 > BRIN_ALL_BLOCKRANGES || heapBlk64 < 0)
+	{
+		char	   *blk = psprintf(INT64_FORMAT, heapBlk64);
+
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("block number out of range: %s", blk)));
+	}
+	heapBlk = (BlockNumber) heapBlk64;
+
 	/*
 	 * We must lock table before index to avoid deadlocks.  However, if the
 	 * passed indexoid isn't an index then IndexGetRelation() will fail.
@@ -831,7 +896,7 @@ brin_summarize_new_values(PG_FUNCTION_ARGS)
 						RelationGetRelationName(indexRel))));
 
 	/* OK, do it */
-	brinsummarize(indexRel, heapRel, &numSummarized, NULL);
+	brinsummarize(indexRel, heapRel, heapBlk, &numSummarized, NULL);
 
 	relation_close(indexRel, ShareUpdateExclusiveLock);
 	relation_close(heapRel, ShareUpdateExclusiveLock);
@@ -1058,34 +1123,52 @@ summarize_range(IndexInfo *indexInfo, BrinBuildState *state, Relation heapRel,
 }
 
 /*
- * Scan a complete BRIN index, and summarize each page range that's not already
- * summarized.  The index and heap must have been locked by caller in at
- * least ShareUpdateExclusiveLock mode.
+ * Summarize page ranges that are not already summarized.  If pageRange is
+ * BRIN_ALL_BLOCKRANGES then the whole table is scanned; otherwise, only the
+ * page range containing the given heap page number is processed.  The index
+ * and heap must have been locked by caller in at least
+ * ShareUpdateExclusiveLock mode.
  *
  * For each new index tuple inserted, *numSummarized (if not NULL) is
  * incremented; for each existing tuple, *numExisting (if not NULL) is
  * incremented.
  */
 static void
-brinsummarize(Relation index, Relation heapRel, double *numSummarized,
-			  double *numExisting)
+brinsummarize(Relation index, Relation heapRel, BlockNumber pageRange,
+			  double *numSummarized, double *numExisting)
 {
 	BrinRevmap *revmap;
 	BrinBuildState *state = NULL;
 	IndexInfo  *indexInfo = NULL;
 	BlockNumber heapNumBlocks;
 	BlockNumber heapBlk;
+	BlockNumber startBlk;
 	BlockNumber pagesPerRange;
 	Buffer		buf;
 
 	revmap = brinRevmapInitialize(index, &pagesPerRange);
 
+	/* determine range of pages to process */
+	heapNumBlocks = RelationGetNumberOfBlocks(heapRel);
+	if (pageRange == BRIN_ALL_BLOCKRANGES)
+		startBlk = 0;
+	else
+	{
+		startBlk = (pageRange / pagesPerRange) * pagesPerRange;
+		/* nothing to do if start point is beyond end of table */
+		if (startBlk >= heapNumBlocks)
+		{
+			brinRevmapTerminate(revmap);
+			return;
+		}
+		heapNumBlocks = Min(heapNumBlocks, startBlk + pagesPerRange);
+	}
+
 	/*
 	 * Scan the revmap to find unsummarized items.
 	 */
 	buf = InvalidBuffer;
-	heapNumBlocks = RelationGetNumberOfBlocks(heapRel);
-	for (heapBlk = 0; heapBlk < heapNumBlocks; heapBlk += pagesPerRange)
+	for (heapBlk = startBlk; heapBlk < heapNumBlocks; heapBlk += pagesPerRange)
 	{
 		BrinTuple  *tup;
 		OffsetNumber off;
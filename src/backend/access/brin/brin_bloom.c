@@ -0,0 +1,451 @@
+/*
+ * brin_bloom.c
+ *		Implementation of Bloom opclass for BRIN
+ *
+ * The Bloom opclasses summarize each page range as a Bloom filter built from
+ * the hashes of the values in the range.  Unlike minmax, the summary does not
+ * depend on the values being correlated with the physical order of the rows,
+ * so it remains useful for equality searches on columns such as random
+ * identifiers, where every minmax range would end up covering almost the
+ * whole domain.  The price is that only equality searches can be supported,
+ * and that a small fraction of ranges is returned despite not containing the
+ * value being looked for.
+ *
+ * The filter is sized when the first value of a range is added, from the
+ * number of tuples a range of pages_per_range heap pages can hold: we assume
+ * that at most BLOOM_NDISTINCT_FRACTION of those are distinct and aim for a
+ * false positive rate of BLOOM_FALSE_POSITIVE_RATE.  The filters are clamped
+ * so that the summary tuple always fits comfortably on an index page; with
+ * the default pages_per_range that means accepting a somewhat higher false
+ * positive rate for ranges that are full of distinct values.
+ *
+ * Each opclass provides the hash function of its data type as an additional
+ * support procedure.  The 32-bit hash is turned into the bit positions using
+ * enhanced double hashing, so only one call to the hash function is needed
+ * per value, no matter how many bits are set.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/brin/brin_bloom.c
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/brin.h"
+#include "access/brin_internal.h"
+#include "access/brin_tuple.h"
+#include "access/genam.h"
+#include "access/hash.h"
+#include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "catalog/pg_type.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+
+
+/*
+ * Additional SQL level support function.
+ *
+ * Procedure numbers must not use values reserved for BRIN itself; see
+ * brin_internal.h.  The hash function takes a single argument, so it cannot
+ * share its number with any of the two-argument procedures of the other
+ * opclasses either.
+ */
+#define		PROCNUM_HASH			15	/* required */
+
+/* The only strategy we support */
+#define		BloomEqualStrategyNumber	1
+
+/*
+ * Sizing parameters: the fraction of the maximum number of tuples in a page
+ * range that we expect to be distinct values, the false positive rate to aim
+ * for, and the limits on the number of hash functions and the size of the
+ * filter.
+ */
+#define		BLOOM_NDISTINCT_FRACTION	0.1
+#define		BLOOM_MIN_NDISTINCT			16
+#define		BLOOM_FALSE_POSITIVE_RATE	0.01
+#define		BLOOM_MAX_NHASHES			32
+#define		BLOOM_MAX_FILTER_BYTES		(BLCKSZ / 2)
+
+/* Seeds used to derive the two independent hashes from the type's hash */
+#define		BLOOM_SEED_1	0x71d924af
+#define		BLOOM_SEED_2	0xba48b2ae
+
+/*
+ * The summary stored in the index tuple.  This is a varlena, so it must
+ * always be accessed after detoasting (the tuple code may give it a short
+ * header).
+ */
+typedef struct BloomFilter
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	uint16		nhashes;		/* number of bits set for each value */
+	uint32		nbits;			/* size of the bitmap, in bits */
+	char		data[FLEXIBLE_ARRAY_MEMBER];	/* the bitmap */
+} BloomFilter;
+
+typedef struct BloomOpaque
+{
+	Oid			cached_subtype;
+	FmgrInfo	subtype_hash_procinfo;
+} BloomOpaque;
+
+Datum		brin_bloom_opcinfo(PG_FUNCTION_ARGS);
+Datum		brin_bloom_add_value(PG_FUNCTION_ARGS);
+Datum		brin_bloom_consistent(PG_FUNCTION_ARGS);
+Datum		brin_bloom_union(PG_FUNCTION_ARGS);
+static BloomFilter *bloom_init(BrinDesc *bdesc);
+static bool bloom_add_hash(BloomFilter *filter, uint32 hash);
+static bool bloom_contains_hash(BloomFilter *filter, uint32 hash);
+static FmgrInfo *bloom_get_subtype_hash_procinfo(BrinDesc *bdesc,
+								uint16 attno, Oid subtype);
+
+
+Datum
+brin_bloom_opcinfo(PG_FUNCTION_ARGS)
+{
+	BrinOpcInfo *result;
+
+	/*
+	 * The summary is a single bytea value, whatever the indexed type.
+	 * opaque->subtype_hash_procinfo is initialized lazily; here it is set to
+	 * uninitialized by palloc0 which sets fn_oid to InvalidOid.
+	 */
+	result = palloc0(MAXALIGN(SizeofBrinOpcInfo(1)) + sizeof(BloomOpaque));
+	result->oi_nstored = 1;
+	result->oi_opaque = (BloomOpaque *)
+		MAXALIGN((char *) result + SizeofBrinOpcInfo(1));
+	result->oi_typcache[0] = lookup_type_cache(BYTEAOID, 0);
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Add the hash of the given value to the filter of the page range.  Return
+ * true if any bit of the filter had to be set, false if the filter already
+ * contained all of them (in which case the index tuple needs no update).
+ */
+Datum
+brin_bloom_add_value(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum		newval = PG_GETARG_DATUM(2);
+	bool		isnull = PG_GETARG_DATUM(3);
+	Oid			colloid = PG_GET_COLLATION();
+	FmgrInfo   *hashFn;
+	uint32		hash;
+	BloomFilter *filter;
+	bool		updated = false;
+
+	/*
+	 * If the new value is null, we record that we saw it if it's the first
+	 * one; otherwise, there's nothing to do.
+	 */
+	if (isnull)
+	{
+		if (column->bv_hasnulls)
+			PG_RETURN_BOOL(false);
+
+		column->bv_hasnulls = true;
+		PG_RETURN_BOOL(true);
+	}
+
+	/* If this is the first non-null value, we need to create the filter */
+	if (column->bv_allnulls)
+	{
+		filter = bloom_init(bdesc);
+		column->bv_allnulls = false;
+		updated = true;
+	}
+	else
+		filter = (BloomFilter *) PG_DETOAST_DATUM(column->bv_values[0]);
+
+	hashFn = index_getprocinfo(bdesc->bd_index, column->bv_attno,
+							   PROCNUM_HASH);
+	hash = DatumGetUInt32(FunctionCall1Coll(hashFn, colloid, newval));
+
+	updated |= bloom_add_hash(filter, hash);
+
+	column->bv_values[0] = PointerGetDatum(filter);
+
+	PG_RETURN_BOOL(updated);
+}
+
+/*
+ * Given an index tuple corresponding to a certain page range and a scan key,
+ * return whether the scan key is consistent with the filter of the range.
+ * Return true if so, false otherwise.
+ */
+Datum
+brin_bloom_consistent(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	ScanKey		key = (ScanKey) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION();
+	AttrNumber	attno;
+	BloomFilter *filter;
+	FmgrInfo   *finfo;
+	uint32		hash;
+
+	Assert(key->sk_attno == column->bv_attno);
+
+	/* handle IS NULL/IS NOT NULL tests */
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+		{
+			if (column->bv_allnulls || column->bv_hasnulls)
+				PG_RETURN_BOOL(true);
+			PG_RETURN_BOOL(false);
+		}
+
+		/*
+		 * For IS NOT NULL, we can only skip ranges that are known to have
+		 * only nulls.
+		 */
+		if (key->sk_flags & SK_SEARCHNOTNULL)
+			PG_RETURN_BOOL(!column->bv_allnulls);
+
+		/*
+		 * Neither IS NULL nor IS NOT NULL was used; assume all indexable
+		 * operators are strict and return false.
+		 */
+		PG_RETURN_BOOL(false);
+	}
+
+	/* if the range is all empty, it cannot possibly be consistent */
+	if (column->bv_allnulls)
+		PG_RETURN_BOOL(false);
+
+	if (key->sk_strategy != BloomEqualStrategyNumber)
+		elog(ERROR, "invalid strategy number %d", key->sk_strategy);
+
+	/*
+	 * The value in the scan key may be of a different type than the indexed
+	 * column, in which case it must be hashed by the hash function of its own
+	 * type.  The opfamily guarantees that the hashes of equal values match.
+	 */
+	attno = key->sk_attno;
+	if (key->sk_subtype == InvalidOid ||
+		key->sk_subtype == bdesc->bd_tupdesc->attrs[attno - 1]->atttypid)
+		finfo = index_getprocinfo(bdesc->bd_index, attno, PROCNUM_HASH);
+	else
+		finfo = bloom_get_subtype_hash_procinfo(bdesc, attno,
+												key->sk_subtype);
+
+	hash = DatumGetUInt32(FunctionCall1Coll(finfo, colloid,
+											key->sk_argument));
+
+	filter = (BloomFilter *) PG_DETOAST_DATUM(column->bv_values[0]);
+
+	PG_RETURN_BOOL(bloom_contains_hash(filter, hash));
+}
+
+/*
+ * Given two BrinValues, update the first of them as a union of the summary
+ * values contained in both.  The second one is untouched.
+ */
+Datum
+brin_bloom_union(PG_FUNCTION_ARGS)
+{
+	BrinValues *col_a = (BrinValues *) PG_GETARG_POINTER(1);
+	BrinValues *col_b = (BrinValues *) PG_GETARG_POINTER(2);
+	BloomFilter *filter_a;
+	BloomFilter *filter_b;
+	uint32		nbytes;
+	uint32		i;
+
+	Assert(col_a->bv_attno == col_b->bv_attno);
+
+	/* Adjust "hasnulls" */
+	if (!col_a->bv_hasnulls && col_b->bv_hasnulls)
+		col_a->bv_hasnulls = true;
+
+	/* If there are no values in B, there's nothing left to do */
+	if (col_b->bv_allnulls)
+		PG_RETURN_VOID();
+
+	filter_b = (BloomFilter *) PG_DETOAST_DATUM(col_b->bv_values[0]);
+
+	/*
+	 * Adjust "allnulls".  If A doesn't have values, just copy the filter from
+	 * B into A, and we're done.
+	 */
+	if (col_a->bv_allnulls)
+	{
+		col_a->bv_allnulls = false;
+		col_a->bv_values[0] = PointerGetDatum(palloc(VARSIZE(filter_b)));
+		memcpy(DatumGetPointer(col_a->bv_values[0]), filter_b,
+			   VARSIZE(filter_b));
+		PG_RETURN_VOID();
+	}
+
+	filter_a = (BloomFilter *) PG_DETOAST_DATUM(col_a->bv_values[0]);
+	nbytes = (filter_a->nbits + 7) / 8;
+
+	if (filter_a->nbits == filter_b->nbits &&
+		filter_a->nhashes == filter_b->nhashes)
+	{
+		for (i = 0; i < nbytes; i++)
+			filter_a->data[i] |= filter_b->data[i];
+	}
+	else
+	{
+		/*
+		 * The filters were sized differently, which can only happen if
+		 * pages_per_range was changed while the range was being summarized.
+		 * The bits cannot be combined, so make A match every value; the
+		 * range will be summarized properly when it's next rebuilt.
+		 */
+		memset(filter_a->data, 0xFF, nbytes);
+	}
+
+	col_a->bv_values[0] = PointerGetDatum(filter_a);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Create an empty filter for a page range of the given index.
+ */
+static BloomFilter *
+bloom_init(BrinDesc *bdesc)
+{
+	BloomFilter *filter;
+	double		ndistinct;
+	double		nbits;
+	int			nbytes;
+	int			maxbytes;
+	int			nhashes;
+	Size		len;
+
+	ndistinct = (double) MaxHeapTuplesPerPage *
+		BrinGetPagesPerRange(bdesc->bd_index) * BLOOM_NDISTINCT_FRACTION;
+	ndistinct = Max(ndistinct, BLOOM_MIN_NDISTINCT);
+
+	/* optimal filter size for the false positive rate, m = -n ln(p) / ln(2)^2 */
+	nbits = ceil(-ndistinct * log(BLOOM_FALSE_POSITIVE_RATE) /
+				 (log(2.0) * log(2.0)));
+
+	/*
+	 * Index tuples are not compressed or toasted, so the filters of all the
+	 * columns have to share the space.
+	 */
+	maxbytes = BLOOM_MAX_FILTER_BYTES / bdesc->bd_tupdesc->natts -
+		offsetof(BloomFilter, data);
+	nbytes = (int) Min((nbits + 7) / 8, maxbytes);
+	nbits = nbytes * 8;
+
+	/* and the optimal number of hash functions for it, k = m/n ln(2) */
+	nhashes = (int) rint(nbits / ndistinct * log(2.0));
+	nhashes = Max(1, Min(nhashes, BLOOM_MAX_NHASHES));
+
+	len = offsetof(BloomFilter, data) + nbytes;
+	filter = (BloomFilter *) palloc0(len);
+	SET_VARSIZE(filter, len);
+	filter->nhashes = nhashes;
+	filter->nbits = (uint32) nbits;
+
+	return filter;
+}
+
+/*
+ * Set the bits of the filter corresponding to the given hash, and return
+ * whether any of them was not set before.
+ *
+ * The bit positions are computed by enhanced double hashing (Dillinger and
+ * Manolios), from two independent hashes derived from the given one.
+ */
+static bool
+bloom_add_hash(BloomFilter *filter, uint32 hash)
+{
+	uint32		h1,
+				h2;
+	int			i;
+	bool		updated = false;
+
+	h1 = DatumGetUInt32(hash_uint32(hash ^ BLOOM_SEED_1)) % filter->nbits;
+	h2 = DatumGetUInt32(hash_uint32(hash ^ BLOOM_SEED_2)) % filter->nbits;
+
+	for (i = 0; i < filter->nhashes; i++)
+	{
+		uint32		byte = h1 / 8;
+		uint32		bit = h1 % 8;
+
+		if (!(filter->data[byte] & (0x01 << bit)))
+		{
+			filter->data[byte] |= (0x01 << bit);
+			updated = true;
+		}
+
+		h1 = (h1 + h2) % filter->nbits;
+		h2 = (h2 + i) % filter->nbits;
+	}
+
+	return updated;
+}
+
+/*
+ * Return whether all the bits of the filter corresponding to the given hash
+ * are set, that is, whether the value may have been added to it.
+ */
+static bool
+bloom_contains_hash(BloomFilter *filter, uint32 hash)
+{
+	uint32		h1,
+				h2;
+	int			i;
+
+	h1 = DatumGetUInt32(hash_uint32(hash ^ BLOOM_SEED_1)) % filter->nbits;
+	h2 = DatumGetUInt32(hash_uint32(hash ^ BLOOM_SEED_2)) % filter->nbits;
+
+	for (i = 0; i < filter->nhashes; i++)
+	{
+		uint32		byte = h1 / 8;
+		uint32		bit = h1 % 8;
+
+		if (!(filter->data[byte] & (0x01 << bit)))
+			return false;
+
+		h1 = (h1 + h2) % filter->nbits;
+		h2 = (h2 + i) % filter->nbits;
+	}
+
+	return true;
+}
+
+/*
+ * Cache and return the hash procedure for a cross-type scan key.
+ */
+static FmgrInfo *
+bloom_get_subtype_hash_procinfo(BrinDesc *bdesc, uint16 attno, Oid subtype)
+{
+	BloomOpaque *opaque;
+
+	opaque = (BloomOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	if (opaque->cached_subtype != subtype ||
+		opaque->subtype_hash_procinfo.fn_oid == InvalidOid)
+	{
+		Oid			opfamily;
+		RegProcedure procid;
+
+		opfamily = bdesc->bd_index->rd_opfamily[attno - 1];
+		procid = get_opfamily_proc(opfamily, subtype, subtype, PROCNUM_HASH);
+		if (!RegProcedureIsValid(procid))
+			elog(ERROR, "missing support function %d(%u,%u) in opfamily %u",
+				 PROCNUM_HASH, subtype, subtype, opfamily);
+
+		fmgr_info_cxt(procid, &opaque->subtype_hash_procinfo,
+					  bdesc->bd_context);
+		opaque->cached_subtype = subtype;
+	}
+
+	return &opaque->subtype_hash_procinfo;
+}
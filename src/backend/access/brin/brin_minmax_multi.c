@@ -0,0 +1,755 @@
+/*
+ * brin_minmax_multi.c
+ *		Implementation of Multi Min/Max opclass for BRIN
+ *
+ * The regular minmax opclasses summarize a page range with a single
+ * [min, max] interval, which works well as long as the values are correlated
+ * with the physical order of the rows.  A few outliers in a range, such as
+ * rows updated long after they were loaded, are enough to widen the interval
+ * until it no longer excludes anything.  This opclass instead keeps a small
+ * sorted list of disjoint intervals for each range, so that outliers only
+ * cost an interval of their own.
+ *
+ * New values start out as single-point intervals.  When the list grows past
+ * MINMAX_MULTI_MAX_RANGES, the two adjacent intervals with the smallest gap
+ * between them are merged, which requires a "distance" support procedure
+ * returning the gap between two values as a float8.  The list is stored as a
+ * bytea holding the boundaries one after another; only fixed-length data
+ * types are supported.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/brin/brin_minmax_multi.c
+ */
+#include "postgres.h"
+
+#include "access/brin_internal.h"
+#include "access/brin_tuple.h"
+#include "access/genam.h"
+#include "access/stratnum.h"
+#include "access/tupmacs.h"
+#include "catalog/pg_amop.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+
+
+/*
+ * Additional SQL level support function
+ *
+ * Procedure numbers must not use values reserved for BRIN itself; see
+ * brin_internal.h.
+ */
+#define		PROCNUM_DISTANCE		11	/* required */
+
+/* maximum number of intervals kept for a page range */
+#define		MINMAX_MULTI_MAX_RANGES	16
+
+/*
+ * The summary stored in the index tuple: nranges intervals, each stored as
+ * its minimum followed by its maximum, in ascending order.  The values are
+ * stored unaligned, so they must be copied out before use.
+ */
+typedef struct SerializedRanges
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int32		nranges;		/* number of intervals */
+	char		data[FLEXIBLE_ARRAY_MEMBER];	/* the boundaries */
+} SerializedRanges;
+
+/*
+ * The in-memory representation: values[2 * i] and values[2 * i + 1] are the
+ * minimum and maximum of the i-th interval.
+ */
+typedef struct Ranges
+{
+	int			nranges;		/* number of intervals */
+	int			maxranges;		/* allocated size of values, in intervals */
+	Datum		values[FLEXIBLE_ARRAY_MEMBER];
+} Ranges;
+
+typedef struct MinmaxMultiOpaque
+{
+	MemoryContext tmpcxt;		/* for the deserialized lists */
+	Oid			cached_subtype;
+	FmgrInfo	strategy_procinfos[BTMaxStrategyNumber];
+} MinmaxMultiOpaque;
+
+Datum		brin_minmax_multi_opcinfo(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_add_value(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_consistent(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_union(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_int2(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_int4(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_int8(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_float4(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_float8(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_date(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_timestamp(PG_FUNCTION_ARGS);
+static Ranges *ranges_allocate(int maxranges);
+static Datum ranges_serialize(Ranges *ranges, Form_pg_attribute attr);
+static Ranges *ranges_deserialize(Datum value, Form_pg_attribute attr,
+				   int extraranges);
+static void ranges_reduce(BrinDesc *bdesc, AttrNumber attno, Oid colloid,
+			  Ranges *ranges);
+static MemoryContext minmax_multi_get_tmpcxt(BrinDesc *bdesc, uint16 attno);
+static FmgrInfo *minmax_multi_get_strategy_procinfo(BrinDesc *bdesc,
+								   uint16 attno, Oid subtype,
+								   uint16 strategynum);
+
+
+Datum
+brin_minmax_multi_opcinfo(PG_FUNCTION_ARGS)
+{
+	Oid			typoid = PG_GETARG_OID(0);
+	BrinOpcInfo *result;
+
+	if (get_typlen(typoid) <= 0)
+		elog(ERROR, "minmax-multi opclasses do not support variable-length type %u",
+			 typoid);
+
+	/*
+	 * The summary is a single bytea value, whatever the indexed type.
+	 * opaque->tmpcxt and opaque->strategy_procinfos are initialized lazily;
+	 * here they are set to uninitialized by palloc0, which sets fn_oid to
+	 * InvalidOid.
+	 */
+	result = palloc0(MAXALIGN(SizeofBrinOpcInfo(1)) +
+					 sizeof(MinmaxMultiOpaque));
+	result->oi_nstored = 1;
+	result->oi_opaque = (MinmaxMultiOpaque *)
+		MAXALIGN((char *) result + SizeofBrinOpcInfo(1));
+	result->oi_typcache[0] = lookup_type_cache(BYTEAOID, 0);
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Examine the given index tuple (which contains partial status of a certain
+ * page range) by comparing it to the given value that comes from another heap
+ * tuple.  If the new value is not covered by any of the intervals of the
+ * existing tuple, add it and return true.  Otherwise, return false and do not
+ * modify in this case.
+ */
+Datum
+brin_minmax_multi_add_value(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum		newval = PG_GETARG_DATUM(2);
+	bool		isnull = PG_GETARG_DATUM(3);
+	Oid			colloid = PG_GET_COLLATION();
+	FmgrInfo   *ltFn;
+	FmgrInfo   *gtFn;
+	Form_pg_attribute attr;
+	AttrNumber	attno;
+	Ranges	   *ranges;
+	MemoryContext tmpcxt;
+	MemoryContext oldcxt;
+	int			lo,
+				hi;
+
+	/*
+	 * If the new value is null, we record that we saw it if it's the first
+	 * one; otherwise, there's nothing to do.
+	 */
+	if (isnull)
+	{
+		if (column->bv_hasnulls)
+			PG_RETURN_BOOL(false);
+
+		column->bv_hasnulls = true;
+		PG_RETURN_BOOL(true);
+	}
+
+	attno = column->bv_attno;
+	attr = bdesc->bd_tupdesc->attrs[attno - 1];
+
+	/*
+	 * If the recorded value is null, store the new value as a single-point
+	 * interval, and we're done.
+	 */
+	if (column->bv_allnulls)
+	{
+		ranges = ranges_allocate(1);
+		ranges->nranges = 1;
+		ranges->values[0] = ranges->values[1] = newval;
+		column->bv_values[0] = ranges_serialize(ranges, attr);
+		column->bv_allnulls = false;
+		PG_RETURN_BOOL(true);
+	}
+
+	/*
+	 * This is called for every heap tuple during index builds, without any
+	 * memory being reset in between, so work in our own temporary context.
+	 */
+	tmpcxt = minmax_multi_get_tmpcxt(bdesc, attno);
+	oldcxt = MemoryContextSwitchTo(tmpcxt);
+
+	ranges = ranges_deserialize(column->bv_values[0], attr, 1);
+
+	/*
+	 * Binary search for the first interval whose maximum is not less than the
+	 * new value.  If the new value is not less than its minimum either, it's
+	 * already covered.
+	 */
+	ltFn = minmax_multi_get_strategy_procinfo(bdesc, attno, attr->atttypid,
+											  BTLessStrategyNumber);
+	gtFn = minmax_multi_get_strategy_procinfo(bdesc, attno, attr->atttypid,
+											  BTGreaterStrategyNumber);
+	lo = 0;
+	hi = ranges->nranges;
+	while (lo < hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (DatumGetBool(FunctionCall2Coll(gtFn, colloid, newval,
+										   ranges->values[2 * mid + 1])))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < ranges->nranges &&
+		!DatumGetBool(FunctionCall2Coll(ltFn, colloid, newval,
+										ranges->values[2 * lo])))
+	{
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextReset(tmpcxt);
+		PG_RETURN_BOOL(false);
+	}
+
+	/* Insert a new single-point interval at that position */
+	Assert(ranges->nranges < ranges->maxranges);
+	memmove(&ranges->values[2 * lo + 2], &ranges->values[2 * lo],
+			sizeof(Datum) * 2 * (ranges->nranges - lo));
+	ranges->values[2 * lo] = ranges->values[2 * lo + 1] = newval;
+	ranges->nranges++;
+
+	ranges_reduce(bdesc, attno, colloid, ranges);
+
+	MemoryContextSwitchTo(oldcxt);
+	pfree(DatumGetPointer(column->bv_values[0]));
+	column->bv_values[0] = ranges_serialize(ranges, attr);
+	MemoryContextReset(tmpcxt);
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * Given an index tuple corresponding to a certain page range and a scan key,
+ * return whether the scan key is consistent with the index tuple's intervals.
+ * Return true if so, false otherwise.
+ */
+Datum
+brin_minmax_multi_consistent(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	ScanKey		key = (ScanKey) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION(),
+				subtype;
+	AttrNumber	attno;
+	Datum		value;
+	Datum		matches;
+	FmgrInfo   *finfo;
+	Ranges	   *ranges;
+	int			i;
+
+	Assert(key->sk_attno == column->bv_attno);
+
+	/* handle IS NULL/IS NOT NULL tests */
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+		{
+			if (column->bv_allnulls || column->bv_hasnulls)
+				PG_RETURN_BOOL(true);
+			PG_RETURN_BOOL(false);
+		}
+
+		/*
+		 * For IS NOT NULL, we can only skip ranges that are known to have
+		 * only nulls.
+		 */
+		if (key->sk_flags & SK_SEARCHNOTNULL)
+			PG_RETURN_BOOL(!column->bv_allnulls);
+
+		/*
+		 * Neither IS NULL nor IS NOT NULL was used; assume all indexable
+		 * operators are strict and return false.
+		 */
+		PG_RETURN_BOOL(false);
+	}
+
+	/* if the range is all empty, it cannot possibly be consistent */
+	if (column->bv_allnulls)
+		PG_RETURN_BOOL(false);
+
+	attno = key->sk_attno;
+	subtype = key->sk_subtype;
+	value = key->sk_argument;
+	ranges = ranges_deserialize(column->bv_values[0],
+								bdesc->bd_tupdesc->attrs[attno - 1], 0);
+
+	switch (key->sk_strategy)
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+			/* only the overall minimum matters */
+			finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+													   key->sk_strategy);
+			matches = FunctionCall2Coll(finfo, colloid, ranges->values[0],
+										value);
+			break;
+		case BTEqualStrategyNumber:
+
+			/*
+			 * In the equality case (WHERE col = someval), we want to return
+			 * the current page range if any of its intervals has minimum <=
+			 * scan key and maximum >= scan key.  The intervals are sorted,
+			 * so we can stop at the first one whose minimum is greater.
+			 */
+			matches = BoolGetDatum(false);
+			for (i = 0; i < ranges->nranges; i++)
+			{
+				finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+												  BTLessEqualStrategyNumber);
+				if (!DatumGetBool(FunctionCall2Coll(finfo, colloid,
+													ranges->values[2 * i],
+													value)))
+					break;
+
+				finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+											   BTGreaterEqualStrategyNumber);
+				if (DatumGetBool(FunctionCall2Coll(finfo, colloid,
+												   ranges->values[2 * i + 1],
+												   value)))
+				{
+					matches = BoolGetDatum(true);
+					break;
+				}
+			}
+			break;
+		case BTGreaterEqualStrategyNumber:
+		case BTGreaterStrategyNumber:
+			/* only the overall maximum matters */
+			finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+													   key->sk_strategy);
+			matches = FunctionCall2Coll(finfo, colloid,
+							   ranges->values[2 * ranges->nranges - 1], value);
+			break;
+		default:
+			/* shouldn't happen */
+			elog(ERROR, "invalid strategy number %d", key->sk_strategy);
+			matches = 0;
+			break;
+	}
+
+	PG_RETURN_DATUM(matches);
+}
+
+/*
+ * Given two BrinValues, update the first of them as a union of the summary
+ * values contained in both.  The second one is untouched.
+ */
+Datum
+brin_minmax_multi_union(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *col_a = (BrinValues *) PG_GETARG_POINTER(1);
+	BrinValues *col_b = (BrinValues *) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION();
+	AttrNumber	attno;
+	Form_pg_attribute attr;
+	FmgrInfo   *ltFn;
+	FmgrInfo   *gtFn;
+	Ranges	   *ranges_a;
+	Ranges	   *ranges_b;
+	Ranges	   *merged;
+	MemoryContext tmpcxt;
+	MemoryContext oldcxt;
+	int			ia,
+				ib;
+
+	Assert(col_a->bv_attno == col_b->bv_attno);
+
+	/* Adjust "hasnulls" */
+	if (!col_a->bv_hasnulls && col_b->bv_hasnulls)
+		col_a->bv_hasnulls = true;
+
+	/* If there are no values in B, there's nothing left to do */
+	if (col_b->bv_allnulls)
+		PG_RETURN_VOID();
+
+	attno = col_a->bv_attno;
+	attr = bdesc->bd_tupdesc->attrs[attno - 1];
+
+	/*
+	 * Adjust "allnulls".  If A doesn't have values, just copy the values from
+	 * B into A, and we're done.  We cannot run the operators in this case,
+	 * because values in A might contain garbage.  Note we already established
+	 * that B contains values.
+	 */
+	if (col_a->bv_allnulls)
+	{
+		col_a->bv_allnulls = false;
+		col_a->bv_values[0] = datumCopy(col_b->bv_values[0], false, -1);
+		PG_RETURN_VOID();
+	}
+
+	tmpcxt = minmax_multi_get_tmpcxt(bdesc, attno);
+	oldcxt = MemoryContextSwitchTo(tmpcxt);
+
+	ranges_a = ranges_deserialize(col_a->bv_values[0], attr, 0);
+	ranges_b = ranges_deserialize(col_b->bv_values[0], attr, 0);
+	merged = ranges_allocate(ranges_a->nranges + ranges_b->nranges);
+
+	ltFn = minmax_multi_get_strategy_procinfo(bdesc, attno, attr->atttypid,
+											  BTLessStrategyNumber);
+	gtFn = minmax_multi_get_strategy_procinfo(bdesc, attno, attr->atttypid,
+											  BTGreaterStrategyNumber);
+
+	/*
+	 * Merge both lists in order of their minimums, coalescing each interval
+	 * with the previous one if they overlap.
+	 */
+	ia = ib = 0;
+	while (ia < ranges_a->nranges || ib < ranges_b->nranges)
+	{
+		Datum	   *next;
+
+		if (ib >= ranges_b->nranges ||
+			(ia < ranges_a->nranges &&
+			 !DatumGetBool(FunctionCall2Coll(ltFn, colloid,
+											 ranges_b->values[2 * ib],
+											 ranges_a->values[2 * ia]))))
+			next = &ranges_a->values[2 * ia++];
+		else
+			next = &ranges_b->values[2 * ib++];
+
+		if (merged->nranges > 0 &&
+			!DatumGetBool(FunctionCall2Coll(gtFn, colloid, next[0],
+								merged->values[2 * merged->nranges - 1])))
+		{
+			if (DatumGetBool(FunctionCall2Coll(gtFn, colloid, next[1],
+								merged->values[2 * merged->nranges - 1])))
+				merged->values[2 * merged->nranges - 1] = next[1];
+		}
+		else
+		{
+			merged->values[2 * merged->nranges] = next[0];
+			merged->values[2 * merged->nranges + 1] = next[1];
+			merged->nranges++;
+		}
+	}
+
+	ranges_reduce(bdesc, attno, colloid, merged);
+
+	MemoryContextSwitchTo(oldcxt);
+	pfree(DatumGetPointer(col_a->bv_values[0]));
+	col_a->bv_values[0] = ranges_serialize(merged, attr);
+	MemoryContextReset(tmpcxt);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Allocate an empty interval list with room for the given number of
+ * intervals.
+ */
+static Ranges *
+ranges_allocate(int maxranges)
+{
+	Ranges	   *ranges;
+
+	ranges = palloc(offsetof(Ranges, values) + sizeof(Datum) * 2 * maxranges);
+	ranges->nranges = 0;
+	ranges->maxranges = maxranges;
+
+	return ranges;
+}
+
+/*
+ * Build the on-disk representation of an interval list.
+ */
+static Datum
+ranges_serialize(Ranges *ranges, Form_pg_attribute attr)
+{
+	SerializedRanges *serialized;
+	Size		len;
+	char	   *ptr;
+	int			i;
+
+	Assert(attr->attlen > 0);
+
+	len = offsetof(SerializedRanges, data) +
+		2 * ranges->nranges * attr->attlen;
+	serialized = (SerializedRanges *) palloc(len);
+	SET_VARSIZE(serialized, len);
+	serialized->nranges = ranges->nranges;
+
+	ptr = serialized->data;
+	for (i = 0; i < 2 * ranges->nranges; i++)
+	{
+		if (attr->attbyval)
+		{
+			Datum		tmp;
+
+			/* store into an aligned buffer first; ptr may be unaligned */
+			store_att_byval(&tmp, ranges->values[i], attr->attlen);
+			memcpy(ptr, &tmp, attr->attlen);
+		}
+		else
+			memcpy(ptr, DatumGetPointer(ranges->values[i]), attr->attlen);
+		ptr += attr->attlen;
+	}
+
+	return PointerGetDatum(serialized);
+}
+
+/*
+ * Read an interval list from its on-disk representation, leaving room for
+ * extraranges additional intervals.  Pass-by-reference values are copied, so
+ * that the result does not depend on the source being kept around.
+ */
+static Ranges *
+ranges_deserialize(Datum value, Form_pg_attribute attr, int extraranges)
+{
+	SerializedRanges *serialized;
+	Ranges	   *ranges;
+	char	   *ptr;
+	int			i;
+
+	Assert(attr->attlen > 0);
+
+	serialized = (SerializedRanges *) PG_DETOAST_DATUM(value);
+	ranges = ranges_allocate(serialized->nranges + extraranges);
+	ranges->nranges = serialized->nranges;
+
+	ptr = serialized->data;
+	for (i = 0; i < 2 * ranges->nranges; i++)
+	{
+		if (attr->attbyval)
+		{
+			Datum		tmp;
+
+			memcpy(&tmp, ptr, attr->attlen);
+			ranges->values[i] = fetch_att(&tmp, true, attr->attlen);
+		}
+		else
+		{
+			char	   *copy = palloc(attr->attlen);
+
+			memcpy(copy, ptr, attr->attlen);
+			ranges->values[i] = PointerGetDatum(copy);
+		}
+		ptr += attr->attlen;
+	}
+
+	return ranges;
+}
+
+/*
+ * Merge adjacent intervals until there are no more than
+ * MINMAX_MULTI_MAX_RANGES of them, always picking the pair with the smallest
+ * gap between them as measured by the opclass' distance procedure.
+ */
+static void
+ranges_reduce(BrinDesc *bdesc, AttrNumber attno, Oid colloid, Ranges *ranges)
+{
+	FmgrInfo   *distanceFn;
+
+	if (ranges->nranges <= MINMAX_MULTI_MAX_RANGES)
+		return;
+
+	distanceFn = index_getprocinfo(bdesc->bd_index, attno, PROCNUM_DISTANCE);
+
+	while (ranges->nranges > MINMAX_MULTI_MAX_RANGES)
+	{
+		int			best = 0;
+		double		bestdist = 0;
+		int			i;
+
+		for (i = 0; i < ranges->nranges - 1; i++)
+		{
+			double		dist;
+
+			dist = DatumGetFloat8(FunctionCall2Coll(distanceFn, colloid,
+												ranges->values[2 * i + 1],
+												ranges->values[2 * i + 2]));
+			if (i == 0 || dist < bestdist)
+			{
+				best = i;
+				bestdist = dist;
+			}
+		}
+
+		/* extend interval "best" up to the end of the next one */
+		ranges->values[2 * best + 1] = ranges->values[2 * best + 3];
+		memmove(&ranges->values[2 * best + 2], &ranges->values[2 * best + 4],
+				sizeof(Datum) * 2 * (ranges->nranges - best - 2));
+		ranges->nranges--;
+	}
+}
+
+/*
+ * Return the temporary memory context of the given column, creating it on
+ * first use.  It lives as long as the BrinDesc.
+ */
+static MemoryContext
+minmax_multi_get_tmpcxt(BrinDesc *bdesc, uint16 attno)
+{
+	MinmaxMultiOpaque *opaque;
+
+	opaque = (MinmaxMultiOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	if (opaque->tmpcxt == NULL)
+		opaque->tmpcxt = AllocSetContextCreate(bdesc->bd_context,
+											   "minmax multi temporary context",
+											   ALLOCSET_SMALL_MINSIZE,
+											   ALLOCSET_SMALL_INITSIZE,
+											   ALLOCSET_DEFAULT_MAXSIZE);
+
+	return opaque->tmpcxt;
+}
+
+/*
+ * Cache and return the procedure for the given strategy.
+ *
+ * Note: this function mirrors minmax_get_strategy_procinfo; see notes there.
+ * If changes are made here, see that function too.
+ */
+static FmgrInfo *
+minmax_multi_get_strategy_procinfo(BrinDesc *bdesc, uint16 attno,
+								   Oid subtype, uint16 strategynum)
+{
+	MinmaxMultiOpaque *opaque;
+
+	Assert(strategynum >= 1 &&
+		   strategynum <= BTMaxStrategyNumber);
+
+	opaque = (MinmaxMultiOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	/*
+	 * We cache the procedures for the previous subtype in the opaque struct,
+	 * to avoid repetitive syscache lookups.  If the subtype changed,
+	 * invalidate all the cached entries.
+	 */
+	if (opaque->cached_subtype != subtype)
+	{
+		uint16		i;
+
+		for (i = 1; i <= BTMaxStrategyNumber; i++)
+			opaque->strategy_procinfos[i - 1].fn_oid = InvalidOid;
+		opaque->cached_subtype = subtype;
+	}
+
+	if (opaque->strategy_procinfos[strategynum - 1].fn_oid == InvalidOid)
+	{
+		Form_pg_attribute attr;
+		HeapTuple	tuple;
+		Oid			opfamily,
+					oprid;
+		bool		isNull;
+
+		opfamily = bdesc->bd_index->rd_opfamily[attno - 1];
+		attr = bdesc->bd_tupdesc->attrs[attno - 1];
+		tuple = SearchSysCache4(AMOPSTRATEGY, ObjectIdGetDatum(opfamily),
+								ObjectIdGetDatum(attr->atttypid),
+								ObjectIdGetDatum(subtype),
+								Int16GetDatum(strategynum));
+
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+				 strategynum, attr->atttypid, subtype, opfamily);
+
+		oprid = DatumGetObjectId(SysCacheGetAttr(AMOPSTRATEGY, tuple,
+											 Anum_pg_amop_amopopr, &isNull));
+		ReleaseSysCache(tuple);
+		Assert(!isNull && RegProcedureIsValid(oprid));
+
+		fmgr_info_cxt(get_opcode(oprid),
+					  &opaque->strategy_procinfos[strategynum - 1],
+					  bdesc->bd_context);
+	}
+
+	return &opaque->strategy_procinfos[strategynum - 1];
+}
+
+/*
+ * Distance procedures: return the gap between two values of the type, as a
+ * float8.  Only the relative order of the distances matters, so no attempt
+ * is made to avoid precision loss.
+ */
+Datum
+brin_minmax_multi_distance_int2(PG_FUNCTION_ARGS)
+{
+	int16		a = PG_GETARG_INT16(0);
+	int16		b = PG_GETARG_INT16(1);
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_int4(PG_FUNCTION_ARGS)
+{
+	int32		a = PG_GETARG_INT32(0);
+	int32		b = PG_GETARG_INT32(1);
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_int8(PG_FUNCTION_ARGS)
+{
+	int64		a = PG_GETARG_INT64(0);
+	int64		b = PG_GETARG_INT64(1);
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_float4(PG_FUNCTION_ARGS)
+{
+	float4		a = PG_GETARG_FLOAT4(0);
+	float4		b = PG_GETARG_FLOAT4(1);
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_float8(PG_FUNCTION_ARGS)
+{
+	float8		a = PG_GETARG_FLOAT8(0);
+	float8		b = PG_GETARG_FLOAT8(1);
+
+	PG_RETURN_FLOAT8(b - a);
+}
+
+Datum
+brin_minmax_multi_distance_date(PG_FUNCTION_ARGS)
+{
+	DateADT		a = PG_GETARG_DATEADT(0);
+	DateADT		b = PG_GETARG_DATEADT(1);
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+/* also used for timestamptz, which has the same representation */
+Datum
+brin_minmax_multi_distance_timestamp(PG_FUNCTION_ARGS)
+{
+	Timestamp	a = PG_GETARG_TIMESTAMP(0);
+	Timestamp	b = PG_GETARG_TIMESTAMP(1);
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
@@ -77,6 +77,22 @@ static relopt_bool boolRelOpts[] =
 		},
 		true
 	},
+	{
+		{
+			"autosummarize",
+			"Enables automatic summarization on this BRIN index",
+			RELOPT_KIND_BRIN
+		},
+		false
+	},
+	{
+		{
+			"deduplicate_items",
+			"Enables \"deduplicate items\" feature for this btree index",
+			RELOPT_KIND_BTREE
+		},
+		BTREE_DEFAULT_DEDUPLICATE_ITEMS
+	},
 	{
 		{
 			"security_barrier",
@@ -26,6 +26,7 @@
 #include "storage/smgr.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/tuplesort.h"
 
 /* Step of index tuples for check whether to switch to buffering build mode */
 #define BUFFERING_MODE_SWITCH_CHECK_STEP 256
@@ -48,7 +49,9 @@ typedef enum
 	GIST_BUFFERING_STATS,		/* gathering statistics of index tuple size
 								 * before switching to the buffering build
 								 * mode */
-	GIST_BUFFERING_ACTIVE		/* in buffering build mode */
+	GIST_BUFFERING_ACTIVE,		/* in buffering build mode */
+	GIST_SORTED_BUILD			/* sorting the input and packing pages
+								 * bottom-up */
 } GistBufferingMode;
 
 /* Working state for gistbuild and its callback */
@@ -70,10 +73,44 @@ typedef struct
 	GISTBuildBuffers *gfbb;
 	HTAB	   *parentMap;
 
+	/*
+	 * Extra data structures used during a sorted build.  Block 0 is reserved
+	 * for the root, which is written last.
+	 */
+	Tuplesortstate *sortstate;	/* state data for tuplesort.c */
+	BlockNumber pages_allocated;	/* # of blocks handed out so far */
+	BlockNumber pages_written;	/* # of blocks written out so far */
+	bool		use_wal;		/* dump pages to WAL? */
+
 	GistBufferingMode bufferingMode;
 } GISTBuildState;
 
+/*
+ * In sorted build, we keep one page in memory for each level of the tree
+ * that is under construction.
+ */
+typedef struct GistSortedBuildPageState
+{
+	Page		page;
+	struct GistSortedBuildPageState *parent;	/* upper level, if any */
+} GistSortedBuildPageState;
+
 /* prototypes for private functions */
+static bool gistSortedBuildAvailable(Relation index);
+static void gistSortedBuildCallback(Relation index,
+						HeapTuple htup,
+						Datum *values,
+						bool *isnull,
+						bool tupleIsAlive,
+						void *state);
+static void gist_indexsortbuild(GISTBuildState *state);
+static void gist_indexsortbuild_pagestate_add(GISTBuildState *state,
+								  GistSortedBuildPageState *pagestate,
+								  IndexTuple itup);
+static void gist_indexsortbuild_pagestate_flush(GISTBuildState *state,
+									GistSortedBuildPageState *pagestate);
+static void gist_indexsortbuild_writepage(GISTBuildState *state, Page page,
+							  BlockNumber blkno);
 static void gistInitBuffering(GISTBuildState *buildstate);
 static int	calculatePagesPerBuffer(GISTBuildState *buildstate, int levelStep);
 static void gistBuildCallback(Relation index,
@@ -105,9 +142,13 @@ static void gistMemorizeAllDownlinks(GISTBuildState *buildstate, Buffer parent);
 static BlockNumber gistGetParent(GISTBuildState *buildstate, BlockNumber child);
 
 /*
- * Main entry point to GiST index build. Initially calls insert over and over,
- * but switches to more efficient buffering build algorithm after a certain
- * number of tuples (unless buffering mode is disabled).
+ * Main entry point to GiST index build.
+ *
+ * If all the opclasses of the index provide a sortsupport function, the
+ * input is sorted and the tree is packed bottom-up, like a B-tree build
+ * does.  Otherwise we initially call insert over and over, but switch to
+ * more efficient buffering build algorithm after a certain number of tuples
+ * (unless buffering mode is disabled).
  */
 Datum
 gistbuild(PG_FUNCTION_ARGS)
@@ -151,6 +192,14 @@ gistbuild(PG_FUNCTION_ARGS)
 	/* Calculate target amount of free space to leave on pages */
 	buildstate.freespace = BLCKSZ * (100 - fillfactor) / 100;
 
+	/*
+	 * Use sorted build when every key column supports it, unless buffering
+	 * build was explicitly requested.
+	 */
+	if (buildstate.bufferingMode != GIST_BUFFERING_STATS &&
+		gistSortedBuildAvailable(index))
+		buildstate.bufferingMode = GIST_SORTED_BUILD;
+
 	/*
 	 * We expect to be called exactly once for any index relation. If that's
 	 * not the case, big trouble's what we have.
@@ -169,53 +218,78 @@ gistbuild(PG_FUNCTION_ARGS)
 	 */
 	buildstate.giststate->tempCxt = createTempGistContext();
 
-	/* initialize the root page */
-	buffer = gistNewBuffer(index);
-	Assert(BufferGetBlockNumber(buffer) == GIST_ROOT_BLKNO);
-	page = BufferGetPage(buffer);
-
-	START_CRIT_SECTION();
+	/* build the index */
+	buildstate.indtuples = 0;
+	buildstate.indtuplesSize = 0;
 
-	GISTInitBuffer(buffer, F_LEAF);
+	if (buildstate.bufferingMode == GIST_SORTED_BUILD)
+	{
+		/*
+		 * Sort all the compressed index tuples, then write the tree out
+		 * bottom-up.  The index file is not touched until the sort is done.
+		 */
+		buildstate.sortstate = tuplesort_begin_index_gist(heap,
+														  index,
+														  maintenance_work_mem,
+														  false);
 
-	MarkBufferDirty(buffer);
+		reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
+									   gistSortedBuildCallback,
+									   (void *) &buildstate);
 
-	if (RelationNeedsWAL(index))
-	{
-		XLogRecPtr	recptr;
+		tuplesort_performsort(buildstate.sortstate);
 
-		XLogBeginInsert();
-		XLogRegisterBuffer(0, buffer, REGBUF_WILL_INIT);
+		gist_indexsortbuild(&buildstate);
 
-		recptr = XLogInsert(RM_GIST_ID, XLOG_GIST_CREATE_INDEX);
-		PageSetLSN(page, recptr);
+		tuplesort_end(buildstate.sortstate);
 	}
 	else
-		PageSetLSN(page, gistGetFakeLSN(heap));
+	{
+		/* initialize the root page */
+		buffer = gistNewBuffer(index);
+		Assert(BufferGetBlockNumber(buffer) == GIST_ROOT_BLKNO);
+		page = BufferGetPage(buffer);
 
-	UnlockReleaseBuffer(buffer);
+		START_CRIT_SECTION();
 
-	END_CRIT_SECTION();
+		GISTInitBuffer(buffer, F_LEAF);
 
-	/* build the index */
-	buildstate.indtuples = 0;
-	buildstate.indtuplesSize = 0;
+		MarkBufferDirty(buffer);
 
-	/*
-	 * Do the heap scan.
-	 */
-	reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
-								   gistBuildCallback, (void *) &buildstate);
+		if (RelationNeedsWAL(index))
+		{
+			XLogRecPtr	recptr;
 
-	/*
-	 * If buffering was used, flush out all the tuples that are still in the
-	 * buffers.
-	 */
-	if (buildstate.bufferingMode == GIST_BUFFERING_ACTIVE)
-	{
-		elog(DEBUG1, "all tuples processed, emptying buffers");
-		gistEmptyAllBuffers(&buildstate);
-		gistFreeBuildBuffers(buildstate.gfbb);
+			XLogBeginInsert();
+			XLogRegisterBuffer(0, buffer, REGBUF_WILL_INIT);
+
+			recptr = XLogInsert(RM_GIST_ID, XLOG_GIST_CREATE_INDEX);
+			PageSetLSN(page, recptr);
+		}
+		else
+			PageSetLSN(page, gistGetFakeLSN(heap));
+
+		UnlockReleaseBuffer(buffer);
+
+		END_CRIT_SECTION();
+
+		/*
+		 * Do the heap scan.
+		 */
+		reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
+									   gistBuildCallback,
+									   (void *) &buildstate);
+
+		/*
+		 * If buffering was used, flush out all the tuples that are still in
+		 * the buffers.
+		 */
+		if (buildstate.bufferingMode == GIST_BUFFERING_ACTIVE)
+		{
+			elog(DEBUG1, "all tuples processed, emptying buffers");
+			gistEmptyAllBuffers(&buildstate);
+			gistFreeBuildBuffers(buildstate.gfbb);
+		}
 	}
 
 	/* okay, all heap tuples are indexed */
@@ -254,6 +328,257 @@ gistValidateBufferingOption(char *value)
 	}
 }
 
+/*
+ * Can the index be built by sorting?  That requires a sortsupport function
+ * in the opclass of every key column.
+ */
+static bool
+gistSortedBuildAvailable(Relation index)
+{
+	int			i;
+
+	for (i = 0; i < index->rd_att->natts; i++)
+	{
+		if (!OidIsValid(index_getprocid(index, i + 1, GIST_SORTSUPPORT_PROC)))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Per-tuple callback from IndexBuildHeapScan, in sorted build mode.
+ *
+ * The values are compressed before sorting, so that the sortsupport
+ * functions work on the same representation that is stored in the index.
+ */
+static void
+gistSortedBuildCallback(Relation index,
+						HeapTuple htup,
+						Datum *values,
+						bool *isnull,
+						bool tupleIsAlive,
+						void *state)
+{
+	GISTBuildState *buildstate = (GISTBuildState *) state;
+	MemoryContext oldCtx;
+	Datum		compressed_values[INDEX_MAX_KEYS];
+
+	oldCtx = MemoryContextSwitchTo(buildstate->giststate->tempCxt);
+
+	gistCompressValues(buildstate->giststate, index,
+					   values, isnull,
+					   true, compressed_values);
+
+	tuplesort_putindextuplevalues(buildstate->sortstate,
+								  buildstate->indexrel,
+								  &htup->t_self,
+								  compressed_values, isnull);
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->giststate->tempCxt);
+
+	/* Update tuple count. */
+	buildstate->indtuples += 1;
+}
+
+/*
+ * Build the GiST tree bottom-up from the sorted tuples.
+ *
+ * Leaf pages are filled in the order the tuples come out of the sort, and a
+ * downlink holding the union of each completed page is added to the level
+ * above.  Pages are written out directly with smgr, bypassing shared
+ * buffers, as nbtsort.c does.
+ */
+static void
+gist_indexsortbuild(GISTBuildState *state)
+{
+	Relation	index = state->indexrel;
+	GistSortedBuildPageState *leafstate;
+	GistSortedBuildPageState *pagestate;
+	IndexTuple	itup;
+	bool		should_free;
+	Page		page;
+
+	state->use_wal = XLogIsNeeded() && RelationNeedsWAL(index);
+
+	/*
+	 * Reserve block 0 for the root page.  We don't know which page becomes
+	 * the root until all the tuples have been processed, so write a zero
+	 * page for now and overwrite it at the end.
+	 */
+	page = (Page) palloc0(BLCKSZ);
+	RelationOpenSmgr(index);
+	smgrextend(index->rd_smgr, MAIN_FORKNUM, GIST_ROOT_BLKNO,
+			   (char *) page, true);
+	state->pages_allocated = 1;
+	state->pages_written = 1;
+
+	/* Start with an empty leaf page */
+	leafstate = (GistSortedBuildPageState *)
+		palloc(sizeof(GistSortedBuildPageState));
+	leafstate->page = page;
+	leafstate->parent = NULL;
+	gistinitpage(page, F_LEAF);
+
+	/* Fill the leaf pages from the sorted tuples */
+	while ((itup = tuplesort_getindextuple(state->sortstate,
+										   true, &should_free)) != NULL)
+	{
+		gist_indexsortbuild_pagestate_add(state, leafstate, itup);
+		MemoryContextReset(state->giststate->tempCxt);
+		if (should_free)
+			pfree(itup);
+	}
+
+	/*
+	 * Write out the partially full page on each level, bottom-up.  The page
+	 * on the topmost level becomes the root.
+	 */
+	pagestate = leafstate;
+	while (pagestate->parent != NULL)
+	{
+		GistSortedBuildPageState *parent;
+
+		gist_indexsortbuild_pagestate_flush(state, pagestate);
+		MemoryContextReset(state->giststate->tempCxt);
+
+		parent = pagestate->parent;
+		pfree(pagestate->page);
+		pfree(pagestate);
+		pagestate = parent;
+	}
+
+	gist_indexsortbuild_writepage(state, pagestate->page, GIST_ROOT_BLKNO);
+	pfree(pagestate->page);
+	pfree(pagestate);
+
+	/*
+	 * As in a B-tree build, the pages were written outside shared buffers,
+	 * so a WAL-logged index must be fsync'd before commit.  See
+	 * _bt_load().
+	 */
+	if (RelationNeedsWAL(index))
+	{
+		RelationOpenSmgr(index);
+		smgrimmedsync(index->rd_smgr, MAIN_FORKNUM);
+	}
+}
+
+/*
+ * Add a tuple to the page on one level of the tree, writing out the page
+ * first if the tuple doesn't fit on it.
+ */
+static void
+gist_indexsortbuild_pagestate_add(GISTBuildState *state,
+								  GistSortedBuildPageState *pagestate,
+								  IndexTuple itup)
+{
+	Size		itupsz = IndexTupleSize(itup);
+
+	if (itupsz > GiSTPageSize)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+			errmsg("index row size %zu exceeds maximum %zu for index \"%s\"",
+				   itupsz, GiSTPageSize,
+				   RelationGetRelationName(state->indexrel))));
+
+	/* Leave the fillfactor's worth of free space on each page */
+	if (PageGetFreeSpace(pagestate->page) < itupsz + state->freespace &&
+		!PageIsEmpty(pagestate->page))
+		gist_indexsortbuild_pagestate_flush(state, pagestate);
+
+	if (PageAddItem(pagestate->page, (Item) itup, itupsz,
+					InvalidOffsetNumber, false, false) == InvalidOffsetNumber)
+		elog(ERROR, "failed to add item to index page in \"%s\"",
+			 RelationGetRelationName(state->indexrel));
+}
+
+/*
+ * Write out the current page of a level, and insert a downlink for it into
+ * the parent level.  The in-memory page is reset to be empty.
+ */
+static void
+gist_indexsortbuild_pagestate_flush(GISTBuildState *state,
+									GistSortedBuildPageState *pagestate)
+{
+	Page		page = pagestate->page;
+	bool		isleaf = GistPageIsLeaf(page);
+	IndexTuple *itvec;
+	int			vect_len;
+	IndexTuple	union_tuple;
+	BlockNumber blkno;
+	MemoryContext oldCtx;
+
+	CHECK_FOR_INTERRUPTS();
+
+	blkno = state->pages_allocated++;
+
+	/* Form the downlink from the union of all the keys on the page */
+	oldCtx = MemoryContextSwitchTo(state->giststate->tempCxt);
+	itvec = gistextractpage(page, &vect_len);
+	union_tuple = gistunion(state->indexrel, itvec, vect_len,
+							state->giststate);
+	ItemPointerSetBlockNumber(&(union_tuple->t_tid), blkno);
+	MemoryContextSwitchTo(oldCtx);
+
+	gist_indexsortbuild_writepage(state, page, blkno);
+	gistinitpage(page, isleaf ? F_LEAF : 0);
+
+	/* Create the parent level, if this was the topmost one so far */
+	if (pagestate->parent == NULL)
+	{
+		GistSortedBuildPageState *parent;
+
+		parent = (GistSortedBuildPageState *)
+			palloc(sizeof(GistSortedBuildPageState));
+		parent->page = (Page) palloc(BLCKSZ);
+		parent->parent = NULL;
+		gistinitpage(parent->page, 0);
+
+		pagestate->parent = parent;
+	}
+
+	gist_indexsortbuild_pagestate_add(state, pagestate->parent, union_tuple);
+}
+
+/*
+ * Emit a completed page.
+ */
+static void
+gist_indexsortbuild_writepage(GISTBuildState *state, Page page,
+							  BlockNumber blkno)
+{
+	Relation	index = state->indexrel;
+
+	/* Ensure rd_smgr is open (could have been closed by relcache flush!) */
+	RelationOpenSmgr(index);
+
+	if (state->use_wal)
+		log_newpage(&index->rd_node, MAIN_FORKNUM, blkno, page, true);
+	else if (RelationNeedsWAL(index))
+		PageSetLSN(page, GistBuildLSN);
+	else
+		PageSetLSN(page, gistGetFakeLSN(index));
+
+	PageSetChecksumInplace(page, blkno);
+
+	/*
+	 * There's no need for smgr to schedule an fsync for these writes; we do
+	 * it ourselves at the end of the build.
+	 */
+	if (blkno < state->pages_written)
+	{
+		/* overwriting the root block we zero-filled at the start */
+		smgrwrite(index->rd_smgr, MAIN_FORKNUM, blkno, (char *) page, true);
+	}
+	else
+	{
+		Assert(blkno == state->pages_written);
+		smgrextend(index->rd_smgr, MAIN_FORKNUM, blkno, (char *) page, true);
+		state->pages_written++;
+	}
+}
+
 /*
  * Attempt to switch to buffering mode.
  *
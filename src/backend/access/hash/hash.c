@@ -20,8 +20,10 @@
 
 #include "access/hash.h"
 #include "access/relscan.h"
+#include "access/xloginsert.h"
 #include "catalog/index.h"
 #include "commands/vacuum.h"
+#include "miscadmin.h"
 #include "optimizer/cost.h"
 #include "optimizer/plancat.h"
 #include "storage/bufmgr.h"
@@ -388,6 +390,7 @@ hashbeginscan(PG_FUNCTION_ARGS)
 	so = (HashScanOpaque) palloc(sizeof(HashScanOpaqueData));
 	so->hashso_bucket_valid = false;
 	so->hashso_bucket_blkno = 0;
+	so->hashso_bucket_buf = InvalidBuffer;
 	so->hashso_curbuf = InvalidBuffer;
 	/* set position invalid (this will cause _hash_first call) */
 	ItemPointerSetInvalid(&(so->hashso_curpos));
@@ -419,7 +422,10 @@ hashrescan(PG_FUNCTION_ARGS)
 		_hash_dropbuf(rel, so->hashso_curbuf);
 	so->hashso_curbuf = InvalidBuffer;
 
-	/* release lock on bucket, too */
+	/* release lock on bucket, too, and the pin on its primary page */
+	if (BufferIsValid(so->hashso_bucket_buf))
+		_hash_dropbuf(rel, so->hashso_bucket_buf);
+	so->hashso_bucket_buf = InvalidBuffer;
 	if (so->hashso_bucket_blkno)
 		_hash_droplock(rel, so->hashso_bucket_blkno, HASH_SHARE);
 	so->hashso_bucket_blkno = 0;
@@ -458,7 +464,10 @@ hashendscan(PG_FUNCTION_ARGS)
 		_hash_dropbuf(rel, so->hashso_curbuf);
 	so->hashso_curbuf = InvalidBuffer;
 
-	/* release lock on bucket, too */
+	/* release lock on bucket, too, and the pin on its primary page */
+	if (BufferIsValid(so->hashso_bucket_buf))
+		_hash_dropbuf(rel, so->hashso_bucket_buf);
+	so->hashso_bucket_buf = InvalidBuffer;
 	if (so->hashso_bucket_blkno)
 		_hash_droplock(rel, so->hashso_bucket_blkno, HASH_SHARE);
 	so->hashso_bucket_blkno = 0;
@@ -541,6 +550,7 @@ loop_top:
 	{
 		BlockNumber bucket_blkno;
 		BlockNumber blkno;
+		Buffer		bucket_buf;
 		bool		bucket_dirty = false;
 
 		/* Get address of bucket's start page */
@@ -553,6 +563,13 @@ loop_top:
 		if (_hash_has_active_scan(rel, cur_bucket))
 			elog(ERROR, "hash index has active scan during VACUUM");
 
+		/*
+		 * Keep a pin on the primary bucket page while we work on the bucket;
+		 * the WAL records we write refer to it.
+		 */
+		bucket_buf = ReadBufferExtended(rel, MAIN_FORKNUM, bucket_blkno,
+										RBM_NORMAL, info->strategy);
+
 		/* Scan each page in bucket */
 		blkno = bucket_blkno;
 		while (BlockNumberIsValid(blkno))
@@ -582,11 +599,26 @@ loop_top:
 			{
 				IndexTuple	itup;
 				ItemPointer htup;
+				Bucket		bucket;
 
 				itup = (IndexTuple) PageGetItem(page,
 												PageGetItemId(page, offno));
 				htup = &(itup->t_tid);
-				if (callback(htup, callback_state))
+
+				/*
+				 * A tuple that no longer belongs to this bucket was left
+				 * behind by a bucket split that was interrupted before it
+				 * could clean up; just remove it.  (Our copy of the metapage
+				 * may be out of date, but that can only make us miss such
+				 * tuples, never remove live ones.)
+				 */
+				bucket = _hash_hashkey2bucket(_hash_get_indextuple_hashkey(itup),
+											  local_metapage.hashm_maxbucket,
+											  local_metapage.hashm_highmask,
+											  local_metapage.hashm_lowmask);
+				if (bucket != cur_bucket)
+					deletable[ndeletable++] = offno;
+				else if (callback(htup, callback_state))
 				{
 					/* mark the item for deletion */
 					deletable[ndeletable++] = offno;
@@ -603,19 +635,19 @@ loop_top:
 
 			if (ndeletable > 0)
 			{
-				PageIndexMultiDelete(page, deletable, ndeletable);
-				_hash_wrtbuf(rel, buf);
+				_hash_delitems(rel, bucket_buf, buf, deletable, ndeletable);
 				bucket_dirty = true;
 			}
-			else
-				_hash_relbuf(rel, buf);
+			_hash_relbuf(rel, buf);
 		}
 
 		/* If we deleted anything, try to compact free space */
 		if (bucket_dirty)
-			_hash_squeezebucket(rel, cur_bucket, bucket_blkno,
+			_hash_squeezebucket(rel, cur_bucket, bucket_buf,
 								info->strategy);
 
+		_hash_dropbuf(rel, bucket_buf);
+
 		/* Release bucket lock */
 		_hash_droplock(rel, bucket_blkno, HASH_EXCLUSIVE);
 
@@ -637,6 +669,7 @@ loop_top:
 	}
 
 	/* Okay, we're really done.  Update tuple count in metapage. */
+	START_CRIT_SECTION();
 
 	if (orig_maxbucket == metap->hashm_maxbucket &&
 		orig_ntuples == metap->hashm_ntuples)
@@ -662,7 +695,29 @@ loop_top:
 		num_index_tuples = metap->hashm_ntuples;
 	}
 
-	_hash_wrtbuf(rel, metabuf);
+	MarkBufferDirty(metabuf);
+
+	/* XLOG stuff */
+	if (RelationNeedsWAL(rel))
+	{
+		xl_hash_update_meta xlrec;
+		XLogRecPtr	recptr;
+
+		xlrec.ntuples = metap->hashm_ntuples;
+
+		XLogBeginInsert();
+		XLogRegisterData((char *) &xlrec, SizeOfHashUpdateMeta);
+
+		/* the metapage doesn't have a standard layout */
+		XLogRegisterBuffer(0, metabuf, 0);
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_UPDATE_META);
+		PageSetLSN(BufferGetPage(metabuf), recptr);
+	}
+
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, metabuf);
 
 	/* return statistics */
 	if (stats == NULL)
@@ -699,10 +754,3 @@ hashvacuumcleanup(PG_FUNCTION_ARGS)
 
 	PG_RETURN_POINTER(stats);
 }
-
-
-void
-hash_redo(XLogReaderState *record)
-{
-	elog(PANIC, "hash_redo: unimplemented");
-}
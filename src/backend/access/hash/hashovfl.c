@@ -18,11 +18,14 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "access/xloginsert.h"
+#include "miscadmin.h"
 #include "utils/rel.h"
 
 
 static Buffer _hash_getovflpage(Relation rel, Buffer metabuf);
 static uint32 _hash_firstfreebit(uint32 map);
+static void _hash_initbitmapbuffer(Buffer buf, uint16 bmsize);
 
 
 /*
@@ -75,6 +78,7 @@ blkno_to_bitno(HashMetaPage metap, BlockNumber ovflblkno)
 	return 0;					/* keep compiler quiet */
 }
 
+
 /*
  *	_hash_addovflpage
  *
@@ -105,6 +109,7 @@ _hash_addovflpage(Relation rel, Buffer metabuf, Buffer buf)
 	Page		ovflpage;
 	HashPageOpaque pageopaque;
 	HashPageOpaque ovflopaque;
+	Buffer		bufs[2];
 
 	/* allocate and lock an empty overflow page */
 	ovflbuf = _hash_getovflpage(rel, metabuf);
@@ -136,7 +141,12 @@ _hash_addovflpage(Relation rel, Buffer metabuf, Buffer buf)
 		buf = _hash_getbuf(rel, nextblkno, HASH_WRITE, LH_OVERFLOW_PAGE);
 	}
 
-	/* now that we have correct backlink, initialize new overflow page */
+	/*
+	 * Now that we have correct backlink, initialize new overflow page and
+	 * logically chain it to the previous page.
+	 */
+	START_CRIT_SECTION();
+
 	ovflpage = BufferGetPage(ovflbuf);
 	ovflopaque = (HashPageOpaque) PageGetSpecialPointer(ovflpage);
 	ovflopaque->hasho_prevblkno = BufferGetBlockNumber(buf);
@@ -144,12 +154,18 @@ _hash_addovflpage(Relation rel, Buffer metabuf, Buffer buf)
 	ovflopaque->hasho_bucket = pageopaque->hasho_bucket;
 	ovflopaque->hasho_flag = LH_OVERFLOW_PAGE;
 	ovflopaque->hasho_page_id = HASHO_PAGE_ID;
-
 	MarkBufferDirty(ovflbuf);
 
-	/* logically chain overflow page to previous page */
 	pageopaque->hasho_nextblkno = BufferGetBlockNumber(ovflbuf);
-	_hash_wrtbuf(rel, buf);
+	MarkBufferDirty(buf);
+
+	bufs[0] = ovflbuf;
+	bufs[1] = buf;
+	_hash_log_pages(rel, InvalidBuffer, bufs, 2);
+
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, buf);
 
 	return ovflbuf;
 }
@@ -169,8 +185,12 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 {
 	HashMetaPage metap;
 	Buffer		mapbuf = 0;
+	Buffer		newmapbuf = InvalidBuffer;
 	Buffer		newbuf;
+	Buffer		bufs[3];
+	int			nbufs;
 	BlockNumber blkno;
+	BlockNumber newmapblkno = InvalidBlockNumber;
 	uint32		orig_firstfree;
 	uint32		splitnum;
 	uint32	   *freep = NULL;
@@ -246,7 +266,12 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 	/*
 	 * No free pages --- have to extend the relation to add an overflow page.
 	 * First, check to see if we have to add a new bitmap page too.
+	 *
+	 * All the new pages are fetched before the metapage is changed, so that
+	 * an error in extending the relation cannot leave an unlogged change in
+	 * the metapage behind.
 	 */
+	bit = metap->hashm_spares[splitnum];
 	if (last_bit == (uint32) (BMPGSZ_BIT(metap) - 1))
 	{
 		/*
@@ -257,9 +282,20 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 		 * marked "in use".  Subsequent pages do not exist yet, but it is
 		 * convenient to pre-mark them as "in use" too.
 		 */
-		bit = metap->hashm_spares[splitnum];
-		_hash_initbitmap(rel, metap, bitno_to_blkno(metap, bit), MAIN_FORKNUM);
-		metap->hashm_spares[splitnum]++;
+		if (metap->hashm_nmaps >= HASH_MAX_BITMAPS)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("out of overflow pages in hash index \"%s\"",
+							RelationGetRelationName(rel))));
+
+		/*
+		 * It is okay to write-lock the new bitmap page while holding
+		 * metapage write lock, because no one else could be contending for
+		 * the new page.
+		 */
+		newmapblkno = bitno_to_blkno(metap, bit);
+		newmapbuf = _hash_getnewbuf(rel, newmapblkno, MAIN_FORKNUM);
+		bit++;
 	}
 	else
 	{
@@ -270,7 +306,6 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 	}
 
 	/* Calculate address of the new overflow page */
-	bit = metap->hashm_spares[splitnum];
 	blkno = bitno_to_blkno(metap, bit);
 
 	/*
@@ -281,6 +316,21 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 	 */
 	newbuf = _hash_getnewbuf(rel, blkno, MAIN_FORKNUM);
 
+	START_CRIT_SECTION();
+
+	nbufs = 0;
+	if (BufferIsValid(newmapbuf))
+	{
+		_hash_initbitmapbuffer(newmapbuf, metap->hashm_bmsize);
+		MarkBufferDirty(newmapbuf);
+		bufs[nbufs++] = newmapbuf;
+
+		/* add the new bitmap page to the metapage's list of bitmaps */
+		metap->hashm_mapp[metap->hashm_nmaps] = newmapblkno;
+		metap->hashm_nmaps++;
+		metap->hashm_spares[splitnum]++;
+	}
+
 	metap->hashm_spares[splitnum]++;
 
 	/*
@@ -290,8 +340,25 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 	if (metap->hashm_firstfree == orig_firstfree)
 		metap->hashm_firstfree = bit + 1;
 
-	/* Write updated metapage and release lock, but not pin */
-	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
+	MarkBufferDirty(metabuf);
+	bufs[nbufs++] = metabuf;
+
+	/*
+	 * The new overflow page is logged too, although its special space is not
+	 * filled in yet, so that replay extends the relation to cover it.
+	 */
+	MarkBufferDirty(newbuf);
+	bufs[nbufs++] = newbuf;
+
+	_hash_log_pages(rel, InvalidBuffer, bufs, nbufs);
+
+	END_CRIT_SECTION();
+
+	if (BufferIsValid(newmapbuf))
+		_hash_relbuf(rel, newmapbuf);
+
+	/* Release metapage lock, but not pin */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 
 	return newbuf;
 
@@ -299,12 +366,21 @@ found:
 	/* convert bit to bit number within page */
 	bit += _hash_firstfreebit(freep[j]);
 
+	/*
+	 * Reacquire exclusive lock on the meta page, keeping the lock on the
+	 * bitmap page so that both changes go into one WAL record.  Nobody
+	 * locks a bitmap page while holding the metapage lock, so there is no
+	 * deadlock risk.
+	 */
+	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
+
+	START_CRIT_SECTION();
+
 	/* mark page "in use" in the bitmap */
 	SETBIT(freep, bit);
-	_hash_wrtbuf(rel, mapbuf);
-
-	/* Reacquire exclusive lock on the meta page */
-	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
+	MarkBufferDirty(mapbuf);
+	nbufs = 0;
+	bufs[nbufs++] = mapbuf;
 
 	/* convert bit to absolute bit number */
 	bit += (i << BMPG_SHIFT(metap));
@@ -319,16 +395,19 @@ found:
 	if (metap->hashm_firstfree == orig_firstfree)
 	{
 		metap->hashm_firstfree = bit + 1;
-
-		/* Write updated metapage and release lock, but not pin */
-		_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
-	}
-	else
-	{
-		/* We didn't change the metapage, so no need to write */
-		_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+		MarkBufferDirty(metabuf);
+		bufs[nbufs++] = metabuf;
 	}
 
+	_hash_log_pages(rel, InvalidBuffer, bufs, nbufs);
+
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, mapbuf);
+
+	/* Release metapage lock, but not pin */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+
 	/* Fetch, init, and return the recycled page */
 	return _hash_getinitbuf(rel, blkno);
 }
@@ -357,12 +436,17 @@ _hash_firstfreebit(uint32 map)
 	return 0;					/* keep compiler quiet */
 }
 
+
 /*
  *	_hash_freeovflpage() -
  *
  *	Remove this overflow page from its bucket's chain, and mark the page as
  *	free.  On entry, ovflbuf is write-locked; it is released before exiting.
  *
+ *	'bucket_buf' is the primary page of the bucket, which the caller holds
+ *	a pin (but not necessarily a lock) on; the WAL record for unlinking the
+ *	page makes replay take a cleanup lock on it.
+ *
  *	Since this function is invoked in VACUUM, we provide an access strategy
  *	parameter that controls fetches of the bucket pages.
  *
@@ -374,12 +458,16 @@ _hash_firstfreebit(uint32 map)
  *	on the bucket, too.
  */
 BlockNumber
-_hash_freeovflpage(Relation rel, Buffer ovflbuf,
+_hash_freeovflpage(Relation rel, Buffer bucket_buf, Buffer ovflbuf,
 				   BufferAccessStrategy bstrategy)
 {
 	HashMetaPage metap;
 	Buffer		metabuf;
 	Buffer		mapbuf;
+	Buffer		prevbuf = InvalidBuffer;
+	Buffer		nextbuf = InvalidBuffer;
+	Buffer		bufs[3];
+	int			nbufs;
 	BlockNumber ovflblkno;
 	BlockNumber prevblkno;
 	BlockNumber blkno;
@@ -402,49 +490,78 @@ _hash_freeovflpage(Relation rel, Buffer ovflbuf,
 	prevblkno = ovflopaque->hasho_prevblkno;
 	bucket = ovflopaque->hasho_bucket;
 
-	/*
-	 * Zero the page for debugging's sake; then write and release it. (Note:
-	 * if we failed to zero the page here, we'd have problems with the Assert
-	 * in _hash_pageinit() when the page is reused.)
-	 */
-	MemSet(ovflpage, 0, BufferGetPageSize(ovflbuf));
-	_hash_wrtbuf(rel, ovflbuf);
-
 	/*
 	 * Fix up the bucket chain.  this is a doubly-linked list, so we must fix
 	 * up the bucket chain members behind and ahead of the overflow page being
 	 * deleted.  No concurrency issues since we hold exclusive lock on the
-	 * entire bucket.
+	 * entire bucket.  All three pages are locked at once so that the change
+	 * can be WAL-logged as a unit.
 	 */
 	if (BlockNumberIsValid(prevblkno))
 	{
-		Buffer		prevbuf = _hash_getbuf_with_strategy(rel,
-														 prevblkno,
-														 HASH_WRITE,
+		prevbuf = _hash_getbuf_with_strategy(rel,
+											 prevblkno,
+											 HASH_WRITE,
 										   LH_BUCKET_PAGE | LH_OVERFLOW_PAGE,
-														 bstrategy);
-		Page		prevpage = BufferGetPage(prevbuf);
-		HashPageOpaque prevopaque = (HashPageOpaque) PageGetSpecialPointer(prevpage);
+											 bstrategy);
+		Assert(((HashPageOpaque) PageGetSpecialPointer(BufferGetPage(prevbuf)))->hasho_bucket == bucket);
+	}
+	if (BlockNumberIsValid(nextblkno))
+	{
+		nextbuf = _hash_getbuf_with_strategy(rel,
+											 nextblkno,
+											 HASH_WRITE,
+											 LH_OVERFLOW_PAGE,
+											 bstrategy);
+		Assert(((HashPageOpaque) PageGetSpecialPointer(BufferGetPage(nextbuf)))->hasho_bucket == bucket);
+	}
 
-		Assert(prevopaque->hasho_bucket == bucket);
+	START_CRIT_SECTION();
+
+	/*
+	 * Reinitialize the doomed page as an unused page.  (It is not zeroed,
+	 * since a page with an LSN must keep a valid header.)
+	 */
+	_hash_pageinit(ovflpage, BufferGetPageSize(ovflbuf));
+	ovflopaque = (HashPageOpaque) PageGetSpecialPointer(ovflpage);
+	ovflopaque->hasho_prevblkno = InvalidBlockNumber;
+	ovflopaque->hasho_nextblkno = InvalidBlockNumber;
+	ovflopaque->hasho_bucket = -1;
+	ovflopaque->hasho_flag = LH_UNUSED_PAGE;
+	ovflopaque->hasho_page_id = HASHO_PAGE_ID;
+	MarkBufferDirty(ovflbuf);
+	nbufs = 0;
+	bufs[nbufs++] = ovflbuf;
+
+	if (BufferIsValid(prevbuf))
+	{
+		HashPageOpaque prevopaque;
+
+		prevopaque = (HashPageOpaque) PageGetSpecialPointer(BufferGetPage(prevbuf));
 		prevopaque->hasho_nextblkno = nextblkno;
-		_hash_wrtbuf(rel, prevbuf);
+		MarkBufferDirty(prevbuf);
+		bufs[nbufs++] = prevbuf;
 	}
-	if (BlockNumberIsValid(nextblkno))
+	if (BufferIsValid(nextbuf))
 	{
-		Buffer		nextbuf = _hash_getbuf_with_strategy(rel,
-														 nextblkno,
-														 HASH_WRITE,
-														 LH_OVERFLOW_PAGE,
-														 bstrategy);
-		Page		nextpage = BufferGetPage(nextbuf);
-		HashPageOpaque nextopaque = (HashPageOpaque) PageGetSpecialPointer(nextpage);
-
-		Assert(nextopaque->hasho_bucket == bucket);
+		HashPageOpaque nextopaque;
+
+		nextopaque = (HashPageOpaque) PageGetSpecialPointer(BufferGetPage(nextbuf));
 		nextopaque->hasho_prevblkno = prevblkno;
-		_hash_wrtbuf(rel, nextbuf);
+		MarkBufferDirty(nextbuf);
+		bufs[nbufs++] = nextbuf;
 	}
 
+	_hash_log_pages(rel, bucket_buf, bufs, nbufs);
+
+	END_CRIT_SECTION();
+
+	if (BufferIsValid(prevbuf))
+		_hash_relbuf(rel, prevbuf);
+	if (BufferIsValid(nextbuf))
+		_hash_relbuf(rel, nextbuf);
+	_hash_relbuf(rel, ovflbuf);
+
 	/* Note: bstrategy is intentionally not used for metapage and bitmap */
 
 	/* Read the metapage so we can determine which bitmap page to use */
@@ -464,33 +581,71 @@ _hash_freeovflpage(Relation rel, Buffer ovflbuf,
 	/* Release metapage lock while we access the bitmap page */
 	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 
-	/* Clear the bitmap bit to indicate that this overflow page is free */
 	mapbuf = _hash_getbuf(rel, blkno, HASH_WRITE, LH_BITMAP_PAGE);
 	mappage = BufferGetPage(mapbuf);
 	freep = HashPageGetBitmap(mappage);
 	Assert(ISSET(freep, bitmapbit));
-	CLRBIT(freep, bitmapbit);
-	_hash_wrtbuf(rel, mapbuf);
 
 	/* Get write-lock on metapage to update firstfree */
 	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
 
+	START_CRIT_SECTION();
+
+	/* Clear the bitmap bit to indicate that this overflow page is free */
+	CLRBIT(freep, bitmapbit);
+	MarkBufferDirty(mapbuf);
+	nbufs = 0;
+	bufs[nbufs++] = mapbuf;
+
 	/* if this is now the first free page, update hashm_firstfree */
 	if (ovflbitno < metap->hashm_firstfree)
 	{
 		metap->hashm_firstfree = ovflbitno;
-		_hash_wrtbuf(rel, metabuf);
-	}
-	else
-	{
-		/* no need to change metapage */
-		_hash_relbuf(rel, metabuf);
+		MarkBufferDirty(metabuf);
+		bufs[nbufs++] = metabuf;
 	}
 
+	_hash_log_pages(rel, InvalidBuffer, bufs, nbufs);
+
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, mapbuf);
+	_hash_relbuf(rel, metabuf);
+
 	return nextblkno;
 }
 
 
+/*
+ *	_hash_initbitmapbuffer()
+ *
+ *	 Initialize the contents of a new bitmap page, which must be pinned and
+ *	 write-locked.  'bmsize' is the size of the bitmap in bytes.
+ *
+ * All bits in the new bitmap page are set to "1", indicating "in use".
+ */
+static void
+_hash_initbitmapbuffer(Buffer buf, uint16 bmsize)
+{
+	Page		pg;
+	HashPageOpaque op;
+	uint32	   *freep;
+
+	pg = BufferGetPage(buf);
+
+	/* initialize the page's special space */
+	op = (HashPageOpaque) PageGetSpecialPointer(pg);
+	op->hasho_prevblkno = InvalidBlockNumber;
+	op->hasho_nextblkno = InvalidBlockNumber;
+	op->hasho_bucket = -1;
+	op->hasho_flag = LH_BITMAP_PAGE;
+	op->hasho_page_id = HASHO_PAGE_ID;
+
+	/* set all of the bits to 1 */
+	freep = HashPageGetBitmap(pg);
+	MemSet(freep, 0xFF, bmsize);
+}
+
 /*
  *	_hash_initbitmap()
  *
@@ -499,44 +654,32 @@ _hash_freeovflpage(Relation rel, Buffer ovflbuf,
  *
  * 'blkno' is the block number of the new bitmap page.
  *
- * All bits in the new bitmap page are set to "1", indicating "in use".
+ * This is used only when creating the index; _hash_getovflpage sets up
+ * later bitmap pages itself, so as to log them together with the metapage.
  */
 void
 _hash_initbitmap(Relation rel, HashMetaPage metap, BlockNumber blkno,
 				 ForkNumber forkNum)
 {
 	Buffer		buf;
-	Page		pg;
-	HashPageOpaque op;
-	uint32	   *freep;
 
 	/*
 	 * It is okay to write-lock the new bitmap page while holding metapage
 	 * write lock, because no one else could be contending for the new page.
 	 * Also, the metapage lock makes it safe to extend the index using
 	 * _hash_getnewbuf.
-	 *
-	 * There is some loss of concurrency in possibly doing I/O for the new
-	 * page while holding the metapage lock, but this path is taken so seldom
-	 * that it's not worth worrying about.
 	 */
 	buf = _hash_getnewbuf(rel, blkno, forkNum);
-	pg = BufferGetPage(buf);
-
-	/* initialize the page's special space */
-	op = (HashPageOpaque) PageGetSpecialPointer(pg);
-	op->hasho_prevblkno = InvalidBlockNumber;
-	op->hasho_nextblkno = InvalidBlockNumber;
-	op->hasho_bucket = -1;
-	op->hasho_flag = LH_BITMAP_PAGE;
-	op->hasho_page_id = HASHO_PAGE_ID;
 
-	/* set all of the bits to 1 */
-	freep = HashPageGetBitmap(pg);
-	MemSet(freep, 0xFF, BMPGSZ_BYTE(metap));
+	/* the bitmap page doesn't have a standard layout */
+	START_CRIT_SECTION();
+	_hash_initbitmapbuffer(buf, metap->hashm_bmsize);
+	MarkBufferDirty(buf);
+	if (RelationNeedsWAL(rel) || forkNum == INIT_FORKNUM)
+		log_newpage_buffer(buf, false);
+	END_CRIT_SECTION();
 
-	/* write out the new bitmap page (releasing write lock and pin) */
-	_hash_wrtbuf(rel, buf);
+	_hash_relbuf(rel, buf);
 
 	/* add the new bitmap page to the metapage's list of bitmaps */
 	/* metapage already has a write lock */
@@ -552,6 +695,43 @@ _hash_initbitmap(Relation rel, HashMetaPage metap, BlockNumber blkno,
 }
 
 
+/*
+ *	_hash_squeezemove()
+ *
+ *	Move the tuples collected by _hash_squeezebucket from the "read" page to
+ *	the "write" page, and WAL-log both pages together.
+ */
+static void
+_hash_squeezemove(Relation rel, Buffer bucket_buf, Buffer wbuf, Buffer rbuf,
+				  IndexTuple *itups, Size *itemszs, OffsetNumber *deletable,
+				  int nitups)
+{
+	Buffer		bufs[2];
+	int			i;
+
+	START_CRIT_SECTION();
+
+	/*
+	 * Insert on the "write" page, being careful to preserve hashkey
+	 * ordering.  (If we insert many tuples into the same "write" page it
+	 * would be worth qsort'ing instead of doing repeated _hash_pgaddtup.)
+	 * This must be done before deleting the tuples from the "read" page,
+	 * since 'itups' point into it.
+	 */
+	for (i = 0; i < nitups; i++)
+		(void) _hash_pgaddtup(rel, wbuf, itemszs[i], itups[i]);
+	MarkBufferDirty(wbuf);
+
+	PageIndexMultiDelete(BufferGetPage(rbuf), deletable, nitups);
+	MarkBufferDirty(rbuf);
+
+	bufs[0] = wbuf;
+	bufs[1] = rbuf;
+	_hash_log_pages(rel, bucket_buf, bufs, 2);
+
+	END_CRIT_SECTION();
+}
+
 /*
  *	_hash_squeezebucket(rel, bucket)
  *
@@ -570,8 +750,14 @@ _hash_initbitmap(Relation rel, HashMetaPage metap, BlockNumber blkno,
  *	required that to be true on entry as well, but it's a lot easier for
  *	callers to leave empty overflow pages and let this guy clean it up.
  *
- *	Caller must hold exclusive lock on the target bucket.  This allows
- *	us to safely lock multiple pages in the bucket.
+ *	Tuples are moved in batches: all the tuples taken from the read page
+ *	that fit on the current write page are added to it and removed from the
+ *	read page in one WAL-logged step, so that a crash never leaves a tuple
+ *	on both pages or on neither.
+ *
+ *	Caller must hold exclusive lock on the target bucket, and a pin on its
+ *	primary page 'bucket_buf'.  This allows us to safely lock multiple pages
+ *	in the bucket.
  *
  *	Since this function is invoked in VACUUM, we provide an access strategy
  *	parameter that controls fetches of the bucket pages.
@@ -579,7 +765,7 @@ _hash_initbitmap(Relation rel, HashMetaPage metap, BlockNumber blkno,
 void
 _hash_squeezebucket(Relation rel,
 					Bucket bucket,
-					BlockNumber bucket_blkno,
+					Buffer bucket_buf,
 					BufferAccessStrategy bstrategy)
 {
 	BlockNumber wblkno;
@@ -590,12 +776,11 @@ _hash_squeezebucket(Relation rel,
 	Page		rpage;
 	HashPageOpaque wopaque;
 	HashPageOpaque ropaque;
-	bool		wbuf_dirty;
 
 	/*
 	 * start squeezing into the base bucket page.
 	 */
-	wblkno = bucket_blkno;
+	wblkno = BufferGetBlockNumber(bucket_buf);
 	wbuf = _hash_getbuf_with_strategy(rel,
 									  wblkno,
 									  HASH_WRITE,
@@ -639,13 +824,15 @@ _hash_squeezebucket(Relation rel,
 	/*
 	 * squeeze the tuples.
 	 */
-	wbuf_dirty = false;
 	for (;;)
 	{
 		OffsetNumber roffnum;
 		OffsetNumber maxroffnum;
-		OffsetNumber deletable[MaxOffsetNumber];
-		int			ndeletable = 0;
+		OffsetNumber deletable[MaxIndexTuplesPerPage];
+		IndexTuple	itups[MaxIndexTuplesPerPage];
+		Size		itemszs[MaxIndexTuplesPerPage];
+		int			nitups = 0;
+		Size		freespace = PageGetFreeSpace(wpage);
 
 		/* Scan each tuple in "read" page */
 		maxroffnum = PageGetMaxOffsetNumber(rpage);
@@ -663,31 +850,38 @@ _hash_squeezebucket(Relation rel,
 
 			/*
 			 * Walk up the bucket chain, looking for a page big enough for
-			 * this item.  Exit if we reach the read page.
+			 * this item and the ones collected before it.  Exit if we reach
+			 * the read page.
 			 */
-			while (PageGetFreeSpace(wpage) < itemsz)
+			while (freespace < itemsz)
 			{
-				Assert(!PageIsEmpty(wpage));
+				Assert(!PageIsEmpty(wpage) || nitups > 0);
 
 				wblkno = wopaque->hasho_nextblkno;
 				Assert(BlockNumberIsValid(wblkno));
 
-				if (wbuf_dirty)
-					_hash_wrtbuf(rel, wbuf);
-				else
-					_hash_relbuf(rel, wbuf);
+				if (nitups > 0)
+				{
+					/*
+					 * Move the collected tuples before releasing the write
+					 * page.  They were the first ones on the read page, so
+					 * the current tuple is now the first one.
+					 */
+					_hash_squeezemove(rel, bucket_buf, wbuf, rbuf,
+									  itups, itemszs, deletable, nitups);
+					nitups = 0;
+					roffnum = FirstOffsetNumber;
+					maxroffnum = PageGetMaxOffsetNumber(rpage);
+					itup = (IndexTuple) PageGetItem(rpage,
+											 PageGetItemId(rpage, roffnum));
+				}
+
+				_hash_relbuf(rel, wbuf);
 
 				/* nothing more to do if we reached the read page */
 				if (rblkno == wblkno)
 				{
-					if (ndeletable > 0)
-					{
-						/* Delete tuples we already moved off read page */
-						PageIndexMultiDelete(rpage, deletable, ndeletable);
-						_hash_wrtbuf(rel, rbuf);
-					}
-					else
-						_hash_relbuf(rel, rbuf);
+					_hash_relbuf(rel, rbuf);
 					return;
 				}
 
@@ -699,27 +893,31 @@ _hash_squeezebucket(Relation rel,
 				wpage = BufferGetPage(wbuf);
 				wopaque = (HashPageOpaque) PageGetSpecialPointer(wpage);
 				Assert(wopaque->hasho_bucket == bucket);
-				wbuf_dirty = false;
+				freespace = PageGetFreeSpace(wpage);
 			}
 
-			/*
-			 * we have found room so insert on the "write" page, being careful
-			 * to preserve hashkey ordering.  (If we insert many tuples into
-			 * the same "write" page it would be worth qsort'ing instead of
-			 * doing repeated _hash_pgaddtup.)
-			 */
-			(void) _hash_pgaddtup(rel, wbuf, itemsz, itup);
-			wbuf_dirty = true;
+			/* remember tuple for moving to the "write" page */
+			itups[nitups] = itup;
+			itemszs[nitups] = itemsz;
+			deletable[nitups] = roffnum;
+			nitups++;
 
-			/* remember tuple for deletion from "read" page */
-			deletable[ndeletable++] = roffnum;
+			/* PageGetFreeSpace already allowed for one line pointer */
+			if (freespace - itemsz >= sizeof(ItemIdData))
+				freespace -= itemsz + sizeof(ItemIdData);
+			else
+				freespace = 0;
 		}
 
+		/* move whatever we collected from the rest of the "read" page */
+		if (nitups > 0)
+			_hash_squeezemove(rel, bucket_buf, wbuf, rbuf,
+							  itups, itemszs, deletable, nitups);
+
 		/*
 		 * If we reach here, there are no live tuples on the "read" page ---
 		 * it was empty when we got to it, or we moved them all.  So we can
-		 * just free the page without bothering with deleting tuples
-		 * individually.  Then advance to the previous "read" page.
+		 * free the page and advance to the previous "read" page.
 		 *
 		 * Tricky point here: if our read and write pages are adjacent in the
 		 * bucket chain, our write lock on wbuf will conflict with
@@ -734,18 +932,15 @@ _hash_squeezebucket(Relation rel,
 		if (rblkno == wblkno)
 		{
 			/* yes, so release wbuf lock first */
-			if (wbuf_dirty)
-				_hash_wrtbuf(rel, wbuf);
-			else
-				_hash_relbuf(rel, wbuf);
+			_hash_relbuf(rel, wbuf);
 			/* free this overflow page (releases rbuf) */
-			_hash_freeovflpage(rel, rbuf, bstrategy);
+			_hash_freeovflpage(rel, bucket_buf, rbuf, bstrategy);
 			/* done */
 			return;
 		}
 
 		/* free this overflow page, then get the previous one */
-		_hash_freeovflpage(rel, rbuf, bstrategy);
+		_hash_freeovflpage(rel, bucket_buf, rbuf, bstrategy);
 
 		rbuf = _hash_getbuf_with_strategy(rel,
 										  rblkno,
@@ -29,9 +29,11 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "access/xloginsert.h"
 #include "miscadmin.h"
 #include "storage/lmgr.h"
 #include "storage/smgr.h"
+#include "utils/rel.h"
 
 
 static bool _hash_alloc_buckets(Relation rel, BlockNumber firstblock,
@@ -42,6 +44,8 @@ static void _hash_splitbucket(Relation rel, Buffer metabuf,
 				  Buffer nbuf,
 				  uint32 maxbucket,
 				  uint32 highmask, uint32 lowmask);
+static void _hash_split_cleanup(Relation rel, Buffer metabuf,
+					Bucket obucket, BlockNumber start_oblkno);
 
 
 /*
@@ -444,7 +448,9 @@ _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
 	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
 
 	/*
-	 * Initialize the first N buckets
+	 * Initialize the first N buckets.  The pages are WAL-logged as full
+	 * images; the init fork of an unlogged index must be logged too, since
+	 * it is what the index is reset to after a crash.
 	 */
 	for (i = 0; i < num_buckets; i++)
 	{
@@ -454,12 +460,19 @@ _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
 		buf = _hash_getnewbuf(rel, BUCKET_TO_BLKNO(metap, i), forkNum);
 		pg = BufferGetPage(buf);
 		pageopaque = (HashPageOpaque) PageGetSpecialPointer(pg);
-		pageopaque->hasho_prevblkno = InvalidBlockNumber;
+		pageopaque->hasho_prevblkno = metap->hashm_maxbucket;
 		pageopaque->hasho_nextblkno = InvalidBlockNumber;
 		pageopaque->hasho_bucket = i;
 		pageopaque->hasho_flag = LH_BUCKET_PAGE;
 		pageopaque->hasho_page_id = HASHO_PAGE_ID;
-		_hash_wrtbuf(rel, buf);
+
+		START_CRIT_SECTION();
+		MarkBufferDirty(buf);
+		if (RelationNeedsWAL(rel) || forkNum == INIT_FORKNUM)
+			log_newpage_buffer(buf, true);
+		END_CRIT_SECTION();
+
+		_hash_relbuf(rel, buf);
 	}
 
 	/* Now reacquire buffer lock on metapage */
@@ -470,19 +483,28 @@ _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
 	 */
 	_hash_initbitmap(rel, metap, num_buckets + 1, forkNum);
 
-	/* all done */
-	_hash_wrtbuf(rel, metabuf);
+	/* all done; the metapage doesn't have a standard layout */
+	START_CRIT_SECTION();
+	MarkBufferDirty(metabuf);
+	if (RelationNeedsWAL(rel) || forkNum == INIT_FORKNUM)
+		log_newpage_buffer(metabuf, false);
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, metabuf);
 
 	return num_buckets;
 }
 
 /*
  *	_hash_pageinit() -- Initialize a new hash index page.
+ *
+ * The page need not be all-zeroes on entry: freed overflow pages keep a
+ * valid header, and a bucket page whose split was interrupted may be
+ * reinitialized by the next attempt.  PageInit clears the whole page.
  */
 void
 _hash_pageinit(Page page, Size size)
 {
-	Assert(PageIsNew(page));
 	PageInit(page, size, sizeof(HashPageOpaqueData));
 }
 
@@ -506,6 +528,11 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 	BlockNumber start_oblkno;
 	BlockNumber start_nblkno;
 	Buffer		buf_nblkno;
+	Buffer		obuf;
+	Buffer		bufs[2];
+	Page		npage;
+	HashPageOpaque nopaque;
+	HashPageOpaque oopaque;
 	uint32		maxbucket;
 	uint32		highmask;
 	uint32		lowmask;
@@ -614,60 +641,104 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 	buf_nblkno = _hash_getnewbuf(rel, start_nblkno, MAIN_FORKNUM);
 
 	/*
-	 * Okay to proceed with split.  Update the metapage bucket mapping info.
-	 *
-	 * Since we are scribbling on the metapage data right in the shared
-	 * buffer, any failure in this next little bit leaves us with a big
-	 * problem: the metapage is effectively corrupt but could get written back
-	 * to disk.  We don't really expect any failure, but just to be sure,
-	 * establish a critical section.
+	 * Compute the bucket mapping that will be in effect once the split is
+	 * done.  _hash_splitbucket needs it to tell which of the two buckets to
+	 * map hashkeys into.
 	 */
-	START_CRIT_SECTION();
-
-	metap->hashm_maxbucket = new_bucket;
-
-	if (new_bucket > metap->hashm_highmask)
+	maxbucket = new_bucket;
+	highmask = metap->hashm_highmask;
+	lowmask = metap->hashm_lowmask;
+	if (new_bucket > highmask)
 	{
 		/* Starting a new doubling */
-		metap->hashm_lowmask = metap->hashm_highmask;
-		metap->hashm_highmask = new_bucket | metap->hashm_lowmask;
+		lowmask = highmask;
+		highmask = new_bucket | lowmask;
 	}
 
 	/*
-	 * If the split point is increasing (hashm_maxbucket's log base 2
-	 * increases), we need to adjust the hashm_spares[] array and
-	 * hashm_ovflpoint so that future overflow pages will be created beyond
-	 * this new batch of bucket pages.
+	 * Okay to proceed with split.  If the split point is increasing
+	 * (hashm_maxbucket's log base 2 increases), we need to adjust the
+	 * hashm_spares[] array and hashm_ovflpoint so that future overflow pages
+	 * will be created beyond this new batch of bucket pages.  Initialize the
+	 * new bucket's primary page at the same time.
+	 *
+	 * We do not advance hashm_maxbucket yet.  That happens only after all the
+	 * tuples belonging in the new bucket have been copied there, so that if
+	 * we crash partway through the split, the half-built new bucket is just
+	 * unreachable (it will be initialized afresh when the split is retried)
+	 * rather than missing tuples that searches expect to find in it.
 	 */
+	START_CRIT_SECTION();
+
 	if (spare_ndx > metap->hashm_ovflpoint)
 	{
 		metap->hashm_spares[spare_ndx] = metap->hashm_spares[metap->hashm_ovflpoint];
 		metap->hashm_ovflpoint = spare_ndx;
 	}
 
+	npage = BufferGetPage(buf_nblkno);
+	nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
+	nopaque->hasho_prevblkno = maxbucket;
+	nopaque->hasho_nextblkno = InvalidBlockNumber;
+	nopaque->hasho_bucket = new_bucket;
+	nopaque->hasho_flag = LH_BUCKET_PAGE;
+	nopaque->hasho_page_id = HASHO_PAGE_ID;
+
+	MarkBufferDirty(metabuf);
+	MarkBufferDirty(buf_nblkno);
+
+	bufs[0] = metabuf;
+	bufs[1] = buf_nblkno;
+	_hash_log_pages(rel, InvalidBuffer, bufs, 2);
+
 	/* Done mucking with metapage */
 	END_CRIT_SECTION();
 
-	/*
-	 * Copy bucket mapping info now; this saves re-accessing the meta page
-	 * inside _hash_splitbucket's inner loop.  Note that once we drop the
-	 * split lock, other splits could begin, so these values might be out of
-	 * date before _hash_splitbucket finishes.  That's okay, since all it
-	 * needs is to tell which of these two buckets to map hashkeys into.
-	 */
-	maxbucket = metap->hashm_maxbucket;
-	highmask = metap->hashm_highmask;
-	lowmask = metap->hashm_lowmask;
-
-	/* Write out the metapage and drop lock, but keep pin */
-	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
+	/* Drop lock on the metapage, but keep pin */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 
-	/* Relocate records to the new bucket */
+	/* Copy records belonging in the new bucket over to it */
 	_hash_splitbucket(rel, metabuf,
 					  old_bucket, new_bucket,
 					  start_oblkno, buf_nblkno,
 					  maxbucket, highmask, lowmask);
 
+	/*
+	 * Now make the new bucket visible.  Write-lock the old bucket's primary
+	 * page and the metapage (in that order, which is the order in which all
+	 * code paths lock a bucket page and the metapage), update the bucket
+	 * mapping, and record the new hashm_maxbucket in the old bucket's
+	 * primary page; the new bucket's primary page already has it.
+	 */
+	obuf = _hash_getbuf(rel, start_oblkno, HASH_WRITE, LH_BUCKET_PAGE);
+	oopaque = (HashPageOpaque) PageGetSpecialPointer(BufferGetPage(obuf));
+	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
+
+	START_CRIT_SECTION();
+
+	metap->hashm_maxbucket = maxbucket;
+	metap->hashm_highmask = highmask;
+	metap->hashm_lowmask = lowmask;
+	oopaque->hasho_prevblkno = maxbucket;
+
+	MarkBufferDirty(obuf);
+	MarkBufferDirty(metabuf);
+
+	bufs[0] = obuf;
+	bufs[1] = metabuf;
+	_hash_log_pages(rel, InvalidBuffer, bufs, 2);
+
+	END_CRIT_SECTION();
+
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+	_hash_relbuf(rel, obuf);
+
+	/*
+	 * Remove the tuples that were copied to the new bucket from the old one,
+	 * and compact what remains.
+	 */
+	_hash_split_cleanup(rel, metabuf, old_bucket, start_oblkno);
+
 	/* Release bucket locks, allowing others to access them */
 	_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
 	_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
@@ -710,7 +781,8 @@ static bool
 _hash_alloc_buckets(Relation rel, BlockNumber firstblock, uint32 nblocks)
 {
 	BlockNumber lastblock;
-	char		zerobuf[BLCKSZ];
+	Page		page;
+	HashPageOpaque opaque;
 
 	lastblock = firstblock + nblocks - 1;
 
@@ -721,35 +793,63 @@ _hash_alloc_buckets(Relation rel, BlockNumber firstblock, uint32 nblocks)
 	if (lastblock < firstblock || lastblock == InvalidBlockNumber)
 		return false;
 
-	MemSet(zerobuf, 0, sizeof(zerobuf));
+	/*
+	 * The page we write is initialized as an unused hash page rather than
+	 * left as zeroes, because WAL-logging it sets its LSN, and a page of
+	 * zeroes with an LSN would fail verification when read back.  Replay of
+	 * the record extends the index just like the smgrextend() call does.
+	 */
+	page = (Page) palloc0(BLCKSZ);
+	_hash_pageinit(page, BLCKSZ);
+	opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+	opaque->hasho_prevblkno = InvalidBlockNumber;
+	opaque->hasho_nextblkno = InvalidBlockNumber;
+	opaque->hasho_bucket = -1;
+	opaque->hasho_flag = LH_UNUSED_PAGE;
+	opaque->hasho_page_id = HASHO_PAGE_ID;
+
+	if (RelationNeedsWAL(rel))
+		log_newpage(&rel->rd_node, MAIN_FORKNUM, lastblock, page, true);
 
 	RelationOpenSmgr(rel);
-	smgrextend(rel->rd_smgr, MAIN_FORKNUM, lastblock, zerobuf, false);
+	smgrextend(rel->rd_smgr, MAIN_FORKNUM, lastblock, (char *) page, false);
+
+	pfree(page);
 
 	return true;
 }
 
 
 /*
- * _hash_splitbucket -- split 'obucket' into 'obucket' and 'nbucket'
+ * _hash_splitbucket -- copy the tuples of 'obucket' that belong in 'nbucket'
  *
  * We are splitting a bucket that consists of a base bucket page and zero
- * or more overflow (bucket chain) pages.  We must relocate tuples that
- * belong in the new bucket, and compress out any free space in the old
- * bucket.
+ * or more overflow (bucket chain) pages.  We must copy the tuples that now
+ * belong in the new bucket to it, adding overflow pages to the new bucket
+ * as needed.  The old bucket is not modified here; _hash_split_cleanup
+ * removes the copied tuples from it once the new bucket has been made
+ * visible in the metapage.  Tuples that belong in neither bucket are left
+ * over from an earlier split that was interrupted by a crash, and are
+ * ignored (cleanup removes those too).
  *
  * The caller must hold exclusive locks on both buckets to ensure that
  * no one else is trying to access them (see README).
  *
  * The caller must hold a pin, but no lock, on the metapage buffer.
  * The buffer is returned in the same state.  (The metapage is only
- * touched if it becomes necessary to add or remove overflow pages.)
+ * touched if it becomes necessary to add overflow pages.)
  *
  * In addition, the caller must have created the new bucket's base page,
  * which is passed in buffer nbuf, pinned and write-locked.  That lock and
  * pin are released here.  (The API is set up this way because we must do
  * _hash_getnewbuf() before releasing the metapage write lock.  So instead of
  * passing the new bucket's start block number, we pass an actual buffer.)
+ *
+ * If we fail partway through (say, because we can't get space for a new
+ * overflow page), the index is still consistent: the new bucket is not
+ * reachable until the caller updates the metapage, and a later split of the
+ * same bucket will reinitialize it.  The overflow pages already added to it
+ * are leaked, however.
  */
 static void
 _hash_splitbucket(Relation rel,
@@ -766,40 +866,28 @@ _hash_splitbucket(Relation rel,
 	Page		opage;
 	Page		npage;
 	HashPageOpaque oopaque;
-	HashPageOpaque nopaque;
 
 	/*
-	 * It should be okay to simultaneously write-lock pages from each bucket,
-	 * since no one else can be trying to acquire buffer lock on pages of
-	 * either bucket.
+	 * It should be okay to simultaneously lock pages from each bucket, since
+	 * no one else can be trying to acquire buffer lock on pages of either
+	 * bucket.
 	 */
-	obuf = _hash_getbuf(rel, start_oblkno, HASH_WRITE, LH_BUCKET_PAGE);
+	obuf = _hash_getbuf(rel, start_oblkno, HASH_READ, LH_BUCKET_PAGE);
 	opage = BufferGetPage(obuf);
 	oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
 
 	npage = BufferGetPage(nbuf);
 
-	/* initialize the new bucket's primary page */
-	nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
-	nopaque->hasho_prevblkno = InvalidBlockNumber;
-	nopaque->hasho_nextblkno = InvalidBlockNumber;
-	nopaque->hasho_bucket = nbucket;
-	nopaque->hasho_flag = LH_BUCKET_PAGE;
-	nopaque->hasho_page_id = HASHO_PAGE_ID;
-
 	/*
-	 * Partition the tuples in the old bucket between the old bucket and the
-	 * new bucket, advancing along the old bucket's overflow bucket chain and
-	 * adding overflow pages to the new bucket as needed.  Outer loop iterates
-	 * once per page in old bucket.
+	 * Copy the tuples that belong in the new bucket, advancing along the old
+	 * bucket's overflow bucket chain.  Outer loop iterates once per page in
+	 * old bucket.
 	 */
 	for (;;)
 	{
 		BlockNumber oblkno;
 		OffsetNumber ooffnum;
 		OffsetNumber omaxoffnum;
-		OffsetNumber deletable[MaxOffsetNumber];
-		int			ndeletable = 0;
 
 		/* Scan each tuple in old page */
 		omaxoffnum = PageGetMaxOffsetNumber(opage);
@@ -820,85 +908,275 @@ _hash_splitbucket(Relation rel,
 			bucket = _hash_hashkey2bucket(_hash_get_indextuple_hashkey(itup),
 										  maxbucket, highmask, lowmask);
 
-			if (bucket == nbucket)
-			{
-				/*
-				 * insert the tuple into the new bucket.  if it doesn't fit on
-				 * the current page in the new bucket, we must allocate a new
-				 * overflow page and place the tuple on that page instead.
-				 *
-				 * XXX we have a problem here if we fail to get space for a
-				 * new overflow page: we'll error out leaving the bucket split
-				 * only partially complete, meaning the index is corrupt,
-				 * since searches may fail to find entries they should find.
-				 */
-				itemsz = IndexTupleDSize(*itup);
-				itemsz = MAXALIGN(itemsz);
-
-				if (PageGetFreeSpace(npage) < itemsz)
-				{
-					/* write out nbuf and drop lock, but keep pin */
-					_hash_chgbufaccess(rel, nbuf, HASH_WRITE, HASH_NOLOCK);
-					/* chain to a new overflow page */
-					nbuf = _hash_addovflpage(rel, metabuf, nbuf);
-					npage = BufferGetPage(nbuf);
-					/* we don't need nopaque within the loop */
-				}
-
-				/*
-				 * Insert tuple on new page, using _hash_pgaddtup to ensure
-				 * correct ordering by hashkey.  This is a tad inefficient
-				 * since we may have to shuffle itempointers repeatedly.
-				 * Possible future improvement: accumulate all the items for
-				 * the new page and qsort them before insertion.
-				 */
-				(void) _hash_pgaddtup(rel, nbuf, itemsz, itup);
-
-				/*
-				 * Mark tuple for deletion from old page.
-				 */
-				deletable[ndeletable++] = ooffnum;
-			}
-			else
+			if (bucket != nbucket)
+				continue;
+
+			/*
+			 * Insert the tuple into the new bucket.  If it doesn't fit on the
+			 * current page in the new bucket, we must allocate a new overflow
+			 * page and place the tuple on that page instead.
+			 */
+			itemsz = IndexTupleDSize(*itup);
+			itemsz = MAXALIGN(itemsz);
+
+			if (PageGetFreeSpace(npage) < itemsz)
 			{
-				/*
-				 * the tuple stays on this page, so nothing to do.
-				 */
-				Assert(bucket == obucket);
+				/* log the full page, and drop lock but keep pin */
+				START_CRIT_SECTION();
+				MarkBufferDirty(nbuf);
+				_hash_log_pages(rel, InvalidBuffer, &nbuf, 1);
+				END_CRIT_SECTION();
+				_hash_chgbufaccess(rel, nbuf, HASH_READ, HASH_NOLOCK);
+
+				/* chain to a new overflow page */
+				nbuf = _hash_addovflpage(rel, metabuf, nbuf);
+				npage = BufferGetPage(nbuf);
 			}
+
+			/*
+			 * Insert tuple on new page, using _hash_pgaddtup to ensure
+			 * correct ordering by hashkey.  This is a tad inefficient since
+			 * we may have to shuffle itempointers repeatedly.  Possible
+			 * future improvement: accumulate all the items for the new page
+			 * and qsort them before insertion.
+			 */
+			(void) _hash_pgaddtup(rel, nbuf, itemsz, itup);
 		}
 
 		oblkno = oopaque->hasho_nextblkno;
-
-		/*
-		 * Done scanning this old page.  If we moved any tuples, delete them
-		 * from the old page.
-		 */
-		if (ndeletable > 0)
-		{
-			PageIndexMultiDelete(opage, deletable, ndeletable);
-			_hash_wrtbuf(rel, obuf);
-		}
-		else
-			_hash_relbuf(rel, obuf);
+		_hash_relbuf(rel, obuf);
 
 		/* Exit loop if no more overflow pages in old bucket */
 		if (!BlockNumberIsValid(oblkno))
 			break;
 
 		/* Else, advance to next old page */
-		obuf = _hash_getbuf(rel, oblkno, HASH_WRITE, LH_OVERFLOW_PAGE);
+		obuf = _hash_getbuf(rel, oblkno, HASH_READ, LH_OVERFLOW_PAGE);
 		opage = BufferGetPage(obuf);
 		oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
 	}
 
 	/*
-	 * We're at the end of the old bucket chain, so we're done partitioning
-	 * the tuples.  Before quitting, call _hash_squeezebucket to ensure the
-	 * tuples remaining in the old bucket (including the overflow pages) are
-	 * packed as tightly as possible.  The new bucket is already tight.
+	 * We're at the end of the old bucket chain, so we're done copying.  Log
+	 * the last page of the new bucket, which is already tight.
 	 */
-	_hash_wrtbuf(rel, nbuf);
+	START_CRIT_SECTION();
+	MarkBufferDirty(nbuf);
+	_hash_log_pages(rel, InvalidBuffer, &nbuf, 1);
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, nbuf);
+}
+
+/*
+ * _hash_split_cleanup -- remove tuples that don't belong in 'obucket'
+ *
+ * Called after a split of 'obucket' has been made visible in the metapage,
+ * to delete the tuples that were copied to the new bucket (plus any left
+ * behind by an earlier split that didn't finish), and then squeeze the
+ * bucket so that the tuples remaining in it are packed as tightly as
+ * possible.
+ *
+ * The caller must hold an exclusive lock on the bucket, and a pin but no
+ * lock on the metapage buffer.
+ */
+static void
+_hash_split_cleanup(Relation rel, Buffer metabuf,
+					Bucket obucket, BlockNumber start_oblkno)
+{
+	HashMetaPage metap;
+	uint32		maxbucket;
+	uint32		highmask;
+	uint32		lowmask;
+	Buffer		bucket_buf;
+	Buffer		buf;
+	BlockNumber blkno;
+
+	/* Get the bucket mapping, which can't change under our bucket lock */
+	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_READ);
+	metap = HashPageGetMeta(BufferGetPage(metabuf));
+	maxbucket = metap->hashm_maxbucket;
+	highmask = metap->hashm_highmask;
+	lowmask = metap->hashm_lowmask;
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+
+	bucket_buf = buf = _hash_getbuf(rel, start_oblkno, HASH_WRITE,
+									LH_BUCKET_PAGE);
+	for (;;)
+	{
+		Page		page = BufferGetPage(buf);
+		HashPageOpaque opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+		OffsetNumber offnum;
+		OffsetNumber maxoffnum;
+		OffsetNumber deletable[MaxOffsetNumber];
+		int			ndeletable = 0;
+
+		maxoffnum = PageGetMaxOffsetNumber(page);
+		for (offnum = FirstOffsetNumber;
+			 offnum <= maxoffnum;
+			 offnum = OffsetNumberNext(offnum))
+		{
+			IndexTuple	itup;
+			Bucket		bucket;
+
+			itup = (IndexTuple) PageGetItem(page,
+											PageGetItemId(page, offnum));
+			bucket = _hash_hashkey2bucket(_hash_get_indextuple_hashkey(itup),
+										  maxbucket, highmask, lowmask);
+			if (bucket != obucket)
+				deletable[ndeletable++] = offnum;
+		}
+
+		if (ndeletable > 0)
+			_hash_delitems(rel, bucket_buf, buf, deletable, ndeletable);
+
+		blkno = opaque->hasho_nextblkno;
+
+		/* keep the pin on the primary bucket page, release the rest */
+		if (buf == bucket_buf)
+			_hash_chgbufaccess(rel, buf, HASH_READ, HASH_NOLOCK);
+		else
+			_hash_relbuf(rel, buf);
+
+		if (!BlockNumberIsValid(blkno))
+			break;
+
+		buf = _hash_getbuf(rel, blkno, HASH_WRITE, LH_OVERFLOW_PAGE);
+	}
+
+	_hash_squeezebucket(rel, obucket, bucket_buf, NULL);
+
+	_hash_dropbuf(rel, bucket_buf);
+}
+
+/*
+ *	_hash_cachemetap() -- Save a copy of the metapage in the relcache.
+ *
+ * Scans use the copy to locate the target bucket without reading the
+ * metapage; see _hash_first.  The caller must hold at least a share lock on
+ * the metapage buffer that 'metap' points into.
+ */
+void
+_hash_cachemetap(Relation rel, HashMetaPage metap)
+{
+	if (rel->rd_amcache == NULL)
+		rel->rd_amcache = MemoryContextAlloc(rel->rd_indexcxt,
+											 sizeof(HashMetaPageData));
+	memcpy(rel->rd_amcache, metap, sizeof(HashMetaPageData));
+}
+
+/*
+ *	_hash_delitems() -- Delete the given items from a bucket page, and
+ *		WAL-log the deletion.
+ *
+ * 'buf' must be write-locked; 'bucket_buf' is the bucket's primary page,
+ * which must be pinned, and may be the same buffer as 'buf'.  The caller
+ * must hold an exclusive lock on the bucket.
+ */
+void
+_hash_delitems(Relation rel, Buffer bucket_buf, Buffer buf,
+			   OffsetNumber *itemnos, int nitems)
+{
+	Page		page = BufferGetPage(buf);
+
+	/* No ereport(ERROR) until changes are logged */
+	START_CRIT_SECTION();
+
+	PageIndexMultiDelete(page, itemnos, nitems);
+	MarkBufferDirty(buf);
+
+	if (RelationNeedsWAL(rel))
+	{
+		xl_hash_delete xlrec;
+		XLogRecPtr	recptr;
+
+		xlrec.is_primary_bucket_page = (buf == bucket_buf);
+
+		XLogBeginInsert();
+		XLogRegisterData((char *) &xlrec, SizeOfHashDelete);
+
+		if (xlrec.is_primary_bucket_page)
+		{
+			XLogRegisterBuffer(0, buf, REGBUF_STANDARD);
+			XLogRegisterBufData(0, (char *) itemnos,
+								nitems * sizeof(OffsetNumber));
+		}
+		else
+		{
+			/* registered only so that replay locks it, see hash.h */
+			XLogRegisterBuffer(0, bucket_buf, REGBUF_STANDARD | REGBUF_NO_IMAGE);
+			XLogRegisterBuffer(1, buf, REGBUF_STANDARD);
+			XLogRegisterBufData(1, (char *) itemnos,
+								nitems * sizeof(OffsetNumber));
+		}
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_DELETE);
+
+		PageSetLSN(page, recptr);
+	}
+
+	END_CRIT_SECTION();
+}
+
+/*
+ *	_hash_log_pages() -- WAL-log full images of modified pages.
+ *
+ * This is how all changes to the structure of a hash index are logged; see
+ * the description of XLOG_HASH_PAGES in hash.h.  The caller must be inside
+ * a critical section, hold exclusive locks on all the buffers in 'bufs',
+ * and have marked them dirty.  If the change moves or removes tuples of a
+ * bucket, 'bucket_buf' is the bucket's primary page, which must be pinned;
+ * otherwise it is InvalidBuffer.  It may be included in 'bufs' as well.
+ */
+void
+_hash_log_pages(Relation rel, Buffer bucket_buf, Buffer *bufs, int nbufs)
+{
+	xl_hash_pages xlrec;
+	XLogRecPtr	recptr;
+	uint8		block_id = 0;
+	int			i;
+
+	Assert(nbufs + (BufferIsValid(bucket_buf) ? 1 : 0) <= HASH_XLOG_MAX_PAGES);
+
+	if (!RelationNeedsWAL(rel))
+		return;
+
+	xlrec.flags = BufferIsValid(bucket_buf) ? XLH_PAGES_BUCKET_CLEANUP : 0;
+
+	XLogBeginInsert();
+	XLogRegisterData((char *) &xlrec, SizeOfHashPages);
+
+	/* The primary bucket page, if any, comes first */
+	if (BufferIsValid(bucket_buf))
+	{
+		uint8		flags = REGBUF_STANDARD | REGBUF_NO_IMAGE;
+
+		for (i = 0; i < nbufs; i++)
+		{
+			if (bufs[i] == bucket_buf)
+				flags = REGBUF_STANDARD | REGBUF_FORCE_IMAGE;
+		}
+		XLogRegisterBuffer(block_id++, bucket_buf, flags);
+	}
+
+	for (i = 0; i < nbufs; i++)
+	{
+		Page		page = BufferGetPage(bufs[i]);
+		HashPageOpaque opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+		uint8		flags = REGBUF_FORCE_IMAGE;
+
+		if (bufs[i] == bucket_buf)
+			continue;
+
+		/* the metapage and bitmap pages keep their data in the "hole" */
+		if ((opaque->hasho_flag & (LH_META_PAGE | LH_BITMAP_PAGE)) == 0)
+			flags |= REGBUF_STANDARD;
+
+		XLogRegisterBuffer(block_id++, bufs[i], flags);
+	}
+
+	recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_PAGES);
 
-	_hash_squeezebucket(rel, obucket, start_oblkno, NULL);
+	for (i = 0; i < nbufs; i++)
+		PageSetLSN(BufferGetPage(bufs[i]), recptr);
 }
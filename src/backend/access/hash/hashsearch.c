@@ -93,7 +93,11 @@ _hash_readprev(Relation rel,
 {
 	BlockNumber blkno;
 
-	blkno = (*opaquep)->hasho_prevblkno;
+	/* a primary bucket page's hasho_prevblkno is not a block number */
+	if ((*opaquep)->hasho_flag & LH_BUCKET_PAGE)
+		blkno = InvalidBlockNumber;
+	else
+		blkno = (*opaquep)->hasho_prevblkno;
 	_hash_relbuf(rel, *bufp);
 	*bufp = InvalidBuffer;
 	/* check for interrupts while we're not holding any buffer lock */
@@ -125,8 +129,7 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 	uint32		hashkey;
 	Bucket		bucket;
 	BlockNumber blkno;
-	BlockNumber oldblkno = InvalidBuffer;
-	bool		retry = false;
+	uint32		cached_maxbucket;
 	Buffer		buf;
 	Buffer		metabuf;
 	Page		page;
@@ -186,15 +189,29 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 
 	so->hashso_sk_hash = hashkey;
 
-	/* Read the metapage */
-	metabuf = _hash_getbuf(rel, HASH_METAPAGE, HASH_READ, LH_META_PAGE);
-	metap = HashPageGetMeta(BufferGetPage(metabuf));
-
 	/*
 	 * Loop until we get a lock on the correct target bucket.
+	 *
+	 * The bucket is computed from the copy of the metapage cached in the
+	 * relcache entry, so that an ordinary lookup need not touch the real
+	 * metapage at all.  The copy may be out of date, but once we hold the
+	 * bucket lock, the primary bucket page tells us whether the bucket has
+	 * been split since the copy was taken: if so, hasho_prevblkno holds a
+	 * value of hashm_maxbucket larger than the cached one.  In that case we
+	 * refresh the cache and try again.  (A bucket cannot be split while we
+	 * hold its lock, and on a hot standby server our pin on the primary page
+	 * keeps the split from being cleaned up under us.)
 	 */
 	for (;;)
 	{
+		if (rel->rd_amcache == NULL)
+		{
+			metabuf = _hash_getbuf(rel, HASH_METAPAGE, HASH_READ, LH_META_PAGE);
+			_hash_cachemetap(rel, HashPageGetMeta(BufferGetPage(metabuf)));
+			_hash_relbuf(rel, metabuf);
+		}
+		metap = (HashMetaPage) rel->rd_amcache;
+
 		/*
 		 * Compute the target bucket number, and convert to block number.
 		 */
@@ -204,45 +221,37 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 									  metap->hashm_lowmask);
 
 		blkno = BUCKET_TO_BLKNO(metap, bucket);
+		cached_maxbucket = metap->hashm_maxbucket;
 
-		/* Release metapage lock, but keep pin. */
-		_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
-
-		/*
-		 * If the previous iteration of this loop locked what is still the
-		 * correct target bucket, we are done.  Otherwise, drop any old lock
-		 * and lock what now appears to be the correct bucket.
-		 */
-		if (retry)
-		{
-			if (oldblkno == blkno)
-				break;
-			_hash_droplock(rel, oldblkno, HASH_SHARE);
-		}
 		_hash_getlock(rel, blkno, HASH_SHARE);
 
-		/*
-		 * Reacquire metapage lock and check that no bucket split has taken
-		 * place while we were awaiting the bucket lock.
-		 */
-		_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_READ);
-		oldblkno = blkno;
-		retry = true;
-	}
+		/* Fetch the primary bucket page for the bucket */
+		buf = _hash_getbuf(rel, blkno, HASH_READ, LH_BUCKET_PAGE);
+		page = BufferGetPage(buf);
+		opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+		Assert(opaque->hasho_bucket == bucket);
 
-	/* done with the metapage */
-	_hash_dropbuf(rel, metabuf);
+		if (opaque->hasho_prevblkno <= cached_maxbucket)
+			break;
+
+		/* the cached metapage is stale; drop everything and refresh it */
+		_hash_relbuf(rel, buf);
+		_hash_droplock(rel, blkno, HASH_SHARE);
+
+		metabuf = _hash_getbuf(rel, HASH_METAPAGE, HASH_READ, LH_META_PAGE);
+		_hash_cachemetap(rel, HashPageGetMeta(BufferGetPage(metabuf)));
+		_hash_relbuf(rel, metabuf);
+	}
 
-	/* Update scan opaque state to show we have lock on the bucket */
+	/*
+	 * Update scan opaque state to show we have lock on the bucket, and keep
+	 * a pin on its primary page for as long as we do.
+	 */
 	so->hashso_bucket = bucket;
 	so->hashso_bucket_valid = true;
 	so->hashso_bucket_blkno = blkno;
-
-	/* Fetch the primary bucket page for the bucket */
-	buf = _hash_getbuf(rel, blkno, HASH_READ, LH_BUCKET_PAGE);
-	page = BufferGetPage(buf);
-	opaque = (HashPageOpaque) PageGetSpecialPointer(page);
-	Assert(opaque->hasho_bucket == bucket);
+	IncrBufferRefCount(buf);
+	so->hashso_bucket_buf = buf;
 
 	/* If a backwards scan is requested, move to the end of the chain */
 	if (ScanDirectionIsBackward(dir))
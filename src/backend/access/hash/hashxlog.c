@@ -0,0 +1,196 @@
+/*-------------------------------------------------------------------------
+ *
+ * hashxlog.c
+ *	  WAL replay logic for hash indexes
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/hash/hashxlog.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/hash.h"
+#include "access/xlogutils.h"
+
+
+/*
+ * replay an index tuple insertion, and the metapage tuple count increment
+ * that goes with it
+ */
+static void
+hash_xlog_insert(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_insert *xlrec = (xl_hash_insert *) XLogRecGetData(record);
+	Buffer		buffer;
+	Page		page;
+
+	if (XLogReadBufferForRedo(record, 0, &buffer) == BLK_NEEDS_REDO)
+	{
+		Size		datalen;
+		char	   *datapos = XLogRecGetBlockData(record, 0, &datalen);
+
+		page = BufferGetPage(buffer);
+
+		if (PageAddItem(page, (Item) datapos, datalen, xlrec->offnum,
+						false, false) == InvalidOffsetNumber)
+			elog(PANIC, "hash_xlog_insert: failed to add item");
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+
+	if (XLogReadBufferForRedo(record, 1, &buffer) == BLK_NEEDS_REDO)
+	{
+		HashMetaPage metap;
+
+		page = BufferGetPage(buffer);
+		metap = HashPageGetMeta(page);
+		metap->hashm_ntuples += 1;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * replay deletion of index tuples from a bucket page
+ */
+static void
+hash_xlog_delete(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_delete *xlrec = (xl_hash_delete *) XLogRecGetData(record);
+	Buffer		bucketbuf;
+	Buffer		buffer;
+	XLogRedoAction action;
+	uint8		block_id;
+
+	/*
+	 * Take a cleanup lock on the primary bucket page, so that no hot standby
+	 * scan of the bucket is in progress while tuples vanish from it.
+	 */
+	action = XLogReadBufferForRedoExtended(record, 0, RBM_NORMAL, true,
+										   &bucketbuf);
+	if (xlrec->is_primary_bucket_page)
+	{
+		buffer = bucketbuf;
+		block_id = 0;
+	}
+	else
+	{
+		action = XLogReadBufferForRedo(record, 1, &buffer);
+		block_id = 1;
+	}
+
+	if (action == BLK_NEEDS_REDO)
+	{
+		Page		page = BufferGetPage(buffer);
+		Size		len;
+		OffsetNumber *unused;
+
+		unused = (OffsetNumber *) XLogRecGetBlockData(record, block_id, &len);
+
+		PageIndexMultiDelete(page, unused, len / sizeof(OffsetNumber));
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	if (BufferIsValid(buffer) && buffer != bucketbuf)
+		UnlockReleaseBuffer(buffer);
+	if (BufferIsValid(bucketbuf))
+		UnlockReleaseBuffer(bucketbuf);
+}
+
+/*
+ * replay the tuple count update done at the end of VACUUM
+ */
+static void
+hash_xlog_update_meta(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_update_meta *xlrec = (xl_hash_update_meta *) XLogRecGetData(record);
+	Buffer		buffer;
+
+	if (XLogReadBufferForRedo(record, 0, &buffer) == BLK_NEEDS_REDO)
+	{
+		Page		page = BufferGetPage(buffer);
+		HashMetaPage metap = HashPageGetMeta(page);
+
+		metap->hashm_ntuples = xlrec->ntuples;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * replay a structural change, logged as full-page images
+ */
+static void
+hash_xlog_pages(XLogReaderState *record)
+{
+	xl_hash_pages *xlrec = (xl_hash_pages *) XLogRecGetData(record);
+	Buffer		buffers[XLR_MAX_BLOCK_ID + 1];
+	int			block_id;
+
+	/*
+	 * Restore all the pages, holding the locks until all of them are done so
+	 * that hot standby scans see the change atomically.  If tuples of a
+	 * bucket are moved or removed, the primary bucket page comes first and
+	 * must be cleanup-locked; if it was not modified itself, it carries no
+	 * image and there is nothing to restore.
+	 */
+	for (block_id = 0; block_id <= record->max_block_id; block_id++)
+	{
+		bool		get_cleanup_lock;
+
+		get_cleanup_lock = (block_id == 0 &&
+							(xlrec->flags & XLH_PAGES_BUCKET_CLEANUP) != 0);
+
+		(void) XLogReadBufferForRedoExtended(record, block_id, RBM_NORMAL,
+											 get_cleanup_lock,
+											 &buffers[block_id]);
+	}
+
+	for (block_id = 0; block_id <= record->max_block_id; block_id++)
+	{
+		if (BufferIsValid(buffers[block_id]))
+			UnlockReleaseBuffer(buffers[block_id]);
+	}
+}
+
+void
+hash_redo(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	switch (info)
+	{
+		case XLOG_HASH_INSERT:
+			hash_xlog_insert(record);
+			break;
+		case XLOG_HASH_DELETE:
+			hash_xlog_delete(record);
+			break;
+		case XLOG_HASH_UPDATE_META:
+			hash_xlog_update_meta(record);
+			break;
+		case XLOG_HASH_PAGES:
+			hash_xlog_pages(record);
+			break;
+		default:
+			elog(PANIC, "hash_redo: unknown op code %u", info);
+	}
+}
@@ -12,9 +12,12 @@
 #include "miscadmin.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "utils/inval.h"
 #include "utils/array.h"
+#include "utils/hsearch.h"
 #include "utils/relfilenodemap.h"
 #include <unistd.h>
 #include <sys/stat.h>
@@ -34,6 +37,38 @@
 
 #define HEAPBLOCKS_PER_PAGE (MAPSIZE * HEAPBLOCKS_PER_BYTE)
 
+/*
+ * Blocks changed since the last checkpoint are collected in a shared hash
+ * table and written to the ptrack forks in batches by ptrack_flush(), at
+ * checkpoint or before the forks are read. An entry covers a run of
+ * PTRACK_BLOCKS_PER_ENTRY blocks of the main fork, aligned on a multiple of
+ * it, so that sequential changes share the entry.
+ */
+#define PTRACK_BLOCKS_PER_ENTRY 64
+
+typedef struct PtrackPendingTag
+{
+	RelFileNode		rnode;
+	BlockNumber		chunk;		/* block number / PTRACK_BLOCKS_PER_ENTRY */
+} PtrackPendingTag;
+
+typedef struct PtrackPendingEntry
+{
+	PtrackPendingTag tag;		/* hash key, must be first */
+	uint64			bits;		/* changed blocks of the chunk */
+} PtrackPendingEntry;
+
+#define PtrackPartitionLockByIndex(i) \
+	(&MainLWLockArray[PTRACK_LWLOCK_OFFSET + (i)].lock)
+#define PtrackPartitionLock(hashcode) \
+	PtrackPartitionLockByIndex((hashcode) % NUM_PTRACK_PARTITIONS)
+
+static HTAB *PtrackPendingHash = NULL;
+
+/*
+ * Blocks which did not fit into the shared table, saved directly to the
+ * ptrack fork by ptrack_save() at the end of critical section.
+ */
 typedef struct BlockTrack
 {
 	BlockNumber		block_number;
@@ -46,15 +81,116 @@ bool ptrack_enable = false;
 
 static Buffer ptrack_readbuf(RelFileNode rnode, BlockNumber blkno, bool extend);
 static void ptrack_extend(SMgrRelation smgr, BlockNumber nvmblocks);
-static void ptrack_set(BlockNumber heapBlk, Buffer vmBuf);
+static void ptrack_set(BlockNumber heapBlk, uint64 bits, Buffer vmBuf);
+static bool ptrack_add_pending(BlockNumber block_number, RelFileNode rel);
 void SetPtrackClearLSN(bool set_invalid);
 Datum pg_ptrack_test(PG_FUNCTION_ARGS);
 
+/* Size of the shared table of changed blocks, in entries */
+static long
+PtrackPendingSize(void)
+{
+	return Max(NBuffers, 1024);
+}
+
+Size
+PtrackShmemSize(void)
+{
+	return hash_estimate_size(PtrackPendingSize(), sizeof(PtrackPendingEntry));
+}
+
+void
+PtrackShmemInit(void)
+{
+	HASHCTL		info;
+
+	StaticAssertStmt(HEAPBLOCKS_PER_PAGE % PTRACK_BLOCKS_PER_ENTRY == 0,
+					 "ptrack pending entry must not cross ptrack map pages");
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(PtrackPendingTag);
+	info.entrysize = sizeof(PtrackPendingEntry);
+	info.num_partitions = NUM_PTRACK_PARTITIONS;
+
+	/*
+	 * Entries are added inside critical sections, so the table is allocated
+	 * at its full size and never grows.
+	 */
+	PtrackPendingHash = ShmemInitHash("ptrack pending blocks",
+									  PtrackPendingSize(),
+									  PtrackPendingSize(),
+									  &info,
+									  HASH_ELEM | HASH_BLOBS |
+									  HASH_PARTITION | HASH_FIXED_SIZE);
+}
+
+/*
+ * Remember a changed block in the shared table. Returns false if the table
+ * is full. This is called when the buffer is registered for WAL, so the
+ * block is in the table before its WAL record gets a position, and the
+ * checkpoint whose redo pointer follows the record writes it to the fork.
+ */
+static bool
+ptrack_add_pending(BlockNumber block_number, RelFileNode rel)
+{
+	PtrackPendingTag tag;
+	PtrackPendingEntry *entry;
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	uint64		bit = UINT64CONST(1) << (block_number % PTRACK_BLOCKS_PER_ENTRY);
+	bool		found;
+
+	if (PtrackPendingHash == NULL)
+		return false;
+
+	/* clear padding, the whole tag is hashed */
+	MemSet(&tag, 0, sizeof(tag));
+	tag.rnode = rel;
+	tag.chunk = block_number / PTRACK_BLOCKS_PER_ENTRY;
+
+	hashcode = get_hash_value(PtrackPendingHash, &tag);
+	partitionLock = PtrackPartitionLock(hashcode);
+
+	/* Most of the time the block is there already */
+	LWLockAcquire(partitionLock, LW_SHARED);
+	entry = (PtrackPendingEntry *)
+		hash_search_with_hash_value(PtrackPendingHash, &tag, hashcode,
+									HASH_FIND, NULL);
+	if (entry != NULL && (entry->bits & bit))
+	{
+		LWLockRelease(partitionLock);
+		return true;
+	}
+	LWLockRelease(partitionLock);
+
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+	entry = (PtrackPendingEntry *)
+		hash_search_with_hash_value(PtrackPendingHash, &tag, hashcode,
+									HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+	{
+		LWLockRelease(partitionLock);
+		return false;
+	}
+	if (!found)
+		entry->bits = 0;
+	entry->bits |= bit;
+	LWLockRelease(partitionLock);
+
+	return true;
+}
+
 /* Tracking memory block inside critical zone */
 void
 ptrack_add_block(BlockNumber block_number, RelFileNode rel)
 {
-	BlockTrack *bt = &blocks_track[blocks_track_count];
+	BlockTrack *bt;
+
+	if (ptrack_add_pending(block_number, rel))
+		return;
+
+	/* The shared table is full, save the block at end of critical zone */
+	bt = &blocks_track[blocks_track_count];
 	bt->block_number = block_number;
 	bt->rel = rel;
 	blocks_track_count++;
@@ -76,15 +212,20 @@ ptrack_save(void)
 		/* Reuse the old pinned buffer if possible */
 		if (BufferIsValid(pbuf))
 		{
-			if (BufferGetBlockNumber(pbuf) == mapBlock)
+			if (i > 0 && RelFileNodeEquals(blocks_track[i - 1].rel, bt->rel) &&
+				BufferGetBlockNumber(pbuf) == mapBlock)
 				goto set_bit;
 			else
 				ReleaseBuffer(pbuf);
 		}
 
 		pbuf = ptrack_readbuf(bt->rel, mapBlock, true);
+		if (!BufferIsValid(pbuf))
+			continue;
 		set_bit:
-		ptrack_set(bt->block_number, pbuf);
+		ptrack_set(bt->block_number - bt->block_number % PTRACK_BLOCKS_PER_ENTRY,
+				   UINT64CONST(1) << (bt->block_number % PTRACK_BLOCKS_PER_ENTRY),
+				   pbuf);
 	}
 	if (pbuf != InvalidBuffer)
 		ReleaseBuffer(pbuf);
@@ -92,15 +233,168 @@ ptrack_save(void)
 	blocks_track_count = 0;
 }
 
-/* Set one bit to buffer */
+static int
+ptrack_pending_cmp(const void *a, const void *b)
+{
+	const PtrackPendingTag *ta = &((const PtrackPendingEntry *) a)->tag;
+	const PtrackPendingTag *tb = &((const PtrackPendingEntry *) b)->tag;
+
+	if (ta->rnode.spcNode != tb->rnode.spcNode)
+		return ta->rnode.spcNode < tb->rnode.spcNode ? -1 : 1;
+	if (ta->rnode.dbNode != tb->rnode.dbNode)
+		return ta->rnode.dbNode < tb->rnode.dbNode ? -1 : 1;
+	if (ta->rnode.relNode != tb->rnode.relNode)
+		return ta->rnode.relNode < tb->rnode.relNode ? -1 : 1;
+	if (ta->chunk != tb->chunk)
+		return ta->chunk < tb->chunk ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Write the blocks collected in the shared table to the ptrack forks.
+ *
+ * The table is emptied under all its partition locks, then the bits are set
+ * in the fork buffers in relation and block order, so each map page is
+ * locked once per flush rather than once per change. PtrackFlushLock is
+ * held until the bits are in the buffers, so that a checkpoint can't write
+ * out the fork buffers while another flush is half done.
+ */
+void
+ptrack_flush(void)
+{
+	HASH_SEQ_STATUS status;
+	PtrackPendingEntry *entry;
+	PtrackPendingEntry *entries = NULL;
+	long		nentries;
+	long		i;
+	Buffer		pbuf = InvalidBuffer;
+	int			p;
+
+	if (PtrackPendingHash == NULL)
+		return;
+
+	LWLockAcquire(PtrackFlushLock, LW_EXCLUSIVE);
+
+	for (p = 0; p < NUM_PTRACK_PARTITIONS; p++)
+		LWLockAcquire(PtrackPartitionLockByIndex(p), LW_EXCLUSIVE);
+
+	nentries = hash_get_num_entries(PtrackPendingHash);
+	if (nentries > 0)
+	{
+		entries = (PtrackPendingEntry *)
+			palloc(sizeof(PtrackPendingEntry) * nentries);
+
+		i = 0;
+		hash_seq_init(&status, PtrackPendingHash);
+		while ((entry = (PtrackPendingEntry *) hash_seq_search(&status)) != NULL)
+		{
+			entries[i++] = *entry;
+			hash_search(PtrackPendingHash, &entry->tag, HASH_REMOVE, NULL);
+		}
+		Assert(i == nentries);
+	}
+
+	for (p = NUM_PTRACK_PARTITIONS; --p >= 0;)
+		LWLockRelease(PtrackPartitionLockByIndex(p));
+
+	if (nentries > 0)
+	{
+		qsort(entries, nentries, sizeof(PtrackPendingEntry), ptrack_pending_cmp);
+
+		for (i = 0; i < nentries; i++)
+		{
+			BlockNumber heapBlk = entries[i].tag.chunk * PTRACK_BLOCKS_PER_ENTRY;
+			BlockNumber mapBlock = HEAPBLK_TO_MAPBLOCK(heapBlk);
+
+			/* Reuse the old pinned buffer if possible */
+			if (BufferIsValid(pbuf))
+			{
+				if (RelFileNodeEquals(entries[i - 1].tag.rnode, entries[i].tag.rnode) &&
+					BufferGetBlockNumber(pbuf) == mapBlock)
+					goto set_bits;
+				else
+					ReleaseBuffer(pbuf);
+			}
+
+			pbuf = ptrack_readbuf(entries[i].tag.rnode, mapBlock, true);
+			if (!BufferIsValid(pbuf))
+				continue;
+			set_bits:
+			ptrack_set(heapBlk, entries[i].bits, pbuf);
+		}
+		if (BufferIsValid(pbuf))
+			ReleaseBuffer(pbuf);
+
+		pfree(entries);
+	}
+
+	LWLockRelease(PtrackFlushLock);
+}
+
+/*
+ * Forget the blocks collected for relations being dropped, so that a later
+ * flush doesn't write them.
+ *
+ * This runs for every dropped relation, so take the locks only when there is
+ * something to forget. The blocks of the relations were added under their
+ * lock, which we hold, so reading the number of entries without the
+ * partition locks can't miss any of them.
+ */
 void
-ptrack_set(BlockNumber heapBlk, Buffer vmBuf)
+ptrack_forget_relations(RelFileNodeBackend *rnodes, int nrels)
+{
+	HASH_SEQ_STATUS status;
+	PtrackPendingEntry *entry;
+	int			p;
+	int			i;
+
+	if (!ptrack_enable || PtrackPendingHash == NULL)
+		return;
+
+	if (hash_get_num_entries(PtrackPendingHash) == 0)
+		return;
+
+	/* wait for a flush in progress, it could be writing to their forks */
+	LWLockAcquire(PtrackFlushLock, LW_SHARED);
+
+	for (p = 0; p < NUM_PTRACK_PARTITIONS; p++)
+		LWLockAcquire(PtrackPartitionLockByIndex(p), LW_EXCLUSIVE);
+
+	hash_seq_init(&status, PtrackPendingHash);
+	while ((entry = (PtrackPendingEntry *) hash_seq_search(&status)) != NULL)
+	{
+		for (i = 0; i < nrels; i++)
+		{
+			if (!RelFileNodeBackendIsTemp(rnodes[i]) &&
+				RelFileNodeEquals(entry->tag.rnode, rnodes[i].node))
+			{
+				hash_search(PtrackPendingHash, &entry->tag, HASH_REMOVE, NULL);
+				break;
+			}
+		}
+	}
+
+	for (p = NUM_PTRACK_PARTITIONS; --p >= 0;)
+		LWLockRelease(PtrackPartitionLockByIndex(p));
+
+	LWLockRelease(PtrackFlushLock);
+}
+
+/*
+ * Set bits of a run of PTRACK_BLOCKS_PER_ENTRY blocks starting at heapBlk
+ * in the ptrack map buffer.
+ */
+static void
+ptrack_set(BlockNumber heapBlk, uint64 bits, Buffer vmBuf)
 {
 	BlockNumber mapBlock = HEAPBLK_TO_MAPBLOCK(heapBlk);
 	uint32		mapByte = HEAPBLK_TO_MAPBYTE(heapBlk);
-	uint8		mapBit = HEAPBLK_TO_MAPBIT(heapBlk);
 	Page		page;
 	char	   *map;
+	bool		all_set = true;
+	int			i;
+
+	Assert(heapBlk % PTRACK_BLOCKS_PER_ENTRY == 0);
 
 	/* Check that we have the right VM page pinned */
 	if (!BufferIsValid(vmBuf) || BufferGetBlockNumber(vmBuf) != mapBlock)
@@ -109,20 +403,27 @@ ptrack_set(BlockNumber heapBlk, Buffer vmBuf)
 	map = PageGetContents(page);
 	LockBuffer(vmBuf, BUFFER_LOCK_SHARE);
 
-	if (!(map[mapByte] & (1 << mapBit)))
+	for (i = 0; i < PTRACK_BLOCKS_PER_ENTRY / HEAPBLOCKS_PER_BYTE; i++)
+	{
+		uint8		mask = (uint8) (bits >> (i * HEAPBLOCKS_PER_BYTE));
+
+		if ((map[mapByte + i] & mask) != mask)
+			all_set = false;
+	}
+
+	if (!all_set)
 	{
 		/* Bad luck. Take an exclusive lock now after unlock share.*/
 		LockBuffer(vmBuf, BUFFER_LOCK_UNLOCK);
 		LockBuffer(vmBuf, BUFFER_LOCK_EXCLUSIVE);
-		if (!(map[mapByte] & (1 << mapBit)))
-		{
-			START_CRIT_SECTION();
 
-			map[mapByte] |= (1 << mapBit);
-			MarkBufferDirty(vmBuf);
+		START_CRIT_SECTION();
 
-			END_CRIT_SECTION_WITHOUT_TRACK();
-		}
+		for (i = 0; i < PTRACK_BLOCKS_PER_ENTRY / HEAPBLOCKS_PER_BYTE; i++)
+			map[mapByte + i] |= (uint8) (bits >> (i * HEAPBLOCKS_PER_BYTE));
+		MarkBufferDirty(vmBuf);
+
+		END_CRIT_SECTION_WITHOUT_TRACK();
 	}
 
 	LockBuffer(vmBuf, BUFFER_LOCK_UNLOCK);
@@ -150,10 +451,21 @@ ptrack_readbuf(RelFileNode rnode, BlockNumber blkno, bool extend)
 	/* Handle requests beyond EOF */
 	if (blkno >= smgr->smgr_ptrack_nblocks)
 	{
-		if (extend)
-			ptrack_extend(smgr, blkno + 1);
-		else
+		if (!extend)
 			return InvalidBuffer;
+
+		/*
+		 * Don't create the fork of a relation dropped after its blocks were
+		 * collected, by a backend that had ptrack_enable off and so did not
+		 * forget them. Its main fork is gone, or truncated until the next
+		 * checkpoint.
+		 */
+		if (smgr->smgr_ptrack_nblocks == 0 &&
+			(!smgrexists(smgr, MAIN_FORKNUM) ||
+			 smgrnblocks(smgr, MAIN_FORKNUM) == 0))
+			return InvalidBuffer;
+
+		ptrack_extend(smgr, blkno + 1);
 	}
 
 	/*
@@ -222,8 +534,14 @@ void
 ptrack_clear(void)
 {
 	HeapTuple tuple;
-	Relation catalog = heap_open(RelationRelationId, AccessShareLock);
-	SysScanDesc scan = systable_beginscan(catalog, InvalidOid, false, NULL, 0, NULL);
+	Relation catalog;
+	SysScanDesc scan;
+
+	/* Write pending changes first, they are cleared too */
+	ptrack_flush();
+
+	catalog = heap_open(RelationRelationId, AccessShareLock);
+	scan = systable_beginscan(catalog, InvalidOid, false, NULL, 0, NULL);
 
 	while (HeapTupleIsValid(tuple = systable_getnext(scan)))
 	{
@@ -279,6 +597,9 @@ ptrack_get_and_clear(Oid tablespace_oid, Oid table_oid)
 	BlockNumber nblock;
 	Relation rel;
 
+	/* Make pending changes visible in the ptrack fork */
+	ptrack_flush();
+
 	if (table_oid == InvalidOid)
 	{
 		elog(WARNING, "InvalidOid");
@@ -351,19 +672,28 @@ SetPtrackClearLSN(bool set_invalid)
 {
 	int			fd;
 	XLogRecPtr	ptr;
+	char		path[MAXPGPATH];
+
 	if (set_invalid)
 		ptr = InvalidXLogRecPtr;
 	else
 		ptr = GetXLogInsertRecPtr();
+
+	/*
+	 * Use an absolute path: the postmaster applies ptrack_enable from
+	 * postgresql.conf before it has changed into the data directory.
+	 */
+	snprintf(path, MAXPGPATH, "%s/global/ptrack_control", DataDir);
+
 	/* LWLockAcquire(ControlFileLock, LW_EXCLUSIVE); */
-	fd = BasicOpenFile("global/ptrack_control",
+	fd = BasicOpenFile(path,
 					   O_RDWR | O_CREAT | PG_BINARY,
 					   S_IRUSR | S_IWUSR);
 	if (fd < 0)
 		ereport(PANIC,
 				(errcode_for_file_access(),
 				 errmsg("could not create ptrack control file \"%s\": %m",
-						"global/ptrack_control")));
+						path)));
 
 	errno = 0;
 	if (write(fd, &ptr, sizeof(XLogRecPtr)) != sizeof(XLogRecPtr))
@@ -410,6 +740,8 @@ pg_ptrack_test(PG_FUNCTION_ARGS)
 				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
 		 (errmsg("must be superuser or replication role to clear ptrack files"))));
 
+	ptrack_flush();
+
 	/* get LSN from ptrack_control file */
 	fd = BasicOpenFile("global/ptrack_control",
 					   O_RDONLY | PG_BINARY,
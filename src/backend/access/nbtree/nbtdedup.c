@@ -0,0 +1,410 @@
+/*-------------------------------------------------------------------------
+ *
+ * nbtdedup.c
+ *	  Deduplicate items in Postgres btrees.
+ *
+ * Leaf tuples with equal keys are merged into "posting list" tuples, which
+ * store the key once followed by the heap TIDs of all the merged tuples (see
+ * the comments about posting list tuples in nbtree.h).  During inserts this
+ * is done lazily, only when a leaf page would otherwise have to be split;
+ * index builds merge duplicates as the sorted tuples are loaded.
+ *
+ * Keys are considered equal only if their stored images are bitwise
+ * identical.  That is stricter than opclass equality (it never merges, say,
+ * numeric 1.0 with 1.00), but it is always safe, because any two
+ * binary-identical keys must also compare as equal.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/nbtree/nbtdedup.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/nbtree.h"
+#include "access/xloginsert.h"
+#include "catalog/catalog.h"
+#include "miscadmin.h"
+#include "utils/rel.h"
+
+
+static Size _bt_keysize(IndexTuple itup);
+static bool _bt_dedup_equal(IndexTuple a, IndexTuple b);
+static void _bt_dedup_addtup(Page newpage, IndexTuple itup, bool dead);
+static int	_bt_htid_cmp(const void *a, const void *b);
+
+
+/*
+ *	_bt_dedup_allowed() -- May duplicates in this index be merged?
+ *
+ *		Posting lists would confuse _bt_check_unique(), so unique indexes are
+ *		never deduplicated.  Note that we must look at indisunique here, not
+ *		at the IndexInfo of an index build: REINDEX and CLUSTER turn off
+ *		ii_Unique to skip the uniqueness check, but later inserts still do it.
+ *
+ *		System catalog indexes are left alone too, so that a scan still
+ *		returns equal catalog entries in the order it always did; code such
+ *		as the dependency machinery reports objects in that order.
+ */
+bool
+_bt_dedup_allowed(Relation rel)
+{
+	return !rel->rd_index->indisunique &&
+		!IsCatalogRelation(rel) &&
+		BTGetDeduplicateItems(rel);
+}
+
+/*
+ *	_bt_dedup_one_page() -- Merge duplicates on a leaf page to make room.
+ *
+ *		Called when the leaf page in buf has no room for a new item, after
+ *		any LP_DEAD items have already been removed.  Each run of adjacent
+ *		tuples with equal keys is replaced by as few posting list tuples as
+ *		BTMaxItemSize allows.  Tuples that are marked LP_DEAD are left alone,
+ *		so that a later _bt_vacuum_one_page() can still remove them.
+ *
+ *		The page is rewritten as a whole and WAL-logged with a full page
+ *		image.  Returns true if anything was merged; in that case the caller
+ *		must not rely on any item offsets it remembered from before the call.
+ *
+ *		The buffer must be exclusive-locked by the caller.
+ */
+bool
+_bt_dedup_one_page(Relation rel, Buffer buf)
+{
+	Page		page = BufferGetPage(buf);
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	Size		maxitemsz = BTMaxItemSize(page);
+	OffsetNumber minoff;
+	OffsetNumber maxoff;
+	OffsetNumber offnum;
+	IndexTuple	previtup = NULL;
+	bool		anyequal = false;
+	Page		newpage;
+	BTDedupState *dstate;
+	IndexTuple	pending;
+
+	Assert(P_ISLEAF(opaque));
+
+	if (!_bt_dedup_allowed(rel))
+		return false;
+
+	minoff = P_FIRSTDATAKEY(opaque);
+	maxoff = PageGetMaxOffsetNumber(page);
+
+	/*
+	 * Do a quick pass first to see whether there is anything to merge at
+	 * all, so that pages without duplicates don't pay for the rewrite.
+	 */
+	for (offnum = minoff; offnum <= maxoff; offnum = OffsetNumberNext(offnum))
+	{
+		ItemId		itemid = PageGetItemId(page, offnum);
+		IndexTuple	itup = (IndexTuple) PageGetItem(page, itemid);
+
+		if (ItemIdIsDead(itemid))
+		{
+			previtup = NULL;
+			continue;
+		}
+		if (previtup != NULL && _bt_dedup_equal(previtup, itup) &&
+			MAXALIGN(_bt_keysize(previtup) +
+					 (BTreeTupleGetNHeapTIDs(previtup) +
+					  BTreeTupleGetNHeapTIDs(itup)) * sizeof(ItemPointerData))
+			<= maxitemsz)
+		{
+			anyequal = true;
+			break;
+		}
+		previtup = itup;
+	}
+
+	if (!anyequal)
+		return false;
+
+	/*
+	 * Build the deduplicated page in a temporary copy.  Nothing is changed
+	 * on the real page until the copy is complete.
+	 */
+	newpage = PageGetTempPageCopySpecial(page);
+	dstate = _bt_dedup_begin(maxitemsz);
+
+	if (!P_RIGHTMOST(opaque))
+	{
+		ItemId		hitemid = PageGetItemId(page, P_HIKEY);
+
+		_bt_dedup_addtup(newpage, (IndexTuple) PageGetItem(page, hitemid),
+						 false);
+	}
+
+	for (offnum = minoff; offnum <= maxoff; offnum = OffsetNumberNext(offnum))
+	{
+		ItemId		itemid = PageGetItemId(page, offnum);
+		IndexTuple	itup = (IndexTuple) PageGetItem(page, itemid);
+
+		if (!ItemIdIsDead(itemid) && _bt_dedup_save_htids(dstate, itup))
+			continue;
+
+		/* itup doesn't belong to the pending group, so finish that off */
+		pending = _bt_dedup_finish_pending(dstate);
+		if (pending != NULL)
+		{
+			_bt_dedup_addtup(newpage, pending, false);
+			pfree(pending);
+		}
+
+		if (ItemIdIsDead(itemid))
+			_bt_dedup_addtup(newpage, itup, true);
+		else
+			_bt_dedup_start_pending(dstate, itup);
+	}
+
+	pending = _bt_dedup_finish_pending(dstate);
+	if (pending != NULL)
+	{
+		_bt_dedup_addtup(newpage, pending, false);
+		pfree(pending);
+	}
+
+	_bt_dedup_end(dstate);
+
+	/* No ereport(ERROR) until changes are logged */
+	START_CRIT_SECTION();
+
+	PageRestoreTempPage(newpage, page);
+	MarkBufferDirty(buf);
+
+	/*
+	 * There is no dedicated WAL record for deduplication; since it only
+	 * happens in place of a page split, a full page image is affordable.
+	 */
+	if (RelationNeedsWAL(rel))
+		log_newpage_buffer(buf, true);
+
+	END_CRIT_SECTION();
+
+	return true;
+}
+
+/*
+ *	_bt_dedup_begin() -- Set up for merging a stream of leaf tuples.
+ *
+ *		Tuples are fed in key order.  _bt_dedup_start_pending() opens a new
+ *		group with a tuple, _bt_dedup_save_htids() adds following tuples to
+ *		it as long as their keys are equal and the posting list tuple stays
+ *		within maxitemsz, and _bt_dedup_finish_pending() returns the tuple
+ *		representing the whole group.
+ */
+BTDedupState *
+_bt_dedup_begin(Size maxitemsz)
+{
+	BTDedupState *dstate = (BTDedupState *) palloc(sizeof(BTDedupState));
+
+	dstate->maxitemsz = maxitemsz;
+	dstate->base = NULL;
+	dstate->basekeysz = 0;
+	dstate->htids = (ItemPointer) palloc(maxitemsz);
+	dstate->nhtids = 0;
+	dstate->nmerged = 0;
+
+	return dstate;
+}
+
+/*
+ * Open a new pending group, starting with itup.
+ */
+void
+_bt_dedup_start_pending(BTDedupState *dstate, IndexTuple itup)
+{
+	int			ntids = BTreeTupleGetNHeapTIDs(itup);
+	int			i;
+
+	Assert(dstate->base == NULL);
+
+	dstate->base = CopyIndexTuple(itup);
+	dstate->basekeysz = _bt_keysize(itup);
+	for (i = 0; i < ntids; i++)
+		dstate->htids[dstate->nhtids++] = *BTreeTupleGetHeapTIDN(itup, i);
+}
+
+/*
+ * Add itup's heap TIDs to the pending group, if it belongs there.  Returns
+ * false if it doesn't, in which case the caller should finish off the group
+ * and start a new one with itup.
+ */
+bool
+_bt_dedup_save_htids(BTDedupState *dstate, IndexTuple itup)
+{
+	int			ntids = BTreeTupleGetNHeapTIDs(itup);
+	int			i;
+
+	if (dstate->base == NULL || !_bt_dedup_equal(dstate->base, itup))
+		return false;
+	if (MAXALIGN(dstate->basekeysz +
+				 (dstate->nhtids + ntids) * sizeof(ItemPointerData)) >
+		dstate->maxitemsz)
+		return false;
+
+	for (i = 0; i < ntids; i++)
+		dstate->htids[dstate->nhtids++] = *BTreeTupleGetHeapTIDN(itup, i);
+	dstate->nmerged++;
+
+	return true;
+}
+
+/*
+ * Return a palloc'd tuple representing the pending group, or NULL if there
+ * is none, and reset for the next group.
+ */
+IndexTuple
+_bt_dedup_finish_pending(BTDedupState *dstate)
+{
+	IndexTuple	result;
+
+	if (dstate->base == NULL)
+		return NULL;
+
+	if (dstate->nmerged == 0)
+	{
+		/* nothing was merged into base, so it can be used as is */
+		result = dstate->base;
+	}
+	else
+	{
+		qsort(dstate->htids, dstate->nhtids, sizeof(ItemPointerData),
+			  _bt_htid_cmp);
+		result = _bt_form_posting(dstate->base, dstate->htids,
+								  dstate->nhtids);
+		pfree(dstate->base);
+	}
+
+	dstate->base = NULL;
+	dstate->nhtids = 0;
+	dstate->nmerged = 0;
+
+	return result;
+}
+
+/*
+ * Release the merge state.  Any pending group must have been finished.
+ */
+void
+_bt_dedup_end(BTDedupState *dstate)
+{
+	Assert(dstate->base == NULL);
+
+	pfree(dstate->htids);
+	pfree(dstate);
+}
+
+/*
+ *	_bt_form_posting() -- Build a leaf tuple with base's key and given TIDs.
+ *
+ *		If nhtids is 1 the result is an ordinary tuple; this is also how
+ *		posting list tuples are reduced to a plain key.  Otherwise htids must
+ *		be sorted.  The result is palloc'd.
+ */
+IndexTuple
+_bt_form_posting(IndexTuple base, ItemPointer htids, int nhtids)
+{
+	Size		keysz = _bt_keysize(base);
+	Size		newsize;
+	IndexTuple	itup;
+
+	Assert(nhtids > 0);
+
+	if (nhtids > 1)
+		newsize = MAXALIGN(keysz + nhtids * sizeof(ItemPointerData));
+	else
+		newsize = keysz;
+
+	itup = (IndexTuple) palloc0(newsize);
+	memcpy(itup, base, keysz);
+	itup->t_info &= ~(INDEX_SIZE_MASK | INDEX_ALT_TID_MASK);
+	itup->t_info |= newsize;
+
+	if (nhtids > 1)
+	{
+		BTreeTupleSetPosting(itup, nhtids, keysz);
+		memcpy(BTreeTupleGetPosting(itup), htids,
+			   nhtids * sizeof(ItemPointerData));
+	}
+	else
+		itup->t_tid = *htids;
+
+	return itup;
+}
+
+/*
+ *	_bt_strip_posting() -- Return a palloc'd copy of itup without its posting
+ *		list, pointing at its first heap TID.
+ *
+ *		Used wherever a leaf tuple's key is copied into a high key or a
+ *		downlink, which must never be posting list tuples.
+ */
+IndexTuple
+_bt_strip_posting(IndexTuple itup)
+{
+	if (!BTreeTupleIsPosting(itup))
+		return CopyIndexTuple(itup);
+
+	return _bt_form_posting(itup, BTreeTupleGetPosting(itup), 1);
+}
+
+/*
+ * Size of the key part of a leaf tuple, including the tuple header.
+ */
+static Size
+_bt_keysize(IndexTuple itup)
+{
+	if (BTreeTupleIsPosting(itup))
+		return BTreeTupleGetPostingOffset(itup);
+	return IndexTupleSize(itup);
+}
+
+/*
+ * Do a and b have bitwise-identical keys?
+ */
+static bool
+_bt_dedup_equal(IndexTuple a, IndexTuple b)
+{
+	Size		keysz = _bt_keysize(a);
+	unsigned short flagmask = ~(INDEX_SIZE_MASK | INDEX_ALT_TID_MASK);
+
+	if (keysz != _bt_keysize(b))
+		return false;
+	if ((a->t_info & flagmask) != (b->t_info & flagmask))
+		return false;
+
+	return memcmp((char *) a + sizeof(IndexTupleData),
+				  (char *) b + sizeof(IndexTupleData),
+				  keysz - sizeof(IndexTupleData)) == 0;
+}
+
+/*
+ * Append itup to the end of the page being built, marking it dead if asked.
+ */
+static void
+_bt_dedup_addtup(Page newpage, IndexTuple itup, bool dead)
+{
+	OffsetNumber off = OffsetNumberNext(PageGetMaxOffsetNumber(newpage));
+
+	if (PageAddItem(newpage, (Item) itup, IndexTupleSize(itup), off,
+					false, false) == InvalidOffsetNumber)
+		elog(ERROR, "failed to add item to the page during deduplication");
+
+	if (dead)
+		ItemIdMarkDead(PageGetItemId(newpage, off));
+}
+
+/*
+ * qsort comparator for heap TIDs
+ */
+static int
+_bt_htid_cmp(const void *a, const void *b)
+{
+	return ItemPointerCompare((ItemPointer) a, (ItemPointer) b);
+}
@@ -33,6 +33,10 @@ typedef struct
 	int			fillfactor;		/* needed when splitting rightmost page */
 	bool		is_leaf;		/* T if splitting a leaf page */
 	bool		is_rightmost;	/* T if splitting a rightmost page */
+	bool		is_ascending;	/* T if new item extends a key prefix at the
+								 * end of a leaf page */
+	bool		split_after_new;	/* T if new item extends a key prefix in
+									 * the middle of a leaf page */
 	OffsetNumber newitemoff;	/* where the new item is to be inserted */
 	int			leftspace;		/* space available for items on left page */
 	int			rightspace;		/* space available for items on right page */
@@ -75,7 +79,10 @@ static void _bt_insert_parent(Relation rel, Buffer buf, Buffer rbuf,
 static OffsetNumber _bt_findsplitloc(Relation rel, Page page,
 				 OffsetNumber newitemoff,
 				 Size newitemsz,
+				 IndexTuple newitem,
 				 bool *newitemonleft);
+static bool _bt_rightmost_in_prefix(Relation rel, Page page,
+						OffsetNumber newitemoff, IndexTuple newitem);
 static void _bt_checksplitloc(FindSplitData *state,
 				  OffsetNumber firstoldonright, bool newitemonleft,
 				  int dataitemstoleft, Size firstoldonrightsz);
@@ -109,9 +116,10 @@ _bt_doinsert(Relation rel, IndexTuple itup,
 	bool		is_unique = false;
 	int			indnkeyatts;
 	ScanKey		itup_scankey;
-	BTStack		stack;
+	BTStack		stack = NULL;
 	Buffer		buf;
 	OffsetNumber offset;
+	bool		fastpath;
 
 	Assert(IndexRelationGetNumberOfAttributes(rel) != 0);
 	indnkeyatts = IndexRelationGetNumberOfKeyAttributes(rel);
@@ -121,24 +129,115 @@ _bt_doinsert(Relation rel, IndexTuple itup,
 	itup_scankey = _bt_mkscankey(rel, itup);
 
 top:
-	/* find the first page containing this key */
-	stack = _bt_search(rel, indnkeyatts, itup_scankey, false, &buf, BT_WRITE);
-
+	/*
+	 * It's very common to have an index on an auto-incremented or
+	 * monotonically increasing value.  In such cases, every insertion happens
+	 * towards the end of the index.  We try to optimize that case by caching
+	 * the right-most leaf of the index.  If our cached block is still the
+	 * rightmost leaf, has enough free space to accommodate a new entry and
+	 * the insertion key is strictly greater than the first key in this page,
+	 * then we can safely conclude that the new key will be inserted in the
+	 * cached block.  So we simply search within the cached block and insert
+	 * the key at the appropriate location.  We call it a fastpath.
+	 *
+	 * Testing has revealed, though, that the fastpath can result in increased
+	 * contention on the exclusive-lock on the rightmost leaf page.  So we
+	 * conditionally check if the lock is available.  If it's not available
+	 * then we simply abandon the fastpath and take the regular path.  This
+	 * makes sense because unavailability of the lock also signals that some
+	 * other backend might be concurrently inserting into the page, thus
+	 * reducing our chances to finding an insertion place in this page.
+	 */
+	fastpath = false;
 	offset = InvalidOffsetNumber;
+	if (RelationGetTargetBlock(rel) != InvalidBlockNumber)
+	{
+		Size		itemsz;
+		Page		page;
+		BTPageOpaque lpageop;
 
-	/* trade in our read lock for a write lock */
-	LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-	LockBuffer(buf, BT_WRITE);
+		/*
+		 * Conditionally acquire exclusive lock on the buffer before doing any
+		 * checks.  If we don't get the lock, we simply follow slowpath.  If we
+		 * do get the lock, this ensures that the index state cannot change,
+		 * as far as the rightmost part of the index is concerned.
+		 */
+		buf = ReadBuffer(rel, RelationGetTargetBlock(rel));
 
-	/*
-	 * If the page was split between the time that we surrendered our read
-	 * lock and acquired our write lock, then this page may no longer be the
-	 * right place for the key we want to insert.  In this case, we need to
-	 * move right in the tree.  See Lehman and Yao for an excruciatingly
-	 * precise description.
-	 */
-	buf = _bt_moveright(rel, buf, indnkeyatts, itup_scankey, false,
-						true, stack, BT_WRITE);
+		if (ConditionalLockBuffer(buf))
+		{
+			_bt_checkpage(rel, buf);
+
+			page = BufferGetPage(buf);
+
+			lpageop = (BTPageOpaque) PageGetSpecialPointer(page);
+			itemsz = IndexTupleDSize(*itup);
+			itemsz = MAXALIGN(itemsz);	/* be safe, PageAddItem will do this
+										 * but we need to be consistent */
+
+			/*
+			 * Check if the page is still the rightmost leaf page, has enough
+			 * free space to accommodate the new tuple, and the insertion scan
+			 * key is strictly greater than the first key on the page.
+			 */
+			if (P_ISLEAF(lpageop) && P_RIGHTMOST(lpageop) &&
+				!P_IGNORE(lpageop) &&
+				(PageGetFreeSpace(page) > itemsz) &&
+				PageGetMaxOffsetNumber(page) >= P_FIRSTDATAKEY(lpageop) &&
+				_bt_compare(rel, indnkeyatts, itup_scankey, page,
+							P_FIRSTDATAKEY(lpageop)) > 0)
+			{
+				/*
+				 * The rightmost page can't be the left half of an incomplete
+				 * split, but be paranoid and check for it anyway.
+				 */
+				Assert(!P_INCOMPLETE_SPLIT(lpageop));
+				fastpath = true;
+			}
+			else
+			{
+				_bt_relbuf(rel, buf);
+
+				/*
+				 * Something did not work out.  Just forget about the cached
+				 * block and follow the normal path.  It might be set again if
+				 * the conditions are favourable.
+				 */
+				RelationSetTargetBlock(rel, InvalidBlockNumber);
+			}
+		}
+		else
+		{
+			ReleaseBuffer(buf);
+
+			/*
+			 * If someone's holding a lock, it's likely to change anyway, so
+			 * don't try again until we get an updated rightmost leaf.
+			 */
+			RelationSetTargetBlock(rel, InvalidBlockNumber);
+		}
+	}
+
+	if (!fastpath)
+	{
+		/* find the first page containing this key */
+		stack = _bt_search(rel, indnkeyatts, itup_scankey, false, &buf,
+						   BT_WRITE);
+
+		/* trade in our read lock for a write lock */
+		LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+		LockBuffer(buf, BT_WRITE);
+
+		/*
+		 * If the page was split between the time that we surrendered our
+		 * read lock and acquired our write lock, then this page may no
+		 * longer be the right place for the key we want to insert.  In this
+		 * case, we need to move right in the tree.  See Lehman and Yao for an
+		 * excruciatingly precise description.
+		 */
+		buf = _bt_moveright(rel, buf, indnkeyatts, itup_scankey, false,
+							true, stack, BT_WRITE);
+	}
 
 	/*
 	 * If we're not allowing duplicates, make sure the key isn't already in
@@ -186,7 +285,10 @@ top:
 				XactLockTableWait(xwait, rel, &itup->t_tid, XLTW_InsertIndex);
 
 			/* start over... */
-			_bt_freestack(stack);
+			if (stack)
+				_bt_freestack(stack);
+			/* the fastpath doesn't build a stack, so don't leave it dangling */
+			stack = NULL;
 			goto top;
 		}
 	}
@@ -213,7 +315,8 @@ top:
 	}
 
 	/* be tidy */
-	_bt_freestack(stack);
+	if (stack)
+		_bt_freestack(stack);
 	_bt_freeskey(itup_scankey);
 
 	return is_unique;
@@ -516,7 +619,8 @@ _bt_check_unique(Relation rel, IndexTuple itup, Relation heapRel,
  *		any existing equal keys because of the way _bt_binsrch() works.
  *
  *		If there's not enough room in the space, we try to make room by
- *		removing any LP_DEAD tuples.
+ *		removing any LP_DEAD tuples, and then by merging duplicate keys into
+ *		posting list tuples.
  *
  *		On entry, *bufptr and *offsetptr point to the first legal position
  *		where the new tuple could be inserted.  The caller should hold an
@@ -619,6 +723,18 @@ _bt_findinsertloc(Relation rel,
 				break;			/* OK, now we have enough space */
 		}
 
+		/*
+		 * next, try merging duplicates on the page into posting lists; this
+		 * also invalidates the hint
+		 */
+		if (P_ISLEAF(lpageop) && _bt_dedup_one_page(rel, buf))
+		{
+			vacuumed = true;
+
+			if (PageGetFreeSpace(page) >= itemsz)
+				break;			/* OK, now we have enough space */
+		}
+
 		/*
 		 * nope, so check conditions (b) and (c) enumerated above
 		 */
@@ -736,6 +852,7 @@ _bt_insertonpg(Relation rel,
 	BTPageOpaque lpageop;
 	OffsetNumber firstright = InvalidOffsetNumber;
 	Size		itemsz;
+	BlockNumber cachedBlock = InvalidBlockNumber;
 
 	page = BufferGetPage(buf);
 	lpageop = (BTPageOpaque) PageGetSpecialPointer(page);
@@ -768,7 +885,7 @@ _bt_insertonpg(Relation rel,
 
 		/* Choose the split point */
 		firstright = _bt_findsplitloc(rel, page,
-									  newitemoff, itemsz,
+									  newitemoff, itemsz, itup,
 									  &newitemonleft);
 
 		/* split the buffer into left and right halves */
@@ -925,12 +1042,32 @@ _bt_insertonpg(Relation rel,
 
 		END_CRIT_SECTION();
 
+		/*
+		 * Remember the block if we just inserted into the rightmost leaf page
+		 * of the index, for the fastpath in _bt_doinsert.  There's no point
+		 * if the root is also the leaf.
+		 */
+		if (P_RIGHTMOST(lpageop) && P_ISLEAF(lpageop) && !P_ISROOT(lpageop))
+			cachedBlock = BufferGetBlockNumber(buf);
+
 		/* release buffers */
 		if (BufferIsValid(metabuf))
 			_bt_relbuf(rel, metabuf);
 		if (BufferIsValid(cbuf))
 			_bt_relbuf(rel, cbuf);
 		_bt_relbuf(rel, buf);
+
+		/*
+		 * Set the cached block now, if the tree is tall enough to make it
+		 * worthwhile.  We don't check the height until all our locks are
+		 * released, since _bt_getrootheight may have to read the metapage.
+		 *
+		 * The page may have stopped being the rightmost leaf by now, but
+		 * _bt_doinsert rechecks that before using it.
+		 */
+		if (BlockNumberIsValid(cachedBlock) &&
+			_bt_getrootheight(rel) >= BTREE_FASTPATH_MIN_LEVEL)
+			RelationSetTargetBlock(rel, cachedBlock);
 	}
 }
 
@@ -1083,8 +1220,19 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 	 * We must truncate the "high key" item, before insert it onto the leaf page.
 	 * It's the only point in insertion process, where we perform truncation.
 	 * All other functions work with this high key and do not change it.
+	 *
+	 * A high key is never a posting list tuple either, so if the first item on
+	 * the right page is one, only its key goes into the high key.
 	 */
-	if (indnatts != indnkeyatts && P_ISLEAF(lopaque))
+	if (P_ISLEAF(lopaque) && BTreeTupleIsPosting(item))
+	{
+		lefthikey = _bt_strip_posting(item);
+		if (indnatts != indnkeyatts)
+			lefthikey = index_truncate_tuple(rel, lefthikey);
+		itemsz = IndexTupleSize(lefthikey);
+		itemsz = MAXALIGN(itemsz);
+	}
+	else if (indnatts != indnkeyatts && P_ISLEAF(lopaque))
 	{
 		lefthikey = index_truncate_tuple(rel, item);
 		itemsz = IndexTupleSize(lefthikey);
@@ -1310,20 +1458,17 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 		if (newitemonleft)
 			XLogRegisterBufData(0, (char *) newitem, MAXALIGN(newitemsz));
 
-		/* Log left page */
-		if (!isleaf)
-		{
-			/*
-			 * We must also log the left page's high key, because the right
-			 * page's leftmost key is suppressed on non-leaf levels.  Show it
-			 * as belonging to the left page buffer, so that it is not stored
-			 * if XLogInsert decides it needs a full-page image of the left
-			 * page.
-			 */
-			itemid = PageGetItemId(origpage, P_HIKEY);
-			item = (IndexTuple) PageGetItem(origpage, itemid);
-			XLogRegisterBufData(0, (char *) item, MAXALIGN(IndexTupleSize(item)));
-		}
+		/*
+		 * Log left page.  We must also log the left page's high key, because
+		 * the right page's leftmost key is suppressed on non-leaf levels, and
+		 * on the leaf level the high key may have been truncated or stripped
+		 * of its posting list.  Show it as belonging to the left page buffer,
+		 * so that it is not stored if XLogInsert decides it needs a full-page
+		 * image of the left page.
+		 */
+		itemid = PageGetItemId(origpage, P_HIKEY);
+		item = (IndexTuple) PageGetItem(origpage, itemid);
+		XLogRegisterBufData(0, (char *) item, MAXALIGN(IndexTupleSize(item)));
 
 		/*
 		 * Log the contents of the right page in the format understood by
@@ -1390,6 +1535,19 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
  * This is the same as nbtsort.c produces for a newly-created tree.  Note
  * that leaf and nonleaf pages use different fillfactors.
  *
+ * Something similar applies to a leaf page when the new item is the
+ * rightmost one of its key prefix: it has the same leading key columns as
+ * the item before it, differing only in the last key column, and the item
+ * after it (if any) has a different prefix.  That is the pattern of
+ * increasing keys within a key prefix, such as (customer, timestamp) in a
+ * multi-column index.  Splitting such pages evenly would leave half-empty
+ * pages behind, since the later keys of the prefix all go to one side.  So
+ * if the new item goes at the very end of the page, we leave the left page
+ * fillfactor% full; if it goes in the middle, we split right after it, so
+ * that the left page can be filled up with that prefix's later keys.  An
+ * item that merely happens to sort last on its page, as random keys often
+ * do, doesn't qualify; the usual even split is best there.
+ *
  * We are passed the intended insert position of the new tuple, expressed as
  * the offsetnumber of the tuple it must go in front of.  (This could be
  * maxoff+1 if the tuple is to go at the end.)
@@ -1404,6 +1562,7 @@ _bt_findsplitloc(Relation rel,
 				 Page page,
 				 OffsetNumber newitemoff,
 				 Size newitemsz,
+				 IndexTuple newitem,
 				 bool *newitemonleft)
 {
 	BTPageOpaque opaque;
@@ -1419,6 +1578,7 @@ _bt_findsplitloc(Relation rel,
 	bool		goodenoughfound;
 
 	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	maxoff = PageGetMaxOffsetNumber(page);
 
 	/* Passed-in newitemsz is MAXALIGNED but does not include line pointer */
 	newitemsz += sizeof(ItemIdData);
@@ -1442,10 +1602,18 @@ _bt_findsplitloc(Relation rel,
 	state.newitemsz = newitemsz;
 	state.is_leaf = P_ISLEAF(opaque);
 	state.is_rightmost = P_RIGHTMOST(opaque);
+	state.is_ascending = state.split_after_new = false;
+	if (state.is_leaf && !state.is_rightmost &&
+		_bt_rightmost_in_prefix(rel, page, newitemoff, newitem))
+	{
+		if (newitemoff > maxoff)
+			state.is_ascending = true;
+		else
+			state.split_after_new = true;
+	}
 	state.have_split = false;
 	if (state.is_leaf)
-		state.fillfactor = RelationGetFillFactor(rel,
-												 BTREE_DEFAULT_FILLFACTOR);
+		state.fillfactor = BTGetFillFactor(rel);
 	else
 		state.fillfactor = BTREE_NONLEAF_FILLFACTOR;
 	state.newitemonleft = false;	/* these just to keep compiler quiet */
@@ -1473,7 +1641,6 @@ _bt_findsplitloc(Relation rel,
 	 */
 	olddataitemstoleft = 0;
 	goodenoughfound = false;
-	maxoff = PageGetMaxOffsetNumber(page);
 
 	for (offnum = P_FIRSTDATAKEY(opaque);
 		 offnum <= maxoff;
@@ -1534,6 +1701,37 @@ _bt_findsplitloc(Relation rel,
 	return state.firstright;
 }
 
+/*
+ * Subroutine for _bt_findsplitloc: is newitem, to be inserted on the leaf
+ * page at newitemoff, the rightmost item of its key prefix?  That is, does
+ * it share all but the last key column with the item before it, but not
+ * with the item after it (if there is one)?
+ *
+ * Single-column indexes have no key prefix, so this is always false for them.
+ */
+static bool
+_bt_rightmost_in_prefix(Relation rel, Page page, OffsetNumber newitemoff,
+						IndexTuple newitem)
+{
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	int			indnkeyatts = IndexRelationGetNumberOfKeyAttributes(rel);
+	ScanKey		itup_scankey;
+	bool		result;
+
+	if (indnkeyatts < 2 || newitemoff <= P_FIRSTDATAKEY(opaque))
+		return false;
+
+	itup_scankey = _bt_mkscankey(rel, newitem);
+	result = (_bt_compare(rel, indnkeyatts - 1, itup_scankey, page,
+						  OffsetNumberPrev(newitemoff)) == 0);
+	if (result && newitemoff <= PageGetMaxOffsetNumber(page))
+		result = (_bt_compare(rel, indnkeyatts - 1, itup_scankey, page,
+							  newitemoff) != 0);
+	_bt_freeskey(itup_scankey);
+
+	return result;
+}
+
 /*
  * Subroutine to analyze a particular possible split choice (ie, firstright
  * and newitemonleft settings), and record the best split so far in *state.
@@ -1600,11 +1798,25 @@ _bt_checksplitloc(FindSplitData *state,
 	{
 		int			delta;
 
-		if (state->is_rightmost)
+		if (state->split_after_new)
+		{
+			/*
+			 * Split right after the new item if we can.  Otherwise fall back
+			 * to an even split, but never call that good enough, so that we
+			 * don't stop looking before we get to the new item.  See comments
+			 * for _bt_findsplitloc.
+			 */
+			if (firstoldonright == state->newitemoff && newitemonleft)
+				delta = 0;
+			else
+				delta = Abs(leftfree - rightfree) + state->leftspace;
+		}
+		else if (state->is_rightmost || state->is_ascending)
 		{
 			/*
-			 * If splitting a rightmost page, try to put (100-fillfactor)% of
-			 * free space on left page. See comments for _bt_findsplitloc.
+			 * If splitting a rightmost page, or a leaf page at the end of a
+			 * key prefix, try to put (100-fillfactor)% of free space on left
+			 * page. See comments for _bt_findsplitloc.
 			 */
 			delta = (state->fillfactor * leftfree)
 				- ((100 - state->fillfactor) * rightfree);
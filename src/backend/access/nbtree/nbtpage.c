@@ -775,6 +775,10 @@ _bt_page_recyclable(Page page)
  * This routine assumes that the caller has pinned and locked the buffer.
  * Also, the given itemnos *must* appear in increasing order in the array.
  *
+ * Posting list tuples that still reference some live heap tuples are not
+ * deleted but replaced: the tuple at updatednos[i] is overwritten with
+ * updated[i], which must be no larger than the tuple it replaces.
+ *
  * We record VACUUMs and b-tree deletes differently in WAL. InHotStandby
  * we need to be able to pin all of the blocks in the btree in physical
  * order when replaying the effects of a VACUUM, just as we do for the
@@ -788,15 +792,48 @@ _bt_page_recyclable(Page page)
 void
 _bt_delitems_vacuum(Relation rel, Buffer buf,
 					OffsetNumber *itemnos, int nitems,
-					BlockNumber lastBlockVacuumed)
+					OffsetNumber *updatednos, IndexTuple *updated,
+					int nupdated, BlockNumber lastBlockVacuumed)
 {
 	Page		page = BufferGetPage(buf);
 	BTPageOpaque opaque;
+	char	   *updatedbuf = NULL;
+	Size		updatedbuflen = 0;
+	int			i;
+
+	/*
+	 * Gather the updated tuples into one chunk for WAL before entering the
+	 * critical section.
+	 */
+	if (nupdated > 0 && RelationNeedsWAL(rel))
+	{
+		char	   *ptr;
+
+		for (i = 0; i < nupdated; i++)
+			updatedbuflen += IndexTupleSize(updated[i]);
+		ptr = updatedbuf = palloc(updatedbuflen);
+		for (i = 0; i < nupdated; i++)
+		{
+			memcpy(ptr, updated[i], IndexTupleSize(updated[i]));
+			ptr += IndexTupleSize(updated[i]);
+		}
+	}
 
 	/* No ereport(ERROR) until changes are logged */
 	START_CRIT_SECTION();
 
-	/* Fix the page */
+	/*
+	 * Fix the page.  Replace updated posting list tuples first, so that the
+	 * offsets of both arrays refer to the page as the caller saw it.
+	 */
+	for (i = 0; i < nupdated; i++)
+	{
+		PageIndexTupleDelete(page, updatednos[i]);
+		if (PageAddItem(page, (Item) updated[i], IndexTupleSize(updated[i]),
+						updatednos[i], false, false) == InvalidOffsetNumber)
+			elog(PANIC, "failed to replace posting list tuple in index \"%s\"",
+				 RelationGetRelationName(rel));
+	}
 	if (nitems > 0)
 		PageIndexMultiDelete(page, itemnos, nitems);
 
@@ -825,6 +862,8 @@ _bt_delitems_vacuum(Relation rel, Buffer buf,
 		xl_btree_vacuum xlrec_vacuum;
 
 		xlrec_vacuum.lastBlockVacuumed = lastBlockVacuumed;
+		xlrec_vacuum.ndeleted = nitems;
+		xlrec_vacuum.nupdated = nupdated;
 
 		XLogBeginInsert();
 		XLogRegisterBuffer(0, buf, REGBUF_STANDARD);
@@ -833,10 +872,16 @@ _bt_delitems_vacuum(Relation rel, Buffer buf,
 		/*
 		 * The target-offsets array is not in the buffer, but pretend that it
 		 * is.  When XLogInsert stores the whole buffer, the offsets array
-		 * need not be stored too.
+		 * need not be stored too.  The same goes for the updated tuples.
 		 */
 		if (nitems > 0)
 			XLogRegisterBufData(0, (char *) itemnos, nitems * sizeof(OffsetNumber));
+		if (nupdated > 0)
+		{
+			XLogRegisterBufData(0, (char *) updatednos,
+								nupdated * sizeof(OffsetNumber));
+			XLogRegisterBufData(0, updatedbuf, updatedbuflen);
+		}
 
 		recptr = XLogInsert(RM_BTREE_ID, XLOG_BTREE_VACUUM);
 
@@ -844,6 +889,9 @@ _bt_delitems_vacuum(Relation rel, Buffer buf,
 	}
 
 	END_CRIT_SECTION();
+
+	if (updatedbuf)
+		pfree(updatedbuf);
 }
 
 /*
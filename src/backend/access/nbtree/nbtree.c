@@ -73,6 +73,9 @@ static void btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 			 BTCycleId cycleid);
 static void btvacuumpage(BTVacState *vstate, BlockNumber blkno,
 			 BlockNumber orig_blkno);
+static IndexTuple btvacuumposting(IndexTuple itup,
+				IndexBulkDeleteCallback callback, void *callback_state,
+				int *nremaining);
 
 
 /*
@@ -303,8 +306,8 @@ btgettuple(PG_FUNCTION_ARGS)
 				 */
 				if (so->killedItems == NULL)
 					so->killedItems = (int *)
-						palloc(MaxIndexTuplesPerPage * sizeof(int));
-				if (so->numKilled < MaxIndexTuplesPerPage)
+						palloc(MaxTIDsPerBTreePage * sizeof(int));
+				if (so->numKilled < MaxTIDsPerBTreePage)
 					so->killedItems[so->numKilled++] = so->currPos.itemIndex;
 			}
 
@@ -314,9 +317,13 @@ btgettuple(PG_FUNCTION_ARGS)
 			res = _bt_next(scan, dir);
 		}
 
-		/* If we have a tuple, return it ... */
+		/* If we have a tuple, read ahead on the heap and return it ... */
 		if (res)
+		{
+			if (scan->xs_prefetch_target > 0)
+				_bt_prefetch_heap(scan, dir);
 			break;
+		}
 		/* ... otherwise see if we have more array keys to deal with */
 	} while (so->numArrayKeys && _bt_advance_array_keys(scan, dir));
 
@@ -418,6 +425,11 @@ btbeginscan(PG_FUNCTION_ARGS)
 	so->killedItems = NULL;		/* until needed */
 	so->numKilled = 0;
 
+	so->prefetchTarget = 0;
+	so->prefetchPage = InvalidBlockNumber;
+	so->currHeapBlock = InvalidBlockNumber;
+	so->prefetchVMBuffer = InvalidBuffer;
+
 	/*
 	 * We don't know yet whether the scan will be index-only, so we do not
 	 * allocate the tuple workspace arrays until btrescan.  However, we set up
@@ -458,6 +470,11 @@ btrescan(PG_FUNCTION_ARGS)
 	BTScanPosUnpinIfPinned(so->markPos);
 	BTScanPosInvalidate(so->markPos);
 
+	/* restart heap read-ahead from scratch, too */
+	so->prefetchTarget = 0;
+	so->prefetchPage = InvalidBlockNumber;
+	so->currHeapBlock = InvalidBlockNumber;
+
 	/*
 	 * Allocate tuple workspace arrays, if needed for an index-only scan and
 	 * not already done in a previous rescan call.  To save on palloc
@@ -519,6 +536,9 @@ btendscan(PG_FUNCTION_ARGS)
 
 	/* No need to invalidate positions, the RAM is about to be freed. */
 
+	if (BufferIsValid(so->prefetchVMBuffer))
+		ReleaseBuffer(so->prefetchVMBuffer);
+
 	/* Release storage */
 	if (so->keyData != NULL)
 		pfree(so->keyData);
@@ -828,7 +848,8 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 								 RBM_NORMAL, info->strategy);
 		LockBufferForCleanup(buf);
 		_bt_checkpage(rel, buf);
-		_bt_delitems_vacuum(rel, buf, NULL, 0, vstate.lastBlockVacuumed);
+		_bt_delitems_vacuum(rel, buf, NULL, 0, NULL, NULL, 0,
+							vstate.lastBlockVacuumed);
 		_bt_relbuf(rel, buf);
 	}
 
@@ -926,6 +947,10 @@ restart:
 	{
 		OffsetNumber deletable[MaxOffsetNumber];
 		int			ndeletable;
+		OffsetNumber updatable[MaxIndexTuplesPerPage];
+		IndexTuple	updated[MaxIndexTuplesPerPage];
+		int			nupdatable;
+		int			nremovedtids;
 		OffsetNumber offnum,
 					minoff,
 					maxoff;
@@ -965,6 +990,8 @@ restart:
 		 * callback function.
 		 */
 		ndeletable = 0;
+		nupdatable = 0;
+		nremovedtids = 0;
 		minoff = P_FIRSTDATAKEY(opaque);
 		maxoff = PageGetMaxOffsetNumber(page);
 		if (callback)
@@ -1001,8 +1028,33 @@ restart:
 				 * applies to *any* type of index that marks index tuples as
 				 * killed.
 				 */
-				if (callback(htup, callback_state))
+				if (BTreeTupleIsPosting(itup))
+				{
+					/*
+					 * A posting list tuple is only deleted once all of its
+					 * heap TIDs are dead; otherwise it is replaced by a
+					 * smaller one without the dead TIDs.
+					 */
+					int			nposting = BTreeTupleGetNPosting(itup);
+					int			nremaining;
+					IndexTuple	newitup;
+
+					newitup = btvacuumposting(itup, callback, callback_state,
+											  &nremaining);
+					if (newitup != NULL)
+					{
+						updatable[nupdatable] = offnum;
+						updated[nupdatable++] = newitup;
+					}
+					else if (nremaining == 0)
+						deletable[ndeletable++] = offnum;
+					nremovedtids += nposting - nremaining;
+				}
+				else if (callback(htup, callback_state))
+				{
 					deletable[ndeletable++] = offnum;
+					nremovedtids++;
+				}
 			}
 		}
 
@@ -1010,8 +1062,10 @@ restart:
 		 * Apply any needed deletes.  We issue just one _bt_delitems_vacuum()
 		 * call per page, so as to minimize WAL traffic.
 		 */
-		if (ndeletable > 0)
+		if (ndeletable > 0 || nupdatable > 0)
 		{
+			int			i;
+
 			/*
 			 * Notice that the issued XLOG_BTREE_VACUUM WAL record includes an
 			 * instruction to the replay code to get cleanup lock on all pages
@@ -1024,8 +1078,12 @@ restart:
 			 * that.
 			 */
 			_bt_delitems_vacuum(rel, buf, deletable, ndeletable,
+								updatable, updated, nupdatable,
 								vstate->lastBlockVacuumed);
 
+			for (i = 0; i < nupdatable; i++)
+				pfree(updated[i]);
+
 			/*
 			 * Remember highest leaf page number we've issued a
 			 * XLOG_BTREE_VACUUM WAL record for.
@@ -1033,7 +1091,7 @@ restart:
 			if (blkno > vstate->lastBlockVacuumed)
 				vstate->lastBlockVacuumed = blkno;
 
-			stats->tuples_removed += ndeletable;
+			stats->tuples_removed += nremovedtids;
 			/* must recompute maxoff */
 			maxoff = PageGetMaxOffsetNumber(page);
 		}
@@ -1065,7 +1123,19 @@ restart:
 		if (minoff > maxoff)
 			delete_now = (blkno == orig_blkno);
 		else
-			stats->num_index_tuples += maxoff - minoff + 1;
+		{
+			/* posting list tuples count once per heap TID */
+			for (offnum = minoff;
+				 offnum <= maxoff;
+				 offnum = OffsetNumberNext(offnum))
+			{
+				IndexTuple	itup;
+
+				itup = (IndexTuple) PageGetItem(page,
+												PageGetItemId(page, offnum));
+				stats->num_index_tuples += BTreeTupleGetNHeapTIDs(itup);
+			}
+		}
 	}
 
 	if (delete_now)
@@ -1103,6 +1173,56 @@ restart:
 	}
 }
 
+/*
+ * btvacuumposting --- determine which heap TIDs of a posting list tuple
+ * are to be removed.
+ *
+ * Sets *nremaining to the number of TIDs that survive.  If some but not all of
+ * them are to be removed, returns a palloc'd replacement tuple holding just
+ * the survivors; otherwise returns NULL.
+ */
+static IndexTuple
+btvacuumposting(IndexTuple itup, IndexBulkDeleteCallback callback,
+				void *callback_state, int *nremaining)
+{
+	int			nposting = BTreeTupleGetNPosting(itup);
+	ItemPointer items = BTreeTupleGetPosting(itup);
+	ItemPointer remaining = NULL;
+	IndexTuple	newitup = NULL;
+	int			live = 0;
+	int			i;
+
+	for (i = 0; i < nposting; i++)
+	{
+		if (callback(items + i, callback_state))
+		{
+			/* first dead TID; start collecting the survivors separately */
+			if (remaining == NULL)
+			{
+				remaining = (ItemPointer) palloc(sizeof(ItemPointerData) *
+												 nposting);
+				memcpy(remaining, items, sizeof(ItemPointerData) * live);
+			}
+		}
+		else
+		{
+			if (remaining != NULL)
+				remaining[live] = items[i];
+			live++;
+		}
+	}
+
+	*nremaining = live;
+	if (remaining != NULL)
+	{
+		if (live > 0)
+			newitup = _bt_form_posting(itup, remaining, live);
+		pfree(remaining);
+	}
+
+	return newitup;
+}
+
 /*
  *	btcanreturn() -- Check whether btree indexes support index-only scans.
  *
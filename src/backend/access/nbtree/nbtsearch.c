@@ -17,6 +17,7 @@
 
 #include "access/nbtree.h"
 #include "access/relscan.h"
+#include "access/visibilitymap.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/predicate.h"
@@ -29,6 +30,8 @@ static bool _bt_readpage(IndexScanDesc scan, ScanDirection dir,
 			 OffsetNumber offnum);
 static void _bt_saveitem(BTScanOpaque so, int itemIndex,
 			 OffsetNumber offnum, IndexTuple itup);
+static void _bt_savepostingitems(BTScanOpaque so, int itemIndex,
+					 OffsetNumber offnum, IndexTuple itup);
 static bool _bt_steppage(IndexScanDesc scan, ScanDirection dir);
 static Buffer _bt_walk_left(Relation rel, Buffer buf);
 static bool _bt_endpoint(IndexScanDesc scan, ScanDirection dir);
@@ -1108,6 +1111,93 @@ _bt_next(IndexScanDesc scan, ScanDirection dir)
 	return true;
 }
 
+/*
+ *	_bt_prefetch_heap() -- Issue prefetch requests for upcoming heap pages.
+ *
+ *		Called after _bt_first or _bt_next has returned an item, when the
+ *		caller asked for read-ahead by setting scan->xs_prefetch_target.  We
+ *		look at the items of so->currPos beyond the one just returned and
+ *		issue PrefetchBuffer for their heap blocks, so that the I/O overlaps
+ *		with the caller's processing of the current tuple.  As in a bitmap
+ *		heap scan, the prefetch distance starts at zero and grows as heap
+ *		pages are consumed, so that a scan that stops after a few tuples
+ *		(e.g. because of a LIMIT) doesn't prefetch much.
+ *
+ *		For an index-only scan, heap pages that the visibility map says are
+ *		all-visible won't be visited, so we don't prefetch them.  Checking
+ *		the map here also brings its pages into shared buffers ahead of the
+ *		caller.
+ */
+void
+_bt_prefetch_heap(IndexScanDesc scan, ScanDirection dir)
+{
+#ifdef USE_PREFETCH
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTScanPos	pos = &so->currPos;
+	int			step = ScanDirectionIsForward(dir) ? 1 : -1;
+	BlockNumber blkno;
+
+	if (scan->heapRelation == NULL)
+		return;
+
+	blkno = ItemPointerGetBlockNumber(&pos->items[pos->itemIndex].heapTid);
+
+	if (pos->currPage != so->prefetchPage ||
+		(ScanDirectionIsForward(dir) ?
+		 so->prefetchIndex <= pos->itemIndex :
+		 so->prefetchIndex >= pos->itemIndex))
+	{
+		/*
+		 * New index page, a change of direction, or the caller has caught up
+		 * with the prefetch cursor: restart the cursor at the current item.
+		 */
+		so->prefetchPage = pos->currPage;
+		so->prefetchIndex = pos->itemIndex;
+		so->prefetchBlock = blkno;
+		so->prefetchPages = 0;
+	}
+	else if (blkno != so->currHeapBlock && so->prefetchPages > 0)
+		so->prefetchPages--;
+
+	if (blkno != so->currHeapBlock)
+	{
+		so->currHeapBlock = blkno;
+
+		/* Increase prefetch target if it's not yet at the max */
+		if (so->prefetchTarget >= scan->xs_prefetch_target)
+			 /* don't increase any further */ ;
+		else if (so->prefetchTarget >= scan->xs_prefetch_target / 2)
+			so->prefetchTarget = scan->xs_prefetch_target;
+		else if (so->prefetchTarget > 0)
+			so->prefetchTarget *= 2;
+		else
+			so->prefetchTarget++;
+	}
+
+	while (so->prefetchPages < so->prefetchTarget)
+	{
+		int			nextIndex = so->prefetchIndex + step;
+
+		if (nextIndex < pos->firstItem || nextIndex > pos->lastItem)
+			break;
+		so->prefetchIndex = nextIndex;
+
+		blkno = ItemPointerGetBlockNumber(&pos->items[nextIndex].heapTid);
+		if (blkno == so->prefetchBlock)
+			continue;
+		so->prefetchBlock = blkno;
+		so->prefetchPages++;
+
+		if (scan->xs_want_itup &&
+			visibilitymap_test(scan->heapRelation, blkno,
+							   &so->prefetchVMBuffer))
+			continue;
+
+		PrefetchBuffer(scan->heapRelation, MAIN_FORKNUM, blkno);
+	}
+#endif   /* USE_PREFETCH */
+}
+
 /*
  *	_bt_readpage() -- Load data from current index page into so->currPos
  *
@@ -1185,7 +1275,13 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 		while (offnum <= maxoff)
 		{
 			itup = _bt_checkkeys(scan, page, offnum, dir, &continuescan);
-			if (itup != NULL)
+			if (itup != NULL && BTreeTupleIsPosting(itup))
+			{
+				/* remember each of the posting list's heap TIDs */
+				_bt_savepostingitems(so, itemIndex, offnum, itup);
+				itemIndex += BTreeTupleGetNPosting(itup);
+			}
+			else if (itup != NULL)
 			{
 				/* tuple passes all scan key conditions, so remember it */
 				_bt_saveitem(so, itemIndex, offnum, itup);
@@ -1201,7 +1297,7 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 			offnum = OffsetNumberNext(offnum);
 		}
 
-		Assert(itemIndex <= MaxIndexTuplesPerPage);
+		Assert(itemIndex <= MaxTIDsPerBTreePage);
 		so->currPos.firstItem = 0;
 		so->currPos.lastItem = itemIndex - 1;
 		so->currPos.itemIndex = 0;
@@ -1209,14 +1305,20 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 	else
 	{
 		/* load items[] in descending order */
-		itemIndex = MaxIndexTuplesPerPage;
+		itemIndex = MaxTIDsPerBTreePage;
 
 		offnum = Min(offnum, maxoff);
 
 		while (offnum >= minoff)
 		{
 			itup = _bt_checkkeys(scan, page, offnum, dir, &continuescan);
-			if (itup != NULL)
+			if (itup != NULL && BTreeTupleIsPosting(itup))
+			{
+				/* remember each of the posting list's heap TIDs */
+				itemIndex -= BTreeTupleGetNPosting(itup);
+				_bt_savepostingitems(so, itemIndex, offnum, itup);
+			}
+			else if (itup != NULL)
 			{
 				/* tuple passes all scan key conditions, so remember it */
 				itemIndex--;
@@ -1234,8 +1336,8 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 
 		Assert(itemIndex >= 0);
 		so->currPos.firstItem = itemIndex;
-		so->currPos.lastItem = MaxIndexTuplesPerPage - 1;
-		so->currPos.itemIndex = MaxIndexTuplesPerPage - 1;
+		so->currPos.lastItem = MaxTIDsPerBTreePage - 1;
+		so->currPos.itemIndex = MaxTIDsPerBTreePage - 1;
 	}
 
 	return (so->currPos.firstItem <= so->currPos.lastItem);
@@ -1260,6 +1362,44 @@ _bt_saveitem(BTScanOpaque so, int itemIndex,
 	}
 }
 
+/*
+ * Save the heap TIDs of a posting list tuple into so->currPos.items[], at
+ * itemIndex and the following slots, in the order they appear in the posting
+ * list.  For an index-only scan, the tuple's key is stored just once, without
+ * the posting list, and shared by all of the items.
+ */
+static void
+_bt_savepostingitems(BTScanOpaque so, int itemIndex,
+					 OffsetNumber offnum, IndexTuple itup)
+{
+	int			nposting = BTreeTupleGetNPosting(itup);
+	int			tupleOffset = 0;
+	int			i;
+
+	if (so->currTuples)
+	{
+		Size		keysz = BTreeTupleGetPostingOffset(itup);
+		IndexTuple	base;
+
+		tupleOffset = so->currPos.nextTupleOffset;
+		base = (IndexTuple) (so->currTuples + tupleOffset);
+		memcpy(base, itup, keysz);
+		base->t_info &= ~(INDEX_SIZE_MASK | INDEX_ALT_TID_MASK);
+		base->t_info |= keysz;
+		base->t_tid = *BTreeTupleGetPosting(itup);
+		so->currPos.nextTupleOffset += MAXALIGN(keysz);
+	}
+
+	for (i = 0; i < nposting; i++)
+	{
+		BTScanPosItem *currItem = &so->currPos.items[itemIndex + i];
+
+		currItem->heapTid = *BTreeTupleGetHeapTIDN(itup, i);
+		currItem->indexOffset = offnum;
+		currItem->tupleOffset = tupleOffset;
+	}
+}
+
 /*
  *	_bt_steppage() -- Step to next page containing valid data for scan
  *
@@ -345,8 +345,7 @@ _bt_pagestate(BTWriteState *wstate, uint32 level)
 	if (level > 0)
 		state->btps_full = (BLCKSZ * (100 - BTREE_NONLEAF_FILLFACTOR) / 100);
 	else
-		state->btps_full = RelationGetTargetPageFreeSpace(wstate->index,
-												   BTREE_DEFAULT_FILLFACTOR);
+		state->btps_full = BTGetTargetPageFreeSpace(wstate->index);
 	/* no parent level, yet */
 	state->btps_next = NULL;
 
@@ -543,7 +542,8 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 		ItemIdSetUnused(ii);	/* redundant */
 		((PageHeader) opage)->pd_lower -= sizeof(ItemIdData);
 
-		if (indnkeyatts != indnatts && P_ISLEAF(opageop))
+		if (P_ISLEAF(opageop) &&
+			(indnkeyatts != indnatts || BTreeTupleIsPosting(oitup)))
 		{
 			/*
 			 * It's essential to truncate High key here.
@@ -551,9 +551,12 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 			 * but to keep whole b-tree structure consistent. Subsequent insertions
 			 * assume that hikey is already truncated, and so they should not
 			 * worry about it, when copying the high key into the parent page
-			 * as a downlink.
+			 * as a downlink.  For the same reason, a high key never carries a
+			 * posting list.
 			 */
-			keytup = index_truncate_tuple(wstate->index, oitup);
+			keytup = _bt_strip_posting(oitup);
+			if (indnkeyatts != indnatts)
+				keytup = index_truncate_tuple(wstate->index, keytup);
 
 			/*  delete "wrong" high key, insert keytup as P_HIKEY. */
 			PageIndexTupleDelete(opage, P_HIKEY);
@@ -625,9 +628,13 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 		 * Truncate the tuple that we're going to insert
 		 * into the parent page as a downlink
 		 */
-		if (indnkeyatts != indnatts && P_ISLEAF(pageop))
+		if (P_ISLEAF(pageop) &&
+			(indnkeyatts != indnatts || BTreeTupleIsPosting(itup)))
 		{
-			state->btps_minkey = index_truncate_tuple(wstate->index, itup);
+			state->btps_minkey = _bt_strip_posting(itup);
+			if (indnkeyatts != indnatts)
+				state->btps_minkey = index_truncate_tuple(wstate->index,
+														  state->btps_minkey);
 			itupsz = IndexTupleDSize(*itup);
 			itupsz = MAXALIGN(itupsz);
 		}
@@ -836,6 +843,47 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 		}
 		pfree(sortKeys);
 	}
+	else if (_bt_dedup_allowed(wstate->index))
+	{
+		/* merge is unnecessary, but merge duplicates into posting lists */
+		BTDedupState *dstate = NULL;
+		IndexTuple	pending;
+
+		while ((itup = tuplesort_getindextuple(btspool->sortstate,
+											   true, &should_free)) != NULL)
+		{
+			/* When we see first tuple, create first index page */
+			if (state == NULL)
+			{
+				state = _bt_pagestate(wstate, 0);
+				dstate = _bt_dedup_begin(BTMaxItemSize(state->btps_page));
+			}
+
+			if (!_bt_dedup_save_htids(dstate, itup))
+			{
+				pending = _bt_dedup_finish_pending(dstate);
+				if (pending != NULL)
+				{
+					_bt_buildadd(wstate, state, pending);
+					pfree(pending);
+				}
+				_bt_dedup_start_pending(dstate, itup);
+			}
+			if (should_free)
+				pfree(itup);
+		}
+
+		if (dstate != NULL)
+		{
+			pending = _bt_dedup_finish_pending(dstate);
+			if (pending != NULL)
+			{
+				_bt_buildadd(wstate, state, pending);
+				pfree(pending);
+			}
+			_bt_dedup_end(dstate);
+		}
+	}
 	else
 	{
 		/* merge is unnecessary */
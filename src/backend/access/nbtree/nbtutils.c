@@ -50,6 +50,8 @@ static void _bt_mark_scankey_required(ScanKey skey);
 static bool _bt_check_rowcompare(ScanKey skey,
 					 IndexTuple tuple, TupleDesc tupdesc,
 					 ScanDirection dir, bool *continuescan);
+static bool _bt_posting_killed(BTScanOpaque so, IndexTuple itup,
+				   BTScanPosItem *kitem, bool *killedflags);
 
 
 /*
@@ -1705,6 +1707,48 @@ _bt_check_rowcompare(ScanKey skey, IndexTuple tuple, TupleDesc tupdesc,
 	return result;
 }
 
+/*
+ * Are all the heap TIDs of posting list tuple itup among the killed items of
+ * the current scan position?  kitem is the killed item that led us to itup;
+ * the items saved from one posting list tuple are adjacent in currPos.items[]
+ * and in the same order, so only its neighbours need to be checked.
+ */
+static bool
+_bt_posting_killed(BTScanOpaque so, IndexTuple itup, BTScanPosItem *kitem,
+				   bool *killedflags)
+{
+	int			nposting = BTreeTupleGetNPosting(itup);
+	ItemPointer posting = BTreeTupleGetPosting(itup);
+	int			first;
+	int			j;
+
+	/* find the first item saved from the same index tuple */
+	first = kitem - so->currPos.items;
+	while (first > so->currPos.firstItem &&
+		   so->currPos.items[first - 1].indexOffset == kitem->indexOffset)
+		first--;
+
+	if (first + nposting - 1 > so->currPos.lastItem)
+		return false;
+
+	for (j = 0; j < nposting; j++)
+	{
+		BTScanPosItem *item = &so->currPos.items[first + j];
+
+		if (!killedflags[first + j] ||
+			item->indexOffset != kitem->indexOffset ||
+			!ItemPointerEquals(&item->heapTid, posting + j))
+			return false;
+	}
+
+	/* the tuple must not have gained TIDs that we didn't see */
+	if (first + nposting <= so->currPos.lastItem &&
+		so->currPos.items[first + nposting].indexOffset == kitem->indexOffset)
+		return false;
+
+	return true;
+}
+
 /*
  * _bt_killitems - set LP_DEAD state for items an indexscan caller has
  * told us were killed
@@ -1747,6 +1791,7 @@ _bt_killitems(IndexScanDesc scan)
 	int			i;
 	int			numKilled = so->numKilled;
 	bool		killedsomething = false;
+	bool	   *killedflags;
 
 	Assert(BTScanPosIsValid(so->currPos));
 
@@ -1794,6 +1839,11 @@ _bt_killitems(IndexScanDesc scan)
 	minoff = P_FIRSTDATAKEY(opaque);
 	maxoff = PageGetMaxOffsetNumber(page);
 
+	/* note which of currPos.items[] are killed, for posting list tuples */
+	killedflags = (bool *) palloc0(sizeof(bool) * MaxTIDsPerBTreePage);
+	for (i = 0; i < numKilled; i++)
+		killedflags[so->killedItems[i]] = true;
+
 	for (i = 0; i < numKilled; i++)
 	{
 		int			itemIndex = so->killedItems[i];
@@ -1809,7 +1859,20 @@ _bt_killitems(IndexScanDesc scan)
 			ItemId		iid = PageGetItemId(page, offnum);
 			IndexTuple	ituple = (IndexTuple) PageGetItem(page, iid);
 
-			if (ItemPointerEquals(&ituple->t_tid, &kitem->heapTid))
+			if (BTreeTupleIsPosting(ituple))
+			{
+				/*
+				 * A posting list tuple can only be marked dead once all of
+				 * its heap TIDs are known dead.
+				 */
+				if (_bt_posting_killed(so, ituple, kitem, killedflags))
+				{
+					ItemIdMarkDead(iid);
+					killedsomething = true;
+					break;		/* out of inner search loop */
+				}
+			}
+			else if (ItemPointerEquals(&ituple->t_tid, &kitem->heapTid))
 			{
 				/* found the item */
 				ItemIdMarkDead(iid);
@@ -1820,6 +1883,8 @@ _bt_killitems(IndexScanDesc scan)
 		}
 	}
 
+	pfree(killedflags);
+
 	/*
 	 * Since this can be redone later if needed, mark as dirty hint.
 	 *
@@ -2051,10 +2116,28 @@ btoptions(PG_FUNCTION_ARGS)
 {
 	Datum		reloptions = PG_GETARG_DATUM(0);
 	bool		validate = PG_GETARG_BOOL(1);
-	bytea	   *result;
+	relopt_value *options;
+	BTOptions  *rdopts;
+	int			numoptions;
+	static const relopt_parse_elt tab[] = {
+		{"fillfactor", RELOPT_TYPE_INT, offsetof(BTOptions, fillfactor)},
+		{"deduplicate_items", RELOPT_TYPE_BOOL,
+		offsetof(BTOptions, deduplicate_items)}
+	};
+
+	options = parseRelOptions(reloptions, validate, RELOPT_KIND_BTREE,
+							  &numoptions);
+
+	/* if none set, we're done */
+	if (numoptions == 0)
+		PG_RETURN_NULL();
+
+	rdopts = allocateReloptStruct(sizeof(BTOptions), options, numoptions);
+
+	fillRelOptions((void *) rdopts, sizeof(BTOptions), options, numoptions,
+				   validate, tab, lengthof(tab));
+
+	pfree(options);
 
-	result = default_reloptions(reloptions, validate, RELOPT_KIND_BTREE);
-	if (result)
-		PG_RETURN_BYTEA_P(result);
-	PG_RETURN_NULL();
+	PG_RETURN_BYTEA_P(rdopts);
 }
@@ -19,10 +19,64 @@
 void
 hash_desc(StringInfo buf, XLogReaderState *record)
 {
+	char	   *rec = XLogRecGetData(record);
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	switch (info)
+	{
+		case XLOG_HASH_INSERT:
+			{
+				xl_hash_insert *xlrec = (xl_hash_insert *) rec;
+
+				appendStringInfo(buf, "off %u", xlrec->offnum);
+			}
+			break;
+		case XLOG_HASH_DELETE:
+			{
+				xl_hash_delete *xlrec = (xl_hash_delete *) rec;
+
+				appendStringInfo(buf, "is_primary %c",
+								 xlrec->is_primary_bucket_page ? 'T' : 'F');
+			}
+			break;
+		case XLOG_HASH_UPDATE_META:
+			{
+				xl_hash_update_meta *xlrec = (xl_hash_update_meta *) rec;
+
+				appendStringInfo(buf, "ntuples %g", xlrec->ntuples);
+			}
+			break;
+		case XLOG_HASH_PAGES:
+			{
+				xl_hash_pages *xlrec = (xl_hash_pages *) rec;
+
+				if (xlrec->flags & XLH_PAGES_BUCKET_CLEANUP)
+					appendStringInfoString(buf, "bucket cleanup");
+			}
+			break;
+	}
 }
 
 const char *
 hash_identify(uint8 info)
 {
-	return NULL;
+	const char *id = NULL;
+
+	switch (info & ~XLR_INFO_MASK)
+	{
+		case XLOG_HASH_INSERT:
+			id = "INSERT";
+			break;
+		case XLOG_HASH_DELETE:
+			id = "DELETE";
+			break;
+		case XLOG_HASH_UPDATE_META:
+			id = "UPDATE_META";
+			break;
+		case XLOG_HASH_PAGES:
+			id = "PAGES";
+			break;
+	}
+
+	return id;
 }
@@ -15,7 +15,7 @@
 
 #include "postgres.h"
 
-#include "access/spgist.h"
+#include "access/spgist_private.h"
 #include "access/stratnum.h"
 #include "catalog/pg_type.h"
 #include "utils/builtins.h"
@@ -261,6 +261,61 @@ spg_kd_inner_consistent(PG_FUNCTION_ARGS)
 	out->levelAdds[0] = 1;
 	out->levelAdds[1] = 1;
 
+	/* For an ordered scan, track each child's area and its distances */
+	if (in->norderbys > 0)
+	{
+		BOX			infArea;
+		BOX		   *area;
+
+		out->distances = (double **) palloc(sizeof(double *) * in->nNodes);
+		out->traversalValues = (void **) palloc(sizeof(void *) * in->nNodes);
+
+		if (in->traversalValue == NULL)
+		{
+			/* the root covers the whole plane */
+			double		inf = get_float8_infinity();
+
+			infArea.high.x = inf;
+			infArea.high.y = inf;
+			infArea.low.x = -inf;
+			infArea.low.y = -inf;
+			area = &infArea;
+		}
+		else
+			area = (BOX *) in->traversalValue;
+
+		for (i = 0; i < out->nNodes; i++)
+		{
+			MemoryContext oldCtx;
+			BOX		   *childArea;
+
+			oldCtx = MemoryContextSwitchTo(in->traversalMemoryContext);
+			childArea = box_copy(area);
+			MemoryContextSwitchTo(oldCtx);
+
+			/* node 0 has the points below coord, node 1 those above it */
+			if ((in->level % 2) != 0)
+			{
+				if (out->nodeNumbers[i] == 0)
+					childArea->high.x = coord;
+				else
+					childArea->low.x = coord;
+			}
+			else
+			{
+				if (out->nodeNumbers[i] == 0)
+					childArea->high.y = coord;
+				else
+					childArea->low.y = coord;
+			}
+
+			out->traversalValues[i] = childArea;
+			out->distances[i] =
+				spg_key_orderbys_distances(BoxPGetDatum(childArea), false,
+										   in->orderbys, in->norderbys);
+		}
+	}
+
 	PG_RETURN_VOID();
 }
 
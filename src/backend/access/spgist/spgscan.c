@@ -15,76 +15,162 @@
 
 #include "postgres.h"
 
+#include <math.h>
+
 #include "access/relscan.h"
 #include "access/spgist_private.h"
+#include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "storage/bufmgr.h"
 #include "utils/datum.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 
 
 typedef void (*storeRes_func) (SpGistScanOpaque so, ItemPointer heapPtr,
-								 Datum leafValue, bool isnull, bool recheck);
+								 Datum leafValue, bool isnull, bool recheck,
+								 bool recheckDistances, double *distances);
+
+/*
+ * Pairing heap comparison function for the SpGistSearchItem queue.
+ *
+ * Without ORDER BY operators, the most recently queued item comes first,
+ * which gives the same depth-first order as a stack.  With them, items are
+ * ordered by distance, nulls last; among items at equal distance, heap
+ * tuples come before index entries so that they are returned as soon as
+ * possible, and the most recently queued item still comes first.
+ */
+static int
+pairingheap_SpGistSearchItem_cmp(const pairingheap_node *a,
+								 const pairingheap_node *b, void *arg)
+{
+	const SpGistSearchItem *sa = (const SpGistSearchItem *) a;
+	const SpGistSearchItem *sb = (const SpGistSearchItem *) b;
+	SpGistScanOpaque so = (SpGistScanOpaque) arg;
+	int			i;
+
+	if (so->numberOfOrderBys > 0)
+	{
+		if (sa->isNull)
+		{
+			if (!sb->isNull)
+				return -1;
+		}
+		else if (sb->isNull)
+			return 1;
+		else
+		{
+			/* Order according to distance comparison */
+			for (i = 0; i < so->numberOfOrderBys; i++)
+			{
+				if (isnan(sa->distances[i]) && isnan(sb->distances[i]))
+					continue;	/* NaN == NaN */
+				if (isnan(sa->distances[i]))
+					return -1;	/* NaN > number */
+				if (isnan(sb->distances[i]))
+					return 1;	/* number < NaN */
+				if (sa->distances[i] != sb->distances[i])
+					return (sa->distances[i] < sb->distances[i]) ? 1 : -1;
+			}
+		}
+
+		/* Heap items go before inner pages, to return them sooner */
+		if (sa->isLeaf && !sb->isLeaf)
+			return 1;
+		if (!sa->isLeaf && sb->isLeaf)
+			return -1;
+	}
 
-typedef struct ScanStackEntry
+	/* Otherwise, the most recently queued item goes first */
+	return (sa->seqNo > sb->seqNo) ? 1 : -1;
+}
+
+/*
+ * Make a new queue item, in traversalCxt.  The caller fills in everything
+ * but the distances, which are copied from the given array (if NULL, they
+ * are set to zero).
+ */
+static SpGistSearchItem *
+spgNewSearchItem(SpGistScanOpaque so, double *distances)
 {
-	Datum		reconstructedValue;		/* value reconstructed from parent */
-	int			level;			/* level of items on this page */
-	ItemPointerData ptr;		/* block and offset to scan from */
-} ScanStackEntry;
+	SpGistSearchItem *item;
+
+	item = (SpGistSearchItem *)
+		MemoryContextAlloc(so->traversalCxt,
+						   SizeOfSpGistSearchItem(so->numberOfOrderBys));
+	if (distances)
+		memcpy(item->distances, distances,
+			   sizeof(double) * so->numberOfOrderBys);
+	else
+		memset(item->distances, 0, sizeof(double) * so->numberOfOrderBys);
 
+	return item;
+}
 
-/* Free a ScanStackEntry */
+/* Add an item to the queue */
 static void
-freeScanStackEntry(SpGistScanOpaque so, ScanStackEntry *stackEntry)
+spgAddSearchItemToQueue(SpGistScanOpaque so, SpGistSearchItem *item)
 {
-	if (!so->state.attType.attbyval &&
-		DatumGetPointer(stackEntry->reconstructedValue) != NULL)
-		pfree(DatumGetPointer(stackEntry->reconstructedValue));
-	pfree(stackEntry);
+	item->seqNo = so->nextSeqNo++;
+	pairingheap_add(so->scanQueue, &item->phNode);
 }
 
-/* Free the entire stack */
+/* Free a SpGistSearchItem */
 static void
-freeScanStack(SpGistScanOpaque so)
+spgFreeSearchItem(SpGistScanOpaque so, SpGistSearchItem *item)
 {
-	ListCell   *lc;
+	if (!so->state.attType.attbyval &&
+		DatumGetPointer(item->value) != NULL)
+		pfree(DatumGetPointer(item->value));
+	if (item->traversalValue)
+		pfree(item->traversalValue);
+	pfree(item);
+}
 
-	foreach(lc, so->scanStack)
-	{
-		freeScanStackEntry(so, (ScanStackEntry *) lfirst(lc));
-	}
-	list_free(so->scanStack);
-	so->scanStack = NIL;
+/* Queue a work item to scan the null or non-null index entries */
+static void
+spgAddStartItem(SpGistScanOpaque so, bool isnull)
+{
+	SpGistSearchItem *startEntry = spgNewSearchItem(so, NULL);
+
+	ItemPointerSet(&startEntry->ptr,
+				   isnull ? SPGIST_NULL_BLKNO : SPGIST_ROOT_BLKNO,
+				   FirstOffsetNumber);
+	startEntry->isLeaf = false;
+	startEntry->level = 0;
+	startEntry->value = (Datum) 0;
+	startEntry->traversalValue = NULL;
+	startEntry->recheck = false;
+	startEntry->recheckDistances = false;
+	startEntry->isNull = isnull;
+
+	spgAddSearchItemToQueue(so, startEntry);
 }
 
 /*
- * Initialize scanStack to search the root page, resetting
+ * Initialize queue to search the root page, resetting
  * any previously active scan
  */
 static void
 resetSpGistScanOpaque(SpGistScanOpaque so)
 {
-	ScanStackEntry *startEntry;
+	MemoryContext oldCtx;
 
-	freeScanStack(so);
+	/* Everything in the old queue goes away with traversalCxt */
+	MemoryContextReset(so->traversalCxt);
 
-	if (so->searchNulls)
-	{
-		/* Stack a work item to scan the null index entries */
-		startEntry = (ScanStackEntry *) palloc0(sizeof(ScanStackEntry));
-		ItemPointerSet(&startEntry->ptr, SPGIST_NULL_BLKNO, FirstOffsetNumber);
-		so->scanStack = lappend(so->scanStack, startEntry);
-	}
+	oldCtx = MemoryContextSwitchTo(so->traversalCxt);
+	so->scanQueue = pairingheap_allocate(pairingheap_SpGistSearchItem_cmp, so);
+	MemoryContextSwitchTo(oldCtx);
+	so->nextSeqNo = 0;
 
+	/* Queue nulls last; without ordering, that makes them be scanned first */
 	if (so->searchNonNulls)
-	{
-		/* Stack a work item to scan the non-null index entries */
-		startEntry = (ScanStackEntry *) palloc0(sizeof(ScanStackEntry));
-		ItemPointerSet(&startEntry->ptr, SPGIST_ROOT_BLKNO, FirstOffsetNumber);
-		so->scanStack = lappend(so->scanStack, startEntry);
-	}
+		spgAddStartItem(so, false);
+
+	if (so->searchNulls)
+		spgAddStartItem(so, true);
 
 	if (so->want_itup)
 	{
@@ -94,6 +180,16 @@ resetSpGistScanOpaque(SpGistScanOpaque so)
 		for (i = 0; i < so->nPtrs; i++)
 			pfree(so->indexTups[i]);
 	}
+
+	if (so->numberOfOrderBys > 0)
+	{
+		/* Must pfree distances to avoid memory leak */
+		int			i;
+
+		for (i = 0; i < so->nPtrs; i++)
+			if (so->distances[i])
+				pfree(so->distances[i]);
+	}
 	so->iPtr = so->nPtrs = 0;
 }
 
@@ -178,12 +274,11 @@ spgbeginscan(PG_FUNCTION_ARGS)
 {
 	Relation	rel = (Relation) PG_GETARG_POINTER(0);
 	int			keysz = PG_GETARG_INT32(1);
-
-	/* ScanKey			scankey = (ScanKey) PG_GETARG_POINTER(2); */
+	int			norderbys = PG_GETARG_INT32(2);
 	IndexScanDesc scan;
 	SpGistScanOpaque so;
 
-	scan = RelationGetIndexScan(rel, keysz, 0);
+	scan = RelationGetIndexScan(rel, keysz, norderbys);
 
 	so = (SpGistScanOpaque) palloc0(sizeof(SpGistScanOpaqueData));
 	if (keysz > 0)
@@ -196,6 +291,22 @@ spgbeginscan(PG_FUNCTION_ARGS)
 										ALLOCSET_DEFAULT_MINSIZE,
 										ALLOCSET_DEFAULT_INITSIZE,
 										ALLOCSET_DEFAULT_MAXSIZE);
+	so->traversalCxt = AllocSetContextCreate(CurrentMemoryContext,
+											 "SP-GiST traversal-value context",
+											 ALLOCSET_DEFAULT_MINSIZE,
+											 ALLOCSET_DEFAULT_INITSIZE,
+											 ALLOCSET_DEFAULT_MAXSIZE);
+
+	/* workspaces with size dependent on numberOfOrderBys: */
+	so->numberOfOrderBys = scan->numberOfOrderBys;
+	so->orderByData = scan->orderByData;
+	if (scan->numberOfOrderBys > 0)
+	{
+		so->orderByTypes = (Oid *) palloc(sizeof(Oid) * scan->numberOfOrderBys);
+		scan->xs_orderbyvals = palloc0(sizeof(Datum) * scan->numberOfOrderBys);
+		scan->xs_orderbynulls = palloc(sizeof(bool) * scan->numberOfOrderBys);
+		memset(scan->xs_orderbynulls, true, sizeof(bool) * scan->numberOfOrderBys);
+	}
 
 	/* Set up indexTupDesc and xs_itupdesc in case it's an index-only scan */
 	so->indexTupDesc = scan->xs_itupdesc = RelationGetDescr(rel);
@@ -211,6 +322,7 @@ spgrescan(PG_FUNCTION_ARGS)
 	IndexScanDesc scan = (IndexScanDesc) PG_GETARG_POINTER(0);
 	SpGistScanOpaque so = (SpGistScanOpaque) scan->opaque;
 	ScanKey		scankey = (ScanKey) PG_GETARG_POINTER(1);
+	ScanKey		orderbys = (ScanKey) PG_GETARG_POINTER(3);
 
 	/* copy scankeys into local storage */
 	if (scankey && scan->numberOfKeys > 0)
@@ -219,10 +331,28 @@ spgrescan(PG_FUNCTION_ARGS)
 				scan->numberOfKeys * sizeof(ScanKeyData));
 	}
 
+	/* copy ordering scankeys into local storage */
+	if (orderbys && scan->numberOfOrderBys > 0)
+	{
+		int			i;
+
+		memmove(scan->orderByData, orderbys,
+				scan->numberOfOrderBys * sizeof(ScanKeyData));
+
+		/*
+		 * Look up the datatype returned by each ordering operator.  The
+		 * opclass computes distances as float8, but the ordering operator
+		 * could return something else; see spgStoreOrderByValues.
+		 */
+		for (i = 0; i < scan->numberOfOrderBys; i++)
+			so->orderByTypes[i] =
+				get_func_rettype(scan->orderByData[i].sk_func.fn_oid);
+	}
+
 	/* preprocess scankeys, set up the representation in *so */
 	spgPrepareScanKeys(scan);
 
-	/* set up starting stack entries */
+	/* set up starting queue entries */
 	resetSpGistScanOpaque(so);
 
 	PG_RETURN_VOID();
@@ -235,6 +365,7 @@ spgendscan(PG_FUNCTION_ARGS)
 	SpGistScanOpaque so = (SpGistScanOpaque) scan->opaque;
 
 	MemoryContextDelete(so->tempCxt);
+	MemoryContextDelete(so->traversalCxt);
 
 	PG_RETURN_VOID();
 }
@@ -256,58 +387,229 @@ spgrestrpos(PG_FUNCTION_ARGS)
 /*
  * Test whether a leaf tuple satisfies all the scan keys
  *
- * *leafValue is set to the reconstructed datum, if provided
- * *recheck is set true if any of the operators are lossy
+ * If it does, it is reported to storeRes right away; in an ordered scan it
+ * is queued instead, to be reported when it reaches the head of the queue.
+ * Returns true if a tuple was reported.
  */
 static bool
 spgLeafTest(Relation index, SpGistScanOpaque so,
 			SpGistLeafTuple leafTuple, bool isnull,
-			int level, Datum reconstructedValue,
-			Datum *leafValue, bool *recheck)
+			SpGistSearchItem *item, storeRes_func storeRes)
 {
 	bool		result;
-	Datum		leafDatum;
-	spgLeafConsistentIn in;
-	spgLeafConsistentOut out;
-	FmgrInfo   *procinfo;
-	MemoryContext oldCtx;
+	Datum		leafValue;
+	bool		recheck;
+	bool		recheckDistances;
+	double	   *distances;
 
 	if (isnull)
 	{
 		/* Should not have arrived on a nulls page unless nulls are wanted */
 		Assert(so->searchNulls);
-		*leafValue = (Datum) 0;
-		*recheck = false;
-		return true;
+		leafValue = (Datum) 0;
+		recheck = false;
+		recheckDistances = false;
+		distances = NULL;
+		result = true;
 	}
+	else
+	{
+		spgLeafConsistentIn in;
+		spgLeafConsistentOut out;
+		FmgrInfo   *procinfo;
+		MemoryContext oldCtx;
+
+		/* use temp context for calling leaf_consistent */
+		oldCtx = MemoryContextSwitchTo(so->tempCxt);
+
+		in.scankeys = so->keyData;
+		in.nkeys = so->numberOfKeys;
+		in.orderbys = so->orderByData;
+		in.norderbys = so->numberOfOrderBys;
+		in.reconstructedValue = item->value;
+		in.traversalValue = item->traversalValue;
+		in.level = item->level;
+		in.returnData = so->want_itup;
+		in.leafDatum = SGLTDATUM(leafTuple, &so->state);
+
+		out.leafValue = (Datum) 0;
+		out.recheck = false;
+		out.recheckDistances = false;
+		out.distances = NULL;
+
+		procinfo = index_getprocinfo(index, 1, SPGIST_LEAF_CONSISTENT_PROC);
+		result = DatumGetBool(FunctionCall2Coll(procinfo,
+												index->rd_indcollation[0],
+												PointerGetDatum(&in),
+												PointerGetDatum(&out)));
+
+		MemoryContextSwitchTo(oldCtx);
+
+		leafValue = out.leafValue;
+		recheck = out.recheck;
+		recheckDistances = out.recheckDistances;
+		distances = out.distances;
+
+		if (result && so->numberOfOrderBys > 0 && distances == NULL)
+			elog(ERROR, "SP-GiST leaf_consistent function did not return distances for an ordered scan");
+	}
+
+	if (!result)
+		return false;
+
+	if (so->numberOfOrderBys > 0)
+	{
+		/* the scan is ordered -> add the item to the queue */
+		SpGistSearchItem *heapItem = spgNewSearchItem(so, distances);
+
+		heapItem->ptr = leafTuple->heapPtr;
+		heapItem->isLeaf = true;
+		heapItem->isNull = isnull;
+		heapItem->level = item->level;
+		heapItem->traversalValue = NULL;
+		heapItem->recheck = recheck;
+		heapItem->recheckDistances = recheckDistances;
+
+		/* Must copy value out of temp context */
+		if (so->want_itup && !isnull)
+		{
+			MemoryContext oldCtx = MemoryContextSwitchTo(so->traversalCxt);
+
+			heapItem->value = datumCopy(leafValue,
+										so->state.attType.attbyval,
+										so->state.attType.attlen);
+			MemoryContextSwitchTo(oldCtx);
+		}
+		else
+			heapItem->value = (Datum) 0;
 
-	leafDatum = SGLTDATUM(leafTuple, &so->state);
+		spgAddSearchItemToQueue(so, heapItem);
+		return false;
+	}
 
-	/* use temp context for calling leaf_consistent */
+	/* non-ordered scan, so report the item right away */
+	storeRes(so, &leafTuple->heapPtr, leafValue, isnull,
+			 recheck, false, NULL);
+	return true;
+}
+
+/*
+ * Process an inner tuple: call the opclass's inner_consistent method, and
+ * queue an item for each child node it wants visited.
+ */
+static void
+spgInnerTest(Relation index, SpGistScanOpaque so,
+			 SpGistInnerTuple innerTuple, bool isnull,
+			 SpGistSearchItem *item)
+{
+	spgInnerConsistentIn in;
+	spgInnerConsistentOut out;
+	FmgrInfo   *procinfo;
+	SpGistNodeTuple *nodes;
+	SpGistNodeTuple node;
+	int			i;
+	MemoryContext oldCtx;
+
+	/* use temp context for calling inner_consistent */
 	oldCtx = MemoryContextSwitchTo(so->tempCxt);
 
 	in.scankeys = so->keyData;
 	in.nkeys = so->numberOfKeys;
-	in.reconstructedValue = reconstructedValue;
-	in.level = level;
+	in.orderbys = so->orderByData;
+	in.norderbys = so->numberOfOrderBys;
+	in.reconstructedValue = item->value;
+	in.traversalValue = item->traversalValue;
+	in.traversalMemoryContext = so->traversalCxt;
+	in.level = item->level;
 	in.returnData = so->want_itup;
-	in.leafDatum = leafDatum;
-
-	out.leafValue = (Datum) 0;
-	out.recheck = false;
+	in.allTheSame = innerTuple->allTheSame;
+	in.hasPrefix = (innerTuple->prefixSize > 0);
+	in.prefixDatum = SGITDATUM(innerTuple, &so->state);
+	in.nNodes = innerTuple->nNodes;
+	in.nodeLabels = spgExtractNodeLabels(&so->state, innerTuple);
+
+	/* collect node pointers */
+	nodes = (SpGistNodeTuple *) palloc(sizeof(SpGistNodeTuple) * in.nNodes);
+	SGITITERATE(innerTuple, i, node)
+	{
+		nodes[i] = node;
+	}
 
-	procinfo = index_getprocinfo(index, 1, SPGIST_LEAF_CONSISTENT_PROC);
-	result = DatumGetBool(FunctionCall2Coll(procinfo,
-											index->rd_indcollation[0],
-											PointerGetDatum(&in),
-											PointerGetDatum(&out)));
+	memset(&out, 0, sizeof(out));
 
-	*leafValue = out.leafValue;
-	*recheck = out.recheck;
+	if (!isnull)
+	{
+		/* use user-defined inner consistent method */
+		procinfo = index_getprocinfo(index, 1, SPGIST_INNER_CONSISTENT_PROC);
+		FunctionCall2Coll(procinfo,
+						  index->rd_indcollation[0],
+						  PointerGetDatum(&in),
+						  PointerGetDatum(&out));
+	}
+	else
+	{
+		/* force all children to be visited */
+		out.nNodes = in.nNodes;
+		out.nodeNumbers = (int *) palloc(sizeof(int) * in.nNodes);
+		for (i = 0; i < in.nNodes; i++)
+			out.nodeNumbers[i] = i;
+	}
 
 	MemoryContextSwitchTo(oldCtx);
 
-	return result;
+	/* If allTheSame, they should all or none of 'em match */
+	if (innerTuple->allTheSame)
+		if (out.nNodes != 0 && out.nNodes != in.nNodes)
+			elog(ERROR, "inconsistent inner_consistent results for allTheSame inner tuple");
+
+	for (i = 0; i < out.nNodes; i++)
+	{
+		int			nodeN = out.nodeNumbers[i];
+
+		Assert(nodeN >= 0 && nodeN < in.nNodes);
+		if (ItemPointerIsValid(&nodes[nodeN]->t_tid))
+		{
+			SpGistSearchItem *innerItem;
+
+			/* Create new work item for this node */
+			innerItem = spgNewSearchItem(so,
+									 out.distances ? out.distances[i] : NULL);
+			innerItem->ptr = nodes[nodeN]->t_tid;
+			innerItem->isLeaf = false;
+			innerItem->isNull = isnull;
+			innerItem->recheck = false;
+			innerItem->recheckDistances = false;
+			if (out.levelAdds)
+				innerItem->level = item->level + out.levelAdds[i];
+			else
+				innerItem->level = item->level;
+			/* Must copy value out of temp context */
+			if (out.reconstructedValues)
+			{
+				oldCtx = MemoryContextSwitchTo(so->traversalCxt);
+				innerItem->value =
+					datumCopy(out.reconstructedValues[i],
+							  so->state.attType.attbyval,
+							  so->state.attType.attlen);
+				MemoryContextSwitchTo(oldCtx);
+			}
+			else
+				innerItem->value = (Datum) 0;
+
+			/*
+			 * The opclass allocated the traverse value in traversalCxt
+			 * already, so just take it over; it is freed with the item.
+			 */
+			if (out.traversalValues)
+				innerItem->traversalValue = out.traversalValues[i];
+			else
+				innerItem->traversalValue = NULL;
+
+			spgAddSearchItemToQueue(so, innerItem);
+		}
+		else if (out.traversalValues && out.traversalValues[i])
+			pfree(out.traversalValues[i]);
+	}
 }
 
 /*
@@ -315,7 +617,8 @@ spgLeafTest(Relation index, SpGistScanOpaque so,
  * subroutine.
  *
  * If scanWholeIndex is true, we'll do just that.  If not, we'll stop at the
- * next page boundary once we have reported at least one tuple.
+ * next page boundary once we have reported at least one tuple.  In an
+ * ordered scan, tuples are reported one at a time, in distance order.
  */
 static void
 spgWalk(Relation index, SpGistScanOpaque so, bool scanWholeIndex,
@@ -326,234 +629,144 @@ spgWalk(Relation index, SpGistScanOpaque so, bool scanWholeIndex,
 
 	while (scanWholeIndex || !reportedSome)
 	{
-		ScanStackEntry *stackEntry;
+		SpGistSearchItem *item;
 		BlockNumber blkno;
 		OffsetNumber offset;
 		Page		page;
 		bool		isnull;
 
-		/* Pull next to-do item from the list */
-		if (so->scanStack == NIL)
+		/* Pull next to-do item from the queue */
+		if (pairingheap_is_empty(so->scanQueue))
 			break;				/* there are no more pages to scan */
 
-		stackEntry = (ScanStackEntry *) linitial(so->scanStack);
-		so->scanStack = list_delete_first(so->scanStack);
-
-redirect:
-		/* Check for interrupts, just in case of infinite loop */
-		CHECK_FOR_INTERRUPTS();
-
-		blkno = ItemPointerGetBlockNumber(&stackEntry->ptr);
-		offset = ItemPointerGetOffsetNumber(&stackEntry->ptr);
+		item = (SpGistSearchItem *) pairingheap_remove_first(so->scanQueue);
 
-		if (buffer == InvalidBuffer)
+		if (item->isLeaf)
 		{
-			buffer = ReadBuffer(index, blkno);
-			LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			/* We store heap items in the queue only in an ordered scan */
+			Assert(so->numberOfOrderBys > 0);
+			storeRes(so, &item->ptr, item->value, item->isNull,
+					 item->recheck, item->recheckDistances, item->distances);
+			reportedSome = true;
 		}
-		else if (blkno != BufferGetBlockNumber(buffer))
+		else
 		{
-			UnlockReleaseBuffer(buffer);
-			buffer = ReadBuffer(index, blkno);
-			LockBuffer(buffer, BUFFER_LOCK_SHARE);
-		}
-		/* else new pointer points to the same page, no work needed */
+redirect:
+			/* Check for interrupts, just in case of infinite loop */
+			CHECK_FOR_INTERRUPTS();
 
-		page = BufferGetPage(buffer);
+			blkno = ItemPointerGetBlockNumber(&item->ptr);
+			offset = ItemPointerGetOffsetNumber(&item->ptr);
 
-		isnull = SpGistPageStoresNulls(page) ? true : false;
+			if (buffer == InvalidBuffer)
+			{
+				buffer = ReadBuffer(index, blkno);
+				LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			}
+			else if (blkno != BufferGetBlockNumber(buffer))
+			{
+				UnlockReleaseBuffer(buffer);
+				buffer = ReadBuffer(index, blkno);
+				LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			}
+			/* else new pointer points to the same page, no work needed */
 
-		if (SpGistPageIsLeaf(page))
-		{
-			SpGistLeafTuple leafTuple;
-			OffsetNumber max = PageGetMaxOffsetNumber(page);
-			Datum		leafValue = (Datum) 0;
-			bool		recheck = false;
+			page = BufferGetPage(buffer);
 
-			if (SpGistBlockIsRoot(blkno))
+			isnull = SpGistPageStoresNulls(page) ? true : false;
+
+			if (SpGistPageIsLeaf(page))
 			{
-				/* When root is a leaf, examine all its tuples */
-				for (offset = FirstOffsetNumber; offset <= max; offset++)
+				SpGistLeafTuple leafTuple;
+				OffsetNumber max = PageGetMaxOffsetNumber(page);
+
+				if (SpGistBlockIsRoot(blkno))
 				{
-					leafTuple = (SpGistLeafTuple)
-						PageGetItem(page, PageGetItemId(page, offset));
-					if (leafTuple->tupstate != SPGIST_LIVE)
+					/* When root is a leaf, examine all its tuples */
+					for (offset = FirstOffsetNumber; offset <= max; offset++)
 					{
-						/* all tuples on root should be live */
-						elog(ERROR, "unexpected SPGiST tuple state: %d",
-							 leafTuple->tupstate);
-					}
+						leafTuple = (SpGistLeafTuple)
+							PageGetItem(page, PageGetItemId(page, offset));
+						if (leafTuple->tupstate != SPGIST_LIVE)
+						{
+							/* all tuples on root should be live */
+							elog(ERROR, "unexpected SPGiST tuple state: %d",
+								 leafTuple->tupstate);
+						}
 
-					Assert(ItemPointerIsValid(&leafTuple->heapPtr));
-					if (spgLeafTest(index, so,
-									leafTuple, isnull,
-									stackEntry->level,
-									stackEntry->reconstructedValue,
-									&leafValue,
-									&recheck))
-					{
-						storeRes(so, &leafTuple->heapPtr,
-								 leafValue, isnull, recheck);
-						reportedSome = true;
+						Assert(ItemPointerIsValid(&leafTuple->heapPtr));
+						if (spgLeafTest(index, so, leafTuple, isnull,
+										item, storeRes))
+							reportedSome = true;
 					}
 				}
-			}
-			else
-			{
-				/* Normal case: just examine the chain we arrived at */
-				while (offset != InvalidOffsetNumber)
+				else
 				{
-					Assert(offset >= FirstOffsetNumber && offset <= max);
-					leafTuple = (SpGistLeafTuple)
-						PageGetItem(page, PageGetItemId(page, offset));
-					if (leafTuple->tupstate != SPGIST_LIVE)
+					/* Normal case: just examine the chain we arrived at */
+					while (offset != InvalidOffsetNumber)
 					{
-						if (leafTuple->tupstate == SPGIST_REDIRECT)
+						Assert(offset >= FirstOffsetNumber && offset <= max);
+						leafTuple = (SpGistLeafTuple)
+							PageGetItem(page, PageGetItemId(page, offset));
+						if (leafTuple->tupstate != SPGIST_LIVE)
 						{
-							/* redirection tuple should be first in chain */
-							Assert(offset == ItemPointerGetOffsetNumber(&stackEntry->ptr));
-							/* transfer attention to redirect point */
-							stackEntry->ptr = ((SpGistDeadTuple) leafTuple)->pointer;
-							Assert(ItemPointerGetBlockNumber(&stackEntry->ptr) != SPGIST_METAPAGE_BLKNO);
-							goto redirect;
+							if (leafTuple->tupstate == SPGIST_REDIRECT)
+							{
+								/* redirection tuple should be first in chain */
+								Assert(offset == ItemPointerGetOffsetNumber(&item->ptr));
+								/* transfer attention to redirect point */
+								item->ptr = ((SpGistDeadTuple) leafTuple)->pointer;
+								Assert(ItemPointerGetBlockNumber(&item->ptr) != SPGIST_METAPAGE_BLKNO);
+								goto redirect;
+							}
+							if (leafTuple->tupstate == SPGIST_DEAD)
+							{
+								/* dead tuple should be first in chain */
+								Assert(offset == ItemPointerGetOffsetNumber(&item->ptr));
+								/* No live entries on this page */
+								Assert(leafTuple->nextOffset == InvalidOffsetNumber);
+								break;
+							}
+							/* We should not arrive at a placeholder */
+							elog(ERROR, "unexpected SPGiST tuple state: %d",
+								 leafTuple->tupstate);
 						}
-						if (leafTuple->tupstate == SPGIST_DEAD)
-						{
-							/* dead tuple should be first in chain */
-							Assert(offset == ItemPointerGetOffsetNumber(&stackEntry->ptr));
-							/* No live entries on this page */
-							Assert(leafTuple->nextOffset == InvalidOffsetNumber);
-							break;
-						}
-						/* We should not arrive at a placeholder */
-						elog(ERROR, "unexpected SPGiST tuple state: %d",
-							 leafTuple->tupstate);
-					}
 
-					Assert(ItemPointerIsValid(&leafTuple->heapPtr));
-					if (spgLeafTest(index, so,
-									leafTuple, isnull,
-									stackEntry->level,
-									stackEntry->reconstructedValue,
-									&leafValue,
-									&recheck))
-					{
-						storeRes(so, &leafTuple->heapPtr,
-								 leafValue, isnull, recheck);
-						reportedSome = true;
-					}
+						Assert(ItemPointerIsValid(&leafTuple->heapPtr));
+						if (spgLeafTest(index, so, leafTuple, isnull,
+										item, storeRes))
+							reportedSome = true;
 
-					offset = leafTuple->nextOffset;
+						offset = leafTuple->nextOffset;
+					}
 				}
 			}
-		}
-		else	/* page is inner */
-		{
-			SpGistInnerTuple innerTuple;
-			spgInnerConsistentIn in;
-			spgInnerConsistentOut out;
-			FmgrInfo   *procinfo;
-			SpGistNodeTuple *nodes;
-			SpGistNodeTuple node;
-			int			i;
-			MemoryContext oldCtx;
+			else	/* page is inner */
+			{
+				SpGistInnerTuple innerTuple;
 
-			innerTuple = (SpGistInnerTuple) PageGetItem(page,
+				innerTuple = (SpGistInnerTuple) PageGetItem(page,
 												PageGetItemId(page, offset));
 
-			if (innerTuple->tupstate != SPGIST_LIVE)
-			{
-				if (innerTuple->tupstate == SPGIST_REDIRECT)
+				if (innerTuple->tupstate != SPGIST_LIVE)
 				{
-					/* transfer attention to redirect point */
-					stackEntry->ptr = ((SpGistDeadTuple) innerTuple)->pointer;
-					Assert(ItemPointerGetBlockNumber(&stackEntry->ptr) != SPGIST_METAPAGE_BLKNO);
-					goto redirect;
+					if (innerTuple->tupstate == SPGIST_REDIRECT)
+					{
+						/* transfer attention to redirect point */
+						item->ptr = ((SpGistDeadTuple) innerTuple)->pointer;
+						Assert(ItemPointerGetBlockNumber(&item->ptr) != SPGIST_METAPAGE_BLKNO);
+						goto redirect;
+					}
+					elog(ERROR, "unexpected SPGiST tuple state: %d",
+						 innerTuple->tupstate);
 				}
-				elog(ERROR, "unexpected SPGiST tuple state: %d",
-					 innerTuple->tupstate);
-			}
-
-			/* use temp context for calling inner_consistent */
-			oldCtx = MemoryContextSwitchTo(so->tempCxt);
-
-			in.scankeys = so->keyData;
-			in.nkeys = so->numberOfKeys;
-			in.reconstructedValue = stackEntry->reconstructedValue;
-			in.level = stackEntry->level;
-			in.returnData = so->want_itup;
-			in.allTheSame = innerTuple->allTheSame;
-			in.hasPrefix = (innerTuple->prefixSize > 0);
-			in.prefixDatum = SGITDATUM(innerTuple, &so->state);
-			in.nNodes = innerTuple->nNodes;
-			in.nodeLabels = spgExtractNodeLabels(&so->state, innerTuple);
-
-			/* collect node pointers */
-			nodes = (SpGistNodeTuple *) palloc(sizeof(SpGistNodeTuple) * in.nNodes);
-			SGITITERATE(innerTuple, i, node)
-			{
-				nodes[i] = node;
-			}
-
-			memset(&out, 0, sizeof(out));
-
-			if (!isnull)
-			{
-				/* use user-defined inner consistent method */
-				procinfo = index_getprocinfo(index, 1, SPGIST_INNER_CONSISTENT_PROC);
-				FunctionCall2Coll(procinfo,
-								  index->rd_indcollation[0],
-								  PointerGetDatum(&in),
-								  PointerGetDatum(&out));
-			}
-			else
-			{
-				/* force all children to be visited */
-				out.nNodes = in.nNodes;
-				out.nodeNumbers = (int *) palloc(sizeof(int) * in.nNodes);
-				for (i = 0; i < in.nNodes; i++)
-					out.nodeNumbers[i] = i;
-			}
-
-			MemoryContextSwitchTo(oldCtx);
 
-			/* If allTheSame, they should all or none of 'em match */
-			if (innerTuple->allTheSame)
-				if (out.nNodes != 0 && out.nNodes != in.nNodes)
-					elog(ERROR, "inconsistent inner_consistent results for allTheSame inner tuple");
-
-			for (i = 0; i < out.nNodes; i++)
-			{
-				int			nodeN = out.nodeNumbers[i];
-
-				Assert(nodeN >= 0 && nodeN < in.nNodes);
-				if (ItemPointerIsValid(&nodes[nodeN]->t_tid))
-				{
-					ScanStackEntry *newEntry;
-
-					/* Create new work item for this node */
-					newEntry = palloc(sizeof(ScanStackEntry));
-					newEntry->ptr = nodes[nodeN]->t_tid;
-					if (out.levelAdds)
-						newEntry->level = stackEntry->level + out.levelAdds[i];
-					else
-						newEntry->level = stackEntry->level;
-					/* Must copy value out of temp context */
-					if (out.reconstructedValues)
-						newEntry->reconstructedValue =
-							datumCopy(out.reconstructedValues[i],
-									  so->state.attType.attbyval,
-									  so->state.attType.attlen);
-					else
-						newEntry->reconstructedValue = (Datum) 0;
-
-					so->scanStack = lcons(newEntry, so->scanStack);
-				}
+				spgInnerTest(index, so, innerTuple, isnull, item);
 			}
 		}
 
-		/* done with this scan stack entry */
-		freeScanStackEntry(so, stackEntry);
+		/* done with this scan queue item */
+		spgFreeSearchItem(so, item);
 		/* clear temp context before proceeding to the next one */
 		MemoryContextReset(so->tempCxt);
 	}
@@ -565,7 +778,8 @@ redirect:
 /* storeRes subroutine for getbitmap case */
 static void
 storeBitmap(SpGistScanOpaque so, ItemPointer heapPtr,
-			Datum leafValue, bool isnull, bool recheck)
+			Datum leafValue, bool isnull, bool recheck,
+			bool recheckDistances, double *distances)
 {
 	tbm_add_tuples(so->tbm, heapPtr, 1, recheck);
 	so->ntids++;
@@ -592,11 +806,26 @@ spggetbitmap(PG_FUNCTION_ARGS)
 /* storeRes subroutine for gettuple case */
 static void
 storeGettuple(SpGistScanOpaque so, ItemPointer heapPtr,
-			  Datum leafValue, bool isnull, bool recheck)
+			  Datum leafValue, bool isnull, bool recheck,
+			  bool recheckDistances, double *distances)
 {
 	Assert(so->nPtrs < MaxIndexTuplesPerPage);
 	so->heapPtrs[so->nPtrs] = *heapPtr;
 	so->recheck[so->nPtrs] = recheck;
+	so->recheckDistances[so->nPtrs] = recheckDistances;
+
+	if (so->numberOfOrderBys > 0)
+	{
+		if (isnull)
+			so->distances[so->nPtrs] = NULL;
+		else
+		{
+			Size		size = sizeof(double) * so->numberOfOrderBys;
+
+			so->distances[so->nPtrs] = memcpy(palloc(size), distances, size);
+		}
+	}
+
 	if (so->want_itup)
 	{
 		/*
@@ -610,6 +839,69 @@ storeGettuple(SpGistScanOpaque so, ItemPointer heapPtr,
 	so->nPtrs++;
 }
 
+/*
+ * Set the ORDER BY values of the returned tuple from the distances the
+ * opclass computed for it; a NULL array means a null index entry.
+ */
+static void
+spgStoreOrderByValues(IndexScanDesc scan, double *distances,
+					  bool recheckDistances)
+{
+	SpGistScanOpaque so = (SpGistScanOpaque) scan->opaque;
+	int			i;
+
+	scan->xs_recheckorderby = recheckDistances;
+
+	for (i = 0; i < scan->numberOfOrderBys; i++)
+	{
+		if (distances == NULL)
+		{
+			/* must free any old value to avoid memory leakage */
+#ifndef USE_FLOAT8_BYVAL
+			if (!scan->xs_orderbynulls[i] && so->orderByTypes[i] == FLOAT8OID)
+				pfree(DatumGetPointer(scan->xs_orderbyvals[i]));
+#endif
+#ifndef USE_FLOAT4_BYVAL
+			if (!scan->xs_orderbynulls[i] && so->orderByTypes[i] == FLOAT4OID)
+				pfree(DatumGetPointer(scan->xs_orderbyvals[i]));
+#endif
+			scan->xs_orderbyvals[i] = (Datum) 0;
+			scan->xs_orderbynulls[i] = true;
+		}
+		else if (so->orderByTypes[i] == FLOAT8OID)
+		{
+#ifndef USE_FLOAT8_BYVAL
+			/* must free any old value to avoid memory leakage */
+			if (!scan->xs_orderbynulls[i])
+				pfree(DatumGetPointer(scan->xs_orderbyvals[i]));
+#endif
+			scan->xs_orderbyvals[i] = Float8GetDatum(distances[i]);
+			scan->xs_orderbynulls[i] = false;
+		}
+		else if (so->orderByTypes[i] == FLOAT4OID)
+		{
+			/* convert distance function's result to ORDER BY type */
+#ifndef USE_FLOAT4_BYVAL
+			/* must free any old value to avoid memory leakage */
+			if (!scan->xs_orderbynulls[i])
+				pfree(DatumGetPointer(scan->xs_orderbyvals[i]));
+#endif
+			scan->xs_orderbyvals[i] = Float4GetDatum((float4) distances[i]);
+			scan->xs_orderbynulls[i] = false;
+		}
+		else
+		{
+			/*
+			 * As in GiST, we can't convert the float8 distance to any other
+			 * ORDER BY type; that's only a problem if it must be rechecked.
+			 */
+			if (scan->xs_recheckorderby)
+				elog(ERROR, "SP-GiST operator family's FOR ORDER BY operator must return float8 or float4 if the distance function is lossy");
+			scan->xs_orderbynulls[i] = true;
+		}
+	}
+}
+
 Datum
 spggettuple(PG_FUNCTION_ARGS)
 {
@@ -627,10 +919,14 @@ spggettuple(PG_FUNCTION_ARGS)
 	{
 		if (so->iPtr < so->nPtrs)
 		{
-			/* continuing to return tuples from a leaf page */
+			/* continuing to return reported tuples */
 			scan->xs_ctup.t_self = so->heapPtrs[so->iPtr];
 			scan->xs_recheck = so->recheck[so->iPtr];
 			scan->xs_itup = so->indexTups[so->iPtr];
+
+			if (so->numberOfOrderBys > 0)
+				spgStoreOrderByValues(scan, so->distances[so->iPtr],
+									  so->recheckDistances[so->iPtr]);
 			so->iPtr++;
 			PG_RETURN_BOOL(true);
 		}
@@ -643,6 +939,16 @@ spggettuple(PG_FUNCTION_ARGS)
 			for (i = 0; i < so->nPtrs; i++)
 				pfree(so->indexTups[i]);
 		}
+
+		if (so->numberOfOrderBys > 0)
+		{
+			/* Must pfree distances to avoid memory leak */
+			int			i;
+
+			for (i = 0; i < so->nPtrs; i++)
+				if (so->distances[i])
+					pfree(so->distances[i]);
+		}
 		so->iPtr = so->nPtrs = 0;
 
 		spgWalk(scan->indexRelation, so, false, storeGettuple);
@@ -70,6 +70,9 @@ typedef struct AnlIndexData
 /* Default statistics target (GUC parameter) */
 int			default_statistics_target = 100;
 
+/* Hook for plugins to get control in examine_attribute() */
+examine_attribute_hook_type examine_attribute_hook = NULL;
+
 /* A few variables that don't seem worth passing around as parameters */
 static MemoryContext anl_context = NULL;
 static BufferAccessStrategy vac_strategy;
@@ -936,6 +939,9 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
 		return NULL;
 	}
 
+	if (examine_attribute_hook)
+		(*examine_attribute_hook) (stats);
+
 	return stats;
 }
 
@@ -548,6 +548,15 @@ ExecInitIndexOnlyScan(IndexOnlyScan *node, EState *estate, int eflags)
 	indexstate->ioss_ScanDesc->xs_want_itup = true;
 	indexstate->ioss_VMBuffer = InvalidBuffer;
 
+#ifdef USE_PREFETCH
+
+	/*
+	 * Let the index AM read ahead on the heap, if it knows how.  It is
+	 * expected to skip heap pages that the visibility map says we won't need.
+	 */
+	indexstate->ioss_ScanDesc->xs_prefetch_target = target_prefetch_pages;
+#endif   /* USE_PREFETCH */
+
 	/*
 	 * If no run-time keys to calculate, go ahead and pass the scankeys to the
 	 * index AM.
@@ -32,6 +32,7 @@
 #include "lib/pairingheap.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
+#include "storage/bufmgr.h"
 #include "utils/array.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
@@ -1025,6 +1026,11 @@ ExecInitIndexScan(IndexScan *node, EState *estate, int eflags)
 											   indexstate->iss_NumScanKeys,
 											 indexstate->iss_NumOrderByKeys);
 
+#ifdef USE_PREFETCH
+	/* Let the index AM read ahead on the heap, if it knows how */
+	indexstate->iss_ScanDesc->xs_prefetch_target = target_prefetch_pages;
+#endif   /* USE_PREFETCH */
+
 	/*
 	 * If no run-time keys to calculate, go ahead and pass the scankeys to the
 	 * index AM.
@@ -28,6 +28,11 @@
  * into a bitmap, and it can also happen internally when we AND a lossy
  * and a non-lossy page.
  *
+ * A completed bitmap can also be copied into shared memory, such as a
+ * dynamic shared memory segment, for iteration by several cooperating
+ * processes.  Each page of the bitmap is then handed out to exactly one of
+ * the processes attached to the shared iteration.
+ *
  *
  * Copyright (c) 2003-2015, PostgreSQL Global Development Group
  *
@@ -43,6 +48,8 @@
 #include "access/htup_details.h"
 #include "nodes/bitmapset.h"
 #include "nodes/tidbitmap.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
 #include "utils/hsearch.h"
 
 /*
@@ -155,6 +162,36 @@ struct TBMIterator
 	TBMIterateResult output;	/* MUST BE LAST (because variable-size) */
 };
 
+/*
+ * State of a shared iteration, living in shared memory.  It is followed by
+ * copies of the exact-page entries and then the lossy-chunk entries, each in
+ * sorted order, so that the whole thing is position-independent and can be
+ * mapped at different addresses in different processes.  The entries are
+ * read-only; only the iteration pointers change, under the spinlock.
+ */
+struct TBMSharedIteratorState
+{
+	slock_t		mutex;			/* protects the iteration pointers */
+	int			npages;			/* number of exact entries */
+	int			nchunks;		/* number of lossy entries */
+	int			spageptr;		/* next spages index */
+	int			schunkptr;		/* next schunks index */
+	int			schunkbit;		/* next bit to check in current schunk */
+};
+
+#define TBM_SHARED_ENTRIES(istate) \
+	((PagetableEntry *) ((char *) (istate) + \
+						 MAXALIGN(sizeof(TBMSharedIteratorState))))
+
+/*
+ * Backend-local handle on a shared iteration.
+ */
+struct TBMSharedIterator
+{
+	TBMSharedIteratorState *state;	/* shared iteration state */
+	TBMIterateResult output;	/* MUST BE LAST (because variable-size) */
+};
+
 
 /* Local function prototypes */
 static void tbm_union_page(TIDBitmap *a, const PagetableEntry *bpage);
@@ -167,6 +204,10 @@ static bool tbm_page_is_lossy(const TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_lossify(TIDBitmap *tbm);
 static int	tbm_comparator(const void *left, const void *right);
+static void tbm_prepare_sorted_lists(TIDBitmap *tbm);
+static int	tbm_next_chunkbit(const PagetableEntry *chunk, int schunkbit);
+static int	tbm_extract_page_tuples(const PagetableEntry *page,
+						TBMIterateResult *output);
 
 
 /*
@@ -598,12 +639,22 @@ tbm_begin_iterate(TIDBitmap *tbm)
 	iterator->schunkptr = 0;
 	iterator->schunkbit = 0;
 
-	/*
-	 * If we have a hashtable, create and fill the sorted page lists, unless
-	 * we already did that for a previous iterator.  Note that the lists are
-	 * attached to the bitmap not the iterator, so they can be used by more
-	 * than one iterator.
-	 */
+	tbm_prepare_sorted_lists(tbm);
+
+	return iterator;
+}
+
+/*
+ * tbm_prepare_sorted_lists - set up the sorted page lists for iteration
+ *
+ * If we have a hashtable, create and fill the sorted page lists, unless
+ * we already did that for a previous iterator.  Note that the lists are
+ * attached to the bitmap not the iterator, so they can be used by more
+ * than one iterator.  The bitmap becomes read-only.
+ */
+static void
+tbm_prepare_sorted_lists(TIDBitmap *tbm)
+{
 	if (tbm->status == TBM_HASH && !tbm->iterating)
 	{
 		HASH_SEQ_STATUS status;
@@ -640,8 +691,6 @@ tbm_begin_iterate(TIDBitmap *tbm)
 	}
 
 	tbm->iterating = true;
-
-	return iterator;
 }
 
 /*
@@ -671,17 +720,9 @@ tbm_iterate(TBMIterator *iterator)
 	while (iterator->schunkptr < tbm->nchunks)
 	{
 		PagetableEntry *chunk = tbm->schunks[iterator->schunkptr];
-		int			schunkbit = iterator->schunkbit;
-
-		while (schunkbit < PAGES_PER_CHUNK)
-		{
-			int			wordnum = WORDNUM(schunkbit);
-			int			bitnum = BITNUM(schunkbit);
+		int			schunkbit;
 
-			if ((chunk->words[wordnum] & ((bitmapword) 1 << bitnum)) != 0)
-				break;
-			schunkbit++;
-		}
+		schunkbit = tbm_next_chunkbit(chunk, iterator->schunkbit);
 		if (schunkbit < PAGES_PER_CHUNK)
 		{
 			iterator->schunkbit = schunkbit;
@@ -717,8 +758,6 @@ tbm_iterate(TBMIterator *iterator)
 	if (iterator->spageptr < tbm->npages)
 	{
 		PagetableEntry *page;
-		int			ntuples;
-		int			wordnum;
 
 		/* In ONE_PAGE state, we don't allocate an spages[] array */
 		if (tbm->status == TBM_ONE_PAGE)
@@ -726,28 +765,7 @@ tbm_iterate(TBMIterator *iterator)
 		else
 			page = tbm->spages[iterator->spageptr];
 
-		/* scan bitmap to extract individual offset numbers */
-		ntuples = 0;
-		for (wordnum = 0; wordnum < WORDS_PER_PAGE; wordnum++)
-		{
-			bitmapword	w = page->words[wordnum];
-
-			if (w != 0)
-			{
-				int			off = wordnum * BITS_PER_BITMAPWORD + 1;
-
-				while (w != 0)
-				{
-					if (w & 1)
-						output->offsets[ntuples++] = (OffsetNumber) off;
-					off++;
-					w >>= 1;
-				}
-			}
-		}
-		output->blockno = page->blockno;
-		output->ntuples = ntuples;
-		output->recheck = page->recheck;
+		tbm_extract_page_tuples(page, output);
 		iterator->spageptr++;
 		return output;
 	}
@@ -769,6 +787,234 @@ tbm_end_iterate(TBMIterator *iterator)
 	pfree(iterator);
 }
 
+/*
+ * tbm_shared_iterate_size - shared memory needed for a shared iteration
+ *
+ * The bitmap must be complete; no more tuples may be added to it after
+ * this is called.
+ */
+Size
+tbm_shared_iterate_size(const TIDBitmap *tbm)
+{
+	return add_size(MAXALIGN(sizeof(TBMSharedIteratorState)),
+					mul_size(tbm->npages + tbm->nchunks,
+							 sizeof(PagetableEntry)));
+}
+
+/*
+ * tbm_prepare_shared_iterate - copy a TIDBitmap to shared memory
+ *
+ * 'space' must point to tbm_shared_iterate_size(tbm) bytes of suitably
+ * aligned shared memory.  The sorted page lists of the bitmap are copied
+ * there, so the local bitmap may be freed afterwards; like
+ * tbm_begin_iterate, this makes the bitmap read-only.
+ *
+ * The result can be passed to tbm_attach_shared_iterate by any process that
+ * has the same shared memory mapped, at whatever address.
+ */
+TBMSharedIteratorState *
+tbm_prepare_shared_iterate(TIDBitmap *tbm, void *space)
+{
+	TBMSharedIteratorState *istate = (TBMSharedIteratorState *) space;
+	PagetableEntry *entries = TBM_SHARED_ENTRIES(istate);
+	int			i;
+
+	tbm_prepare_sorted_lists(tbm);
+
+	SpinLockInit(&istate->mutex);
+	istate->npages = tbm->npages;
+	istate->nchunks = tbm->nchunks;
+	istate->spageptr = 0;
+	istate->schunkptr = 0;
+	istate->schunkbit = 0;
+
+	/* In ONE_PAGE state, we don't allocate an spages[] array */
+	if (tbm->status == TBM_ONE_PAGE)
+		memcpy(&entries[0], &tbm->entry1, sizeof(PagetableEntry));
+	else
+	{
+		for (i = 0; i < tbm->npages; i++)
+			memcpy(&entries[i], tbm->spages[i], sizeof(PagetableEntry));
+		for (i = 0; i < tbm->nchunks; i++)
+			memcpy(&entries[tbm->npages + i], tbm->schunks[i],
+				   sizeof(PagetableEntry));
+	}
+
+	return istate;
+}
+
+/*
+ * tbm_attach_shared_iterate - join a shared iteration
+ *
+ * Returns a backend-local iterator, from which tbm_shared_iterate returns
+ * the pages not yet claimed by any other participant.
+ */
+TBMSharedIterator *
+tbm_attach_shared_iterate(TBMSharedIteratorState *istate)
+{
+	TBMSharedIterator *iterator;
+
+	/*
+	 * Create the TBMSharedIterator struct, with enough trailing space to
+	 * serve the needs of the TBMIterateResult sub-struct.
+	 */
+	iterator = (TBMSharedIterator *) palloc(sizeof(TBMSharedIterator) +
+								 MAX_TUPLES_PER_PAGE * sizeof(OffsetNumber));
+	iterator->state = istate;
+
+	return iterator;
+}
+
+/*
+ * tbm_shared_iterate - claim the next page of a shared TIDBitmap
+ *
+ * Like tbm_iterate, but each page is returned to only one of the
+ * participants.  Pages are claimed in numerical order, but since the
+ * participants process them concurrently, no one participant sees all of
+ * them.
+ */
+TBMIterateResult *
+tbm_shared_iterate(TBMSharedIterator *iterator)
+{
+	TBMSharedIteratorState *istate = iterator->state;
+	PagetableEntry *spages = TBM_SHARED_ENTRIES(istate);
+	PagetableEntry *schunks = spages + istate->npages;
+	TBMIterateResult *output = &(iterator->output);
+	PagetableEntry *page = NULL;
+
+	SpinLockAcquire(&istate->mutex);
+
+	/*
+	 * If lossy chunk pages remain, make sure we've advanced schunkptr/
+	 * schunkbit to the next set bit.  This looks at no more than
+	 * PAGES_PER_CHUNK bits per chunk, so it's OK to do it while holding the
+	 * spinlock.
+	 */
+	while (istate->schunkptr < istate->nchunks)
+	{
+		PagetableEntry *chunk = &schunks[istate->schunkptr];
+		int			schunkbit;
+
+		schunkbit = tbm_next_chunkbit(chunk, istate->schunkbit);
+		if (schunkbit < PAGES_PER_CHUNK)
+		{
+			istate->schunkbit = schunkbit;
+			break;
+		}
+		/* advance to next chunk */
+		istate->schunkptr++;
+		istate->schunkbit = 0;
+	}
+
+	/*
+	 * If both chunk and per-page data remain, must output the numerically
+	 * earlier page.
+	 */
+	if (istate->schunkptr < istate->nchunks)
+	{
+		PagetableEntry *chunk = &schunks[istate->schunkptr];
+		BlockNumber chunk_blockno;
+
+		chunk_blockno = chunk->blockno + istate->schunkbit;
+		if (istate->spageptr >= istate->npages ||
+			chunk_blockno < spages[istate->spageptr].blockno)
+		{
+			/* Return a lossy page indicator from the chunk */
+			istate->schunkbit++;
+			SpinLockRelease(&istate->mutex);
+
+			output->blockno = chunk_blockno;
+			output->ntuples = -1;
+			output->recheck = true;
+			return output;
+		}
+	}
+
+	if (istate->spageptr < istate->npages)
+		page = &spages[istate->spageptr++];
+
+	SpinLockRelease(&istate->mutex);
+
+	/* The entries are read-only, so we can extract the tuples unlocked */
+	if (page != NULL)
+	{
+		tbm_extract_page_tuples(page, output);
+		return output;
+	}
+
+	/* Nothing more in the bitmap */
+	return NULL;
+}
+
+/*
+ * tbm_end_shared_iterate - detach from a shared iteration
+ *
+ * The shared state itself belongs to whoever allocated its memory.
+ */
+void
+tbm_end_shared_iterate(TBMSharedIterator *iterator)
+{
+	pfree(iterator);
+}
+
+/*
+ * tbm_next_chunkbit - find the next set bit in a lossy chunk
+ *
+ * Returns the first set bit at or after schunkbit, or PAGES_PER_CHUNK if
+ * there is none.
+ */
+static int
+tbm_next_chunkbit(const PagetableEntry *chunk, int schunkbit)
+{
+	while (schunkbit < PAGES_PER_CHUNK)
+	{
+		int			wordnum = WORDNUM(schunkbit);
+		int			bitnum = BITNUM(schunkbit);
+
+		if ((chunk->words[wordnum] & ((bitmapword) 1 << bitnum)) != 0)
+			break;
+		schunkbit++;
+	}
+	return schunkbit;
+}
+
+/*
+ * tbm_extract_page_tuples - fill in an iteration result for an exact page
+ *
+ * Returns the number of tuples.
+ */
+static int
+tbm_extract_page_tuples(const PagetableEntry *page, TBMIterateResult *output)
+{
+	int			ntuples;
+	int			wordnum;
+
+	/* scan bitmap to extract individual offset numbers */
+	ntuples = 0;
+	for (wordnum = 0; wordnum < WORDS_PER_PAGE; wordnum++)
+	{
+		bitmapword	w = page->words[wordnum];
+
+		if (w != 0)
+		{
+			int			off = wordnum * BITS_PER_BITMAPWORD + 1;
+
+			while (w != 0)
+			{
+				if (w & 1)
+					output->offsets[ntuples++] = (OffsetNumber) off;
+				off++;
+				w >>= 1;
+			}
+		}
+	}
+	output->blockno = page->blockno;
+	output->ntuples = ntuples;
+	output->recheck = page->recheck;
+
+	return ntuples;
+}
+
 /*
  * tbm_find_pageentry - find a PagetableEntry for the pageno
  *
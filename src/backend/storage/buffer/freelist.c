@@ -341,6 +341,23 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 	}
 }
 
+/*
+ * have_free_buffer -- a lockless check to see if there is a free buffer in
+ *					   buffer pool.
+ *
+ * The result becomes stale as soon as other backends take buffers off the
+ * freelist, so a caller that strictly needs a free buffer must not rely on
+ * it.  It's good enough for deciding whether prewarming is still useful.
+ */
+bool
+have_free_buffer(void)
+{
+	if (StrategyControl->firstFreeBuffer >= 0)
+		return true;
+	else
+		return false;
+}
+
 /*
  * StrategyFreeBuffer: put a buffer on the freelist
  */
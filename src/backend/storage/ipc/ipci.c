@@ -18,6 +18,7 @@
 #include "access/commit_ts.h"
 #include "access/heapam.h"
 #include "access/multixact.h"
+#include "access/ptrack.h"
 #include "access/nbtree.h"
 #include "access/subtrans.h"
 #include "access/twophase.h"
@@ -137,6 +138,7 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 		size = add_size(size, WalSndShmemSize());
 		size = add_size(size, WalRcvShmemSize());
 		size = add_size(size, BTreeShmemSize());
+		size = add_size(size, PtrackShmemSize());
 		size = add_size(size, SyncScanShmemSize());
 		size = add_size(size, AsyncShmemSize());
 #ifdef EXEC_BACKEND
@@ -248,6 +250,7 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 	 * Set up other modules that need some shared memory space
 	 */
 	BTreeShmemInit();
+	PtrackShmemInit();
 	SyncScanShmemInit();
 	AsyncShmemInit();
 
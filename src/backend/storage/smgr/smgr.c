@@ -17,6 +17,7 @@
  */
 #include "postgres.h"
 
+#include "access/ptrack.h"
 #include "commands/tablespace.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
@@ -420,6 +421,9 @@ smgrdounlink(SMgrRelation reln, bool isRedo)
 	for (forknum = 0; forknum <= MAX_FORKNUM; forknum++)
 		(*(smgrsw[which].smgr_close)) (reln, forknum);
 
+	/* Forget changed blocks not yet written to its ptrack fork */
+	ptrack_forget_relations(&rnode, 1);
+
 	/*
 	 * Get rid of any remaining buffers for the relation.  bufmgr will just
 	 * drop them without bothering to write the contents.
@@ -493,6 +497,9 @@ smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo)
 			(*(smgrsw[which].smgr_close)) (rels[i], forknum);
 	}
 
+	/* Forget changed blocks not yet written to their ptrack forks */
+	ptrack_forget_relations(rnodes, nrels);
+
 	/*
 	 * Get rid of any remaining buffers for the relations.  bufmgr will just
 	 * drop them without bothering to write the contents.
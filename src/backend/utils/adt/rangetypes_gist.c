@@ -19,6 +19,7 @@
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/rangetypes.h"
+#include "utils/sortsupport.h"
 
 
 /*
@@ -165,6 +166,7 @@ static int	interval_cmp_upper(const void *a, const void *b, void *arg);
 static int	common_entry_cmp(const void *i1, const void *i2);
 static float8 call_subtype_diff(TypeCacheEntry *typcache,
 				  Datum val1, Datum val2);
+static int	range_gist_cmp(Datum a, Datum b, SortSupport ssup);
 
 
 /* GiST query consistency check */
@@ -694,6 +696,24 @@ range_gist_same(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+/*
+ * Sort support routine for sorted GiST index build.
+ *
+ * Ranges are ordered by lower bound and then by upper bound, with empty
+ * ranges first, so that ranges placed on the same leaf page have nearby
+ * bounds.
+ */
+Datum
+range_gist_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	ssup->comparator = range_gist_cmp;
+	ssup->ssup_extra = NULL;
+
+	PG_RETURN_VOID();
+}
+
 /*
  *----------------------------------------------------------
  * STATIC FUNCTIONS
@@ -1548,3 +1568,55 @@ call_subtype_diff(TypeCacheEntry *typcache, Datum val1, Datum val2)
 		return value;
 	return 0.0;
 }
+
+/*
+ * SortSupport comparator for range_gist_sortsupport
+ */
+static int
+range_gist_cmp(Datum a, Datum b, SortSupport ssup)
+{
+	RangeType  *range_a = DatumGetRangeType(a);
+	RangeType  *range_b = DatumGetRangeType(b);
+	TypeCacheEntry *typcache = (TypeCacheEntry *) ssup->ssup_extra;
+	RangeBound	lower1,
+				lower2;
+	RangeBound	upper1,
+				upper2;
+	bool		empty1,
+				empty2;
+	int			result;
+
+	if (typcache == NULL)
+	{
+		Oid			rngtypid = RangeTypeGetOid(range_a);
+
+		typcache = lookup_type_cache(rngtypid, TYPECACHE_RANGE_INFO);
+		if (typcache->rngelemtype == NULL)
+			elog(ERROR, "type %u is not a range type", rngtypid);
+		ssup->ssup_extra = (void *) typcache;
+	}
+
+	range_deserialize(typcache, range_a, &lower1, &upper1, &empty1);
+	range_deserialize(typcache, range_b, &lower2, &upper2, &empty2);
+
+	/* For b-tree use, empty ranges sort before all else */
+	if (empty1 && empty2)
+		result = 0;
+	else if (empty1)
+		result = -1;
+	else if (empty2)
+		result = 1;
+	else
+	{
+		result = range_cmp_bounds(typcache, &lower1, &lower2);
+		if (result == 0)
+			result = range_cmp_bounds(typcache, &upper1, &upper2);
+	}
+
+	if ((Pointer) range_a != DatumGetPointer(a))
+		pfree(range_a);
+	if ((Pointer) range_b != DatumGetPointer(b))
+		pfree(range_b);
+
+	return result;
+}
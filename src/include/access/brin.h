@@ -31,6 +31,7 @@ extern Datum brinbulkdelete(PG_FUNCTION_ARGS);
 extern Datum brinvacuumcleanup(PG_FUNCTION_ARGS);
 extern Datum brincostestimate(PG_FUNCTION_ARGS);
 extern Datum brinoptions(PG_FUNCTION_ARGS);
+extern Datum brin_summarize_range(PG_FUNCTION_ARGS);
 
 /*
  * Storage type for BRIN's reloptions
@@ -39,6 +40,7 @@ typedef struct BrinOptions
 {
 	int32		vl_len_;		/* varlena header (do not touch directly!) */
 	BlockNumber pagesPerRange;
+	bool		autosummarize;
 } BrinOptions;
 
 #define BRIN_DEFAULT_PAGES_PER_RANGE	128
@@ -46,5 +48,9 @@ typedef struct BrinOptions
 	((relation)->rd_options ? \
 	 ((BrinOptions *) (relation)->rd_options)->pagesPerRange : \
 	  BRIN_DEFAULT_PAGES_PER_RANGE)
+#define BrinGetAutoSummarize(relation) \
+	((relation)->rd_options ? \
+	 ((BrinOptions *) (relation)->rd_options)->autosummarize : \
+	  false)
 
 #endif   /* BRIN_H */
@@ -38,6 +38,15 @@
  */
 #define GIST_MAX_SPLIT_PAGES		75
 
+/*
+ * LSN stamped on the pages of a sorted index build that are not WAL-logged,
+ * because wal_level is minimal.  Scans and vacuum detect a concurrent split
+ * by comparing a page's NSN with the LSN its parent had, and skip the check
+ * for a parent with an invalid LSN, so built pages need a valid one.  Any
+ * real LSN of a later split is larger.
+ */
+#define GistBuildLSN				((XLogRecPtr) 1)
+
 /* Buffer lock modes */
 #define GIST_SHARE	BUFFER_LOCK_SHARE
 #define GIST_EXCLUSIVE	BUFFER_LOCK_EXCLUSIVE
@@ -493,12 +502,16 @@ extern IndexTuple gistgetadjusted(Relation r,
 				GISTSTATE *giststate);
 extern IndexTuple gistFormTuple(GISTSTATE *giststate,
 			  Relation r, Datum *attdata, bool *isnull, bool isleaf);
+extern void gistCompressValues(GISTSTATE *giststate, Relation r,
+				   Datum *attdata, bool *isnull, bool isleaf,
+				   Datum *compatt);
 
 extern OffsetNumber gistchoose(Relation r, Page p,
 		   IndexTuple it,
 		   GISTSTATE *giststate);
 
 extern void GISTInitBuffer(Buffer b, uint32 f);
+extern void gistinitpage(Page page, uint32 f);
 extern void gistdentryinit(GISTSTATE *giststate, int nkey, GISTENTRY *e,
 			   Datum k, Relation r, Page pg, OffsetNumber o,
 			   bool l, bool isNull);
@@ -53,9 +53,16 @@ typedef uint32 Bucket;
 #define LH_BITMAP_PAGE			(1 << 2)
 #define LH_META_PAGE			(1 << 3)
 
+/*
+ * In an overflow page, hasho_prevblkno stores the block number of the
+ * previous page in the bucket chain.  In a primary bucket page, it instead
+ * stores the value of hashm_maxbucket as of the last time the bucket was
+ * created or split, so that a scan using a cached copy of the metapage can
+ * tell whether the bucket has been split since the copy was taken.
+ */
 typedef struct HashPageOpaqueData
 {
-	BlockNumber hasho_prevblkno;	/* previous ovfl (or bucket) blkno */
+	BlockNumber hasho_prevblkno;	/* see above */
 	BlockNumber hasho_nextblkno;	/* next ovfl blkno */
 	Bucket		hasho_bucket;	/* bucket number this pg belongs to */
 	uint16		hasho_flag;		/* page type code, see above */
@@ -93,6 +100,15 @@ typedef struct HashScanOpaqueData
 	 */
 	BlockNumber hashso_bucket_blkno;
 
+	/*
+	 * While we hold the bucket lock, we also keep a pin on the bucket's
+	 * primary page.  During WAL replay, records that remove or move tuples
+	 * take a cleanup lock on the primary bucket page, so this pin is what
+	 * protects a scan running on a hot standby server, where the bucket lock
+	 * does not exist.
+	 */
+	Buffer		hashso_bucket_buf;
+
 	/*
 	 * We also want to remember which buffer we're currently examining in the
 	 * scan. We keep the buffer pinned (but not locked) across hashgettuple
@@ -117,7 +133,8 @@ typedef HashScanOpaqueData *HashScanOpaque;
 #define HASH_METAPAGE	0		/* metapage is always block 0 */
 
 #define HASH_MAGIC		0x6440640
-#define HASH_VERSION	2		/* 2 signifies only hash key value is stored */
+#define HASH_VERSION	3		/* 3 signifies WAL-logged, only hash key
+								 * value is stored */
 
 /*
  * Spares[] holds the number of overflow pages currently allocated at or
@@ -227,6 +244,77 @@ typedef HashMetaPageData *HashMetaPage;
 #define HASH_SHARE		ShareLock
 #define HASH_EXCLUSIVE	ExclusiveLock
 
+/*
+ * XLOG records for hash operations
+ */
+#define XLOG_HASH_INSERT		0x00	/* add index tuple to a page */
+#define XLOG_HASH_DELETE		0x10	/* delete index tuples from a page */
+#define XLOG_HASH_UPDATE_META	0x20	/* set metapage tuple count */
+#define XLOG_HASH_PAGES			0x30	/* full images of modified pages */
+
+/*
+ * This is what we need to know about an index tuple insertion.  The
+ * target page is registered as block 0, with the new tuple as its data.
+ * The metapage, whose tuple count is incremented, is block 1.
+ */
+typedef struct xl_hash_insert
+{
+	OffsetNumber offnum;
+} xl_hash_insert;
+
+#define SizeOfHashInsert	(offsetof(xl_hash_insert, offnum) + sizeof(OffsetNumber))
+
+/*
+ * This is what we need to know about deletion of index tuples from a page,
+ * by VACUUM or after a bucket split.  The primary page of the bucket is
+ * block 0, and replay takes a cleanup lock on it to keep out hot standby
+ * scans of the bucket.  If the tuples are deleted from the primary page
+ * itself, the array of offset numbers is block 0's data; otherwise the
+ * target page is block 1, carrying the array.
+ */
+typedef struct xl_hash_delete
+{
+	bool		is_primary_bucket_page;
+} xl_hash_delete;
+
+#define SizeOfHashDelete	(offsetof(xl_hash_delete, is_primary_bucket_page) + sizeof(bool))
+
+/*
+ * New tuple count for the metapage, set at the end of VACUUM.  The
+ * metapage is block 0.
+ */
+typedef struct xl_hash_update_meta
+{
+	double		ntuples;
+} xl_hash_update_meta;
+
+#define SizeOfHashUpdateMeta	(offsetof(xl_hash_update_meta, ntuples) + sizeof(double))
+
+/*
+ * Changes to the structure of the index -- overflow page allocation and
+ * release, squeezing a bucket, and the steps of a bucket split -- are
+ * logged as full-page images of all the pages they modify, which makes
+ * each such change atomic without a separate redo routine for each.  If
+ * XLH_PAGES_BUCKET_CLEANUP is set, block 0 is the primary page of the bucket
+ * whose tuples are moved or removed, and replay acquires a cleanup lock on
+ * it first (if the primary page itself was not modified, it is registered
+ * without an image).
+ */
+typedef struct xl_hash_pages
+{
+	uint8		flags;
+} xl_hash_pages;
+
+#define XLH_PAGES_BUCKET_CLEANUP	0x01
+
+#define SizeOfHashPages		(offsetof(xl_hash_pages, flags) + sizeof(uint8))
+
+/*
+ * Maximum number of pages, including the primary bucket page, that one
+ * XLOG_HASH_PAGES record can carry.
+ */
+#define HASH_XLOG_MAX_PAGES		4
+
 /*
  *	Strategy number. There's only one valid strategy for hashing: equality.
  */
@@ -291,12 +379,12 @@ extern OffsetNumber _hash_pgaddtup(Relation rel, Buffer buf,
 
 /* hashovfl.c */
 extern Buffer _hash_addovflpage(Relation rel, Buffer metabuf, Buffer buf);
-extern BlockNumber _hash_freeovflpage(Relation rel, Buffer ovflbuf,
-				   BufferAccessStrategy bstrategy);
+extern BlockNumber _hash_freeovflpage(Relation rel, Buffer bucket_buf,
+				   Buffer ovflbuf, BufferAccessStrategy bstrategy);
 extern void _hash_initbitmap(Relation rel, HashMetaPage metap,
 				 BlockNumber blkno, ForkNumber forkNum);
 extern void _hash_squeezebucket(Relation rel,
-					Bucket bucket, BlockNumber bucket_blkno,
+					Bucket bucket, Buffer bucket_buf,
 					BufferAccessStrategy bstrategy);
 
 /* hashpage.c */
@@ -320,6 +408,11 @@ extern uint32 _hash_metapinit(Relation rel, double num_tuples,
 				ForkNumber forkNum);
 extern void _hash_pageinit(Page page, Size size);
 extern void _hash_expandtable(Relation rel, Buffer metabuf);
+extern void _hash_cachemetap(Relation rel, HashMetaPage metap);
+extern void _hash_delitems(Relation rel, Buffer bucket_buf, Buffer buf,
+			   OffsetNumber *itemnos, int nitems);
+extern void _hash_log_pages(Relation rel, Buffer bucket_buf,
+				Buffer *bufs, int nbufs);
 
 /* hashscan.c */
 extern void _hash_regscan(IndexScanDesc scan);
@@ -356,8 +449,10 @@ extern bool _hash_convert_tuple(Relation index,
 extern OffsetNumber _hash_binsearch(Page page, uint32 hash_value);
 extern OffsetNumber _hash_binsearch_last(Page page, uint32 hash_value);
 
-/* hash.c */
+/* hashxlog.c */
 extern void hash_redo(XLogReaderState *record);
+
+/* hashdesc.c */
 extern void hash_desc(StringInfo buf, XLogReaderState *record);
 extern const char *hash_identify(uint8 info);
 
@@ -132,6 +132,81 @@ typedef struct BTMetaPageData
 #define BTREE_DEFAULT_FILLFACTOR	90
 #define BTREE_NONLEAF_FILLFACTOR	70
 
+/*
+ * The rightmost-leaf insertion fastpath (see _bt_doinsert) is only used
+ * once the tree has at least this many levels.  For smaller trees, the
+ * descent from the root is cheap anyway.
+ */
+#define BTREE_FASTPATH_MIN_LEVEL	2
+
+/*
+ * Storage type for btree's reloptions.  fillfactor must stay in the same
+ * position as in StdRdOptions.
+ */
+typedef struct BTOptions
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int			fillfactor;		/* page fill factor in percent (0..100) */
+	bool		deduplicate_items;		/* merge duplicates into posting
+										 * lists? */
+} BTOptions;
+
+#define BTREE_DEFAULT_DEDUPLICATE_ITEMS	true
+
+#define BTGetFillFactor(relation) \
+	((relation)->rd_options ? \
+	 ((BTOptions *) (relation)->rd_options)->fillfactor : \
+	 BTREE_DEFAULT_FILLFACTOR)
+#define BTGetTargetPageFreeSpace(relation) \
+	(BLCKSZ * (100 - BTGetFillFactor(relation)) / 100)
+#define BTGetDeduplicateItems(relation) \
+	((relation)->rd_options ? \
+	 ((BTOptions *) (relation)->rd_options)->deduplicate_items : \
+	 BTREE_DEFAULT_DEDUPLICATE_ITEMS)
+
+/*
+ * Posting list tuples.
+ *
+ * Deduplication replaces a run of leaf tuples with equal keys by a single
+ * "posting list" tuple: one copy of the key followed by a sorted array of
+ * the heap TIDs of all the merged tuples.  Such a tuple is marked with
+ * INDEX_ALT_TID_MASK in t_info, and its t_tid does not point into the heap;
+ * instead the block number holds the byte offset of the TID array within the
+ * tuple, and the offset number holds the number of TIDs.  High keys, tuples
+ * on internal pages, and tuples of unique indexes are never posting lists.
+ *
+ * MaxTIDsPerBTreePage is an upper bound on the number of heap TIDs that a
+ * single leaf page can reference, which is how many items a scan may need
+ * to remember per page.
+ */
+#define INDEX_ALT_TID_MASK			INDEX_AM_RESERVED_BIT
+
+#define BTreeTupleIsPosting(itup) \
+	(((itup)->t_info & INDEX_ALT_TID_MASK) != 0)
+#define BTreeTupleGetNPosting(itup) \
+	((int) (itup)->t_tid.ip_posid)
+#define BTreeTupleGetPostingOffset(itup) \
+	BlockIdGetBlockNumber(&(itup)->t_tid.ip_blkid)
+#define BTreeTupleGetPosting(itup) \
+	((ItemPointer) ((char *) (itup) + BTreeTupleGetPostingOffset(itup)))
+#define BTreeTupleSetPosting(itup, nposting, off) \
+	do { \
+		(itup)->t_info |= INDEX_ALT_TID_MASK; \
+		BlockIdSet(&(itup)->t_tid.ip_blkid, (off)); \
+		(itup)->t_tid.ip_posid = (OffsetNumber) (nposting); \
+	} while (0)
+
+/* number of heap TIDs referenced by any leaf tuple, and the n'th of them */
+#define BTreeTupleGetNHeapTIDs(itup) \
+	(BTreeTupleIsPosting(itup) ? BTreeTupleGetNPosting(itup) : 1)
+#define BTreeTupleGetHeapTIDN(itup, n) \
+	(BTreeTupleIsPosting(itup) ? \
+	 BTreeTupleGetPosting(itup) + (n) : &(itup)->t_tid)
+
+#define MaxTIDsPerBTreePage \
+	((int) ((BLCKSZ - SizeOfPageHeaderData - sizeof(BTPageOpaqueData)) / \
+			sizeof(ItemPointerData)))
+
 /*
  *	Test whether two btree entries are "the same".
  *
@@ -275,9 +350,9 @@ typedef struct xl_btree_insert
  *
  * The left page's data portion contains the new item, if it's the _L variant.
  * (In the _R variants, the new item is one of the right page's tuples.)
- * If level > 0, an IndexTuple representing the HIKEY of the left page
- * follows.  We don't need this on leaf pages, because it's the same as the
- * leftmost key in the new right page.
+ * An IndexTuple representing the HIKEY of the left page follows.  On leaf
+ * pages it is derived from the leftmost key in the new right page, but it may
+ * have been truncated or stripped of its posting list, so it is logged too.
  *
  * Backup Blk 1: new right page
  *
@@ -344,17 +419,27 @@ typedef struct xl_btree_reuse_page
  * starting from the last block vacuumed through until this one. Individual
  * block numbers aren't given.
  *
+ * Posting list tuples that lose only some of their heap TIDs are replaced
+ * rather than deleted.  The block data holds the ndeleted offsets of the
+ * deleted tuples, then the nupdated offsets of the replaced tuples, then the
+ * replacement tuples themselves, in the same order.  Updates are applied
+ * before deletions, so all offsets refer to the page as it was before vacuum.
+ *
  * Note that the *last* WAL record in any vacuum of an index is allowed to
- * have a zero length array of offsets. Earlier records must have at least one.
+ * have no changes at all. Earlier records must have at least one.
  */
 typedef struct xl_btree_vacuum
 {
 	BlockNumber lastBlockVacuumed;
+	uint16		ndeleted;
+	uint16		nupdated;
 
-	/* TARGET OFFSET NUMBERS FOLLOW */
+	/* DELETED TARGET OFFSET NUMBERS FOLLOW */
+	/* UPDATED TARGET OFFSET NUMBERS FOLLOW */
+	/* UPDATED TUPLES FOLLOW */
 } xl_btree_vacuum;
 
-#define SizeOfBtreeVacuum	(offsetof(xl_btree_vacuum, lastBlockVacuumed) + sizeof(BlockNumber))
+#define SizeOfBtreeVacuum	(offsetof(xl_btree_vacuum, nupdated) + sizeof(uint16))
 
 /*
  * This is what we need to know about marking an empty branch for deletion.
@@ -548,7 +633,7 @@ typedef struct BTScanPosData
 	int			lastItem;		/* last valid index in items[] */
 	int			itemIndex;		/* current index in items[] */
 
-	BTScanPosItem items[MaxIndexTuplesPerPage]; /* MUST BE LAST */
+	BTScanPosItem items[MaxTIDsPerBTreePage];	/* MUST BE LAST */
 } BTScanPosData;
 
 typedef BTScanPosData *BTScanPos;
@@ -630,6 +715,23 @@ typedef struct BTScanOpaqueData
 	 */
 	int			markItemIndex;	/* itemIndex, or -1 if not valid */
 
+	/*
+	 * Heap read-ahead state, used when scan->xs_prefetch_target > 0.  We
+	 * issue prefetch requests for the heap blocks of currPos items ahead of
+	 * itemIndex, counting changes of heap block number between consecutive
+	 * items as "pages".  prefetchPages tracks how many pages ahead of the
+	 * caller the prefetch cursor is, and prefetchTarget is the desired
+	 * distance, which ramps up to xs_prefetch_target the same way bitmap
+	 * heap scans do.  The cursor does not cross index page boundaries.
+	 */
+	int			prefetchTarget; /* current target prefetch distance */
+	int			prefetchPages;	/* # pages the prefetch cursor is ahead */
+	int			prefetchIndex;	/* currPos.items index of prefetch cursor */
+	BlockNumber prefetchPage;	/* index page prefetchIndex refers to */
+	BlockNumber prefetchBlock;	/* heap block at prefetchIndex */
+	BlockNumber currHeapBlock;	/* heap block of last returned item */
+	Buffer		prefetchVMBuffer;		/* VM page, for index-only scans */
+
 	/* keep these last in struct for efficiency */
 	BTScanPosData currPos;		/* current position data */
 	BTScanPosData markPos;		/* marked position, if any */
@@ -676,6 +778,34 @@ extern void _bt_finish_split(Relation rel, Buffer bbuf, BTStack stack);
 extern bool _bt_pgaddtup(Page page, Size itemsize, IndexTuple itup,
 						 OffsetNumber itup_off);
 
+/*
+ * BTDedupState is the working state for merging a stream of leaf tuples into
+ * posting list tuples; see _bt_dedup_begin().
+ */
+typedef struct BTDedupState
+{
+	Size		maxitemsz;		/* limit on size of a posting list tuple */
+	IndexTuple	base;			/* first tuple of pending group, or NULL */
+	Size		basekeysz;		/* size of base's key part */
+	ItemPointer htids;			/* heap TIDs of the pending group */
+	int			nhtids;			/* number of them */
+	int			nmerged;		/* number of tuples merged into base */
+} BTDedupState;
+
+/*
+ * prototypes for functions in nbtdedup.c
+ */
+extern bool _bt_dedup_allowed(Relation rel);
+extern bool _bt_dedup_one_page(Relation rel, Buffer buf);
+extern BTDedupState *_bt_dedup_begin(Size maxitemsz);
+extern void _bt_dedup_start_pending(BTDedupState *dstate, IndexTuple itup);
+extern bool _bt_dedup_save_htids(BTDedupState *dstate, IndexTuple itup);
+extern IndexTuple _bt_dedup_finish_pending(BTDedupState *dstate);
+extern void _bt_dedup_end(BTDedupState *dstate);
+extern IndexTuple _bt_form_posting(IndexTuple base, ItemPointer htids,
+				 int nhtids);
+extern IndexTuple _bt_strip_posting(IndexTuple itup);
+
 /*
  * prototypes for functions in nbtpage.c
  */
@@ -694,7 +824,8 @@ extern void _bt_delitems_delete(Relation rel, Buffer buf,
 					OffsetNumber *itemnos, int nitems, Relation heapRel);
 extern void _bt_delitems_vacuum(Relation rel, Buffer buf,
 					OffsetNumber *itemnos, int nitems,
-					BlockNumber lastBlockVacuumed);
+					OffsetNumber *updatednos, IndexTuple *updated,
+					int nupdated, BlockNumber lastBlockVacuumed);
 extern int	_bt_pagedel(Relation rel, Buffer buf);
 
 /*
@@ -712,6 +843,7 @@ extern int32 _bt_compare(Relation rel, int keysz, ScanKey scankey,
 			Page page, OffsetNumber offnum);
 extern bool _bt_first(IndexScanDesc scan, ScanDirection dir);
 extern bool _bt_next(IndexScanDesc scan, ScanDirection dir);
+extern void _bt_prefetch_heap(IndexScanDesc scan, ScanDirection dir);
 extern Buffer _bt_get_endpoint(Relation rel, uint32 level, bool rightmost);
 
 /*
@@ -14,6 +14,11 @@ extern bool ptrack_enable;
 extern void ptrack_save(void);
 
 extern void ptrack_add_block(BlockNumber block_number, RelFileNode rel);
+extern void ptrack_flush(void);
+extern void ptrack_forget_relations(RelFileNodeBackend *rnodes, int nrels);
+
+extern Size PtrackShmemSize(void);
+extern void PtrackShmemInit(void);
 
 extern void ptrack_clear(void);
 extern bytea *ptrack_get_and_clear(Oid tablespace_oid, Oid table_oid);
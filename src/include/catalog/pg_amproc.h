@@ -193,6 +193,7 @@ DATA(insert (	1029   600 600 6 2582 ));
 DATA(insert (	1029   600 600 7 2584 ));
 DATA(insert (	1029   600 600 8 3064 ));
 DATA(insert (	1029   600 600 9 3282 ));
+DATA(insert (	1029   600 600 10 4140 ));
 DATA(insert (	2593   603 603 1 2578 ));
 DATA(insert (	2593   603 603 2 2583 ));
 DATA(insert (	2593   603 603 3 2579 ));
@@ -239,6 +240,7 @@ DATA(insert (	3919   3831 3831 5 3879 ));
 DATA(insert (	3919   3831 3831 6 3880 ));
 DATA(insert (	3919   3831 3831 7 3881 ));
 DATA(insert (	3919   3831 3831 9 3996 ));
+DATA(insert (	3919   3831 3831 10 4141 ));
 DATA(insert (	3550   869 869 1 3553 ));
 DATA(insert (	3550   869 869 2 3554 ));
 DATA(insert (	3550   869 869 3 3555 ));
@@ -659,5 +661,174 @@ DATA(insert (	4104   603	 603  3  4107 ));
 DATA(insert (	4104   603	 603  4  4108 ));
 DATA(insert (	4104   603	 603  11 4067 ));
 DATA(insert (	4104   603	 603  13  187 ));
+/* bloom integer: int2, int4, int8 */
+DATA(insert (	4109	20	  20  1  4120 ));
+DATA(insert (	4109	20	  20  2  4121 ));
+DATA(insert (	4109	20	  20  3  4122 ));
+DATA(insert (	4109	20	  20  4  4123 ));
+DATA(insert (	4109	20	  20  15  949 ));
+DATA(insert (	4109	20	  21  1  4120 ));
+DATA(insert (	4109	20	  21  2  4121 ));
+DATA(insert (	4109	20	  21  3  4122 ));
+DATA(insert (	4109	20	  21  4  4123 ));
+DATA(insert (	4109	20	  23  1  4120 ));
+DATA(insert (	4109	20	  23  2  4121 ));
+DATA(insert (	4109	20	  23  3  4122 ));
+DATA(insert (	4109	20	  23  4  4123 ));
+DATA(insert (	4109	21	  21  1  4120 ));
+DATA(insert (	4109	21	  21  2  4121 ));
+DATA(insert (	4109	21	  21  3  4122 ));
+DATA(insert (	4109	21	  21  4  4123 ));
+DATA(insert (	4109	21	  21  15  449 ));
+DATA(insert (	4109	21	  20  1  4120 ));
+DATA(insert (	4109	21	  20  2  4121 ));
+DATA(insert (	4109	21	  20  3  4122 ));
+DATA(insert (	4109	21	  20  4  4123 ));
+DATA(insert (	4109	21	  23  1  4120 ));
+DATA(insert (	4109	21	  23  2  4121 ));
+DATA(insert (	4109	21	  23  3  4122 ));
+DATA(insert (	4109	21	  23  4  4123 ));
+DATA(insert (	4109	23	  23  1  4120 ));
+DATA(insert (	4109	23	  23  2  4121 ));
+DATA(insert (	4109	23	  23  3  4122 ));
+DATA(insert (	4109	23	  23  4  4123 ));
+DATA(insert (	4109	23	  23  15  450 ));
+DATA(insert (	4109	23	  20  1  4120 ));
+DATA(insert (	4109	23	  20  2  4121 ));
+DATA(insert (	4109	23	  20  3  4122 ));
+DATA(insert (	4109	23	  20  4  4123 ));
+DATA(insert (	4109	23	  21  1  4120 ));
+DATA(insert (	4109	23	  21  2  4121 ));
+DATA(insert (	4109	23	  21  3  4122 ));
+DATA(insert (	4109	23	  21  4  4123 ));
+/* bloom text */
+DATA(insert (	4110	25	  25  1  4120 ));
+DATA(insert (	4110	25	  25  2  4121 ));
+DATA(insert (	4110	25	  25  3  4122 ));
+DATA(insert (	4110	25	  25  4  4123 ));
+DATA(insert (	4110	25	  25  15  400 ));
+/* bloom date */
+DATA(insert (	4111  1082	1082  1  4120 ));
+DATA(insert (	4111  1082	1082  2  4121 ));
+DATA(insert (	4111  1082	1082  3  4122 ));
+DATA(insert (	4111  1082	1082  4  4123 ));
+DATA(insert (	4111  1082	1082  15  450 ));
+/* bloom timestamp */
+DATA(insert (	4112  1114	1114  1  4120 ));
+DATA(insert (	4112  1114	1114  2  4121 ));
+DATA(insert (	4112  1114	1114  3  4122 ));
+DATA(insert (	4112  1114	1114  4  4123 ));
+DATA(insert (	4112  1114	1114  15 2039 ));
+/* bloom timestamp with time zone */
+DATA(insert (	4113  1184	1184  1  4120 ));
+DATA(insert (	4113  1184	1184  2  4121 ));
+DATA(insert (	4113  1184	1184  3  4122 ));
+DATA(insert (	4113  1184	1184  4  4123 ));
+DATA(insert (	4113  1184	1184  15 2039 ));
+/* bloom uuid */
+DATA(insert (	4114  2950	2950  1  4120 ));
+DATA(insert (	4114  2950	2950  2  4121 ));
+DATA(insert (	4114  2950	2950  3  4122 ));
+DATA(insert (	4114  2950	2950  4  4123 ));
+DATA(insert (	4114  2950	2950  15 2963 ));
+/* minmax multi integer: int2, int4, int8 */
+DATA(insert (	4115	20	  20  1  4124 ));
+DATA(insert (	4115	20	  20  2  4125 ));
+DATA(insert (	4115	20	  20  3  4126 ));
+DATA(insert (	4115	20	  20  4  4127 ));
+DATA(insert (	4115	20	  20  11 4130 ));
+DATA(insert (	4115	20	  21  1  4124 ));
+DATA(insert (	4115	20	  21  2  4125 ));
+DATA(insert (	4115	20	  21  3  4126 ));
+DATA(insert (	4115	20	  21  4  4127 ));
+DATA(insert (	4115	20	  23  1  4124 ));
+DATA(insert (	4115	20	  23  2  4125 ));
+DATA(insert (	4115	20	  23  3  4126 ));
+DATA(insert (	4115	20	  23  4  4127 ));
+DATA(insert (	4115	21	  21  1  4124 ));
+DATA(insert (	4115	21	  21  2  4125 ));
+DATA(insert (	4115	21	  21  3  4126 ));
+DATA(insert (	4115	21	  21  4  4127 ));
+DATA(insert (	4115	21	  21  11 4128 ));
+DATA(insert (	4115	21	  20  1  4124 ));
+DATA(insert (	4115	21	  20  2  4125 ));
+DATA(insert (	4115	21	  20  3  4126 ));
+DATA(insert (	4115	21	  20  4  4127 ));
+DATA(insert (	4115	21	  23  1  4124 ));
+DATA(insert (	4115	21	  23  2  4125 ));
+DATA(insert (	4115	21	  23  3  4126 ));
+DATA(insert (	4115	21	  23  4  4127 ));
+DATA(insert (	4115	23	  23  1  4124 ));
+DATA(insert (	4115	23	  23  2  4125 ));
+DATA(insert (	4115	23	  23  3  4126 ));
+DATA(insert (	4115	23	  23  4  4127 ));
+DATA(insert (	4115	23	  23  11 4129 ));
+DATA(insert (	4115	23	  20  1  4124 ));
+DATA(insert (	4115	23	  20  2  4125 ));
+DATA(insert (	4115	23	  20  3  4126 ));
+DATA(insert (	4115	23	  20  4  4127 ));
+DATA(insert (	4115	23	  21  1  4124 ));
+DATA(insert (	4115	23	  21  2  4125 ));
+DATA(insert (	4115	23	  21  3  4126 ));
+DATA(insert (	4115	23	  21  4  4127 ));
+/* minmax multi float */
+DATA(insert (	4116   700	 700  1  4124 ));
+DATA(insert (	4116   700	 700  2  4125 ));
+DATA(insert (	4116   700	 700  3  4126 ));
+DATA(insert (	4116   700	 700  4  4127 ));
+DATA(insert (	4116   700	 700  11 4131 ));
+DATA(insert (	4116   700	 701  1  4124 ));
+DATA(insert (	4116   700	 701  2  4125 ));
+DATA(insert (	4116   700	 701  3  4126 ));
+DATA(insert (	4116   700	 701  4  4127 ));
+DATA(insert (	4116   701	 701  1  4124 ));
+DATA(insert (	4116   701	 701  2  4125 ));
+DATA(insert (	4116   701	 701  3  4126 ));
+DATA(insert (	4116   701	 701  4  4127 ));
+DATA(insert (	4116   701	 701  11 4132 ));
+DATA(insert (	4116   701	 700  1  4124 ));
+DATA(insert (	4116   701	 700  2  4125 ));
+DATA(insert (	4116   701	 700  3  4126 ));
+DATA(insert (	4116   701	 700  4  4127 ));
+/* minmax multi datetime (date, timestamp, timestamptz) */
+DATA(insert (	4117  1114	1114  1  4124 ));
+DATA(insert (	4117  1114	1114  2  4125 ));
+DATA(insert (	4117  1114	1114  3  4126 ));
+DATA(insert (	4117  1114	1114  4  4127 ));
+DATA(insert (	4117  1114	1114  11 4134 ));
+DATA(insert (	4117  1114	1184  1  4124 ));
+DATA(insert (	4117  1114	1184  2  4125 ));
+DATA(insert (	4117  1114	1184  3  4126 ));
+DATA(insert (	4117  1114	1184  4  4127 ));
+DATA(insert (	4117  1114	1082  1  4124 ));
+DATA(insert (	4117  1114	1082  2  4125 ));
+DATA(insert (	4117  1114	1082  3  4126 ));
+DATA(insert (	4117  1114	1082  4  4127 ));
+DATA(insert (	4117  1184	1184  1  4124 ));
+DATA(insert (	4117  1184	1184  2  4125 ));
+DATA(insert (	4117  1184	1184  3  4126 ));
+DATA(insert (	4117  1184	1184  4  4127 ));
+DATA(insert (	4117  1184	1184  11 4134 ));
+DATA(insert (	4117  1184	1114  1  4124 ));
+DATA(insert (	4117  1184	1114  2  4125 ));
+DATA(insert (	4117  1184	1114  3  4126 ));
+DATA(insert (	4117  1184	1114  4  4127 ));
+DATA(insert (	4117  1184	1082  1  4124 ));
+DATA(insert (	4117  1184	1082  2  4125 ));
+DATA(insert (	4117  1184	1082  3  4126 ));
+DATA(insert (	4117  1184	1082  4  4127 ));
+DATA(insert (	4117  1082	1082  1  4124 ));
+DATA(insert (	4117  1082	1082  2  4125 ));
+DATA(insert (	4117  1082	1082  3  4126 ));
+DATA(insert (	4117  1082	1082  4  4127 ));
+DATA(insert (	4117  1082	1082  11 4133 ));
+DATA(insert (	4117  1082	1114  1  4124 ));
+DATA(insert (	4117  1082	1114  2  4125 ));
+DATA(insert (	4117  1082	1114  3  4126 ));
+DATA(insert (	4117  1082	1114  4  4127 ));
+DATA(insert (	4117  1082	1184  1  4124 ));
+DATA(insert (	4117  1082	1184  2  4125 ));
+DATA(insert (	4117  1082	1184  3  4126 ));
+DATA(insert (	4117  1082	1184  4  4127 ));
 
 #endif   /* PG_AMPROC_H */
@@ -147,6 +147,14 @@ typedef struct VacuumParams
 										 * activated, -1 to use default */
 } VacuumParams;
 
+/*
+ * Hook for plugins to get control after the typanalyze function set up
+ * statistics collection for a column, e.g. to wrap compute_stats and fill
+ * a spare stakind slot with statistics of their own.
+ */
+typedef void (*examine_attribute_hook_type) (VacAttrStats *stats);
+extern PGDLLIMPORT examine_attribute_hook_type examine_attribute_hook;
+
 /* GUC parameters */
 extern PGDLLIMPORT int default_statistics_target;		/* PGDLLIMPORT for
 														 * PostGIS */
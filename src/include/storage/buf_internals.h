@@ -266,6 +266,7 @@ extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 
 extern int	StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc);
 extern void StrategyNotifyBgWriter(int bgwprocno);
+extern bool have_free_buffer(void);
 
 extern Size StrategyShmemSize(void);
 extern void StrategyInitialize(bool init);
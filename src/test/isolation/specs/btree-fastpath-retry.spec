@@ -0,0 +1,33 @@
+# B-tree rightmost leaf insertion fastpath test
+#
+# A unique index insertion that has to wait for another transaction's
+# insertion of the same key starts over once that transaction is done.
+# Session 2 has the rightmost leaf cached, so both its first try and the
+# retry use the insertion fastpath, which doesn't keep a descent stack.
+# The wide keys make the tree tall enough for the fastpath.
+
+setup
+{
+  CREATE TABLE fastpath (k text PRIMARY KEY, id int);
+  INSERT INTO fastpath
+    SELECT lpad(g::text, 200, '0'), g FROM generate_series(1, 3000) g;
+}
+
+teardown
+{
+  DROP TABLE fastpath;
+}
+
+session "s1"
+setup			{ BEGIN; }
+step "ins1"		{ INSERT INTO fastpath VALUES (lpad('3002', 200, '0'), 1); }
+step "c1"		{ COMMIT; }
+step "a1"		{ ABORT; }
+
+session "s2"
+setup			{ INSERT INTO fastpath VALUES (lpad('3001', 200, '0'), 0); }
+step "ins2"		{ INSERT INTO fastpath VALUES (lpad('3002', 200, '0'), 2); }
+step "sel2"		{ SELECT id FROM fastpath WHERE k > lpad('3000', 200, '0') ORDER BY k; }
+
+permutation "ins1" "ins2" "c1" "sel2"
+permutation "ins1" "ins2" "a1" "sel2"
@@ -0,0 +1,13 @@
+CREATE EXTENSION test_tidbitmap;
+
+--
+-- Each of these iterates over a bitmap of the given number of pages with
+-- the given number of background workers, and checks that every page is
+-- returned exactly once with the right tuples.
+--
+SELECT * FROM test_shared_tidbitmap(0, 2);
+SELECT * FROM test_shared_tidbitmap(1, 2);
+SELECT * FROM test_shared_tidbitmap(1000, 0);
+SELECT * FROM test_shared_tidbitmap(20000, 3);
+-- a bitmap too small to hold all the pages exactly, so some become lossy
+SELECT * FROM test_shared_tidbitmap(20000, 3, 16384);
@@ -0,0 +1,13 @@
+/* src/test/modules/test_tidbitmap/test_tidbitmap--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION test_tidbitmap" to load this file. \quit
+
+CREATE FUNCTION test_shared_tidbitmap(npages pg_catalog.int4,
+					   num_workers pg_catalog.int4 default 1,
+					   maxbytes pg_catalog.int8 default 4194304,
+					   OUT pages pg_catalog.int8,
+					   OUT lossy_pages pg_catalog.int8,
+					   OUT tuples pg_catalog.int8)
+    RETURNS record STRICT
+	AS 'MODULE_PATHNAME' LANGUAGE C;
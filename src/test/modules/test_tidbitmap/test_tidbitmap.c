@@ -0,0 +1,489 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_tidbitmap.c
+ *		Test code for iterating over a TIDBitmap from several processes.
+ *
+ * The user backend builds a bitmap, copies it into a dynamic shared memory
+ * segment with tbm_prepare_shared_iterate, and then pulls pages from it
+ * with tbm_shared_iterate concurrently with a number of background workers.
+ * Every participant checks the pages it gets against what was added to the
+ * bitmap, and counts how often each page was returned.
+ *
+ * Copyright (c) 2016, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_tidbitmap/test_tidbitmap.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/tidbitmap.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "storage/shm_toc.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(test_shared_tidbitmap);
+
+/* Identifier for shared memory segments used by this extension. */
+#define		PG_TEST_TIDBITMAP_MAGIC		0x5d1a7e03
+
+/* Keys of the things stored in the segment's table of contents. */
+#define		TEST_TIDBITMAP_KEY_HEADER	0
+#define		TEST_TIDBITMAP_KEY_CLAIMS	1
+#define		TEST_TIDBITMAP_KEY_BITMAP	2
+
+/*
+ * Which pages of the bitmap hold which tuples.  Most pages are in it, with
+ * tuples 1 .. TUPLES_ON_PAGE(blkno) of the page.
+ */
+#define PAGE_IN_BITMAP(blkno)		((blkno) % 7 != 3)
+#define TUPLES_ON_PAGE(blkno)		((int) ((blkno) % 10) + 1)
+#define MAX_TUPLES_ON_PAGE			10
+
+/*
+ * This structure is stored in the dynamic shared memory segment.  The
+ * participants add up what they have seen in it, and it lets the user
+ * backend know whether all the workers started up and finished OK.
+ */
+typedef struct
+{
+	slock_t		mutex;
+	int			workers_total;
+	int			workers_attached;
+	int			workers_finished;
+	BlockNumber npages;
+	int64		pages;
+	int64		lossy_pages;
+	int64		tuples;
+	int64		bad_pages;
+} test_tidbitmap_header;
+
+typedef struct
+{
+	int			nworkers;
+	BackgroundWorkerHandle *handle[FLEXIBLE_ARRAY_MEMBER];
+} worker_state;
+
+void		test_tidbitmap_main(Datum main_arg) pg_attribute_noreturn();
+
+static worker_state *launch_workers(dsm_segment *seg, int nworkers);
+static void cleanup_background_workers(dsm_segment *seg, Datum arg);
+static void wait_for_workers_to_attach(worker_state *wstate,
+						   volatile test_tidbitmap_header *hdr);
+static int	count_stopped_workers(worker_state *wstate);
+static void iterate_shared_bitmap(volatile test_tidbitmap_header *hdr,
+					  pg_atomic_uint32 *claims,
+					  TBMSharedIteratorState *istate);
+
+/*
+ * Build a bitmap over the first npages pages, and iterate over it with
+ * nworkers background workers helping.
+ */
+Datum
+test_shared_tidbitmap(PG_FUNCTION_ARGS)
+{
+	int32		npages = PG_GETARG_INT32(0);
+	int32		nworkers = PG_GETARG_INT32(1);
+	int64		maxbytes = PG_GETARG_INT64(2);
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
+	TIDBitmap  *tbm;
+	BlockNumber blkno;
+	shm_toc_estimator e;
+	Size		istate_size;
+	Size		segsize;
+	dsm_segment *seg;
+	shm_toc    *toc;
+	volatile test_tidbitmap_header *hdr;
+	pg_atomic_uint32 *claims;
+	TBMSharedIteratorState *istate;
+	worker_state *wstate;
+	int			i;
+
+	if (npages < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of pages must be a non-negative integer")));
+	if (nworkers < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of workers must be a non-negative integer")));
+	if (maxbytes < 1024 || maxbytes > MaxAllocSize)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("bitmap size must be between 1024 and %zu bytes",
+						MaxAllocSize)));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	/* Build the bitmap. */
+	tbm = tbm_create((long) maxbytes);
+	for (blkno = 0; blkno < npages; blkno++)
+	{
+		ItemPointerData tids[MAX_TUPLES_ON_PAGE];
+
+		if (!PAGE_IN_BITMAP(blkno))
+			continue;
+		for (i = 0; i < TUPLES_ON_PAGE(blkno); i++)
+			ItemPointerSet(&tids[i], blkno, i + 1);
+		tbm_add_tuples(tbm, tids, TUPLES_ON_PAGE(blkno), false);
+	}
+
+	/* Set up the dynamic shared memory segment. */
+	istate_size = tbm_shared_iterate_size(tbm);
+	shm_toc_initialize_estimator(&e);
+	shm_toc_estimate_chunk(&e, sizeof(test_tidbitmap_header));
+	shm_toc_estimate_chunk(&e, mul_size(npages, sizeof(pg_atomic_uint32)));
+	shm_toc_estimate_chunk(&e, istate_size);
+	shm_toc_estimate_keys(&e, 3);
+	segsize = shm_toc_estimate(&e);
+
+	seg = dsm_create(segsize, 0);
+	toc = shm_toc_create(PG_TEST_TIDBITMAP_MAGIC, dsm_segment_address(seg),
+						 segsize);
+
+	hdr = shm_toc_allocate(toc, sizeof(test_tidbitmap_header));
+	SpinLockInit(&hdr->mutex);
+	hdr->workers_total = nworkers;
+	hdr->workers_attached = 0;
+	hdr->workers_finished = 0;
+	hdr->npages = npages;
+	hdr->pages = 0;
+	hdr->lossy_pages = 0;
+	hdr->tuples = 0;
+	hdr->bad_pages = 0;
+	shm_toc_insert(toc, TEST_TIDBITMAP_KEY_HEADER, (void *) hdr);
+
+	claims = shm_toc_allocate(toc, mul_size(npages, sizeof(pg_atomic_uint32)));
+	for (blkno = 0; blkno < npages; blkno++)
+		pg_atomic_init_u32(&claims[blkno], 0);
+	shm_toc_insert(toc, TEST_TIDBITMAP_KEY_CLAIMS, claims);
+
+	/*
+	 * Copy the bitmap into the segment.  The local bitmap is not needed any
+	 * more after that; free it, so that any pointer into it left in the copy
+	 * would show up.
+	 */
+	istate = tbm_prepare_shared_iterate(tbm,
+										shm_toc_allocate(toc, istate_size));
+	shm_toc_insert(toc, TEST_TIDBITMAP_KEY_BITMAP, istate);
+	tbm_free(tbm);
+
+	/*
+	 * Start the workers, and wait for all of them to attach, so that they
+	 * really compete with us for the pages.
+	 */
+	wstate = launch_workers(seg, nworkers);
+	wait_for_workers_to_attach(wstate, hdr);
+
+	iterate_shared_bitmap(hdr, claims, istate);
+
+	for (i = 0; i < wstate->nworkers; i++)
+	{
+		if (WaitForBackgroundWorkerShutdown(wstate->handle[i]) ==
+			BGWH_POSTMASTER_DIED)
+			ereport(ERROR,
+					(errcode(ERRCODE_ADMIN_SHUTDOWN),
+					 errmsg("postmaster exited during a parallel operation")));
+	}
+	if (hdr->workers_finished != nworkers)
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("one or more background workers failed")));
+
+	/* Every page in the bitmap must have been returned exactly once. */
+	for (blkno = 0; blkno < npages; blkno++)
+	{
+		uint32		nclaims = pg_atomic_read_u32(&claims[blkno]);
+
+		if (nclaims != (PAGE_IN_BITMAP(blkno) ? 1 : 0))
+			elog(ERROR, "page %u was returned %u times", blkno, nclaims);
+	}
+	if (hdr->bad_pages > 0)
+		elog(ERROR, INT64_FORMAT " pages were returned with the wrong tuples",
+			 hdr->bad_pages);
+
+	values[0] = Int64GetDatum(hdr->pages);
+	values[1] = Int64GetDatum(hdr->lossy_pages);
+	values[2] = Int64GetDatum(hdr->tuples);
+	memset(nulls, 0, sizeof(nulls));
+
+	dsm_detach(seg);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Register the background workers.  They are terminated if we bail out
+ * before they are done.
+ */
+static worker_state *
+launch_workers(dsm_segment *seg, int nworkers)
+{
+	worker_state *wstate;
+	BackgroundWorker worker;
+	int			i;
+
+	wstate = MemoryContextAlloc(CurTransactionContext,
+								offsetof(worker_state, handle) +
+								sizeof(BackgroundWorkerHandle *) * nworkers);
+	wstate->nworkers = 0;
+
+	on_dsm_detach(seg, cleanup_background_workers, PointerGetDatum(wstate));
+
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	worker.bgw_main = NULL;		/* new worker might not have library loaded */
+	sprintf(worker.bgw_library_name, "test_tidbitmap");
+	sprintf(worker.bgw_function_name, "test_tidbitmap_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "test_tidbitmap");
+	worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(seg));
+	/* set bgw_notify_pid, so we can wait for the worker to stop */
+	worker.bgw_notify_pid = MyProcPid;
+
+	for (i = 0; i < nworkers; i++)
+	{
+		if (!RegisterDynamicBackgroundWorker(&worker,
+											 &wstate->handle[wstate->nworkers]))
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("could not register background process"),
+				 errhint("You may need to increase max_worker_processes.")));
+		wstate->nworkers++;
+	}
+
+	return wstate;
+}
+
+static void
+cleanup_background_workers(dsm_segment *seg, Datum arg)
+{
+	worker_state *wstate = (worker_state *) DatumGetPointer(arg);
+
+	while (wstate->nworkers > 0)
+	{
+		--wstate->nworkers;
+		TerminateBackgroundWorker(wstate->handle[wstate->nworkers]);
+	}
+}
+
+static void
+wait_for_workers_to_attach(worker_state *wstate,
+						   volatile test_tidbitmap_header *hdr)
+{
+	for (;;)
+	{
+		int			workers_attached;
+		int			workers_finished;
+
+		SpinLockAcquire(&hdr->mutex);
+		workers_attached = hdr->workers_attached;
+		workers_finished = hdr->workers_finished;
+		SpinLockRelease(&hdr->mutex);
+
+		if (workers_attached >= wstate->nworkers)
+			break;
+
+		/*
+		 * A worker may be done before the others have even started, but one
+		 * that has stopped without finishing its part has failed.
+		 */
+		if (count_stopped_workers(wstate) > workers_finished)
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("one or more background workers failed to start")));
+
+		/* The workers set our latch when they attach; poll just in case. */
+		WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT, 10L);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+static int
+count_stopped_workers(worker_state *wstate)
+{
+	int			nstopped = 0;
+	int			n;
+
+	for (n = 0; n < wstate->nworkers; ++n)
+	{
+		BgwHandleStatus status;
+		pid_t		pid;
+
+		status = GetBackgroundWorkerPid(wstate->handle[n], &pid);
+		if (status == BGWH_POSTMASTER_DIED)
+			ereport(ERROR,
+					(errcode(ERRCODE_ADMIN_SHUTDOWN),
+					 errmsg("postmaster exited during a parallel operation")));
+		if (status == BGWH_STOPPED)
+			nstopped++;
+	}
+
+	return nstopped;
+}
+
+/*
+ * Pull pages from the shared bitmap until there are none left, and check
+ * each one against what was put in the bitmap.
+ */
+static void
+iterate_shared_bitmap(volatile test_tidbitmap_header *hdr,
+					  pg_atomic_uint32 *claims,
+					  TBMSharedIteratorState *istate)
+{
+	TBMSharedIterator *iterator;
+	TBMIterateResult *tbmres;
+	int64		pages = 0;
+	int64		lossy_pages = 0;
+	int64		tuples = 0;
+	int64		bad_pages = 0;
+
+	iterator = tbm_attach_shared_iterate(istate);
+	while ((tbmres = tbm_shared_iterate(iterator)) != NULL)
+	{
+		BlockNumber blkno = tbmres->blockno;
+		int			i;
+
+		CHECK_FOR_INTERRUPTS();
+
+		pages++;
+		if (blkno >= hdr->npages || !PAGE_IN_BITMAP(blkno))
+		{
+			bad_pages++;
+			continue;
+		}
+		pg_atomic_fetch_add_u32(&claims[blkno], 1);
+
+		/*
+		 * Checking a page takes hardly any time, so give the others a chance
+		 * to claim some pages too, even on a single CPU.
+		 */
+		if (pages % 64 == 0)
+			pg_usleep(100L);
+
+		if (tbmres->ntuples < 0)
+		{
+			lossy_pages++;
+			continue;
+		}
+
+		tuples += tbmres->ntuples;
+		if (tbmres->ntuples != TUPLES_ON_PAGE(blkno) || tbmres->recheck)
+		{
+			bad_pages++;
+			continue;
+		}
+		for (i = 0; i < tbmres->ntuples; i++)
+		{
+			if (tbmres->offsets[i] != i + 1)
+			{
+				bad_pages++;
+				break;
+			}
+		}
+	}
+	tbm_end_shared_iterate(iterator);
+
+	SpinLockAcquire(&hdr->mutex);
+	hdr->pages += pages;
+	hdr->lossy_pages += lossy_pages;
+	hdr->tuples += tuples;
+	hdr->bad_pages += bad_pages;
+	SpinLockRelease(&hdr->mutex);
+}
+
+/*
+ * Background worker entrypoint.
+ */
+void
+test_tidbitmap_main(Datum main_arg)
+{
+	dsm_segment *seg;
+	shm_toc    *toc;
+	volatile test_tidbitmap_header *hdr;
+	pg_atomic_uint32 *claims;
+	TBMSharedIteratorState *istate;
+	int			myworkernumber;
+	PGPROC	   *registrant;
+
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "test_tidbitmap worker");
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("unable to map dynamic shared memory segment")));
+	toc = shm_toc_attach(PG_TEST_TIDBITMAP_MAGIC, dsm_segment_address(seg));
+	if (toc == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			   errmsg("bad magic number in dynamic shared memory segment")));
+
+	hdr = shm_toc_lookup(toc, TEST_TIDBITMAP_KEY_HEADER);
+	claims = shm_toc_lookup(toc, TEST_TIDBITMAP_KEY_CLAIMS);
+	istate = shm_toc_lookup(toc, TEST_TIDBITMAP_KEY_BITMAP);
+
+	SpinLockAcquire(&hdr->mutex);
+	myworkernumber = ++hdr->workers_attached;
+	SpinLockRelease(&hdr->mutex);
+	if (myworkernumber > hdr->workers_total)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("too many tidbitmap testing workers already")));
+
+	/* Let the user backend know we're here. */
+	registrant = BackendPidGetProc(MyBgworkerEntry->bgw_notify_pid);
+	if (registrant == NULL)
+	{
+		elog(DEBUG1, "registrant backend has exited prematurely");
+		proc_exit(1);
+	}
+	SetLatch(&registrant->procLatch);
+
+	/* Wait for the other workers, so that we all start at the same time. */
+	for (;;)
+	{
+		int			workers_attached;
+
+		SpinLockAcquire(&hdr->mutex);
+		workers_attached = hdr->workers_attached;
+		SpinLockRelease(&hdr->mutex);
+		if (workers_attached >= hdr->workers_total)
+			break;
+
+		pg_usleep(1000L);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	iterate_shared_bitmap(hdr, claims, istate);
+
+	SpinLockAcquire(&hdr->mutex);
+	++hdr->workers_finished;
+	SpinLockRelease(&hdr->mutex);
+
+	dsm_detach(seg);
+	proc_exit(1);
+}
@@ -421,3 +421,81 @@ UPDATE brintest SET textcol = '' WHERE textcol IS NOT NULL;
 SELECT brin_summarize_new_values('brintest'); -- error, not an index
 SELECT brin_summarize_new_values('tenk1_unique1'); -- error, not a BRIN index
 SELECT brin_summarize_new_values('brinidx'); -- ok, no change expected
+
+-- Test brin_summarize_range
+CREATE TABLE brin_summarize (
+    value int
+) WITH (fillfactor=10, autovacuum_enabled=false);
+CREATE INDEX brin_summarize_idx ON brin_summarize USING brin (value) WITH (pages_per_range=2);
+-- Fill a few pages
+DO $$
+DECLARE curtid tid;
+BEGIN
+  LOOP
+    INSERT INTO brin_summarize VALUES (1) RETURNING ctid INTO curtid;
+    EXIT WHEN curtid > tid '(2, 0)';
+  END LOOP;
+END;
+$$;
+
+-- nothing: the build summarized the first range, though the table was empty
+SELECT brin_summarize_range('brin_summarize_idx', 0);
+-- nothing: block 1 is in the first range too
+SELECT brin_summarize_range('brin_summarize_idx', 1);
+-- summarize one range
+SELECT brin_summarize_range('brin_summarize_idx', 2);
+-- nothing: page doesn't exist in table
+SELECT brin_summarize_range('brin_summarize_idx', 4294967294);
+-- all ranges: nothing left to do
+SELECT brin_summarize_range('brin_summarize_idx', 4294967295);
+-- invalid block number values
+SELECT brin_summarize_range('brin_summarize_idx', -1);
+SELECT brin_summarize_range('brin_summarize_idx', 4294967296);
+
+-- autosummarize is a valid storage parameter for BRIN only
+ALTER INDEX brin_summarize_idx SET (autosummarize = on);
+CREATE INDEX brin_summarize_btree ON brin_summarize (value) WITH (autosummarize = on);
+
+DROP TABLE brin_summarize;
+
+-- Test bloom and minmax-multi opclasses
+CREATE TABLE brin_other (
+    id int,
+    val int8,
+    ts timestamp,
+    u uuid
+) WITH (fillfactor=10, autovacuum_enabled=false);
+INSERT INTO brin_other
+  SELECT i, (i * 7919) % 1000, timestamp '2015-01-01' + i * interval '1 hour',
+         md5(i::text)::uuid
+  FROM generate_series(1, 1000) i;
+CREATE INDEX brin_other_bloom ON brin_other
+  USING brin (id int4_bloom_ops, u uuid_bloom_ops) WITH (pages_per_range=4);
+CREATE INDEX brin_other_multi ON brin_other
+  USING brin (val int8_minmax_multi_ops, ts timestamp_minmax_multi_ops)
+  WITH (pages_per_range=4);
+-- add some values after the build, and summarize them
+INSERT INTO brin_other
+  SELECT i, (i * 7919) % 1000, timestamp '2015-01-01' + i * interval '1 hour',
+         md5(i::text)::uuid
+  FROM generate_series(1001, 1200) i;
+SELECT brin_summarize_new_values('brin_other_bloom') > 0 AS summarized;
+SELECT brin_summarize_new_values('brin_other_multi') > 0 AS summarized;
+
+SET enable_seqscan = off;
+SELECT count(*) FROM brin_other WHERE id = 500;
+SELECT count(*) FROM brin_other WHERE id = 1100::int8;
+SELECT count(*) FROM brin_other WHERE u = md5('700')::uuid;
+SELECT count(*) FROM brin_other WHERE id IS NULL;
+SELECT count(*) FROM brin_other WHERE val = 3;
+SELECT count(*) FROM brin_other WHERE val < 10;
+SELECT count(*) FROM brin_other WHERE val >= 990::int2;
+SELECT count(*) FROM brin_other WHERE ts BETWEEN '2015-01-02' AND '2015-01-03';
+SELECT count(*) FROM brin_other WHERE ts = '2015-01-05 01:00';
+SELECT count(*) FROM brin_other WHERE ts >= '2015-02-19';
+RESET enable_seqscan;
+
+-- bloom opclasses support only equality
+EXPLAIN (COSTS OFF) SELECT * FROM brin_other WHERE id < 10;
+
+DROP TABLE brin_other;
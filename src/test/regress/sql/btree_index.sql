@@ -92,3 +92,103 @@ vacuum btree_tall_tbl;
 -- need to insert some rows to cause the fast root page to split.
 insert into btree_tall_tbl (id, t)
   select g, repeat('x', 100) from generate_series(1, 500) g;
+
+--
+-- Test deduplication of equal keys into posting list tuples
+--
+create table btree_dedup_tbl(id int4, grp int4);
+create index btree_dedup_idx on btree_dedup_tbl (grp);
+create index btree_nodedup_idx on btree_dedup_tbl (grp)
+  with (deduplicate_items = off);
+create index btree_baddedup_idx on btree_dedup_tbl (grp)
+  with (deduplicate_items = bogus);
+insert into btree_dedup_tbl select g, g % 10 from generate_series(1, 10000) g;
+
+-- Full leaf pages merge their duplicates rather than splitting
+select pg_relation_size('btree_dedup_idx') <
+       pg_relation_size('btree_nodedup_idx') as dedup_smaller;
+drop index btree_nodedup_idx;
+
+-- Every heap TID of a posting list must be returned, in either direction
+set enable_seqscan to false;
+set enable_indexscan to true;
+set enable_bitmapscan to false;
+select count(*), sum(id) from btree_dedup_tbl where grp = 3;
+select count(*), min(grp), max(grp) from
+  (select grp from btree_dedup_tbl where grp >= 8 order by grp desc limit 1005) s;
+
+set enable_indexscan to false;
+set enable_bitmapscan to true;
+select count(*), sum(id) from btree_dedup_tbl where grp = 3;
+
+-- VACUUM removes dead TIDs from posting lists, and whole posting lists
+delete from btree_dedup_tbl where id % 3 = 0 or grp = 5;
+vacuum btree_dedup_tbl;
+select count(*), sum(id) from btree_dedup_tbl where grp = 3;
+select count(*) from btree_dedup_tbl where grp = 5;
+
+insert into btree_dedup_tbl select g, 5 from generate_series(1, 1000) g;
+set enable_indexscan to true;
+set enable_bitmapscan to false;
+select count(*), sum(id) from btree_dedup_tbl where grp = 5;
+
+-- Index build merges duplicates too
+create index btree_dedup_build_idx on btree_dedup_tbl (grp);
+drop index btree_dedup_idx;
+select count(*), sum(id) from btree_dedup_tbl where grp = 3;
+
+reset enable_seqscan;
+reset enable_indexscan;
+reset enable_bitmapscan;
+drop table btree_dedup_tbl;
+
+--
+-- Test the rightmost leaf insertion fastpath
+--
+-- The wide keys make the tree tall enough for the fastpath with few rows.
+-- Increasing keys all go to the rightmost leaf, which each insertion after
+-- the first one caches for the next.
+--
+create table btree_fastpath_tbl (k text primary key, id int4);
+insert into btree_fastpath_tbl
+  select lpad(g::text, 200, '0'), g from generate_series(1, 3000) g;
+
+-- Duplicates of keys on the cached leaf are still caught
+\set VERBOSITY terse
+insert into btree_fastpath_tbl values (lpad('3000', 200, '0'), 0);
+insert into btree_fastpath_tbl values (lpad('2990', 200, '0'), 0);
+
+-- A key below the cached leaf takes the normal path
+insert into btree_fastpath_tbl values (lpad('0', 200, '0'), 0);
+
+-- Delete the rightmost keys, and insert them again and beyond
+delete from btree_fastpath_tbl where id > 2500;
+vacuum btree_fastpath_tbl;
+insert into btree_fastpath_tbl
+  select lpad(g::text, 200, '0'), g from generate_series(2501, 4000) g;
+insert into btree_fastpath_tbl values (lpad('2501', 200, '0'), 0);
+\set VERBOSITY default
+
+set enable_seqscan to false;
+set enable_indexscan to true;
+set enable_bitmapscan to false;
+select count(*), sum(id), min(id), max(id) from btree_fastpath_tbl
+  where k > lpad('2400', 200, '0');
+select count(*) from btree_fastpath_tbl where k < lpad('1', 200, '0');
+
+--
+-- Increasing keys within a key prefix: leaf pages are split after the
+-- last key of a group, and the index must stay consistent
+--
+create table btree_prefix_tbl (grp int4, seq int4);
+create index btree_prefix_idx on btree_prefix_tbl (grp, seq);
+insert into btree_prefix_tbl select g % 10, g from generate_series(1, 20000) g;
+select count(*), sum(seq), min(seq), max(seq) from btree_prefix_tbl
+  where grp = 3;
+select count(*) from btree_prefix_tbl where grp = 7 and seq > 19000;
+
+reset enable_seqscan;
+reset enable_indexscan;
+reset enable_bitmapscan;
+drop table btree_fastpath_tbl;
+drop table btree_prefix_tbl;
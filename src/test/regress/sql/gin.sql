@@ -10,8 +10,16 @@ create index gin_test_idx on gin_test_tbl using gin (i) with (fastupdate = on);
 insert into gin_test_tbl select array[1, 2, g] from generate_series(1, 20000) g;
 insert into gin_test_tbl select array[1, 3, g] from generate_series(1, 1000) g;
 
+select gin_clean_pending_list('gin_test_idx')>10 as many; -- flush the fastupdate buffers
+
+insert into gin_test_tbl select array[3, 1, g] from generate_series(1, 1000) g;
+
 vacuum gin_test_tbl; -- flush the fastupdate buffers
 
+select gin_clean_pending_list('gin_test_idx'); -- nothing to flush
+
+select gin_clean_pending_list('gin_test_tbl'); -- error, not an index
+
 -- Test vacuuming
 delete from gin_test_tbl where i @> array[2];
 vacuum gin_test_tbl;
@@ -24,6 +24,34 @@ delete from gist_point_tbl where id < 10000;
 
 vacuum analyze gist_point_tbl;
 
+-- Rebuild the index.  The point opclass supports sorted build, so this
+-- packs the tree bottom-up; check that it still finds the right rows.
+reindex index gist_pointidx;
+
+set enable_seqscan=off;
+set enable_bitmapscan=off;
+
+select count(*) from gist_point_tbl where p <@ box(point(0,0), point(100000, 100000));
+
+select p from gist_point_tbl order by p <-> point(50000, 50000) limit 3;
+
+-- Split the pages of the sorted-built tree.  Under wal_level = minimal the
+-- build doesn't WAL-log its pages, and scans and vacuum must still see the
+-- splits through the page LSNs.
+insert into gist_point_tbl (id, p)
+select g+200000, point(g*10+2, g*10+2) from generate_series(1, 10000) g;
+
+delete from gist_point_tbl where id >= 200000 and id % 3 = 0;
+
+vacuum gist_point_tbl;
+
+select count(*) from gist_point_tbl where p <@ box(point(0,0), point(100000, 100000));
+
+select p from gist_point_tbl order by p <-> point(50000, 50000) limit 3;
+
+reset enable_seqscan;
+reset enable_bitmapscan;
+
 
 --
 -- Test Index-only plans on GiST indexes